@@ -0,0 +1,69 @@
+#ifndef CX_ARENA_ALLOCATOR_H
+#define CX_ARENA_ALLOCATOR_H
+#include <stddef.h>
+#include "cx_alloc.h"
+
+// Arena allocator opaque type
+typedef struct CxArenaAllocator CxArenaAllocator;
+
+// Arena allocator creation flags
+typedef enum {
+    CxArenaFlagHugePages = 1 << 0,  // Requests transparent huge pages for the arena (madvise(MADV_HUGEPAGE))
+    CxArenaFlagPrefault  = 1 << 1,  // Maps all the pages of the arena on creation
+} CxArenaFlags;
+
+// Arena allocator stats
+typedef struct CxArenaAllocatorStats {
+    size_t nallocs;         // Number of individual allocations
+    size_t nbytes;          // Total number of requested bytes
+    size_t usedBytes;       // Number of bytes used from the arena including alignment padding
+    size_t reservedBytes;   // Size of the reserved virtual address range
+} CxArenaAllocatorStats;
+
+// Creates an arena allocator which reserves a range of 'reserve' bytes of virtual memory
+// with mmap() and allocates from it by incrementing an offset.
+// The reserve size is rounded up to the page size (or to the huge page size if
+// CxArenaFlagHugePages is set) and physical memory is only used for the touched pages,
+// unless CxArenaFlagPrefault is set.
+// Freeing an area only releases its memory if it is the last allocated area,
+// which can also be grown or shrunk in place by realloc.
+// Allocations which do not fit in the remaining range fail returning NULL.
+// Returns NULL if the range could not be reserved.
+// The allocator is thread safe.
+CxArenaAllocator* cx_arena_allocator_create(size_t reserve, CxArenaFlags flags);
+
+// Destroy a previously created arena allocator unmapping its range.
+void cx_arena_allocator_destroy(CxArenaAllocator* a);
+
+// Sets optional function called when an allocation does not fit in the arena
+void cx_arena_allocator_set_error_fn(CxArenaAllocator* a, CxAllocatorErrorFn fn, void* userdata);
+
+// Allocates size bytes using standard alignment and return its pointer
+void* cx_arena_allocator_alloc(CxArenaAllocator* a, size_t size);
+
+// Allocates size bytes using specified alignment and return its pointer
+void* cx_arena_allocator_alloc2(CxArenaAllocator* a, size_t size, size_t align);
+
+// Reallocates new area and copy old area to new area.
+// The last allocated area is grown or shrunk in place if possible.
+void* cx_arena_allocator_realloc(CxArenaAllocator* a, void* old_ptr, size_t old_size, size_t size);
+
+// Clears the allocator keeping the touched pages mapped, so new allocations
+// reuse them without page faults.
+// Must not be called concurrently with allocations.
+void cx_arena_allocator_clear(CxArenaAllocator* a);
+
+// Clears the allocator returning the physical memory of the touched pages to the
+// system with madvise(MADV_DONTNEED), keeping the reserved range.
+// This allocator can continue to be used.
+// Must not be called concurrently with allocations.
+void cx_arena_allocator_free(CxArenaAllocator* a);
+
+// Returns allocator interface
+const CxAllocator* cx_arena_allocator_iface(const CxArenaAllocator* a);
+
+// Returns allocator statistics
+CxArenaAllocatorStats cx_arena_allocator_stats(CxArenaAllocator* a);
+
+#endif
+
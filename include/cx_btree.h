@@ -0,0 +1,853 @@
+/*
+Ordered Map Implementation (B+ tree)
+------------------------------------
+- Entries are kept sorted by key in leaf nodes linked in key order,
+  so sorted iteration and range scans read consecutive entries.
+- Inner nodes only store separator keys and child pointers.
+- The size in bytes of the nodes is configurable, by default 4 cache lines,
+  and determines the number of entries and keys of each node.
+- Insert, delete and find are O(log n).
+- Inserting after the last entry splits the last leaf leaving it full,
+  so trees built by appending ordered keys have full leaves.
+- Trees can be bulk loaded from sorted input with full leaves.
+- Uses global type allocator initialized with default allocator.
+- Can be configured to use custom allocator per instance.
+
+Example
+-------
+
+#include <stdio.h>
+#include <assert.h>
+#define cx_btree_name bt
+#define cx_btree_key int
+#define cx_btree_val double
+#define cx_btree_implement
+#include "cx_btree.h"
+
+int main() {
+
+    bt t = bt_init();
+    for (int i = 0; i < 100; i++) {
+        bt_set(&t, i, i * 2.0);
+    }
+    assert(*bt_get(&t, 10) == 20.0);
+
+    // Iterate over entries with keys in the range [10, 20)
+    bt_iter iter = bt_lower_bound(&t, 10);
+    bt_entry* e;
+    while ((e = bt_next(&t, &iter)) != NULL && e->key < 20) {
+        printf("key:%d val:%f\n", e->key, e->val);
+    }
+    bt_free(&t);
+    return 0;
+}
+
+
+Configuration
+-------------
+
+Define the name of the tree type (mandatory):
+    #define cx_btree_name <name>
+
+Define the type of the tree key (mandatory):
+    #define cx_btree_key <type>
+
+Define the type of the tree value (mandatory):
+    #define cx_btree_val <type>
+
+Define the size in bytes of the tree nodes.
+Leaf nodes store up to (size - 16) / sizeof(entry) entries and inner nodes
+up to (size - 16) / (sizeof(key) + sizeof(pointer)) keys, with a minimum of 4.
+The default is 256 (4 cache lines).
+    #define cx_btree_node_size <size>
+
+Define the key comparison function, which receives pointers to the keys:
+int (*cmp)(const ktype* k1, const ktype* k2, size_t size);
+Returns a negative value if k1 < k2, 0 if k1 == k2 or a positive value if k1 > k2.
+The default comparison function uses the relational operators,
+and can be used with keys of arithmetic or pointer types.
+    #define cx_btree_cmp_key(pk1,pk2,s) <cmp_func>
+    example for tree<char*, T>:
+        #define cx_btree_cmp_key(pk1,pk2,s) strcmp(*(pk1),*(pk2))
+
+Define function to free the key of deleted entries:
+void (*free)(void* key);
+By default no function is defined.
+    #define cx_btree_free_key(pk) <free_func>
+
+Define function to free the value of deleted entries:
+void (*free)(void* val);
+By default no function is defined.
+    #define cx_btree_free_val(pv) <free_func>
+
+Define optional custom allocator pointer or function call which return pointer to allocator.
+Uses default allocator if not defined.
+This allocator will be used for all instances of this type.
+    #define cx_btree_allocator <allocator>
+
+Sets if tree uses custom allocator per instance.
+If set, it is necessary to initialize each tree with the desired allocator.
+    #define cx_btree_instance_allocator
+
+Sets if all tree functions are prefixed with 'static'
+    #define cx_btree_static
+
+Sets if all tree functions are prefixed with 'inline'
+    #define cx_btree_inline
+
+Sets to implement functions in this translation unit:
+    #define cx_btree_implement
+
+
+API
+---
+
+Assuming:
+#define cx_btree_name bt        // Tree type name
+#define cx_btree_key  ktype     // Type of key
+#define cx_btree_val  vtype     // Type of value
+
+Initialize tree defined with custom allocator
+    bt bt_init(const CxAllocator* alloc);
+
+Initialize tree NOT defined with custom allocator
+    bt bt_init(void);
+
+Free tree allocated memory
+    void bt_free(bt* t);
+
+Sets the value associated with the specified key.
+If the key is already in the tree, its value is replaced and
+the specified key is freed (if cx_btree_free_key is defined).
+    void bt_set(bt* t, ktype k, vtype v);
+
+Returns pointer to value associated with the specified key.
+Returns NULL if not found.
+    vtype* bt_get(const bt* t, ktype k);
+
+Deletes entry with the specified key.
+Returns true if found or false otherwise.
+    bool bt_del(bt* t, ktype k);
+
+Loads 'n' keys and values, which must be sorted by key without duplicates,
+into an empty tree, filling the leaves and building the inner nodes bottom up.
+Returns false if the tree is not empty or the keys are not strictly ascending,
+without changing the tree.
+    bool bt_load_sorted(bt* t, const ktype* keys, const vtype* vals, size_t n);
+
+Returns the number of entries in the tree
+    size_t bt_count(const bt* t);
+
+Clears the tree, freeing all its nodes.
+    void bt_clear(bt* t);
+
+Returns iterator positioned at the first entry with key equal or greater than
+the specified key, or at the end of the tree.
+    bt_iter bt_lower_bound(const bt* t, ktype k);
+
+Returns iterator positioned at the first entry with key greater than
+the specified key, or at the end of the tree.
+    bt_iter bt_upper_bound(const bt* t, ktype k);
+
+Returns the entry at the iterator position and advances the iterator
+to the next entry in key order. Returns NULL at the end of the tree.
+A zero initialized iterator starts at the first entry.
+The tree must not be modified while the iterator is in use.
+    bt_entry* bt_next(const bt* t, bt_iter* iter);
+
+*/
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include "cx_alloc.h"
+
+#ifndef cx_btree_name
+    #error "cx_btree_name not defined"
+#endif
+#ifndef cx_btree_key
+    #error "cx_btree_key not defined"
+#endif
+#ifndef cx_btree_val
+    #error "cx_btree_val not defined"
+#endif
+
+#ifndef cx_btree_node_size
+    #define cx_btree_node_size (256)
+#endif
+
+// Default key comparison function
+#ifndef cx_btree_cmp_key
+    #define cx_btree_cmp_key(pk1,pk2,s) ((*(pk1) > *(pk2)) - (*(pk1) < *(pk2)))
+#endif
+#define cx_btree_cmp_(pk1,pk2) cx_btree_cmp_key(pk1,pk2,sizeof(cx_btree_key))
+
+// Default free key function
+#ifndef cx_btree_free_key
+    #define cx_btree_free_key_(key)
+#else
+    #define cx_btree_free_key_(key) cx_btree_free_key(key)
+#endif
+
+// Default free value function
+#ifndef cx_btree_free_val
+    #define cx_btree_free_val_(val)
+#else
+    #define cx_btree_free_val_(val) cx_btree_free_val(val)
+#endif
+
+// Auxiliary internal macros
+#define cx_btree_concat2_(a, b) a ## b
+#define cx_btree_concat1_(a, b) cx_btree_concat2_(a, b)
+#define cx_btree_name_(name) cx_btree_concat1_(cx_btree_name, name)
+
+// API attributes
+#if defined(cx_btree_static) && defined(cx_btree_inline)
+    #define cx_btree_api_ static inline
+#elif defined(cx_btree_static)
+    #define cx_btree_api_ static
+#elif defined(cx_btree_inline)
+    #define cx_btree_api_ inline
+#else
+    #define cx_btree_api_
+#endif
+
+// Default allocator
+#ifndef cx_btree_allocator
+    #define cx_btree_allocator cx_def_allocator()
+#endif
+
+// Use custom instance allocator
+#ifdef cx_btree_instance_allocator
+    #define cx_btree_alloc_field_\
+        const CxAllocator* alloc_;
+    #define cx_btree_alloc_(t,n)\
+        cx_alloc_malloc((t)->alloc_, n)
+    #define cx_btree_free_(t,p,n)\
+        cx_alloc_free((t)->alloc_, p, n)
+// Use global type allocator
+#else
+    #define cx_btree_alloc_field_
+    #define cx_btree_alloc_(t,n)\
+        cx_alloc_malloc(cx_btree_allocator,n)
+    #define cx_btree_free_(t,p,n)\
+        cx_alloc_free(cx_btree_allocator,p,n)
+#endif
+
+//
+// Declarations
+//
+
+typedef struct cx_btree_name_(_entry) {
+    cx_btree_key key;
+    cx_btree_val val;
+} cx_btree_name_(_entry);
+
+// Maximum number of entries of leaf nodes and of keys of inner nodes
+#define cx_btree_max_(n) ((n) < 4 ? 4 : (n))
+#define cx_btree_leaf_max_\
+    cx_btree_max_((cx_btree_node_size - 16) / sizeof(cx_btree_name_(_entry)))
+#define cx_btree_inner_max_\
+    cx_btree_max_((cx_btree_node_size - 16) / (sizeof(cx_btree_key) + sizeof(void*)))
+
+// Minimum number of entries or keys of nodes after deletes
+#define cx_btree_leaf_min_  (cx_btree_leaf_max_ / 2)
+#define cx_btree_inner_min_ (cx_btree_inner_max_ / 2)
+
+typedef struct cx_btree_name_(_leaf_) {
+    uint32_t count_;
+    struct cx_btree_name_(_leaf_)* next_;
+    cx_btree_name_(_entry) entries_[cx_btree_leaf_max_];
+} cx_btree_name_(_leaf_);
+
+typedef struct cx_btree_name_(_inner_) {
+    uint32_t count_;                            // Number of keys
+    cx_btree_key keys_[cx_btree_inner_max_];    // Key i is the first key of the child i+1
+    void* children_[cx_btree_inner_max_ + 1];
+} cx_btree_name_(_inner_);
+
+typedef struct cx_btree_name {
+    cx_btree_alloc_field_
+    size_t  count_;     // Number of entries
+    size_t  height_;    // Number of inner node levels
+    void*   root_;      // Root node or NULL if empty
+} cx_btree_name;
+
+typedef struct cx_btree_name_(_iter) {
+    cx_btree_name_(_leaf_)* leaf_;
+    size_t idx_;
+} cx_btree_name_(_iter);
+
+#ifdef cx_btree_instance_allocator
+    cx_btree_api_ cx_btree_name cx_btree_name_(_init)(const CxAllocator* alloc);
+#else
+    cx_btree_api_ cx_btree_name cx_btree_name_(_init)(void);
+#endif
+cx_btree_api_ void cx_btree_name_(_free)(cx_btree_name* t);
+cx_btree_api_ void cx_btree_name_(_set)(cx_btree_name* t, cx_btree_key k, cx_btree_val v);
+cx_btree_api_ cx_btree_val* cx_btree_name_(_get)(const cx_btree_name* t, cx_btree_key k);
+cx_btree_api_ bool cx_btree_name_(_del)(cx_btree_name* t, cx_btree_key k);
+cx_btree_api_ bool cx_btree_name_(_load_sorted)(cx_btree_name* t, cx_btree_key const* keys, cx_btree_val const* vals, size_t n);
+cx_btree_api_ size_t cx_btree_name_(_count)(const cx_btree_name* t);
+cx_btree_api_ void cx_btree_name_(_clear)(cx_btree_name* t);
+cx_btree_api_ cx_btree_name_(_iter) cx_btree_name_(_lower_bound)(const cx_btree_name* t, cx_btree_key k);
+cx_btree_api_ cx_btree_name_(_iter) cx_btree_name_(_upper_bound)(const cx_btree_name* t, cx_btree_key k);
+cx_btree_api_ cx_btree_name_(_entry)* cx_btree_name_(_next)(const cx_btree_name* t, cx_btree_name_(_iter)* iter);
+
+//
+// Implementation
+//
+#ifdef cx_btree_implement
+
+    // Index of the iterator at the end of the tree
+    #define cx_btree_end_ (SIZE_MAX)
+
+    // Returns the index of the first entry of the leaf with key >= 'key' (or > 'key' if 'upper')
+    static inline size_t cx_btree_name_(_leaf_find_)(const cx_btree_name_(_leaf_)* l, cx_btree_key const* key, bool upper) {
+
+        size_t lo = 0;
+        size_t hi = l->count_;
+        while (lo < hi) {
+            const size_t mid = (lo + hi) / 2;
+            const int res = cx_btree_cmp_(&l->entries_[mid].key, key);
+            if (res < 0 || (upper && res == 0)) {
+                lo = mid + 1;
+            } else {
+                hi = mid;
+            }
+        }
+        return lo;
+    }
+
+    // Returns the index of the child of the inner node which contains 'key':
+    // the number of separator keys <= 'key'.
+    static inline size_t cx_btree_name_(_inner_find_)(const cx_btree_name_(_inner_)* n, cx_btree_key const* key) {
+
+        size_t lo = 0;
+        size_t hi = n->count_;
+        while (lo < hi) {
+            const size_t mid = (lo + hi) / 2;
+            if (cx_btree_cmp_(&n->keys_[mid], key) <= 0) {
+                lo = mid + 1;
+            } else {
+                hi = mid;
+            }
+        }
+        return lo;
+    }
+
+    // Returns the leaf which contains 'key'
+    static inline cx_btree_name_(_leaf_)* cx_btree_name_(_find_leaf_)(const cx_btree_name* t, cx_btree_key const* key) {
+
+        void* node = t->root_;
+        for (size_t h = t->height_; h > 0; h--) {
+            const cx_btree_name_(_inner_)* n = node;
+            node = n->children_[cx_btree_name_(_inner_find_)(n, key)];
+        }
+        return node;
+    }
+
+    // Returns pointer to the first key of the subtree with the specified height
+    static inline cx_btree_key* cx_btree_name_(_min_key_)(void* node, size_t height) {
+
+        for (; height > 0; height--) {
+            node = ((cx_btree_name_(_inner_)*)node)->children_[0];
+        }
+        return &((cx_btree_name_(_leaf_)*)node)->entries_[0].key;
+    }
+
+    static cx_btree_name_(_leaf_)* cx_btree_name_(_new_leaf_)(cx_btree_name* t) {
+
+        cx_btree_name_(_leaf_)* l = cx_btree_alloc_(t, sizeof(cx_btree_name_(_leaf_)));
+        l->count_ = 0;
+        l->next_ = NULL;
+        return l;
+    }
+
+    static cx_btree_name_(_inner_)* cx_btree_name_(_new_inner_)(cx_btree_name* t) {
+
+        cx_btree_name_(_inner_)* n = cx_btree_alloc_(t, sizeof(cx_btree_name_(_inner_)));
+        n->count_ = 0;
+        return n;
+    }
+
+    // Frees the subtree with the specified height
+    static void cx_btree_name_(_free_node_)(cx_btree_name* t, void* node, size_t height) {
+
+        if (height == 0) {
+            cx_btree_name_(_leaf_)* l = node;
+#if defined(cx_btree_free_key) || defined(cx_btree_free_val)
+            for (size_t i = 0; i < l->count_; i++) {
+                cx_btree_free_key_(&l->entries_[i].key);
+                cx_btree_free_val_(&l->entries_[i].val);
+            }
+#endif
+            cx_btree_free_(t, l, sizeof(*l));
+            return;
+        }
+        cx_btree_name_(_inner_)* n = node;
+        for (size_t i = 0; i <= n->count_; i++) {
+            cx_btree_name_(_free_node_)(t, n->children_[i], height - 1);
+        }
+        cx_btree_free_(t, n, sizeof(*n));
+    }
+
+    // Inserts or updates entry in the subtree with the specified height.
+    // Returns 0 if updated, 1 if inserted, or 2 if inserted and the node was split,
+    // setting the first key of the new right node and the new node.
+    static int cx_btree_name_(_insert_)(cx_btree_name* t, void* node, size_t height,
+        cx_btree_key* key, cx_btree_val* val, cx_btree_key* sep, void** right) {
+
+        if (height == 0) {
+            cx_btree_name_(_leaf_)* l = node;
+            size_t idx = cx_btree_name_(_leaf_find_)(l, key, false);
+            if (idx < l->count_ && cx_btree_cmp_(&l->entries_[idx].key, key) == 0) {
+                // Keeps the current key, which may be used as separator in inner nodes
+                cx_btree_free_key_(key);
+                cx_btree_free_val_(&l->entries_[idx].val);
+                memcpy(&l->entries_[idx].val, val, sizeof(cx_btree_val));
+                return 0;
+            }
+            if (l->count_ < cx_btree_leaf_max_) {
+                memmove(&l->entries_[idx + 1], &l->entries_[idx], (l->count_ - idx) * sizeof(l->entries_[0]));
+                memcpy(&l->entries_[idx].key, key, sizeof(cx_btree_key));
+                memcpy(&l->entries_[idx].val, val, sizeof(cx_btree_val));
+                l->count_++;
+                return 1;
+            }
+            // Splits the leaf. Appending to the last leaf leaves it full.
+            cx_btree_name_(_leaf_)* r = cx_btree_name_(_new_leaf_)(t);
+            size_t mid = (cx_btree_leaf_max_ + 1) / 2;
+            if (idx == l->count_ && l->next_ == NULL) {
+                mid = cx_btree_leaf_max_;
+            }
+            cx_btree_name_(_leaf_)* dst = l;
+            if (idx < mid) {
+                mid--;
+            } else {
+                dst = r;
+            }
+            r->count_ = l->count_ - mid;
+            memcpy(r->entries_, &l->entries_[mid], r->count_ * sizeof(l->entries_[0]));
+            l->count_ = mid;
+            if (dst == r) {
+                idx -= mid;
+            }
+            memmove(&dst->entries_[idx + 1], &dst->entries_[idx], (dst->count_ - idx) * sizeof(l->entries_[0]));
+            memcpy(&dst->entries_[idx].key, key, sizeof(cx_btree_key));
+            memcpy(&dst->entries_[idx].val, val, sizeof(cx_btree_val));
+            dst->count_++;
+            r->next_ = l->next_;
+            l->next_ = r;
+            *sep = r->entries_[0].key;
+            *right = r;
+            return 2;
+        }
+
+        cx_btree_name_(_inner_)* n = node;
+        const size_t ci = cx_btree_name_(_inner_find_)(n, key);
+        cx_btree_key csep;
+        void* cright;
+        const int res = cx_btree_name_(_insert_)(t, n->children_[ci], height - 1, key, val, &csep, &cright);
+        if (res != 2) {
+            return res;
+        }
+        if (n->count_ < cx_btree_inner_max_) {
+            memmove(&n->keys_[ci + 1], &n->keys_[ci], (n->count_ - ci) * sizeof(n->keys_[0]));
+            memmove(&n->children_[ci + 2], &n->children_[ci + 1], (n->count_ - ci) * sizeof(n->children_[0]));
+            n->keys_[ci] = csep;
+            n->children_[ci + 1] = cright;
+            n->count_++;
+            return 1;
+        }
+        // Splits the inner node moving up its middle key
+        cx_btree_key keys[cx_btree_inner_max_ + 1];
+        void* children[cx_btree_inner_max_ + 2];
+        memcpy(keys, n->keys_, ci * sizeof(keys[0]));
+        keys[ci] = csep;
+        memcpy(&keys[ci + 1], &n->keys_[ci], (n->count_ - ci) * sizeof(keys[0]));
+        memcpy(children, n->children_, (ci + 1) * sizeof(children[0]));
+        children[ci + 1] = cright;
+        memcpy(&children[ci + 2], &n->children_[ci + 1], (n->count_ - ci) * sizeof(children[0]));
+        const size_t mid = (cx_btree_inner_max_ + 1) / 2;
+        cx_btree_name_(_inner_)* r = cx_btree_name_(_new_inner_)(t);
+        n->count_ = mid;
+        memcpy(n->keys_, keys, mid * sizeof(keys[0]));
+        memcpy(n->children_, children, (mid + 1) * sizeof(children[0]));
+        r->count_ = cx_btree_inner_max_ - mid;
+        memcpy(r->keys_, &keys[mid + 1], r->count_ * sizeof(keys[0]));
+        memcpy(r->children_, &children[mid + 1], (r->count_ + 1) * sizeof(children[0]));
+        *sep = keys[mid];
+        *right = r;
+        return 2;
+    }
+
+    // Fixes the child 'ci' of inner node 'n' with less than the minimum number of
+    // entries or keys, borrowing from a sibling or merging with it.
+    // Prefers the left sibling, so an empty leaf is always borrowed into or merged
+    // into its left sibling, which removes or updates its separator key.
+    static void cx_btree_name_(_rebalance_)(cx_btree_name* t, cx_btree_name_(_inner_)* n, size_t ci, size_t height) {
+
+        const size_t li = ci > 0 ? ci - 1 : ci;     // Index of left node of the pair
+        if (height == 0) {
+            cx_btree_name_(_leaf_)* c = n->children_[ci];
+            cx_btree_name_(_leaf_)* left = ci > 0 ? n->children_[ci - 1] : NULL;
+            cx_btree_name_(_leaf_)* right = ci < n->count_ ? n->children_[ci + 1] : NULL;
+            if (left && left->count_ > cx_btree_leaf_min_) {
+                memmove(&c->entries_[1], &c->entries_[0], c->count_ * sizeof(c->entries_[0]));
+                c->entries_[0] = left->entries_[--left->count_];
+                c->count_++;
+                n->keys_[ci - 1] = c->entries_[0].key;
+                return;
+            }
+            if (!left && right->count_ > cx_btree_leaf_min_) {
+                c->entries_[c->count_++] = right->entries_[0];
+                right->count_--;
+                memmove(&right->entries_[0], &right->entries_[1], right->count_ * sizeof(right->entries_[0]));
+                n->keys_[ci] = right->entries_[0].key;
+                return;
+            }
+            // Merges the right node of the pair into the left node
+            cx_btree_name_(_leaf_)* l = n->children_[li];
+            cx_btree_name_(_leaf_)* r = n->children_[li + 1];
+            memcpy(&l->entries_[l->count_], r->entries_, r->count_ * sizeof(r->entries_[0]));
+            l->count_ += r->count_;
+            l->next_ = r->next_;
+            cx_btree_free_(t, r, sizeof(*r));
+        } else {
+            cx_btree_name_(_inner_)* c = n->children_[ci];
+            cx_btree_name_(_inner_)* left = ci > 0 ? n->children_[ci - 1] : NULL;
+            cx_btree_name_(_inner_)* right = ci < n->count_ ? n->children_[ci + 1] : NULL;
+            if (left && left->count_ > cx_btree_inner_min_) {
+                memmove(&c->keys_[1], &c->keys_[0], c->count_ * sizeof(c->keys_[0]));
+                memmove(&c->children_[1], &c->children_[0], (c->count_ + 1) * sizeof(c->children_[0]));
+                c->keys_[0] = n->keys_[ci - 1];
+                c->children_[0] = left->children_[left->count_];
+                c->count_++;
+                n->keys_[ci - 1] = left->keys_[--left->count_];
+                return;
+            }
+            if (!left && right->count_ > cx_btree_inner_min_) {
+                c->keys_[c->count_] = n->keys_[ci];
+                c->children_[c->count_ + 1] = right->children_[0];
+                c->count_++;
+                n->keys_[ci] = right->keys_[0];
+                right->count_--;
+                memmove(&right->keys_[0], &right->keys_[1], right->count_ * sizeof(right->keys_[0]));
+                memmove(&right->children_[0], &right->children_[1], (right->count_ + 1) * sizeof(right->children_[0]));
+                return;
+            }
+            // Merges the right node of the pair and their separator key into the left node
+            cx_btree_name_(_inner_)* l = n->children_[li];
+            cx_btree_name_(_inner_)* r = n->children_[li + 1];
+            l->keys_[l->count_] = n->keys_[li];
+            memcpy(&l->keys_[l->count_ + 1], r->keys_, r->count_ * sizeof(r->keys_[0]));
+            memcpy(&l->children_[l->count_ + 1], r->children_, (r->count_ + 1) * sizeof(r->children_[0]));
+            l->count_ += r->count_ + 1;
+            cx_btree_free_(t, r, sizeof(*r));
+        }
+        // Removes the separator key and the merged right node from the parent
+        memmove(&n->keys_[li], &n->keys_[li + 1], (n->count_ - li - 1) * sizeof(n->keys_[0]));
+        memmove(&n->children_[li + 1], &n->children_[li + 2], (n->count_ - li - 1) * sizeof(n->children_[0]));
+        n->count_--;
+    }
+
+    // Deletes the entry with the specified key from the subtree with the specified height.
+    // Returns true if found. Sets 'first' if the first entry of the subtree was deleted.
+    // Each separator key is the first key of the subtree at its right and shares the key
+    // of its entry, so the separator of a deleted first key is updated before it is freed.
+    static bool cx_btree_name_(_delete_)(cx_btree_name* t, void* node, size_t height, cx_btree_key* key, bool* first) {
+
+        if (height == 0) {
+            cx_btree_name_(_leaf_)* l = node;
+            const size_t idx = cx_btree_name_(_leaf_find_)(l, key, false);
+            if (idx == l->count_ || cx_btree_cmp_(&l->entries_[idx].key, key) != 0) {
+                return false;
+            }
+            cx_btree_free_key_(&l->entries_[idx].key);
+            cx_btree_free_val_(&l->entries_[idx].val);
+            l->count_--;
+            memmove(&l->entries_[idx], &l->entries_[idx + 1], (l->count_ - idx) * sizeof(l->entries_[0]));
+            *first = idx == 0;
+            return true;
+        }
+
+        cx_btree_name_(_inner_)* n = node;
+        const size_t ci = cx_btree_name_(_inner_find_)(n, key);
+        if (!cx_btree_name_(_delete_)(t, n->children_[ci], height - 1, key, first)) {
+            return false;
+        }
+        if (*first && ci > 0) {
+            // Empty leaves are fixed by the rebalance
+            if (height > 1 || ((cx_btree_name_(_leaf_)*)n->children_[ci])->count_ > 0) {
+                n->keys_[ci - 1] = *cx_btree_name_(_min_key_)(n->children_[ci], height - 1);
+            }
+            *first = false;
+        }
+        const size_t count = height == 1 ?
+            ((cx_btree_name_(_leaf_)*)n->children_[ci])->count_ :
+            ((cx_btree_name_(_inner_)*)n->children_[ci])->count_;
+        const size_t min = height == 1 ? cx_btree_leaf_min_ : cx_btree_inner_min_;
+        if (count < min) {
+            cx_btree_name_(_rebalance_)(t, n, ci, height - 1);
+        }
+        return true;
+    }
+
+#ifdef cx_btree_instance_allocator
+
+    cx_btree_api_ cx_btree_name cx_btree_name_(_init)(const CxAllocator* alloc) {
+        return (cx_btree_name){
+            .alloc_ = alloc == NULL ? cx_def_allocator() : alloc,
+        };
+    }
+
+#else
+
+    cx_btree_api_ cx_btree_name cx_btree_name_(_init)(void) {
+        return (cx_btree_name){0};
+    }
+
+#endif
+
+cx_btree_api_ void cx_btree_name_(_free)(cx_btree_name* t) {
+
+    assert(t);
+    cx_btree_name_(_clear)(t);
+}
+
+cx_btree_api_ void cx_btree_name_(_set)(cx_btree_name* t, cx_btree_key k, cx_btree_val v) {
+
+    assert(t);
+    if (t->root_ == NULL) {
+        t->root_ = cx_btree_name_(_new_leaf_)(t);
+        t->height_ = 0;
+    }
+    cx_btree_key sep;
+    void* right;
+    const int res = cx_btree_name_(_insert_)(t, t->root_, t->height_, &k, &v, &sep, &right);
+    if (res == 0) {
+        return;
+    }
+    t->count_++;
+    if (res == 2) {
+        // Grows the tree with new root
+        cx_btree_name_(_inner_)* root = cx_btree_name_(_new_inner_)(t);
+        root->count_ = 1;
+        root->keys_[0] = sep;
+        root->children_[0] = t->root_;
+        root->children_[1] = right;
+        t->root_ = root;
+        t->height_++;
+    }
+}
+
+cx_btree_api_ cx_btree_val* cx_btree_name_(_get)(const cx_btree_name* t, cx_btree_key k) {
+
+    assert(t);
+    if (t->root_ == NULL) {
+        return NULL;
+    }
+    cx_btree_name_(_leaf_)* l = cx_btree_name_(_find_leaf_)(t, &k);
+    const size_t idx = cx_btree_name_(_leaf_find_)(l, &k, false);
+    if (idx < l->count_ && cx_btree_cmp_(&l->entries_[idx].key, &k) == 0) {
+        return &l->entries_[idx].val;
+    }
+    return NULL;
+}
+
+cx_btree_api_ bool cx_btree_name_(_del)(cx_btree_name* t, cx_btree_key k) {
+
+    assert(t);
+    if (t->root_ == NULL) {
+        return false;
+    }
+    bool first = false;
+    if (!cx_btree_name_(_delete_)(t, t->root_, t->height_, &k, &first)) {
+        return false;
+    }
+    t->count_--;
+    if (t->count_ == 0) {
+        cx_btree_name_(_free_node_)(t, t->root_, t->height_);
+        t->root_ = NULL;
+        t->height_ = 0;
+        return true;
+    }
+    // Shrinks the tree if the root has a single child
+    if (t->height_ > 0 && ((cx_btree_name_(_inner_)*)t->root_)->count_ == 0) {
+        cx_btree_name_(_inner_)* root = t->root_;
+        t->root_ = root->children_[0];
+        t->height_--;
+        cx_btree_free_(t, root, sizeof(*root));
+    }
+    return true;
+}
+
+cx_btree_api_ bool cx_btree_name_(_load_sorted)(cx_btree_name* t, cx_btree_key const* keys, cx_btree_val const* vals, size_t n) {
+
+    assert(t);
+    if (t->root_ != NULL) {
+        return false;
+    }
+    for (size_t i = 1; i < n; i++) {
+        if (cx_btree_cmp_(&keys[i - 1], &keys[i]) >= 0) {
+            return false;
+        }
+    }
+    if (n == 0) {
+        return true;
+    }
+
+    // Builds the leaves, distributing the entries evenly among the minimum number of leaves
+    size_t count = (n + cx_btree_leaf_max_ - 1) / cx_btree_leaf_max_;
+    void** nodes = cx_btree_alloc_(t, count * sizeof(*nodes));
+    cx_btree_name_(_leaf_)* prev = NULL;
+    size_t pos = 0;
+    for (size_t i = 0; i < count; i++) {
+        cx_btree_name_(_leaf_)* l = cx_btree_name_(_new_leaf_)(t);
+        l->count_ = n / count + (i < n % count);
+        for (size_t j = 0; j < l->count_; j++, pos++) {
+            memcpy(&l->entries_[j].key, &keys[pos], sizeof(cx_btree_key));
+            memcpy(&l->entries_[j].val, &vals[pos], sizeof(cx_btree_val));
+        }
+        if (prev) {
+            prev->next_ = l;
+        }
+        prev = l;
+        nodes[i] = l;
+    }
+
+    // Builds each level of inner nodes from the nodes of the level below
+    size_t height = 0;
+    while (count > 1) {
+        const size_t nchildren = cx_btree_inner_max_ + 1;
+        const size_t ncount = (count + nchildren - 1) / nchildren;
+        pos = 0;
+        for (size_t i = 0; i < ncount; i++) {
+            cx_btree_name_(_inner_)* in = cx_btree_name_(_new_inner_)(t);
+            const size_t nc = count / ncount + (i < count % ncount);
+            in->count_ = nc - 1;
+            for (size_t j = 0; j < nc; j++, pos++) {
+                in->children_[j] = nodes[pos];
+                if (j > 0) {
+                    in->keys_[j - 1] = *cx_btree_name_(_min_key_)(nodes[pos], height);
+                }
+            }
+            nodes[i] = in;
+        }
+        count = ncount;
+        height++;
+    }
+    t->root_ = nodes[0];
+    t->height_ = height;
+    t->count_ = n;
+    cx_btree_free_(t, nodes, ((n + cx_btree_leaf_max_ - 1) / cx_btree_leaf_max_) * sizeof(*nodes));
+    return true;
+}
+
+cx_btree_api_ size_t cx_btree_name_(_count)(const cx_btree_name* t) {
+
+    assert(t);
+    return t->count_;
+}
+
+cx_btree_api_ void cx_btree_name_(_clear)(cx_btree_name* t) {
+
+    assert(t);
+    if (t->root_ == NULL) {
+        return;
+    }
+    cx_btree_name_(_free_node_)(t, t->root_, t->height_);
+    t->root_ = NULL;
+    t->height_ = 0;
+    t->count_ = 0;
+}
+
+    // Returns iterator at the first entry with key >= 'key' (or > 'key' if 'upper')
+    static cx_btree_name_(_iter) cx_btree_name_(_bound_)(const cx_btree_name* t, cx_btree_key* key, bool upper) {
+
+        if (t->root_ == NULL) {
+            return (cx_btree_name_(_iter)){.idx_ = cx_btree_end_};
+        }
+        cx_btree_name_(_leaf_)* l = cx_btree_name_(_find_leaf_)(t, key);
+        const size_t idx = cx_btree_name_(_leaf_find_)(l, key, upper);
+        if (idx < l->count_) {
+            return (cx_btree_name_(_iter)){.leaf_ = l, .idx_ = idx};
+        }
+        if (l->next_ == NULL) {
+            return (cx_btree_name_(_iter)){.idx_ = cx_btree_end_};
+        }
+        return (cx_btree_name_(_iter)){.leaf_ = l->next_, .idx_ = 0};
+    }
+
+cx_btree_api_ cx_btree_name_(_iter) cx_btree_name_(_lower_bound)(const cx_btree_name* t, cx_btree_key k) {
+
+    assert(t);
+    return cx_btree_name_(_bound_)(t, &k, false);
+}
+
+cx_btree_api_ cx_btree_name_(_iter) cx_btree_name_(_upper_bound)(const cx_btree_name* t, cx_btree_key k) {
+
+    assert(t);
+    return cx_btree_name_(_bound_)(t, &k, true);
+}
+
+cx_btree_api_ cx_btree_name_(_entry)* cx_btree_name_(_next)(const cx_btree_name* t, cx_btree_name_(_iter)* iter) {
+
+    assert(t);
+    assert(iter);
+    // Zero initialized iterator starts at the first leaf
+    if (iter->leaf_ == NULL) {
+        if (iter->idx_ == cx_btree_end_ || t->root_ == NULL) {
+            iter->idx_ = cx_btree_end_;
+            return NULL;
+        }
+        void* node = t->root_;
+        for (size_t h = t->height_; h > 0; h--) {
+            node = ((cx_btree_name_(_inner_)*)node)->children_[0];
+        }
+        iter->leaf_ = node;
+        iter->idx_ = 0;
+    }
+    cx_btree_name_(_entry)* e = &iter->leaf_->entries_[iter->idx_++];
+    if (iter->idx_ == iter->leaf_->count_) {
+        iter->leaf_ = iter->leaf_->next_;
+        iter->idx_ = iter->leaf_ ? 0 : cx_btree_end_;
+    }
+    return e;
+}
+
+#endif // cx_btree_implement
+
+// Undefine config  macros
+#undef cx_btree_name
+#undef cx_btree_key
+#undef cx_btree_val
+#undef cx_btree_node_size
+#undef cx_btree_cmp_key
+#undef cx_btree_free_key
+#undef cx_btree_free_val
+#undef cx_btree_allocator
+#undef cx_btree_instance_allocator
+#undef cx_btree_static
+#undef cx_btree_inline
+#undef cx_btree_implement
+
+// Undefine internal macros
+#undef cx_btree_cmp_
+#undef cx_btree_free_key_
+#undef cx_btree_free_val_
+#undef cx_btree_concat2_
+#undef cx_btree_concat1_
+#undef cx_btree_name_
+#undef cx_btree_api_
+#undef cx_btree_alloc_field_
+#undef cx_btree_alloc_
+#undef cx_btree_free_
+#undef cx_btree_max_
+#undef cx_btree_leaf_max_
+#undef cx_btree_inner_max_
+#undef cx_btree_leaf_min_
+#undef cx_btree_inner_min_
+#undef cx_btree_end_
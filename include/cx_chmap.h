@@ -0,0 +1,456 @@
+/*
+Concurrent Hashmap Implementation
+---------------------------------
+- Keys are partitioned across a power of 2 number of shards.
+- Each shard has its own read/write lock and its own open addressing
+  hash table (cx_hmap2.h) which is resized independently of other shards.
+- Lookups copy the value while holding the shard read lock,
+  so no pointer to the map internal storage is returned.
+
+Example
+-------
+
+// Concurrent map for int -> double
+#define cx_chmap_name   cmap
+#define cx_chmap_key    int
+#define cx_chmap_val    double
+#define cx_chmap_static
+#define cx_chmap_implement
+#include "cx_chmap.h"
+
+static void incr(double* val, bool found, void* ctx) {
+    *val += 1.0;
+}
+
+int main() {
+
+    cmap m = cmap_init(0);
+    // The following calls can be executed concurrently by several threads
+    cmap_set(&m, 1, 2.0);
+    double val;
+    if (cmap_get_copy(&m, 1, &val)) {
+        printf("val:%f\n", val);
+    }
+    cmap_update(&m, 1, incr, NULL);
+    cmap_del(&m, 1);
+    cmap_free(&m);
+    return 0;
+}
+
+Configuration
+-------------
+
+Define the name of the map type (mandatory):
+    #define cx_chmap_name <name>
+
+Define the type of the map key (mandatory):
+    #define cx_chmap_key <type>
+
+Define the type of the map value (mandatory):
+    #define cx_chmap_val <type>
+
+Define the number of shards which must be a power of 2 (default = 64).
+    #define cx_chmap_nshards <n>
+
+Define the key comparison function:
+int (*cmp)(const void* k1, const void* k2, size_t size);
+The default comparison function is a single integer comparison
+for keys with size of 1, 2, 4 or 8 bytes and memcmp() otherwise.
+    #define cx_chmap_cmp_key(pk1,pk2,s) <cmp_func>
+
+Define the key hash function:
+size_t (*hash)(const void* key, size_t size);
+The default hash function is a multiplicative mixer for keys with size of
+1, 2, 4 or 8 bytes and cx_hmap_hash_wy64() otherwise.
+    #define cx_chmap_hash_key(pk,s) <hash_func>
+
+Stores the hash of the key in each entry (see cx_hmap2.h)
+    #define cx_chmap_cache_hash
+
+Define function to free the key of deleted entries:
+void (*free)(void* key);
+By default no function is defined.
+    #define cx_chmap_free_key(pk) <free_func>
+
+Define function to free the value of deleted entries:
+void (*free)(void* val);
+By default no function is defined.
+    #define cx_chmap_free_val <free_func>
+
+Define optional custom allocator pointer or function call which return pointer to allocator.
+Uses default allocator if not defined.
+This allocator will be used for all instances of this type.
+The allocator must be thread safe.
+    #define cx_chmap_allocator <allocator>
+
+Sets if map uses custom allocator per instance.
+If set, it is necessary to initialize each map with the desired allocator.
+    #define cx_chmap_instance_allocator
+
+Sets if all map functions are prefixed with 'static'
+    #define cx_chmap_static
+
+Sets if all map functions are prefixed with 'inline'
+    #define cx_chmap_inline
+
+Sets to implement functions in this translation unit:
+    #define cx_chmap_implement
+
+
+API
+---
+
+Assuming:
+#define cx_chmap_name cmap      // Map type name
+#define cx_chmap_key  ktype     // Type of key
+#define cx_chmap_val  vtype     // Type of value
+
+Initialize map defined with custom allocator.
+The specified number of buckets is distributed among the shards.
+If the specified number of bucket is 0, the default will be used.
+    cmap cmap_init(const CxAllocator* alloc, size_t nbuckets);
+
+Initialize map NOT defined with custom allocator
+    cmap cmap_init(size_t nbuckets);
+
+Free map allocated memory.
+Must not be called concurrently with other operations.
+    void cmap_free(cmap* m);
+
+Inserts or updates specified key and value
+    void cmap_set(cmap* m, ktype k, vtype v);
+
+Copies the value associated with the specified key to 'val'.
+Returns true if found or false otherwise.
+    bool cmap_get_copy(cmap* m, ktype k, vtype* val);
+
+Deletes entry with the specified key.
+Returns true if found or false otherwise.
+    bool cmap_del(cmap* m, ktype k);
+
+Calls 'fn' with pointer to the value associated with the specified key
+while holding the shard write lock, so the value can be atomically read and modified.
+If the key is not found, a new entry with the value zeroed is inserted before calling 'fn'.
+The key is moved to the map as in 'set'.
+Returns true if the key was found or false if it was inserted.
+    bool cmap_update(cmap* m, ktype k, void (*fn)(vtype* val, bool found, void* ctx), void* ctx);
+
+Returns the number of entries in the map
+    size_t cmap_count(cmap* m);
+
+Clears the map without deallocating memory.
+    void cmap_clear(cmap* m);
+
+*/
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <pthread.h>
+#include "cx_alloc.h"
+#include "cx_hmap_util.h"
+
+#ifndef cx_chmap_name
+    #error "cx_chmap_name not defined"
+#endif
+#ifndef cx_chmap_key
+    #error "cx_chmap_key not defined"
+#endif
+#ifndef cx_chmap_val
+    #error "cx_chmap_val not defined"
+#endif
+
+#ifndef cx_chmap_nshards
+    #define cx_chmap_nshards (64)
+#endif
+#if (cx_chmap_nshards & (cx_chmap_nshards - 1)) != 0
+    #error "cx_chmap_nshards must be a power of 2"
+#endif
+
+// Key hash function
+#ifdef cx_chmap_hash_key
+    #define cx_chmap_hash_key_(pk,s) cx_chmap_hash_key(pk,s)
+#else
+    #define cx_chmap_hash_key_(pk,s)\
+        (cx_hmap_int_key_(s) ? cx_hmap_hash_int_(pk,s) : cx_hmap_hash_wy64(pk,s))
+#endif
+
+// Auxiliary internal macros
+#define cx_chmap_concat2_(a, b) a ## b
+#define cx_chmap_concat1_(a, b) cx_chmap_concat2_(a, b)
+#define cx_chmap_name_(name) cx_chmap_concat1_(cx_chmap_name, name)
+#define cx_chmap_map_(name) cx_chmap_concat1_(cx_chmap_name_(_map_), name)
+#define cx_chmap_op_set_ (0)
+#define cx_chmap_op_get_ (1)
+#define cx_chmap_op_del_ (2)
+#define cx_chmap_op_ins_ (3)
+
+// API attributes
+#if defined(cx_chmap_static) && defined(cx_chmap_inline)
+    #define cx_chmap_api_ static inline
+#elif defined(cx_chmap_static)
+    #define cx_chmap_api_ static
+#elif defined(cx_chmap_inline)
+    #define cx_chmap_api_ inline
+#else
+    #define cx_chmap_api_
+#endif
+
+// Default allocator
+#ifndef cx_chmap_allocator
+    #define cx_chmap_allocator cx_def_allocator()
+#endif
+
+// Use custom instance allocator
+#ifdef cx_chmap_instance_allocator
+    #define cx_chmap_alloc_field_\
+        const CxAllocator* alloc_;
+    #define cx_chmap_allocator_(m) ((m)->alloc_)
+// Use global type allocator
+#else
+    #define cx_chmap_alloc_field_
+    #define cx_chmap_allocator_(m) (cx_chmap_allocator)
+#endif
+
+// Defines the hash table type of each shard
+#define cx_hmap_name cx_chmap_name_(_map_)
+#define cx_hmap_key cx_chmap_key
+#define cx_hmap_val cx_chmap_val
+#ifdef cx_chmap_cmp_key
+    #define cx_hmap_cmp_key(pk1,pk2,s) cx_chmap_cmp_key(pk1,pk2,s)
+#endif
+#define cx_hmap_hash_key(pk,s) cx_chmap_hash_key_(pk,s)
+#ifdef cx_chmap_free_key
+    #define cx_hmap_free_key(pk) cx_chmap_free_key(pk)
+#endif
+#ifdef cx_chmap_free_val
+    #define cx_hmap_free_val(pv) cx_chmap_free_val(pv)
+#endif
+#ifdef cx_chmap_cache_hash
+    #define cx_hmap_cache_hash
+#endif
+#define cx_hmap_instance_allocator
+#define cx_hmap_static
+#ifdef cx_chmap_implement
+    #define cx_hmap_implement
+#endif
+#include "cx_hmap2.h"
+
+//
+// Declarations
+//
+
+// Shard aligned to cache line to avoid false sharing between shard locks
+typedef struct cx_chmap_name_(_shard_) {
+    pthread_rwlock_t lock_;
+    cx_chmap_name_(_map_) map_;
+} __attribute__((aligned(64))) cx_chmap_name_(_shard_);
+
+typedef struct cx_chmap_name {
+    cx_chmap_alloc_field_
+    void*   mem_;                           // Allocated memory for the shards
+    cx_chmap_name_(_shard_)* shards_;       // Array of shards aligned to cache line
+} cx_chmap_name;
+
+#ifdef cx_chmap_instance_allocator
+    cx_chmap_api_ cx_chmap_name cx_chmap_name_(_init)(const CxAllocator* alloc, size_t nbuckets);
+#else
+    cx_chmap_api_ cx_chmap_name cx_chmap_name_(_init)(size_t nbuckets);
+#endif
+cx_chmap_api_ void cx_chmap_name_(_free)(cx_chmap_name* m);
+cx_chmap_api_ void cx_chmap_name_(_set)(cx_chmap_name* m, cx_chmap_key k, cx_chmap_val v);
+cx_chmap_api_ bool cx_chmap_name_(_get_copy)(cx_chmap_name* m, cx_chmap_key k, cx_chmap_val* val);
+cx_chmap_api_ bool cx_chmap_name_(_del)(cx_chmap_name* m, cx_chmap_key k);
+cx_chmap_api_ bool cx_chmap_name_(_update)(cx_chmap_name* m, cx_chmap_key k, void (*fn)(cx_chmap_val* val, bool found, void* ctx), void* ctx);
+cx_chmap_api_ size_t cx_chmap_name_(_count)(cx_chmap_name* m);
+cx_chmap_api_ void cx_chmap_name_(_clear)(cx_chmap_name* m);
+
+//
+// Implementation
+//
+#ifdef cx_chmap_implement
+
+    // Allocates and initializes the shards
+    cx_chmap_api_ void cx_chmap_name_(_init_)(cx_chmap_name* m, size_t nbuckets) {
+
+        const size_t align = _Alignof(cx_chmap_name_(_shard_));
+        m->mem_ = cx_alloc_malloc(cx_chmap_allocator_(m), cx_chmap_nshards * sizeof(cx_chmap_name_(_shard_)) + align);
+        m->shards_ = (cx_chmap_name_(_shard_)*)(((uintptr_t)m->mem_ + align - 1) & ~(uintptr_t)(align - 1));
+        const size_t shard_nbuckets = nbuckets / cx_chmap_nshards;
+        for (size_t i = 0; i < cx_chmap_nshards; i++) {
+            cx_chmap_name_(_shard_)* s = m->shards_ + i;
+            int res = pthread_rwlock_init(&s->lock_, NULL);
+            assert(res == 0); (void)res;
+            s->map_ = cx_chmap_map_(_init)(cx_chmap_allocator_(m), shard_nbuckets);
+        }
+    }
+
+    // Returns the shard for the specified key hash
+    static inline cx_chmap_name_(_shard_)* cx_chmap_name_(_get_shard_)(cx_chmap_name* m, size_t hash) {
+
+        return m->shards_ + (hash & (cx_chmap_nshards - 1));
+    }
+
+    static inline void cx_chmap_name_(_rdlock_)(cx_chmap_name_(_shard_)* s) {
+
+        int res = pthread_rwlock_rdlock(&s->lock_);
+        assert(res == 0); (void)res;
+    }
+
+    static inline void cx_chmap_name_(_wrlock_)(cx_chmap_name_(_shard_)* s) {
+
+        int res = pthread_rwlock_wrlock(&s->lock_);
+        assert(res == 0); (void)res;
+    }
+
+    static inline void cx_chmap_name_(_unlock_)(cx_chmap_name_(_shard_)* s) {
+
+        int res = pthread_rwlock_unlock(&s->lock_);
+        assert(res == 0); (void)res;
+    }
+
+#ifdef cx_chmap_instance_allocator
+
+    cx_chmap_api_ cx_chmap_name cx_chmap_name_(_init)(const CxAllocator* alloc, size_t nbuckets) {
+
+        cx_chmap_name m = {.alloc_ = alloc == NULL ? cx_def_allocator() : alloc};
+        cx_chmap_name_(_init_)(&m, nbuckets);
+        return m;
+    }
+
+#else
+
+    cx_chmap_api_ cx_chmap_name cx_chmap_name_(_init)(size_t nbuckets) {
+
+        cx_chmap_name m = {0};
+        cx_chmap_name_(_init_)(&m, nbuckets);
+        return m;
+    }
+
+#endif
+
+cx_chmap_api_ void cx_chmap_name_(_free)(cx_chmap_name* m) {
+
+    if (m->shards_ == NULL) {
+        return;
+    }
+    for (size_t i = 0; i < cx_chmap_nshards; i++) {
+        cx_chmap_name_(_shard_)* s = m->shards_ + i;
+        cx_chmap_map_(_free)(&s->map_);
+        pthread_rwlock_destroy(&s->lock_);
+    }
+    const size_t align = _Alignof(cx_chmap_name_(_shard_));
+    cx_alloc_free(cx_chmap_allocator_(m), m->mem_, cx_chmap_nshards * sizeof(cx_chmap_name_(_shard_)) + align);
+    m->mem_ = NULL;
+    m->shards_ = NULL;
+}
+
+cx_chmap_api_ void cx_chmap_name_(_set)(cx_chmap_name* m, cx_chmap_key k, cx_chmap_val v) {
+
+    const size_t hash = cx_chmap_hash_key_((char*)&k, sizeof(cx_chmap_key));
+    cx_chmap_name_(_shard_)* s = cx_chmap_name_(_get_shard_)(m, hash);
+    cx_chmap_name_(_wrlock_)(s);
+    cx_chmap_map_(_entry)* e = cx_chmap_map_(_oper_)(&s->map_, cx_chmap_op_set_, &k, hash, NULL);
+    e->val = v;
+    cx_chmap_name_(_unlock_)(s);
+}
+
+cx_chmap_api_ bool cx_chmap_name_(_get_copy)(cx_chmap_name* m, cx_chmap_key k, cx_chmap_val* val) {
+
+    const size_t hash = cx_chmap_hash_key_((char*)&k, sizeof(cx_chmap_key));
+    cx_chmap_name_(_shard_)* s = cx_chmap_name_(_get_shard_)(m, hash);
+    cx_chmap_name_(_rdlock_)(s);
+    cx_chmap_map_(_entry)* e = cx_chmap_map_(_oper_)(&s->map_, cx_chmap_op_get_, &k, hash, NULL);
+    if (e != NULL) {
+        *val = e->val;
+    }
+    cx_chmap_name_(_unlock_)(s);
+    return e != NULL;
+}
+
+cx_chmap_api_ bool cx_chmap_name_(_del)(cx_chmap_name* m, cx_chmap_key k) {
+
+    const size_t hash = cx_chmap_hash_key_((char*)&k, sizeof(cx_chmap_key));
+    cx_chmap_name_(_shard_)* s = cx_chmap_name_(_get_shard_)(m, hash);
+    cx_chmap_name_(_wrlock_)(s);
+    cx_chmap_map_(_entry)* e = cx_chmap_map_(_oper_)(&s->map_, cx_chmap_op_del_, &k, hash, NULL);
+    cx_chmap_name_(_unlock_)(s);
+    return e != NULL;
+}
+
+cx_chmap_api_ bool cx_chmap_name_(_update)(cx_chmap_name* m, cx_chmap_key k, void (*fn)(cx_chmap_val* val, bool found, void* ctx), void* ctx) {
+
+    const size_t hash = cx_chmap_hash_key_((char*)&k, sizeof(cx_chmap_key));
+    cx_chmap_name_(_shard_)* s = cx_chmap_name_(_get_shard_)(m, hash);
+    cx_chmap_name_(_wrlock_)(s);
+    // Gets or inserts the entry with a single probe
+    const size_t count = s->map_.count_;
+    cx_chmap_map_(_entry)* e = cx_chmap_map_(_oper_)(&s->map_, cx_chmap_op_ins_, &k, hash, NULL);
+    const bool found = s->map_.count_ == count;
+    if (found) {
+#ifdef cx_chmap_free_key
+        cx_chmap_free_key(&k);
+#endif
+    } else {
+        memset(&e->val, 0, sizeof(e->val));
+    }
+    fn(&e->val, found, ctx);
+    cx_chmap_name_(_unlock_)(s);
+    return found;
+}
+
+cx_chmap_api_ size_t cx_chmap_name_(_count)(cx_chmap_name* m) {
+
+    size_t count = 0;
+    for (size_t i = 0; i < cx_chmap_nshards; i++) {
+        cx_chmap_name_(_shard_)* s = m->shards_ + i;
+        cx_chmap_name_(_rdlock_)(s);
+        count += cx_chmap_map_(_count)(&s->map_);
+        cx_chmap_name_(_unlock_)(s);
+    }
+    return count;
+}
+
+cx_chmap_api_ void cx_chmap_name_(_clear)(cx_chmap_name* m) {
+
+    for (size_t i = 0; i < cx_chmap_nshards; i++) {
+        cx_chmap_name_(_shard_)* s = m->shards_ + i;
+        cx_chmap_name_(_wrlock_)(s);
+        cx_chmap_map_(_clear)(&s->map_);
+        cx_chmap_name_(_unlock_)(s);
+    }
+}
+
+#endif // cx_chmap_implement
+
+// Undefine config  macros
+#undef cx_chmap_name
+#undef cx_chmap_key
+#undef cx_chmap_val
+#undef cx_chmap_nshards
+#undef cx_chmap_cmp_key
+#undef cx_chmap_hash_key
+#undef cx_chmap_cache_hash
+#undef cx_chmap_free_key
+#undef cx_chmap_free_val
+#undef cx_chmap_allocator
+#undef cx_chmap_instance_allocator
+#undef cx_chmap_static
+#undef cx_chmap_inline
+#undef cx_chmap_implement
+
+// Undefine internal macros
+#undef cx_chmap_hash_key_
+#undef cx_chmap_concat2_
+#undef cx_chmap_concat1_
+#undef cx_chmap_name_
+#undef cx_chmap_map_
+#undef cx_chmap_op_set_
+#undef cx_chmap_op_get_
+#undef cx_chmap_op_del_
+#undef cx_chmap_op_ins_
+#undef cx_chmap_api_
+#undef cx_chmap_alloc_field_
+#undef cx_chmap_allocator_
+
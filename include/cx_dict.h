@@ -0,0 +1,761 @@
+/*
+Insertion Ordered Dictionary Implementation
+-------------------------------------------
+- Entries are stored densely in insertion order in a single array,
+  so iteration is a linear scan and entries can be accessed by their order.
+- Lookups use a separate index table of int32 slots with the position
+  of the entries in the array, using linear probing.
+  The number of slots is a power of 2 and the initial slot is selected using Fibonacci hashing.
+- Small dictionaries have no index table: lookups scan the entries array.
+- Deleting an entry marks its position in the entries array and its index slot as deleted (O(1)).
+  The positions of deleted entries are reclaimed when the entries array is full
+  or before accessing entries by their order.
+- Uses global type allocator initialized with default allocator.
+- Can be configured to use custom allocator per instance.
+- Optionally stores the hash of each entry.
+
+Example
+-------
+
+#include <stdio.h>
+#include <assert.h>
+#define cx_dict_name dict
+#define cx_dict_key int
+#define cx_dict_val double
+#define cx_dict_implement
+#include "cx_dict.h"
+
+int main() {
+
+    dict d = dict_init();
+
+    // Set keys and values
+    size_t size = 100;
+    for (size_t i = 0; i < size; i++) {
+        dict_set(&d, i, i * 2.0);
+    }
+    assert(dict_count(&d) == size);
+
+    // Get values
+    for (size_t i = 0; i < size; i++) {
+        assert(*dict_get(&d, i) == i * 2.0);
+    }
+
+    // Iterate over keys and values in insertion order
+    dict_iter iter = {0};
+    dict_entry* e = NULL;
+    while ((e = dict_next(&d, &iter)) != NULL) {
+        printf("key:%d val:%f\n", e->key, e->val);
+    }
+    dict_free(&d);
+    return 0;
+}
+
+
+Configuration
+-------------
+
+Define the name of the dictionary type (mandatory):
+    #define cx_dict_name <name>
+
+Define the type of the dictionary key (mandatory):
+    #define cx_dict_key <type>
+
+Define the type of the dictionary value (mandatory):
+    #define cx_dict_val <type>
+
+Define the maximum number of entries of dictionaries without index table (default = 8).
+    #define cx_dict_linear_max <n>
+
+Define the key comparison function:
+int (*cmp)(const void* k1, const void* k2, size_t size);
+The default comparison function is a single integer comparison
+for keys with size of 1, 2, 4 or 8 bytes and memcmp() otherwise.
+    #define cx_dict_cmp_key(pk1,pk2,s) <cmp_func>
+
+Define the key hash function:
+size_t (*hash)(const void* key, size_t size);
+The default hash function is a multiplicative mixer for keys with size of
+1, 2, 4 or 8 bytes and cx_hmap_hash_wy64() otherwise.
+    #define cx_dict_hash_key(pk,s) <hash_func>
+
+Stores the hash of the key in each entry.
+Lookups compare the stored hashes before calling the key comparison function
+and growing the index table does not need to call the key hash function again.
+Recommended for keys with expensive comparison, such as strings.
+    #define cx_dict_cache_hash
+
+Define function to compare the key pointed by 'pk' with a borrowed key view
+with the specified pointer and length, returning 0 if they are equal.
+Enables the _getn(), _deln() and _emplacen() functions.
+    #define cx_dict_cmp_keyn(pk,key,len) <cmp_func>
+
+Define function to free the key of deleted entries:
+void (*free)(void* key);
+By default no function is defined.
+    #define cx_dict_free_key(pk) <free_func>
+
+Define function to free the value of deleted entries:
+void (*free)(void* val);
+By default no function is defined.
+    #define cx_dict_free_val <free_func>
+
+Define optional custom allocator pointer or function call which return pointer to allocator.
+Uses default allocator if not defined.
+This allocator will be used for all instances of this type.
+    #define cx_dict_allocator <allocator>
+
+Sets if dictionary uses custom allocator per instance.
+If set, it is necessary to initialize each dictionary with the desired allocator.
+    #define cx_dict_instance_allocator
+
+Sets if all dictionary functions are prefixed with 'static'
+    #define cx_dict_static
+
+Sets if all dictionary functions are prefixed with 'inline'
+    #define cx_dict_inline
+
+Sets to implement functions in this translation unit:
+    #define cx_dict_implement
+
+
+API
+---
+
+Assuming:
+#define cx_dict_name dict       // Dictionary type name
+#define cx_dict_key  ktype      // Type of key
+#define cx_dict_val  vtype      // Type of value
+
+Initialize dictionary defined with custom allocator
+    dict dict_init(const CxAllocator* alloc);
+
+Initialize dictionary NOT defined with custom allocator
+    dict dict_init();
+
+Free dictionary allocated memory
+    void dict_free(dict* d);
+
+Inserts or updates specified key and value.
+New keys are appended to the end of the insertion order.
+Updated keys keep their order.
+    void dict_set(dict* d, ktype k, vtype v);
+
+Returns pointer to value associated with specified key.
+Returns NULL if not found.
+    vtype* dict_get(const dict* d, ktype k);
+
+Deletes entry with the specified key keeping the order of the other entries.
+Returns true if found or false otherwise.
+Can be called while iterating with dict_next().
+    bool dict_del(dict* d, ktype k);
+
+Returns pointer to value associated with the key equal to the specified key view
+with 'len' bytes and precomputed 'hash', which must be the same hash calculated by
+the key hash function for the equal key (only if cx_dict_cmp_keyn is defined).
+Returns NULL if not found.
+    vtype* dict_getn(const dict* d, const void* key, size_t len, size_t hash);
+
+Deletes entry with the key equal to the specified key view with 'len' bytes and
+precomputed 'hash' (only if cx_dict_cmp_keyn is defined).
+Returns true if found or false otherwise.
+    bool dict_deln(dict* d, const void* key, size_t len, size_t hash);
+
+Returns pointer to the entry with the key equal to the specified key view with 'len'
+bytes and precomputed 'hash', appending a new entry with the key and value zeroed
+if not found, using a single lookup (only if cx_dict_cmp_keyn is defined).
+Sets 'inserted' (if not NULL) to indicate if the entry was inserted, in which case
+the caller must set the entry key to a key equal to the key view.
+    dict_entry* dict_emplacen(dict* d, const void* key, size_t len, size_t hash, bool* inserted);
+
+Returns the number of entries in the dictionary
+    size_t dict_count(const dict* d);
+
+Returns pointer to the entry at the specified insertion order.
+Returns NULL if the order is invalid.
+If entries were deleted since the last call, first removes the deleted entries
+from the entries array in O(n), invalidating iterators.
+    dict_entry* dict_at(dict* d, size_t order);
+
+Returns the next entry in insertion order from the specified iterator,
+which must be initialized with zeros, skipping deleted entries.
+Returns NULL after the last entry.
+Entries can be deleted while iterating, but setting new keys
+and dict_at() invalidate the iterator.
+    dict_entry* dict_next(const dict* d, dict_iter* iter);
+
+Clears the dictionary without deallocating memory.
+    void dict_clear(dict* d);
+
+*/
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include "cx_alloc.h"
+#include "cx_hmap_util.h"
+
+#ifndef cx_dict_name
+    #error "cx_dict_name not defined"
+#endif
+#ifndef cx_dict_key
+    #error "cx_dict_key not defined"
+#endif
+#ifndef cx_dict_val
+    #error "cx_dict_val not defined"
+#endif
+
+#ifndef cx_dict_linear_max
+    #define cx_dict_linear_max (8)
+#endif
+
+// Default key comparison function
+#ifndef cx_dict_cmp_key
+    #define cx_dict_cmp_key(pk1,pk2,s)\
+        (cx_hmap_int_key_(s) ? cx_hmap_cmp_int_(pk1,pk2,s) : memcmp(pk1,pk2,s))
+#endif
+
+// Default key hash function
+#ifndef cx_dict_hash_key
+    #define cx_dict_hash_key(pk,s)\
+        (cx_hmap_int_key_(s) ? cx_hmap_hash_int_(pk,s) : cx_hmap_hash_wy64(pk,s))
+#endif
+
+// Hash of the key pointed by 'pk'
+#define cx_dict_hash_(pk) cx_dict_hash_key((char*)(pk), sizeof(cx_dict_key))
+
+// Stored hash of entries
+#ifdef cx_dict_cache_hash
+    #define cx_dict_hash_field_         size_t hash_;
+    #define cx_dict_entry_hash_(e)      ((e)->hash_)
+    #define cx_dict_hash_eq_(e,h)       ((e)->hash_ == (h))
+    #define cx_dict_set_hash_(e,h)      (e)->hash_ = (h)
+#else
+    #define cx_dict_hash_field_
+    #define cx_dict_entry_hash_(e)      cx_dict_hash_(&(e)->key)
+    #define cx_dict_hash_eq_(e,h)       (true)
+    #define cx_dict_set_hash_(e,h)
+#endif
+
+// Default free key function
+#ifndef cx_dict_free_key
+    #define cx_dict_free_key_(key)
+#else
+    #define cx_dict_free_key_(key) cx_dict_free_key(key)
+#endif
+
+// Default free value function
+#ifndef cx_dict_free_val
+    #define cx_dict_free_val_(val)
+#else
+    #define cx_dict_free_val_(val) cx_dict_free_val(val)
+#endif
+
+// Values of index slots without entries
+#define cx_dict_empty_      (-1)
+#define cx_dict_deleted_    (-2)
+
+// Number of words of the bit set of deleted positions for the specified capacity
+#define cx_dict_words_(cap) (((size_t)(cap) + 63) / 64)
+
+// Returns if the entry at the specified position is deleted
+#define cx_dict_is_deleted_(d,pos) (((d)->deleted_[(pos) / 64] >> ((pos) % 64)) & 1)
+
+// Auxiliary internal macros
+#define cx_dict_concat2_(a, b) a ## b
+#define cx_dict_concat1_(a, b) cx_dict_concat2_(a, b)
+#define cx_dict_name_(name) cx_dict_concat1_(cx_dict_name, name)
+
+// API attributes
+#if defined(cx_dict_static) && defined(cx_dict_inline)
+    #define cx_dict_api_ static inline
+#elif defined(cx_dict_static)
+    #define cx_dict_api_ static
+#elif defined(cx_dict_inline)
+    #define cx_dict_api_ inline
+#else
+    #define cx_dict_api_
+#endif
+
+// Default allocator
+#ifndef cx_dict_allocator
+    #define cx_dict_allocator cx_def_allocator()
+#endif
+
+// Use custom instance allocator
+#ifdef cx_dict_instance_allocator
+    #define cx_dict_alloc_field_\
+        const CxAllocator* alloc_;
+    #define cx_dict_alloc_(d,n)\
+        cx_alloc_malloc((d)->alloc_, n)
+    #define cx_dict_free_(d,p,n)\
+        cx_alloc_free((d)->alloc_, p, n)
+// Use global type allocator
+#else
+    #define cx_dict_alloc_field_
+    #define cx_dict_alloc_(d,n)\
+        cx_alloc_malloc(cx_dict_allocator,n)
+    #define cx_dict_free_(d,p,n)\
+        cx_alloc_free(cx_dict_allocator,p,n)
+#endif
+
+//
+// Declarations
+//
+
+typedef struct cx_dict_name_(_entry) {
+    cx_dict_hash_field_
+    cx_dict_key key;
+    cx_dict_val val;
+} cx_dict_name_(_entry);
+
+typedef struct cx_dict_name {
+    cx_dict_alloc_field_
+    uint32_t    count_;                     // Number of entries
+    uint32_t    len_;                       // Number of used positions of the entries array
+    uint32_t    cap_;                       // Capacity of the entries array
+    cx_dict_name_(_entry)* entries_;        // Entries in insertion order including deleted entries
+    uint64_t*   deleted_;                   // Bit set of the positions of deleted entries
+    int32_t*    index_;                     // Index table with 2*cap_ slots or NULL
+} cx_dict_name;
+
+typedef struct cx_dict_name_(_iter) {
+    size_t pos_;                            // Next position of the entries array
+} cx_dict_name_(_iter);
+
+#ifdef cx_dict_instance_allocator
+    cx_dict_api_ cx_dict_name cx_dict_name_(_init)(const CxAllocator* alloc);
+#else
+    cx_dict_api_ cx_dict_name cx_dict_name_(_init)(void);
+#endif
+cx_dict_api_ void cx_dict_name_(_free)(cx_dict_name* d);
+cx_dict_api_ void cx_dict_name_(_set)(cx_dict_name* d, cx_dict_key k, cx_dict_val v);
+cx_dict_api_ cx_dict_val* cx_dict_name_(_get)(const cx_dict_name* d, cx_dict_key k);
+cx_dict_api_ bool cx_dict_name_(_del)(cx_dict_name* d, cx_dict_key k);
+#ifdef cx_dict_cmp_keyn
+cx_dict_api_ cx_dict_val* cx_dict_name_(_getn)(const cx_dict_name* d, const void* key, size_t len, size_t hash);
+cx_dict_api_ bool cx_dict_name_(_deln)(cx_dict_name* d, const void* key, size_t len, size_t hash);
+cx_dict_api_ cx_dict_name_(_entry)* cx_dict_name_(_emplacen)(cx_dict_name* d, const void* key, size_t len, size_t hash, bool* inserted);
+#endif
+cx_dict_api_ size_t cx_dict_name_(_count)(const cx_dict_name* d);
+cx_dict_api_ cx_dict_name_(_entry)* cx_dict_name_(_at)(cx_dict_name* d, size_t order);
+cx_dict_api_ cx_dict_name_(_entry)* cx_dict_name_(_next)(const cx_dict_name* d, cx_dict_name_(_iter)* iter);
+cx_dict_api_ void cx_dict_name_(_clear)(cx_dict_name* d);
+
+//
+// Implementation
+//
+#ifdef cx_dict_implement
+
+    // Declaration of function to hash keys
+    uint64_t cx_hmap_hash_wy64(const void* buf, size_t len);
+
+    // Inserts the position of the entry with the specified hash in the index table
+    static inline void cx_dict_name_(_index_add_)(cx_dict_name* d, size_t hash, uint32_t pos) {
+
+        const size_t nslots = 2 * (size_t)d->cap_;
+        size_t slot = cx_hmap_fib_index_(hash, nslots);
+        while (d->index_[slot] >= 0) {
+            slot = (slot + 1) & (nslots - 1);
+        }
+        d->index_[slot] = pos;
+    }
+
+    // Builds the index table for the current entries if the dictionary is not small.
+    // The entries array must not have deleted entries.
+    static void cx_dict_name_(_index_build_)(cx_dict_name* d) {
+
+        assert(d->len_ == d->count_);
+        if (d->cap_ <= cx_dict_linear_max) {
+            return;
+        }
+        const size_t nslots = 2 * (size_t)d->cap_;
+        if (d->index_ == NULL) {
+            d->index_ = cx_dict_alloc_(d, nslots * sizeof(*d->index_));
+        }
+        memset(d->index_, 0xFF, nslots * sizeof(*d->index_));
+        for (uint32_t i = 0; i < d->count_; i++) {
+            cx_dict_name_(_index_add_)(d, cx_dict_entry_hash_(&d->entries_[i]), i);
+        }
+    }
+
+    // Moves back the entries over the deleted entries keeping their order and rebuilds the index table
+    static void cx_dict_name_(_compact_)(cx_dict_name* d) {
+
+        uint32_t n = 0;
+        for (uint32_t i = 0; i < d->len_; i++) {
+            if (!cx_dict_is_deleted_(d, i)) {
+                d->entries_[n++] = d->entries_[i];
+            }
+        }
+        assert(n == d->count_);
+        d->len_ = n;
+        memset(d->deleted_, 0, cx_dict_words_(d->cap_) * sizeof(*d->deleted_));
+        cx_dict_name_(_index_build_)(d);
+    }
+
+    // Doubles the capacity of the entries array copying only the entries not deleted
+    // and rebuilds the index table
+    static void cx_dict_name_(_grow_)(cx_dict_name* d) {
+
+        const size_t old_cap = d->cap_;
+        const size_t cap = old_cap == 0 ? 4 : old_cap * 2;
+        assert(cap <= INT32_MAX);
+        cx_dict_name_(_entry)* entries = cx_dict_alloc_(d, cap * sizeof(*entries));
+        uint32_t n = 0;
+        for (uint32_t i = 0; i < d->len_; i++) {
+            if (!cx_dict_is_deleted_(d, i)) {
+                entries[n++] = d->entries_[i];
+            }
+        }
+        assert(n == d->count_);
+        cx_dict_free_(d, d->entries_, old_cap * sizeof(*entries));
+        cx_dict_free_(d, d->deleted_, cx_dict_words_(old_cap) * sizeof(*d->deleted_));
+        d->entries_ = entries;
+        d->len_ = n;
+        d->deleted_ = cx_dict_alloc_(d, cx_dict_words_(cap) * sizeof(*d->deleted_));
+        memset(d->deleted_, 0, cx_dict_words_(cap) * sizeof(*d->deleted_));
+        if (d->index_) {
+            cx_dict_free_(d, d->index_, 2 * old_cap * sizeof(*d->index_));
+            d->index_ = NULL;
+        }
+        d->cap_ = cap;
+        cx_dict_name_(_index_build_)(d);
+    }
+
+    // Returns the position of the entry with the specified key and hash or -1 if not found.
+    // If not found and 'free_slot' is not NULL, sets it to the index slot where the key can be inserted.
+    static inline int32_t cx_dict_name_(_find_)(const cx_dict_name* d, cx_dict_key* key, size_t hash, size_t* free_slot) {
+
+        if (d->index_ == NULL) {
+            for (uint32_t i = 0; i < d->len_; i++) {
+                const cx_dict_name_(_entry)* e = d->entries_ + i;
+                if (!cx_dict_is_deleted_(d, i) && cx_dict_hash_eq_(e, hash) && cx_dict_cmp_key(&e->key, key, sizeof(cx_dict_key)) == 0) {
+                    return i;
+                }
+            }
+            return -1;
+        }
+        const size_t nslots = 2 * (size_t)d->cap_;
+        size_t slot = cx_hmap_fib_index_(hash, nslots);
+        size_t deleted = nslots;
+        while (true) {
+            const int32_t pos = d->index_[slot];
+            if (pos == cx_dict_empty_) {
+                // Inserts in the first deleted slot of the probe sequence if found
+                if (free_slot) {
+                    *free_slot = deleted < nslots ? deleted : slot;
+                }
+                return -1;
+            }
+            if (pos == cx_dict_deleted_) {
+                if (deleted == nslots) {
+                    deleted = slot;
+                }
+            } else {
+                const cx_dict_name_(_entry)* e = d->entries_ + pos;
+                if (cx_dict_hash_eq_(e, hash) && cx_dict_cmp_key(&e->key, key, sizeof(cx_dict_key)) == 0) {
+                    return pos;
+                }
+            }
+            slot = (slot + 1) & (nslots - 1);
+        }
+    }
+
+    // Marks the entry at the specified position with the specified hash as deleted.
+    // Its index slot is marked as deleted instead of empty, so lookups continue probing after it.
+    static void cx_dict_name_(_remove_)(cx_dict_name* d, uint32_t pos, size_t hash) {
+
+        if (d->index_) {
+            const size_t nslots = 2 * (size_t)d->cap_;
+            size_t slot = cx_hmap_fib_index_(hash, nslots);
+            while (d->index_[slot] != (int32_t)pos) {
+                slot = (slot + 1) & (nslots - 1);
+            }
+            d->index_[slot] = cx_dict_deleted_;
+        }
+        cx_dict_free_key_(&d->entries_[pos].key);
+        cx_dict_free_val_(&d->entries_[pos].val);
+        d->deleted_[pos / 64] |= 1ull << (pos % 64);
+        d->count_--;
+        // Resets the dictionary when the last entry is deleted
+        if (d->count_ == 0) {
+            memset(d->deleted_, 0, cx_dict_words_(d->len_) * sizeof(*d->deleted_));
+            d->len_ = 0;
+            if (d->index_) {
+                memset(d->index_, 0xFF, 2 * (size_t)d->cap_ * sizeof(*d->index_));
+            }
+        }
+    }
+
+    // Appends new entry with the specified hash to the entries array and returns its pointer.
+    // 'slot' is the free index slot found by the failed lookup of the key, which is used
+    // if the entries array does not need to be compacted or grown.
+    static cx_dict_name_(_entry)* cx_dict_name_(_append_)(cx_dict_name* d, size_t hash, size_t slot) {
+
+        // Reuses the positions of the deleted entries if they are at least 1/4 of the capacity
+        if (d->len_ == d->cap_) {
+            if (d->cap_ > 0 && d->len_ - d->count_ >= d->cap_ / 4) {
+                cx_dict_name_(_compact_)(d);
+            } else {
+                cx_dict_name_(_grow_)(d);
+            }
+            if (d->index_) {
+                cx_dict_name_(_index_add_)(d, hash, d->len_);
+            }
+        } else if (d->index_) {
+            d->index_[slot] = d->len_;
+        }
+        cx_dict_name_(_entry)* e = d->entries_ + d->len_;
+        cx_dict_set_hash_(e, hash);
+        d->len_++;
+        d->count_++;
+        return e;
+    }
+
+#ifdef cx_dict_cmp_keyn
+
+    // Returns the position of the entry with the key equal to the specified key view or -1 if not found.
+    // If not found and 'free_slot' is not NULL, sets it to the index slot where the key can be inserted.
+    static inline int32_t cx_dict_name_(_findn_)(const cx_dict_name* d, const void* key, size_t len, size_t hash, size_t* free_slot) {
+
+        if (d->index_ == NULL) {
+            for (uint32_t i = 0; i < d->len_; i++) {
+                const cx_dict_name_(_entry)* e = d->entries_ + i;
+                if (!cx_dict_is_deleted_(d, i) && cx_dict_hash_eq_(e, hash) && cx_dict_cmp_keyn(&e->key, key, len) == 0) {
+                    return i;
+                }
+            }
+            return -1;
+        }
+        const size_t nslots = 2 * (size_t)d->cap_;
+        size_t slot = cx_hmap_fib_index_(hash, nslots);
+        size_t deleted = nslots;
+        while (true) {
+            const int32_t pos = d->index_[slot];
+            if (pos == cx_dict_empty_) {
+                // Inserts in the first deleted slot of the probe sequence if found
+                if (free_slot) {
+                    *free_slot = deleted < nslots ? deleted : slot;
+                }
+                return -1;
+            }
+            if (pos == cx_dict_deleted_) {
+                if (deleted == nslots) {
+                    deleted = slot;
+                }
+            } else {
+                const cx_dict_name_(_entry)* e = d->entries_ + pos;
+                if (cx_dict_hash_eq_(e, hash) && cx_dict_cmp_keyn(&e->key, key, len) == 0) {
+                    return pos;
+                }
+            }
+            slot = (slot + 1) & (nslots - 1);
+        }
+    }
+
+#endif
+
+#ifdef cx_dict_instance_allocator
+
+    cx_dict_api_ cx_dict_name cx_dict_name_(_init)(const CxAllocator* alloc) {
+        return (cx_dict_name){
+            .alloc_ = alloc == NULL ? cx_def_allocator() : alloc,
+        };
+    }
+
+#else
+
+    cx_dict_api_ cx_dict_name cx_dict_name_(_init)(void) {
+        return (cx_dict_name){0};
+    }
+
+#endif
+
+cx_dict_api_ void cx_dict_name_(_free)(cx_dict_name* d) {
+
+    assert(d);
+    cx_dict_name_(_clear)(d);
+    cx_dict_free_(d, d->entries_, d->cap_ * sizeof(*d->entries_));
+    cx_dict_free_(d, d->deleted_, cx_dict_words_(d->cap_) * sizeof(*d->deleted_));
+    if (d->index_) {
+        cx_dict_free_(d, d->index_, 2 * (size_t)d->cap_ * sizeof(*d->index_));
+    }
+    d->entries_ = NULL;
+    d->deleted_ = NULL;
+    d->index_ = NULL;
+    d->cap_ = 0;
+}
+
+cx_dict_api_ void cx_dict_name_(_set)(cx_dict_name* d, cx_dict_key k, cx_dict_val v) {
+
+    assert(d);
+    const size_t hash = cx_dict_hash_(&k);
+    size_t slot = 0;
+    const int32_t pos = cx_dict_name_(_find_)(d, &k, hash, &slot);
+    if (pos >= 0) {
+        cx_dict_name_(_entry)* e = d->entries_ + pos;
+#ifdef cx_dict_free_key
+        cx_dict_free_key_(&e->key);
+        e->key = k;
+#endif
+        cx_dict_free_val_(&e->val);
+        e->val = v;
+        return;
+    }
+    cx_dict_name_(_entry)* e = cx_dict_name_(_append_)(d, hash, slot);
+    e->key = k;
+    e->val = v;
+}
+
+cx_dict_api_ cx_dict_val* cx_dict_name_(_get)(const cx_dict_name* d, cx_dict_key k) {
+
+    assert(d);
+    const int32_t pos = cx_dict_name_(_find_)(d, &k, cx_dict_hash_(&k), NULL);
+    return pos < 0 ? NULL : &d->entries_[pos].val;
+}
+
+#ifdef cx_dict_cmp_keyn
+
+cx_dict_api_ cx_dict_val* cx_dict_name_(_getn)(const cx_dict_name* d, const void* key, size_t len, size_t hash) {
+
+    assert(d);
+    const int32_t pos = cx_dict_name_(_findn_)(d, key, len, hash, NULL);
+    return pos < 0 ? NULL : &d->entries_[pos].val;
+}
+
+cx_dict_api_ bool cx_dict_name_(_deln)(cx_dict_name* d, const void* key, size_t len, size_t hash) {
+
+    assert(d);
+    const int32_t pos = cx_dict_name_(_findn_)(d, key, len, hash, NULL);
+    if (pos < 0) {
+        return false;
+    }
+    cx_dict_name_(_remove_)(d, pos, hash);
+    return true;
+}
+
+cx_dict_api_ cx_dict_name_(_entry)* cx_dict_name_(_emplacen)(cx_dict_name* d, const void* key, size_t len, size_t hash, bool* inserted) {
+
+    assert(d);
+    size_t slot = 0;
+    const int32_t pos = cx_dict_name_(_findn_)(d, key, len, hash, &slot);
+    if (inserted) {
+        *inserted = pos < 0;
+    }
+    if (pos >= 0) {
+        return d->entries_ + pos;
+    }
+    cx_dict_name_(_entry)* e = cx_dict_name_(_append_)(d, hash, slot);
+    memset(&e->key, 0, sizeof(e->key));
+    memset(&e->val, 0, sizeof(e->val));
+    return e;
+}
+
+#endif
+
+cx_dict_api_ bool cx_dict_name_(_del)(cx_dict_name* d, cx_dict_key k) {
+
+    assert(d);
+    const size_t hash = cx_dict_hash_(&k);
+    const int32_t pos = cx_dict_name_(_find_)(d, &k, hash, NULL);
+    if (pos < 0) {
+        return false;
+    }
+    cx_dict_name_(_remove_)(d, pos, hash);
+    return true;
+}
+
+cx_dict_api_ size_t cx_dict_name_(_count)(const cx_dict_name* d) {
+
+    assert(d);
+    return d->count_;
+}
+
+cx_dict_api_ cx_dict_name_(_entry)* cx_dict_name_(_at)(cx_dict_name* d, size_t order) {
+
+    assert(d);
+    if (order >= d->count_) {
+        return NULL;
+    }
+    // The position of each entry is its order only without deleted entries
+    if (d->len_ != d->count_) {
+        cx_dict_name_(_compact_)(d);
+    }
+    return d->entries_ + order;
+}
+
+cx_dict_api_ cx_dict_name_(_entry)* cx_dict_name_(_next)(const cx_dict_name* d, cx_dict_name_(_iter)* iter) {
+
+    assert(d);
+    assert(iter);
+    while (iter->pos_ < d->len_) {
+        const size_t pos = iter->pos_++;
+        if (!cx_dict_is_deleted_(d, pos)) {
+            return d->entries_ + pos;
+        }
+    }
+    return NULL;
+}
+
+cx_dict_api_ void cx_dict_name_(_clear)(cx_dict_name* d) {
+
+    assert(d);
+#if defined(cx_dict_free_key) || defined(cx_dict_free_val)
+    for (uint32_t i = 0; i < d->len_; i++) {
+        if (!cx_dict_is_deleted_(d, i)) {
+            cx_dict_free_key_(&d->entries_[i].key);
+            cx_dict_free_val_(&d->entries_[i].val);
+        }
+    }
+#endif
+    if (d->deleted_) {
+        memset(d->deleted_, 0, cx_dict_words_(d->len_) * sizeof(*d->deleted_));
+    }
+    d->count_ = 0;
+    d->len_ = 0;
+    if (d->index_) {
+        memset(d->index_, 0xFF, 2 * (size_t)d->cap_ * sizeof(*d->index_));
+    }
+}
+
+#endif // cx_dict_implement
+
+// Undefine config  macros
+#undef cx_dict_name
+#undef cx_dict_key
+#undef cx_dict_val
+#undef cx_dict_linear_max
+#undef cx_dict_cmp_key
+#undef cx_dict_cmp_keyn
+#undef cx_dict_hash_key
+#undef cx_dict_cache_hash
+#undef cx_dict_free_key
+#undef cx_dict_free_val
+#undef cx_dict_allocator
+#undef cx_dict_instance_allocator
+#undef cx_dict_static
+#undef cx_dict_inline
+#undef cx_dict_implement
+
+// Undefine internal macros
+#undef cx_dict_hash_
+#undef cx_dict_empty_
+#undef cx_dict_deleted_
+#undef cx_dict_words_
+#undef cx_dict_is_deleted_
+#undef cx_dict_hash_field_
+#undef cx_dict_entry_hash_
+#undef cx_dict_hash_eq_
+#undef cx_dict_set_hash_
+#undef cx_dict_free_key_
+#undef cx_dict_free_val_
+#undef cx_dict_concat2_
+#undef cx_dict_concat1_
+#undef cx_dict_name_
+#undef cx_dict_api_
+#undef cx_dict_alloc_field_
+#undef cx_dict_alloc_
+#undef cx_dict_free_
+
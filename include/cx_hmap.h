@@ -2,6 +2,10 @@
 Hashmap Implementation
 ----------------------
 - Uses chaining.
+- The number of buckets is a power of 2 and the bucket index is selected using Fibonacci hashing.
+- Optionally stores the hash of each entry.
+- Chain nodes are allocated from slabs owned by the map and recycled
+  through an intrusive free list. The slabs are only released by _free().
 - Can be configured to use global or custom allocator per instance.
 
 Example
@@ -11,8 +15,6 @@ Example
 #define cx_hmap_name                map
 #define cx_hmap_key                 int
 #define cx_hmap_val                 double
-#define cx_hmap_cmp_key(pk1,pk2)    memcmp(pk1,pk2,sizeof(int))
-#define cx_hmap_hash_key(pk)        cx_hmap_hash_fnv1a32((char*)pk,sizeof(*pk))
 #define cx_hmap_static
 #define cx_hmap_implement
 #include "cx_hmap.h"
@@ -67,7 +69,9 @@ Define the type of the map key (mandatory):
 Define the type of the map value (mandatory):
     #define cx_hmap_val <type>
 
-Define the key comparison function (mandatory):
+Define the key comparison function.
+The default comparison function is a single integer comparison
+for keys with size of 1, 2, 4 or 8 bytes and memcmp() otherwise.
     #define cx_hmap_cmp_key(pk1,pk2) <cmp_func>
     example for map<int, T>:
         #define cx_hmap_cmp_key(pk1,pk2) memcmp(pk1,pk2,sizeof(*pk1))
@@ -76,7 +80,9 @@ Define the key comparison function (mandatory):
     example for map<cxstr, T>
         #define cx_hmap_cmp_key(pk1,pk2) cxstr_cmps(pk1,pk2)
 
-Define the key hash function (mandatory):
+Define the key hash function.
+The default hash function is a multiplicative mixer for keys with size of
+1, 2, 4 or 8 bytes and cx_hmap_hash_wy64() otherwise.
     #define cx_hmap_hash_key(pk) <hash_func>
     example for map<int, T>:
         #define cx_hmap_hash_key(pk)    cx_hmap_hash_fnv1a32((char*)pk,sizeof(*pk))
@@ -84,9 +90,15 @@ Define the key hash function (mandatory):
         #define cx_hmap_hash_key(pk)    cx_hmap_hash_fnv1a32(*pk, strlen(*pk))
     example for map<cxstr, T>
         #define cx_hmap_hash_key(pk)    cx_hmap_hash_fnv1a32((pk)->data, (pk)->len_)
+    Available hash functions:
+        uint32_t cx_hmap_hash_fnv1a32(const void* buf, size_t len);   // FNV-1a, one byte per iteration
+        uint64_t cx_hmap_hash_wy64(const void* buf, size_t len);      // 64 bit, 16 bytes per iteration
+        uint64_t cx_hmap_hash_wy64_str(const char* str);              // Same as cx_hmap_hash_wy64(str, strlen(str))
+        uint64_t cx_hmap_hash_wy64_str_fast(const char* str);         // Same, reading past the terminator (see cx_hmap_util.h)
 
 Define the default initial number of buckets,
-when map is initialized with nbuckets = 0
+when map is initialized with nbuckets = 0.
+The number of buckets is always rounded to a power of 2.
     #define cx_hmap_def_nbuckets <n>
 
 Define the load factor (number of entries/number of buckets)
@@ -94,6 +106,36 @@ which, if exceeded, will imply in the rehash of the hash map
 (expensive operation)
     #define cx_hmap_load_factor <lf>
 
+Enables incremental rehashing.
+When the load factor is exceeded, a new bucket array is allocated but the entries
+of the old bucket array are migrated in small steps by the following 'set' and 'del'
+operations, instead of all at once, removing the latency spike of a full rehash.
+During the migration 'get' checks both bucket arrays and does not migrate entries.
+    #define cx_hmap_incremental_rehash
+
+Define the number of old buckets migrated per 'set' or 'del' operation
+when incremental rehashing is enabled (default = 8).
+    #define cx_hmap_rehash_step <n>
+
+Stores the hash of the key in each entry.
+Lookups compare the stored hashes before calling the key comparison function
+and rehashing does not need to call the key hash function again.
+Recommended for keys with expensive comparison, such as strings.
+    #define cx_hmap_cache_hash
+
+Define the maximum number of chain nodes allocated in a single slab (default = 1024).
+The first slab has 16 nodes and each new slab doubles the size of the previous one
+up to this maximum.
+    #define cx_hmap_slab_max_nodes <n>
+
+Define function to compare the key pointed by 'pk' with a borrowed key view
+with the specified pointer and length, returning 0 if they are equal.
+Enables the _getn() and _deln() functions.
+    #define cx_hmap_cmp_keyn(pk,key,len) <cmp_func>
+    example for map<char*, T>:
+        #define cx_hmap_cmp_keyn(pk,key,len)\
+            (strncmp(*(char**)(pk),key,len) || (*(char**)(pk))[len])
+
 Define function to free the key of deleted entries:
 void (*free)(void* key);
 By default no function is defined.
@@ -157,6 +199,44 @@ Deletes entry with the specified key.
 Returns true if found or false otherwise.
     bool hmap_del(hmap* m, ktype k);
 
+Returns pointer to the value associated with the key pointed by 'k',
+inserting a new entry with the value zeroed if the key is not found,
+using a single lookup. Sets 'inserted' (if not NULL) to indicate if
+the entry was inserted. The key is copied to the map only if inserted,
+otherwise it is still owned by the caller.
+    vtype* hmap_emplace(hmap* m, ktype const* k, bool* inserted);
+
+Inserts or updates the key and value pointed by 'k' and 'v',
+copying them directly to the entry.
+    void hmap_set_ptr(hmap* m, ktype const* k, vtype const* v);
+
+Calls 'fn' with pointer to the value associated with the specified key,
+inserting a new entry with the value zeroed if the key is not found,
+using a single lookup. The key is moved to the map as in 'set'.
+Returns true if the key was found or false if it was inserted.
+    bool hmap_upsert(hmap* m, ktype k, void (*fn)(vtype* val, bool found, void* ctx), void* ctx);
+
+Returns pointer to value associated with the key equal to the specified key view
+with 'len' bytes and precomputed 'hash', which must be the same hash calculated by
+the key hash function for the equal key (only if cx_hmap_cmp_keyn is defined).
+Returns NULL if not found.
+    vtype* hmap_getn(hmap* m, const void* key, size_t len, size_t hash);
+
+Deletes entry with the key equal to the specified key view with 'len' bytes and
+precomputed 'hash' (only if cx_hmap_cmp_keyn is defined).
+Returns true if found or false otherwise.
+    bool hmap_deln(hmap* m, const void* key, size_t len, size_t hash);
+
+Gets the values of 'n' keys, setting each element of 'vals' to the pointer
+to the value associated with the corresponding key or NULL if not found.
+The keys are hashed and their buckets prefetched in batches, overlapping the
+memory latency of several lookups. Returns the number of keys found.
+    size_t hmap_get_batch( hmap* m, const ktype* keys, size_t n, vtype** vals);
+
+Inserts or updates 'n' keys and values, hashing the keys and prefetching
+their buckets in batches.
+    void hmap_set_batch(hmap* m, const ktype* keys, const vtype* vals, size_t n);
+
 Returns the number of entries in the hashmap
     size_t hmap_count(const hmap* m);
 
@@ -177,6 +257,7 @@ Returns statistics for the specified map (if enabled)
 #include <stdlib.h>
 #include <string.h>
 #include "cx_alloc.h"
+#include "cx_hmap_util.h"
 
 #ifndef cx_hmap_name
     #error "cx_hmap_name not defined"
@@ -187,21 +268,56 @@ Returns statistics for the specified map (if enabled)
 #ifndef cx_hmap_val
     #error "cx_hmap_val not defined"
 #endif
-#ifndef cx_hmap_cmp_key
-    #error "cx_hmap_cmp_key(pk1,pk2) not defined"
-#endif
-#ifndef cx_hmap_hash_key
-    #error "cx_hmap_hash_key(pk) not defined"
-#endif
 
 #ifndef cx_hmap_def_nbuckets
-    #define cx_hmap_def_nbuckets (17)
+    #define cx_hmap_def_nbuckets (16)
 #endif
 
 #ifndef cx_hmap_load_factor
     #define cx_hmap_load_factor (2.0)
 #endif
 
+#ifndef cx_hmap_rehash_step
+    #define cx_hmap_rehash_step (8)
+#endif
+
+#ifndef cx_hmap_slab_max_nodes
+    #define cx_hmap_slab_max_nodes (1024)
+#endif
+#define cx_hmap_slab_min_nodes_ (16)
+
+// Number of keys hashed and prefetched at once by the batch functions
+#define cx_hmap_batch_ (16)
+
+// Stored hash of entries
+#ifdef cx_hmap_cache_hash
+    #define cx_hmap_hash_field_         size_t hash_;
+    #define cx_hmap_entry_hash_(e)      ((e)->hash_)
+    #define cx_hmap_hash_eq_(e,h)       ((e)->hash_ == (h))
+    #define cx_hmap_set_hash_(e,h)      (e)->hash_ = (h)
+#else
+    #define cx_hmap_hash_field_
+    #define cx_hmap_entry_hash_(e)      cx_hmap_hash_key(&(e)->key)
+    #define cx_hmap_hash_eq_(e,h)       (true)
+    #define cx_hmap_set_hash_(e,h)      (void)(h)
+#endif
+
+
+// Default key comparison function:
+// single integer compare for keys with 1, 2, 4 or 8 bytes, memcmp() otherwise.
+#ifndef cx_hmap_cmp_key
+    #define cx_hmap_cmp_key(pk1,pk2)\
+        (cx_hmap_int_key_(sizeof(cx_hmap_key)) ?\
+            cx_hmap_cmp_int_(pk1,pk2,sizeof(cx_hmap_key)) : memcmp(pk1,pk2,sizeof(cx_hmap_key)))
+#endif
+
+// Default key hash function:
+// multiplicative mixer for keys with 1, 2, 4 or 8 bytes, cx_hmap_hash_wy64() otherwise.
+#ifndef cx_hmap_hash_key
+    #define cx_hmap_hash_key(pk)\
+        (cx_hmap_int_key_(sizeof(cx_hmap_key)) ?\
+            cx_hmap_hash_int_(pk,sizeof(cx_hmap_key)) : cx_hmap_hash_wy64(pk,sizeof(cx_hmap_key)))
+#endif
 
 // Default free key function
 #ifndef cx_hmap_free_key
@@ -262,15 +378,31 @@ Returns statistics for the specified map (if enabled)
 
 typedef struct cx_hmap_name_(_entry) {
     struct cx_hmap_name_(_entry)* next_;
+    cx_hmap_hash_field_
     cx_hmap_key key;
     cx_hmap_val val;
 } cx_hmap_name_(_entry);
 
+// Slab of chain nodes
+typedef struct cx_hmap_name_(_slab_) {
+    struct cx_hmap_name_(_slab_)* next_;
+    size_t nnodes_;
+    cx_hmap_name_(_entry) nodes_[];
+} cx_hmap_name_(_slab_);
+
 typedef struct cx_hmap_name {
     cx_hmap_alloc_field_
     size_t      count_;
     size_t      nbuckets_;
     cx_hmap_name_(_entry)* buckets_;
+    cx_hmap_name_(_slab_)* slabs_;      // List of slabs, last allocated first
+    size_t      slab_used_;             // Number of nodes used from the last allocated slab
+    cx_hmap_name_(_entry)* free_nodes_; // List of free chain nodes
+#ifdef cx_hmap_incremental_rehash
+    size_t      old_nbuckets_;  // Number of buckets of the old array being migrated
+    size_t      migrated_;      // Number of old buckets already migrated
+    cx_hmap_name_(_entry)* old_buckets_; // Old bucket array or NULL if no migration
+#endif
 } cx_hmap_name;
 
 typedef struct cx_hmap_name_(_iter) {
@@ -288,6 +420,15 @@ cx_hmap_api_ void cx_hmap_name_(_free)(cx_hmap_name* m);
 cx_hmap_api_ void cx_hmap_name_(_set)(cx_hmap_name* m, cx_hmap_key k, cx_hmap_val v);
 cx_hmap_api_ cx_hmap_val* cx_hmap_name_(_get)(cx_hmap_name* m, cx_hmap_key k);
 cx_hmap_api_ bool cx_hmap_name_(_del)(cx_hmap_name* m, cx_hmap_key k);
+cx_hmap_api_ cx_hmap_val* cx_hmap_name_(_emplace)(cx_hmap_name* m, cx_hmap_key const* k, bool* inserted);
+cx_hmap_api_ void cx_hmap_name_(_set_ptr)(cx_hmap_name* m, cx_hmap_key const* k, cx_hmap_val const* v);
+cx_hmap_api_ bool cx_hmap_name_(_upsert)(cx_hmap_name* m, cx_hmap_key k, void (*fn)(cx_hmap_val* val, bool found, void* ctx), void* ctx);
+#ifdef cx_hmap_cmp_keyn
+cx_hmap_api_ cx_hmap_val* cx_hmap_name_(_getn)(cx_hmap_name* m, const void* key, size_t len, size_t hash);
+cx_hmap_api_ bool cx_hmap_name_(_deln)(cx_hmap_name* m, const void* key, size_t len, size_t hash);
+#endif
+cx_hmap_api_ size_t cx_hmap_name_(_get_batch)(cx_hmap_name* m, cx_hmap_key const* keys, size_t n, cx_hmap_val** vals);
+cx_hmap_api_ void cx_hmap_name_(_set_batch)(cx_hmap_name* m, cx_hmap_key const* keys, cx_hmap_val const* vals, size_t n);
 cx_hmap_api_ void cx_hmap_name_(_clear)(cx_hmap_name* m);
 cx_hmap_api_ size_t cx_hmap_name_(_count)(cx_hmap_name* m);
 cx_hmap_api_ cx_hmap_name_(_entry)* cx_hmap_name_(_next)(cx_hmap_name* m, cx_hmap_name_(_iter)* iter);
@@ -299,15 +440,127 @@ cx_hmap_api_ cx_hmap_name_(_entry)* cx_hmap_name_(_next)(cx_hmap_name* m, cx_hma
     #define cx_hmap_op_set_ (0)
     #define cx_hmap_op_get_ (1)
     #define cx_hmap_op_del_ (2)
+    #define cx_hmap_op_ins_ (3)
 
-    size_t cx_hmap_next_prime(size_t n);
-
-    // Declaration of function to hash keys
+    // Declaration of functions to hash keys
     uint32_t cx_hmap_hash_fnv1a32(const void *buf, size_t len);
+    uint64_t cx_hmap_hash_wy64(const void* buf, size_t len);
+    uint64_t cx_hmap_hash_wy64_str(const char* str);
 
     // Declaration of function for freeing C strings
     void cx_hmap_free_str(char** str);
 
+    // Returns a chain node from the free list or from the current slab,
+    // allocating a new slab if necessary.
+    cx_hmap_api_ cx_hmap_name_(_entry)* cx_hmap_name_(_alloc_node_)(cx_hmap_name* m) {
+
+        if (m->free_nodes_ != NULL) {
+            cx_hmap_name_(_entry)* e = m->free_nodes_;
+            m->free_nodes_ = e->next_;
+            return e;
+        }
+        if (m->slabs_ == NULL || m->slab_used_ == m->slabs_->nnodes_) {
+            size_t nnodes = m->slabs_ == NULL ? cx_hmap_slab_min_nodes_ : m->slabs_->nnodes_ * 2;
+            if (nnodes > cx_hmap_slab_max_nodes) {
+                nnodes = cx_hmap_slab_max_nodes;
+            }
+            cx_hmap_name_(_slab_)* slab = cx_hmap_alloc_(m, sizeof(cx_hmap_name_(_slab_)) + nnodes * sizeof(cx_hmap_name_(_entry)));
+            slab->next_ = m->slabs_;
+            slab->nnodes_ = nnodes;
+            m->slabs_ = slab;
+            m->slab_used_ = 0;
+        }
+        return m->slabs_->nodes_ + m->slab_used_++;
+    }
+
+    // Returns chain node to the free list
+    cx_hmap_api_ void cx_hmap_name_(_free_node_)(cx_hmap_name* m, cx_hmap_name_(_entry)* e) {
+
+        e->next_ = m->free_nodes_;
+        m->free_nodes_ = e;
+    }
+
+    // Frees all the slabs of chain nodes
+    cx_hmap_api_ void cx_hmap_name_(_free_slabs_)(cx_hmap_name* m) {
+
+        cx_hmap_name_(_slab_)* slab = m->slabs_;
+        while (slab != NULL) {
+            cx_hmap_name_(_slab_)* next = slab->next_;
+            cx_hmap_free_(m, slab, sizeof(cx_hmap_name_(_slab_)) + slab->nnodes_ * sizeof(cx_hmap_name_(_entry)));
+            slab = next;
+        }
+        m->slabs_ = NULL;
+        m->slab_used_ = 0;
+        m->free_nodes_ = NULL;
+    }
+
+    // Moves entry from the old bucket array to its bucket in the current bucket array.
+    // If 'node' is true the entry is an allocated chain node which is reused if possible.
+    cx_hmap_api_ void cx_hmap_name_(_move_entry_)(cx_hmap_name* m, cx_hmap_name_(_entry)* src, bool node) {
+
+        const size_t hash = cx_hmap_entry_hash_(src);
+        cx_hmap_name_(_entry)* e = m->buckets_ + cx_hmap_fib_index_(hash, m->nbuckets_);
+        // If destination bucket is empty, copy the entry to the bucket area
+        if (e->next_ == NULL) {
+            cx_hmap_set_hash_(e, hash);
+            memcpy(&e->key, &src->key, sizeof(cx_hmap_key));
+            memcpy(&e->val, &src->val, sizeof(cx_hmap_val));
+            e->next_ = e;
+            if (node) {
+                cx_hmap_name_(_free_node_)(m, src);
+            }
+            return;
+        }
+        // Otherwise links a chain node as the first link of the bucket
+        cx_hmap_name_(_entry)* new = src;
+        if (!node) {
+            new = cx_hmap_name_(_alloc_node_)(m);
+            cx_hmap_set_hash_(new, hash);
+            memcpy(&new->key, &src->key, sizeof(cx_hmap_key));
+            memcpy(&new->val, &src->val, sizeof(cx_hmap_val));
+        }
+        new->next_ = e->next_ == e ? NULL : e->next_;
+        e->next_ = new;
+    }
+
+    // Moves all the entries from the specified old bucket to the current bucket array
+    cx_hmap_api_ void cx_hmap_name_(_migrate_bucket_)(cx_hmap_name* m, cx_hmap_name_(_entry)* b) {
+
+        if (b->next_ == NULL) {
+            return;
+        }
+        cx_hmap_name_(_entry)* curr = b->next_ == b ? NULL : b->next_;
+        cx_hmap_name_(_move_entry_)(m, b, false);
+        b->next_ = NULL;
+        while (curr != NULL) {
+            cx_hmap_name_(_entry)* next = curr->next_;
+            cx_hmap_name_(_move_entry_)(m, curr, true);
+            curr = next;
+        }
+    }
+
+#ifdef cx_hmap_incremental_rehash
+    // Migrates up to 'n' buckets from the old bucket array.
+    // Frees the old bucket array after the last bucket is migrated.
+    cx_hmap_api_ void cx_hmap_name_(_rehash_step_)(cx_hmap_name* m, size_t n) {
+
+        if (m->old_buckets_ == NULL) {
+            return;
+        }
+        while (n > 0 && m->migrated_ < m->old_nbuckets_) {
+            cx_hmap_name_(_migrate_bucket_)(m, m->old_buckets_ + m->migrated_);
+            m->migrated_++;
+            n--;
+        }
+        if (m->migrated_ == m->old_nbuckets_) {
+            cx_hmap_free_(m, m->old_buckets_, m->old_nbuckets_ * sizeof(cx_hmap_name_(_entry)));
+            m->old_buckets_ = NULL;
+            m->old_nbuckets_ = 0;
+            m->migrated_ = 0;
+        }
+    }
+#endif
+
     // Resize hash map if load exceeded
     cx_hmap_api_ void cx_hmap_name_(_check_resize_)(cx_hmap_name* m) {
 
@@ -315,28 +568,36 @@ cx_hmap_api_ cx_hmap_name_(_entry)* cx_hmap_name_(_next)(cx_hmap_name* m, cx_hma
             return;
         }
 
-        cx_hmap_name new = *m; // copy eventual allocator
-        new.nbuckets_ = cx_hmap_next_prime(m->nbuckets_ + 1);
-        new.count_ = 0;
-        new.buckets_ = NULL;
-        cx_hmap_name_(_iter) iter = {0};
-        while (true) {
-            cx_hmap_name_(_entry)* e = cx_hmap_name_(_next)(m, &iter);
-            if (e == NULL) {
-                break;
-            }
-            cx_hmap_name_(_set)(&new, e->key, e->val);
+#ifdef cx_hmap_incremental_rehash
+        // Finishes previous migration if not completed
+        cx_hmap_name_(_rehash_step_)(m, SIZE_MAX);
+#endif
+        cx_hmap_name_(_entry)* old_buckets = m->buckets_;
+        const size_t old_nbuckets = m->nbuckets_;
+        m->nbuckets_ *= 2;
+        const size_t allocSize = m->nbuckets_ * sizeof(*m->buckets_);
+        m->buckets_ = cx_hmap_alloc_(m, allocSize);
+        memset(m->buckets_, 0, allocSize);
+#ifdef cx_hmap_incremental_rehash
+        // The entries of the old buckets will be migrated by the next operations
+        m->old_buckets_ = old_buckets;
+        m->old_nbuckets_ = old_nbuckets;
+        m->migrated_ = 0;
+#else
+        // Moves all the entries, reusing the chain nodes
+        for (size_t i = 0; i < old_nbuckets; i++) {
+            cx_hmap_name_(_migrate_bucket_)(m, old_buckets + i);
         }
-        // Clear the old map nodes and buckets, but KEEP the entries.
-        cx_hmap_name_(_free_internal_)(m, false, true);
-        *m = new;
+        cx_hmap_free_(m, old_buckets, old_nbuckets * sizeof(*m->buckets_));
+#endif
         //printf("RESIZED:%lu\n", m->nbuckets_);
     }
 
     // Creates a new entry and inserts it after specified parent
-    cx_hmap_api_ cx_hmap_name_(_entry)* cx_hmap_name_(_add_entry_)(cx_hmap_name* m, cx_hmap_name_(_entry)* par, cx_hmap_key* key) {
+    cx_hmap_api_ cx_hmap_name_(_entry)* cx_hmap_name_(_add_entry_)(cx_hmap_name* m, cx_hmap_name_(_entry)* par, cx_hmap_key* key, size_t hash) {
 
-        cx_hmap_name_(_entry)* new = cx_hmap_alloc_(m, sizeof(cx_hmap_name_(_entry)));
+        cx_hmap_name_(_entry)* new = cx_hmap_name_(_alloc_node_)(m);
+        cx_hmap_set_hash_(new, hash);
         memcpy(&new->key, key, sizeof(cx_hmap_key));
         new->next_ = NULL;
         par->next_ = new;
@@ -345,7 +606,7 @@ cx_hmap_api_ cx_hmap_name_(_entry)* cx_hmap_name_(_next)(cx_hmap_name* m, cx_hma
     }
 
     // Map operations
-    cx_hmap_api_ cx_hmap_name_(_entry)* cx_hmap_name_(_oper_)(cx_hmap_name* m, int op, cx_hmap_key* key) {
+    cx_hmap_api_ cx_hmap_name_(_entry)* cx_hmap_name_(_oper_)(cx_hmap_name* m, int op, cx_hmap_key* key, size_t hash) {
 
         if (m->buckets_ == NULL) {
             if (op == cx_hmap_op_get_) {
@@ -354,10 +615,10 @@ cx_hmap_api_ cx_hmap_name_(_entry)* cx_hmap_name_(_next)(cx_hmap_name* m, cx_hma
             if (op == cx_hmap_op_del_) {
                 return NULL;
             }
-            if (op == cx_hmap_op_set_) {
+            if (op == cx_hmap_op_set_ || op == cx_hmap_op_ins_) {
                 // Allows for static initialization of maps
                 if (m->nbuckets_ == 0) {
-                    m->nbuckets_ = cx_hmap_def_nbuckets;
+                    m->nbuckets_ = cx_hmap_next_pow2(cx_hmap_def_nbuckets);
                 }
                 const size_t allocSize = m->nbuckets_ * sizeof(*m->buckets_);
                 m->buckets_ = cx_hmap_alloc_(m, allocSize);
@@ -365,15 +626,32 @@ cx_hmap_api_ cx_hmap_name_(_entry)* cx_hmap_name_(_next)(cx_hmap_name* m, cx_hma
             }
         }
 
-        if (op == cx_hmap_op_set_) {
+        if (op == cx_hmap_op_set_ || op == cx_hmap_op_ins_) {
             cx_hmap_name_(_check_resize_)(m);
         }
+#ifdef cx_hmap_incremental_rehash
+        if (op != cx_hmap_op_get_) {
+            cx_hmap_name_(_rehash_step_)(m, cx_hmap_rehash_step);
+        }
+#endif
 
-        // Hash the key, calculates the bucket index and get its pointer
-        //const size_t hash = cx_hmap_hash_key((char*)key, sizeof(cx_hmap_key));
-        const size_t hash = cx_hmap_hash_key(key);
-        const size_t idx = hash % m->nbuckets_;
+        // Calculates the bucket index from the key hash and get its pointer
+        const size_t idx = cx_hmap_fib_index_(hash, m->nbuckets_);
         cx_hmap_name_(_entry)* e = m->buckets_ + idx;
+#ifdef cx_hmap_incremental_rehash
+        // If the key old bucket was not migrated yet, all the keys
+        // with this old bucket index are still in the old bucket.
+        if (m->old_buckets_ != NULL) {
+            cx_hmap_name_(_entry)* old = m->old_buckets_ + cx_hmap_fib_index_(hash, m->old_nbuckets_);
+            if (old->next_ != NULL) {
+                if (op == cx_hmap_op_get_) {
+                    e = old;
+                } else {
+                    cx_hmap_name_(_migrate_bucket_)(m, old);
+                }
+            }
+        }
+#endif
 
         // If bucket next pointer is NULL, the bucket is empty
         if (e->next_ == NULL) {
@@ -381,6 +659,7 @@ cx_hmap_api_ cx_hmap_name_(_entry)* cx_hmap_name_(_next)(cx_hmap_name* m, cx_hma
             if (op == cx_hmap_op_get_ || op == cx_hmap_op_del_) {
                 return NULL;
             }
+            cx_hmap_set_hash_(e, hash);
             memcpy(&e->key, key, sizeof(cx_hmap_key));
             e->next_ = e;
             m->count_++;
@@ -388,9 +667,9 @@ cx_hmap_api_ cx_hmap_name_(_entry)* cx_hmap_name_(_next)(cx_hmap_name* m, cx_hma
         }
 
         // This bucket is used, checks its key
-        if (cx_hmap_cmp_key(&e->key, key) == 0) {
-            // For "Get" just returns the pointer to this entry.
-            if (op == cx_hmap_op_get_) {
+        if (cx_hmap_hash_eq_(e, hash) && cx_hmap_cmp_key(&e->key, key) == 0) {
+            // For "Get" and "Ins" just returns the pointer to this entry.
+            if (op == cx_hmap_op_get_ || op == cx_hmap_op_ins_) {
                 return e;
             }
             // For "Set" optionally free and updates the key and frees the value.
@@ -419,7 +698,7 @@ cx_hmap_api_ cx_hmap_name_(_entry)* cx_hmap_name_(_next)(cx_hmap_name* m, cx_hma
             if (e->next_ == NULL) {
                 e->next_ = e;
             }
-            cx_hmap_free_(m, next, sizeof(cx_hmap_name_(_entry)));
+            cx_hmap_name_(_free_node_)(m, next);
             return e;
         }
 
@@ -429,17 +708,17 @@ cx_hmap_api_ cx_hmap_name_(_entry)* cx_hmap_name_(_next)(cx_hmap_name* m, cx_hma
             if (op == cx_hmap_op_get_ || op == cx_hmap_op_del_) {
                 return NULL;
             }
-            // For "Set" adds first link to this bucket, returning its pointer
-            return cx_hmap_name_(_add_entry_)(m, e, key);
+            // For "Set" and "Ins" adds first link to this bucket, returning its pointer
+            return cx_hmap_name_(_add_entry_)(m, e, key, hash);
         }
 
         // Checks the linked list of entries starting at this bucket.
         cx_hmap_name_(_entry)* prev = e;
         cx_hmap_name_(_entry)* curr = e->next_;
         while (curr != NULL) {
-            if (cx_hmap_cmp_key(&curr->key, key) == 0) {
-                // For "Get" just returns the pointer
-                if (op == cx_hmap_op_get_) {
+            if (cx_hmap_hash_eq_(curr, hash) && cx_hmap_cmp_key(&curr->key, key) == 0) {
+                // For "Get" and "Ins" just returns the pointer
+                if (op == cx_hmap_op_get_ || op == cx_hmap_op_ins_) {
                     return curr;
                 }
                 // For "Set" optionally free and updates the key and frees the value.
@@ -460,7 +739,7 @@ cx_hmap_api_ cx_hmap_name_(_entry)* cx_hmap_name_(_next)(cx_hmap_name* m, cx_hma
                 }
                 cx_hmap_free_key_(&curr->key);
                 cx_hmap_free_val_(&curr->val);
-                cx_hmap_free_(m, curr, sizeof(cx_hmap_name_(_entry)));
+                cx_hmap_name_(_free_node_)(m, curr);
                 m->count_--;
                 return curr;
             }
@@ -472,7 +751,7 @@ cx_hmap_api_ cx_hmap_name_(_entry)* cx_hmap_name_(_next)(cx_hmap_name* m, cx_hma
             return NULL;
         }
         // Adds new entry to this bucket at the end of the linked list and returns its pointer
-        cx_hmap_name_(_entry)* new = cx_hmap_name_(_add_entry_)(m, prev, key);
+        cx_hmap_name_(_entry)* new = cx_hmap_name_(_add_entry_)(m, prev, key, hash);
         return new;
     }
 
@@ -481,7 +760,7 @@ cx_hmap_api_ cx_hmap_name_(_entry)* cx_hmap_name_(_next)(cx_hmap_name* m, cx_hma
     cx_hmap_api_ cx_hmap_name cx_hmap_name_(_init)(const CxAllocator* alloc, size_t nbuckets) {
         return (cx_hmap_name){
             .alloc_ = alloc == NULL ? cx_def_allocator() : alloc,
-            .nbuckets_ = cx_hmap_next_prime(nbuckets),
+            .nbuckets_ = cx_hmap_next_pow2(nbuckets == 0 ? cx_hmap_def_nbuckets : nbuckets),
         };
     }
 
@@ -489,20 +768,17 @@ cx_hmap_api_ cx_hmap_name_(_entry)* cx_hmap_name_(_next)(cx_hmap_name* m, cx_hma
 
     cx_hmap_api_ cx_hmap_name cx_hmap_name_(_init)(size_t nbuckets) {
         return (cx_hmap_name){
-            .nbuckets_ = cx_hmap_next_prime(nbuckets),
+            .nbuckets_ = cx_hmap_next_pow2(nbuckets == 0 ? cx_hmap_def_nbuckets : nbuckets),
         };
     }
 
 #endif
 
-// Frees all the link list nodes and optionally: entries pointer and/or buckets array
-cx_hmap_api_ void cx_hmap_name_(_free_internal_)(cx_hmap_name* m, bool entries, bool buckets) {
+// Frees all the link list nodes of the specified bucket array and optionally the entries
+cx_hmap_api_ void cx_hmap_name_(_free_chains_)(cx_hmap_name* m, cx_hmap_name_(_entry)* buckets, size_t nbuckets, bool entries) {
 
-    if (m == NULL || m->buckets_ == NULL) {
-         return;
-    }
-    for (size_t i = 0; i < m->nbuckets_; i++) {
-        cx_hmap_name_(_entry)* e = m->buckets_ + i;
+    for (size_t i = 0; i < nbuckets; i++) {
+        cx_hmap_name_(_entry)* e = buckets + i;
         // If bucket is empty or is a single entry, continue
         if (e->next_ == NULL) {
             continue;
@@ -525,12 +801,32 @@ cx_hmap_api_ void cx_hmap_name_(_free_internal_)(cx_hmap_name* m, bool entries,
                 cx_hmap_free_key_(&prev->key);
                 cx_hmap_free_val_(&prev->val);
             }
-            cx_hmap_free_(m, prev, sizeof(cx_hmap_name_(_entry)));
+            cx_hmap_name_(_free_node_)(m, prev);
         }
         e->next_ = NULL;
     }
+}
+
+// Frees all the link list nodes and optionally: entries pointer and/or buckets array
+cx_hmap_api_ void cx_hmap_name_(_free_internal_)(cx_hmap_name* m, bool entries, bool buckets) {
+
+    if (m == NULL || m->buckets_ == NULL) {
+         return;
+    }
+#ifdef cx_hmap_incremental_rehash
+    // The old bucket array being migrated is always freed
+    if (m->old_buckets_ != NULL) {
+        cx_hmap_name_(_free_chains_)(m, m->old_buckets_, m->old_nbuckets_, entries);
+        cx_hmap_free_(m, m->old_buckets_, m->old_nbuckets_ * sizeof(cx_hmap_name_(_entry)));
+        m->old_buckets_ = NULL;
+        m->old_nbuckets_ = 0;
+        m->migrated_ = 0;
+    }
+#endif
+    cx_hmap_name_(_free_chains_)(m, m->buckets_, m->nbuckets_, entries);
     m->count_ = 0;
     if (buckets) {
+        cx_hmap_name_(_free_slabs_)(m);
         cx_hmap_free_(m, m->buckets_, m->nbuckets_ * sizeof(cx_hmap_name_(_entry)));
         m->buckets_ = NULL;
     }
@@ -543,20 +839,150 @@ cx_hmap_api_ void cx_hmap_name_(_free)(cx_hmap_name* m) {
 
 cx_hmap_api_ void cx_hmap_name_(_set)(cx_hmap_name* m, cx_hmap_key k, cx_hmap_val v) {
 
-    cx_hmap_name_(_entry)* e = cx_hmap_name_(_oper_)(m, cx_hmap_op_set_, &k);
+    cx_hmap_name_(_entry)* e = cx_hmap_name_(_oper_)(m, cx_hmap_op_set_, &k, cx_hmap_hash_key(&k));
     e->val = v;
 }
 
 cx_hmap_api_ cx_hmap_val* cx_hmap_name_(_get)(cx_hmap_name* m, cx_hmap_key k) {
-    cx_hmap_name_(_entry)* e = cx_hmap_name_(_oper_)(m, cx_hmap_op_get_, &k);
+    cx_hmap_name_(_entry)* e = cx_hmap_name_(_oper_)(m, cx_hmap_op_get_, &k, cx_hmap_hash_key(&k));
     return e == NULL ? NULL : &e->val;
 }
 
 cx_hmap_api_ bool cx_hmap_name_(_del)(cx_hmap_name* m, cx_hmap_key k) {
-    cx_hmap_name_(_entry)* e = cx_hmap_name_(_oper_)(m, cx_hmap_op_del_, &k);
+    cx_hmap_name_(_entry)* e = cx_hmap_name_(_oper_)(m, cx_hmap_op_del_, &k, cx_hmap_hash_key(&k));
     return e == NULL ? false : true;
 }
 
+cx_hmap_api_ cx_hmap_val* cx_hmap_name_(_emplace)(cx_hmap_name* m, cx_hmap_key const* k, bool* inserted) {
+
+    const size_t count = m->count_;
+    cx_hmap_name_(_entry)* e = cx_hmap_name_(_oper_)(m, cx_hmap_op_ins_, (cx_hmap_key*)k, cx_hmap_hash_key(k));
+    const bool ins = m->count_ != count;
+    if (ins) {
+        memset(&e->val, 0, sizeof(e->val));
+    }
+    if (inserted) {
+        *inserted = ins;
+    }
+    return &e->val;
+}
+
+cx_hmap_api_ void cx_hmap_name_(_set_ptr)(cx_hmap_name* m, cx_hmap_key const* k, cx_hmap_val const* v) {
+
+    cx_hmap_name_(_entry)* e = cx_hmap_name_(_oper_)(m, cx_hmap_op_set_, (cx_hmap_key*)k, cx_hmap_hash_key(k));
+    memcpy(&e->val, v, sizeof(e->val));
+}
+
+cx_hmap_api_ bool cx_hmap_name_(_upsert)(cx_hmap_name* m, cx_hmap_key k, void (*fn)(cx_hmap_val* val, bool found, void* ctx), void* ctx) {
+
+    bool inserted;
+    cx_hmap_val* v = cx_hmap_name_(_emplace)(m, &k, &inserted);
+#ifdef cx_hmap_free_key
+    if (!inserted) {
+        cx_hmap_free_key(&k);
+    }
+#endif
+    fn(v, !inserted, ctx);
+    return !inserted;
+}
+
+#ifdef cx_hmap_cmp_keyn
+
+    // Returns the entry with the key equal to the specified key view or NULL if not found
+    static cx_hmap_name_(_entry)* cx_hmap_name_(_findn_)(cx_hmap_name* m, const void* key, size_t len, size_t hash) {
+
+        if (m->buckets_ == NULL) {
+            return NULL;
+        }
+        cx_hmap_name_(_entry)* e = m->buckets_ + cx_hmap_fib_index_(hash, m->nbuckets_);
+#ifdef cx_hmap_incremental_rehash
+        if (m->old_buckets_ != NULL) {
+            cx_hmap_name_(_entry)* old = m->old_buckets_ + cx_hmap_fib_index_(hash, m->old_nbuckets_);
+            if (old->next_ != NULL) {
+                e = old;
+            }
+        }
+#endif
+        if (e->next_ == NULL) {
+            return NULL;
+        }
+        // The bucket entry points to itself if it has no linked entries
+        while (true) {
+            if (cx_hmap_hash_eq_(e, hash) && cx_hmap_cmp_keyn(&e->key, key, len) == 0) {
+                return e;
+            }
+            if (e->next_ == e || e->next_ == NULL) {
+                return NULL;
+            }
+            e = e->next_;
+        }
+    }
+
+cx_hmap_api_ cx_hmap_val* cx_hmap_name_(_getn)(cx_hmap_name* m, const void* key, size_t len, size_t hash) {
+
+    cx_hmap_name_(_entry)* e = cx_hmap_name_(_findn_)(m, key, len, hash);
+    return e == NULL ? NULL : &e->val;
+}
+
+cx_hmap_api_ bool cx_hmap_name_(_deln)(cx_hmap_name* m, const void* key, size_t len, size_t hash) {
+
+    cx_hmap_name_(_entry)* e = cx_hmap_name_(_findn_)(m, key, len, hash);
+    if (e == NULL) {
+        return false;
+    }
+    // Deletes using a copy of the stored key which is equal to the key view
+    cx_hmap_key k = e->key;
+    cx_hmap_name_(_oper_)(m, cx_hmap_op_del_, &k, hash);
+    return true;
+}
+
+#endif
+
+cx_hmap_api_ size_t cx_hmap_name_(_get_batch)(cx_hmap_name* m, cx_hmap_key const* keys, size_t n, cx_hmap_val** vals) {
+
+    size_t found = 0;
+    size_t hashes[cx_hmap_batch_];
+    for (size_t b = 0; b < n; b += cx_hmap_batch_) {
+        const size_t count = n - b < cx_hmap_batch_ ? n - b : cx_hmap_batch_;
+        cx_hmap_key* pk = (cx_hmap_key*)keys + b;
+        for (size_t i = 0; i < count; i++) {
+            hashes[i] = cx_hmap_hash_key(&pk[i]);
+        }
+        if (m->buckets_ != NULL) {
+            for (size_t i = 0; i < count; i++) {
+                __builtin_prefetch(m->buckets_ + cx_hmap_fib_index_(hashes[i], m->nbuckets_), 0);
+            }
+        }
+        for (size_t i = 0; i < count; i++) {
+            cx_hmap_name_(_entry)* e = cx_hmap_name_(_oper_)(m, cx_hmap_op_get_, &pk[i], hashes[i]);
+            vals[b + i] = e == NULL ? NULL : &e->val;
+            found += e != NULL;
+        }
+    }
+    return found;
+}
+
+cx_hmap_api_ void cx_hmap_name_(_set_batch)(cx_hmap_name* m, cx_hmap_key const* keys, cx_hmap_val const* vals, size_t n) {
+
+    size_t hashes[cx_hmap_batch_];
+    for (size_t b = 0; b < n; b += cx_hmap_batch_) {
+        const size_t count = n - b < cx_hmap_batch_ ? n - b : cx_hmap_batch_;
+        cx_hmap_key* pk = (cx_hmap_key*)keys + b;
+        for (size_t i = 0; i < count; i++) {
+            hashes[i] = cx_hmap_hash_key(&pk[i]);
+        }
+        if (m->buckets_ != NULL) {
+            for (size_t i = 0; i < count; i++) {
+                __builtin_prefetch(m->buckets_ + cx_hmap_fib_index_(hashes[i], m->nbuckets_), 1);
+            }
+        }
+        for (size_t i = 0; i < count; i++) {
+            cx_hmap_name_(_entry)* e = cx_hmap_name_(_oper_)(m, cx_hmap_op_set_, &pk[i], hashes[i]);
+            e->val = vals[b + i];
+        }
+    }
+}
+
 cx_hmap_api_ void cx_hmap_name_(_clear)(cx_hmap_name* m) {
 
     cx_hmap_name_(_free_internal_)(m, true, false);
@@ -566,12 +992,31 @@ cx_hmap_api_ size_t cx_hmap_name_(_count)(cx_hmap_name* m) {
     return m->count_;
 }
 
+// Returns pointer to the bucket at the specified iteration index.
+// During incremental rehash, iterates over the old buckets first.
+cx_hmap_api_ cx_hmap_name_(_entry)* cx_hmap_name_(_iter_bucket_)(cx_hmap_name* m, size_t i) {
+
+#ifdef cx_hmap_incremental_rehash
+    if (i < m->old_nbuckets_) {
+        return m->old_buckets_ + i;
+    }
+    return m->buckets_ + i - m->old_nbuckets_;
+#else
+    return m->buckets_ + i;
+#endif
+}
+
 cx_hmap_api_ cx_hmap_name_(_entry)* cx_hmap_name_(_next)(cx_hmap_name* m, cx_hmap_name_(_iter)* iter) {
 
     if (m->count_ == 0) {
         return NULL;
     }
-    for (size_t i = iter->bucket_; i < m->nbuckets_; i++) {
+#ifdef cx_hmap_incremental_rehash
+    const size_t nbuckets = m->old_nbuckets_ + m->nbuckets_;
+#else
+    const size_t nbuckets = m->nbuckets_;
+#endif
+    for (size_t i = iter->bucket_; i < nbuckets; i++) {
         if (iter->next_ != NULL) {
             cx_hmap_name_(_entry)* e = iter->next_;
             iter->next_ = e->next_;
@@ -580,7 +1025,7 @@ cx_hmap_api_ cx_hmap_name_(_entry)* cx_hmap_name_(_next)(cx_hmap_name* m, cx_hma
             }
             return e;
         }
-        cx_hmap_name_(_entry)* e = m->buckets_ + i;
+        cx_hmap_name_(_entry)* e = cx_hmap_name_(_iter_bucket_)(m, i);
         if (e->next_ == NULL) {
             iter->bucket_++;
             continue;
@@ -608,14 +1053,25 @@ cx_hmap_api_ cx_hmap_name_(_entry)* cx_hmap_name_(_next)(cx_hmap_name* m, cx_hma
         size_t min_chain;       // Number of links of the shortest chain
         float  avg_chain;       // Average chain length
         float  load_factor;     // Load factor: count / nbuckets
+        size_t old_nbuckets;    // Number of old buckets still being migrated
+        size_t slabs;           // Number of allocated slabs of chain nodes
+        size_t slab_nodes;      // Total number of chain nodes in all slabs
+        size_t free_nodes;      // Number of released chain nodes in the free list
+        size_t unused_nodes;    // Number of nodes not yet used from the last allocated slab
     } cx_hmap_name_(_stats);
 
     cx_hmap_api_ cx_hmap_name_(_stats) cx_hmap_name_(_get_stats)(const cx_hmap_name* m) {
         cx_hmap_name_(_stats) s = {0};
         s.nbuckets = m->nbuckets_;
         s.min_chain = UINT64_MAX;
-        for (size_t i = 0; i < m->nbuckets_; i++) {
-            cx_hmap_name_(_entry)* e = &m->buckets_[i];
+#ifdef cx_hmap_incremental_rehash
+        s.old_nbuckets = m->old_nbuckets_;
+        const size_t nbuckets = m->old_nbuckets_ + m->nbuckets_;
+#else
+        const size_t nbuckets = m->nbuckets_;
+#endif
+        for (size_t i = 0; i < nbuckets; i++) {
+            cx_hmap_name_(_entry)* e = cx_hmap_name_(_iter_bucket_)((cx_hmap_name*)m, i);
             if (e->next_ == NULL) {
                 s.min_chain = 0;
                 s.empty++;
@@ -641,6 +1097,16 @@ cx_hmap_api_ cx_hmap_name_(_entry)* cx_hmap_name_(_next)(cx_hmap_name* m, cx_hma
                 s.min_chain = chains;
             }
         }
+        for (cx_hmap_name_(_slab_)* slab = m->slabs_; slab != NULL; slab = slab->next_) {
+            s.slabs++;
+            s.slab_nodes += slab->nnodes_;
+        }
+        if (m->slabs_ != NULL) {
+            s.unused_nodes = m->slabs_->nnodes_ - m->slab_used_;
+        }
+        for (cx_hmap_name_(_entry)* e = m->free_nodes_; e != NULL; e = e->next_) {
+            s.free_nodes++;
+        }
         //s.avg_chain = (float)(s.max_chain + s.min_chain)/2.0;
         s.avg_chain = (float)s.links / (float)s.count;
         s.load_factor = (float)s.count / (float)m->nbuckets_;
@@ -656,7 +1122,12 @@ cx_hmap_api_ cx_hmap_name_(_entry)* cx_hmap_name_(_next)(cx_hmap_name* m, cx_hma
                 "max_chain..: %lu\n"
                 "min_chain..: %lu\n"
                 "avg_chain..: %.2f\n"
-                "load_factor: %.2f\n",
+                "load_factor: %.2f\n"
+                "old_nbuckets: %lu\n"
+                "slabs......: %lu\n"
+                "slab_nodes.: %lu\n"
+                "free_nodes.: %lu\n"
+                "unused_nodes: %lu\n",
                 ps->nbuckets,
                 ps->count,
                 ps->empty,
@@ -664,7 +1135,12 @@ cx_hmap_api_ cx_hmap_name_(_entry)* cx_hmap_name_(_next)(cx_hmap_name* m, cx_hma
                 ps->max_chain,
                 ps->min_chain,
                 ps->avg_chain,
-                ps->load_factor);
+                ps->load_factor,
+                ps->old_nbuckets,
+                ps->slabs,
+                ps->slab_nodes,
+                ps->free_nodes,
+                ps->unused_nodes);
     }
 
 #endif // cx_hmap_stats
@@ -675,6 +1151,7 @@ cx_hmap_api_ cx_hmap_name_(_entry)* cx_hmap_name_(_next)(cx_hmap_name* m, cx_hma
 #undef cx_hmap_key
 #undef cx_hmap_val
 #undef cx_hmap_cmp_key
+#undef cx_hmap_cmp_keyn
 #undef cx_hmap_hash_key
 #undef cx_hmap_free_key
 #undef cx_hmap_free_val
@@ -684,6 +1161,12 @@ cx_hmap_api_ cx_hmap_name_(_entry)* cx_hmap_name_(_next)(cx_hmap_name* m, cx_hma
 #undef cx_hmap_inline
 #undef cx_hmap_implement
 #undef cx_hmap_stats
+#undef cx_hmap_incremental_rehash
+#undef cx_hmap_rehash_step
+#undef cx_hmap_def_nbuckets
+#undef cx_hmap_load_factor
+#undef cx_hmap_slab_max_nodes
+#undef cx_hmap_cache_hash
 
 // Undefine internal macros
 #undef cx_hmap_concat2_
@@ -695,10 +1178,17 @@ cx_hmap_api_ cx_hmap_name_(_entry)* cx_hmap_name_(_next)(cx_hmap_name* m, cx_hma
 #undef cx_hmap_alloc_
 #undef cx_hmap_free_
 #undef cx_hmap_free_key_
+#undef cx_hmap_batch_
 #undef cx_hmap_free_val_
 #undef cx_hmap_op_set_
 #undef cx_hmap_op_get_
 #undef cx_hmap_op_del_
+#undef cx_hmap_op_ins_
+#undef cx_hmap_slab_min_nodes_
+#undef cx_hmap_hash_field_
+#undef cx_hmap_entry_hash_
+#undef cx_hmap_hash_eq_
+#undef cx_hmap_set_hash_
 
 
 
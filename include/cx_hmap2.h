@@ -2,8 +2,11 @@
 Hashmap Implementation
 ----------------------
 - Uses open addressing with linear probing.
+- The number of buckets is a power of 2 and the initial probe index is selected using Fibonacci hashing.
 - Uses global type allocator initialized with default allocator.
 - Can be configured to use custom allocator per instance.
+- Optionally stores the hash of each entry.
+- Optionally uses Robin Hood insertion and backward shift deletion.
 
 Example
 -------
@@ -67,7 +70,8 @@ Define the type of the map value (mandatory):
     #define cx_hmap_val <type>
 
 Define the default initial number of buckets,
-when map is initialized with nbuckets = 0
+when map is initialized with nbuckets = 0.
+The number of buckets is always rounded to a power of 2.
     #define cx_hmap_def_nbuckets <n>
 
 Define the load factor (number of entries/number of buckets)
@@ -77,14 +81,42 @@ which, if exceeded, will imply in the rehash of the hash map
 
 Define the key comparison function:
 int (*cmp)(const void* k1, const void* k2, size_t size);
-The default comparison function is memcmp();
+The default comparison function is a single integer comparison
+for keys with size of 1, 2, 4 or 8 bytes and memcmp() otherwise.
     #define cx_hmap_cmp_key(pk1,pk2,s) <cmp_func>
 
 Define the key hash function:
-uint32_t (*hash)(const void* key, size_t size);
-The default hash function implements FNV-1a algorithm
+size_t (*hash)(const void* key, size_t size);
+The default hash function is a multiplicative mixer for keys with size of
+1, 2, 4 or 8 bytes and cx_hmap_hash_wy64() otherwise, a 64 bit hash which processes
+16 bytes per iteration. cx_hmap_hash_fnv1a32() is also available.
     #define cx_hmap_hash_key(pk,s) <hash_func>
 
+Stores the hash of the key in each entry.
+Probes compare the stored hashes before calling the key comparison function
+and resizing does not need to call the key hash function again.
+Recommended for keys with expensive comparison, such as strings.
+    #define cx_hmap_cache_hash
+
+Uses Robin Hood insertion: an entry being inserted takes the bucket of an entry
+which is closer to its initial bucket, keeping the probe distances of all entries
+short and similar. The status of each bucket stores the probe distance of its entry,
+so lookups stop as soon as an entry closer to its initial bucket is found.
+Deletes shift back the following entries instead of leaving deleted buckets,
+so probe lengths do not grow with repeated inserts and deletes.
+The probe distances must fit in a byte: inserting a key which would need a
+longer probe distance after resizing the map once aborts the program, which
+happens only if about 255 keys have the same hash.
+    #define cx_hmap_robin_hood
+
+Define function to compare the key pointed by 'pk' with a borrowed key view
+with the specified pointer and length, returning 0 if they are equal.
+Enables the _getn() and _deln() functions.
+    #define cx_hmap_cmp_keyn(pk,key,len) <cmp_func>
+    example for map<char*, T>:
+        #define cx_hmap_cmp_keyn(pk,key,len)\
+            (strncmp(*(char**)(pk),key,len) || (*(char**)(pk))[len])
+
 Define function to free the key of deleted entries:
 void (*free)(void* key);
 By default no function is defined.
@@ -117,6 +149,11 @@ Enable implementation of stats function.
 Used mainly for development and benchmarking
     #define cx_hmap_stats
 
+Enable the functions to save the map to a file and to open a saved map
+mapped in memory. The key and value types must be plain data without pointers
+and the key hash function must be the same for the processes sharing the file.
+    #define cx_hmap_freeze
+
 
 API
 ---
@@ -148,6 +185,55 @@ Deletes entry with the specified key.
 Returns true if found or false otherwise.
     bool hmap_del(hmap* m, ktype k);
 
+Returns pointer to the value associated with the key pointed by 'k',
+inserting a new entry with the value zeroed if the key is not found,
+using a single probe. Sets 'inserted' (if not NULL) to indicate if
+the entry was inserted. The key is copied to the map only if inserted,
+otherwise it is still owned by the caller.
+    vtype* hmap_emplace(hmap* m, ktype const* k, bool* inserted);
+
+Inserts or updates the key and value pointed by 'k' and 'v',
+copying them directly to the entry.
+    void hmap_set_ptr(hmap* m, ktype const* k, vtype const* v);
+
+Calls 'fn' with pointer to the value associated with the specified key,
+inserting a new entry with the value zeroed if the key is not found,
+using a single probe. The key is moved to the map as in 'set'.
+Returns true if the key was found or false if it was inserted.
+    bool hmap_upsert(hmap* m, ktype k, void (*fn)(vtype* val, bool found, void* ctx), void* ctx);
+
+Returns pointer to value associated with the key equal to the specified key view
+with 'len' bytes and precomputed 'hash', which must be the same hash calculated by
+the key hash function for the equal key (only if cx_hmap_cmp_keyn is defined).
+Returns NULL if not found.
+    vtype* hmap_getn(const hmap* m, const void* key, size_t len, size_t hash);
+
+Deletes entry with the key equal to the specified key view with 'len' bytes and
+precomputed 'hash' (only if cx_hmap_cmp_keyn is defined).
+Returns true if found or false otherwise.
+    bool hmap_deln(hmap* m, const void* key, size_t len, size_t hash);
+
+Gets the values of 'n' keys, setting each element of 'vals' to the pointer
+to the value associated with the corresponding key or NULL if not found.
+The keys are hashed and their buckets prefetched in batches, overlapping the
+memory latency of several lookups. Returns the number of keys found.
+    size_t hmap_get_batch(const hmap* m, const ktype* keys, size_t n, vtype** vals);
+
+Inserts or updates 'n' keys and values, hashing the keys and prefetching
+their buckets in batches.
+    void hmap_set_batch(hmap* m, const ktype* keys, const vtype* vals, size_t n);
+
+Removes in a single sweep the entries for which 'pred' returns false,
+calling it once for each entry.
+With linear probing the deleted buckets are also cleared in the same sweep,
+moving the remaining entries in place closer to their initial buckets.
+    void hmap_retain(hmap* m, bool (*pred)(hmap_entry* e, void* ctx), void* ctx);
+
+Rehashes the map to the smallest number of buckets for the current number of
+entries which does not exceed the resize load factor, releasing the memory
+of the map if it is empty.
+    void hmap_shrink_to_fit(hmap* m);
+
 Returns the number of entries in the hashmap
     size_t hmap_count(const hmap* m);
 
@@ -157,9 +243,36 @@ The current number of buckets is not changed.
 
 Returns the next hashmap entry from the specified iterator.
 Returns NULL after the last entry.
+Empty buckets are skipped 8 status bytes at a time.
     hmap_entry* hmap_next(const hmap* m, hmap_iter* iter);
 
-Returns statistics for the specified map (if enabled)
+Returns iterator over the entries of the buckets from 'begin' up to but not including 'end'.
+The map must not be modified while the iterator is in use.
+    hmap_iter hmap_iter_range(const hmap* m, size_t begin, size_t end);
+
+Splits the buckets of the map in up to 'n' disjoint ranges with about the same number
+of buckets, and so of entries, setting the first elements of 'iters' with their iterators.
+Returns the number of ranges, which is less than 'n' for small maps.
+The ranges of a map which is not modified can be iterated concurrently by different threads.
+    size_t hmap_iter_split(const hmap* m, size_t n, hmap_iter* iters);
+
+Writes the map to the specified writer (only if cx_hmap_freeze is defined).
+The file layout is a header followed by the bucket status array and the bucket array,
+at offsets relative to the start of the file, in the native byte order.
+    CxError hmap_freeze(const hmap* m, const CxWriter* out);
+
+Opens file previously written by hmap_freeze(), mapping it read only in memory
+and initializing the map pointing to the mapped arrays without copying them
+(only if cx_hmap_freeze is defined). Processes opening the same file share its pages.
+The map can be used with the functions which don't change it, such as hmap_get(),
+hmap_get_batch(), hmap_count() and hmap_next(), and must be closed with hmap_mapped_close().
+    CxError hmap_mapped_open(const char* path, hmap* m);
+
+Unmaps map opened with hmap_mapped_open() (only if cx_hmap_freeze is defined).
+    void hmap_mapped_close(hmap* m);
+
+Returns statistics for the specified map (if enabled),
+including the maximum and average probe distance of the entries.
     hmap_stats hmap_get_stats(const cx_hmap_name* m);
 
 */
@@ -170,6 +283,15 @@ Returns statistics for the specified map (if enabled)
 #include <assert.h>
 #include <stdio.h>
 #include "cx_alloc.h"
+#include "cx_hmap_util.h"
+#ifdef cx_hmap_freeze
+    #include <fcntl.h>
+    #include <unistd.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include "cx_error.h"
+    #include "cx_writer.h"
+#endif
 
 #ifndef cx_hmap_name
     #error "cx_hmap_name not defined"
@@ -182,23 +304,52 @@ Returns statistics for the specified map (if enabled)
 #endif
 
 #ifndef cx_hmap_def_nbuckets
-    #define cx_hmap_def_nbuckets (17)
+    #define cx_hmap_def_nbuckets (16)
 #endif
 
 #ifndef cx_hmap_resize_load
     #define cx_hmap_resize_load (0.8)
 #endif
 
-// Default key comparison function
+// Default key comparison function:
+// single integer compare for keys with 1, 2, 4 or 8 bytes, memcmp() otherwise.
 #ifndef cx_hmap_cmp_key
-    #define cx_hmap_cmp_key memcmp
+    #define cx_hmap_cmp_key(pk1,pk2,s)\
+        (cx_hmap_int_key_(s) ? cx_hmap_cmp_int_(pk1,pk2,s) : memcmp(pk1,pk2,s))
 #endif
 
-// Default key hash function
+// Default key hash function:
+// multiplicative mixer for keys with 1, 2, 4 or 8 bytes, cx_hmap_hash_wy64() otherwise.
 #ifndef cx_hmap_hash_key
-    #define cx_hmap_hash_key cx_hmap_hash_fnv1a32
+    #define cx_hmap_hash_key(pk,s)\
+        (cx_hmap_int_key_(s) ? cx_hmap_hash_int_(pk,s) : cx_hmap_hash_wy64(pk,s))
+#endif
+
+#ifdef cx_hmap_freeze
+    #if defined(cx_hmap_free_key) || defined(cx_hmap_free_val)
+        #error "cx_hmap_freeze requires keys and values without free functions"
+    #endif
 #endif
 
+// Stored hash of entries
+#ifdef cx_hmap_cache_hash
+    #define cx_hmap_hash_field_         size_t hash_;
+    #define cx_hmap_entry_hash_(e)      ((e)->hash_)
+    #define cx_hmap_hash_eq_(e,h)       ((e)->hash_ == (h))
+    #define cx_hmap_set_hash_(e,h)      (e)->hash_ = (h)
+#else
+    #define cx_hmap_hash_field_
+    #define cx_hmap_entry_hash_(e)      cx_hmap_hash_(&(e)->key)
+    #define cx_hmap_hash_eq_(e,h)       (true)
+    #define cx_hmap_set_hash_(e,h)
+#endif
+
+// Hash of the key pointed by 'pk'
+#define cx_hmap_hash_(pk) cx_hmap_hash_key((char*)(pk), sizeof(cx_hmap_key))
+
+// Number of keys hashed and prefetched at once by the batch functions
+#define cx_hmap_batch_ (16)
+
 // Default free key function
 #ifndef cx_hmap_free_key
     #define cx_hmap_free_key_(key)
@@ -257,6 +408,7 @@ Returns statistics for the specified map (if enabled)
 //
 
 typedef struct cx_hmap_name_(_entry) {
+    cx_hmap_hash_field_
     cx_hmap_key key;
     cx_hmap_val val;
 } cx_hmap_name_(_entry);
@@ -272,6 +424,7 @@ typedef struct cx_hmap_name {
 
 typedef struct cx_hmap_name_(_iter) {
     size_t bucket_;
+    size_t end_;        // End bucket of range or 0 for all buckets
 } cx_hmap_name_(_iter);
 
 #ifdef cx_hmap_instance_allocator
@@ -283,9 +436,27 @@ cx_hmap_api_ void cx_hmap_name_(_free)(cx_hmap_name* m);
 cx_hmap_api_ void cx_hmap_name_(_set)(cx_hmap_name* m, cx_hmap_key k, cx_hmap_val v);
 cx_hmap_api_ cx_hmap_val* cx_hmap_name_(_get)(const cx_hmap_name* m, cx_hmap_key k);
 cx_hmap_api_ bool cx_hmap_name_(_del)(cx_hmap_name* m, cx_hmap_key k);
+cx_hmap_api_ cx_hmap_val* cx_hmap_name_(_emplace)(cx_hmap_name* m, cx_hmap_key const* k, bool* inserted);
+cx_hmap_api_ void cx_hmap_name_(_set_ptr)(cx_hmap_name* m, cx_hmap_key const* k, cx_hmap_val const* v);
+cx_hmap_api_ bool cx_hmap_name_(_upsert)(cx_hmap_name* m, cx_hmap_key k, void (*fn)(cx_hmap_val* val, bool found, void* ctx), void* ctx);
+#ifdef cx_hmap_cmp_keyn
+cx_hmap_api_ cx_hmap_val* cx_hmap_name_(_getn)(const cx_hmap_name* m, const void* key, size_t len, size_t hash);
+cx_hmap_api_ bool cx_hmap_name_(_deln)(cx_hmap_name* m, const void* key, size_t len, size_t hash);
+#endif
+cx_hmap_api_ size_t cx_hmap_name_(_get_batch)(const cx_hmap_name* m, cx_hmap_key const* keys, size_t n, cx_hmap_val** vals);
+cx_hmap_api_ void cx_hmap_name_(_set_batch)(cx_hmap_name* m, cx_hmap_key const* keys, cx_hmap_val const* vals, size_t n);
+cx_hmap_api_ void cx_hmap_name_(_retain)(cx_hmap_name* m, bool (*pred)(cx_hmap_name_(_entry)* e, void* ctx), void* ctx);
+cx_hmap_api_ void cx_hmap_name_(_shrink_to_fit)(cx_hmap_name* m);
 cx_hmap_api_ void cx_hmap_name_(_clear)(cx_hmap_name* m);
 cx_hmap_api_ size_t cx_hmap_name_(_count)(const cx_hmap_name* m);
 cx_hmap_api_ cx_hmap_name_(_entry)* cx_hmap_name_(_next)(cx_hmap_name* m, cx_hmap_name_(_iter)* iter);
+cx_hmap_api_ cx_hmap_name_(_iter) cx_hmap_name_(_iter_range)(const cx_hmap_name* m, size_t begin, size_t end);
+cx_hmap_api_ size_t cx_hmap_name_(_iter_split)(const cx_hmap_name* m, size_t n, cx_hmap_name_(_iter)* iters);
+#ifdef cx_hmap_freeze
+cx_hmap_api_ CxError cx_hmap_name_(_freeze)(const cx_hmap_name* m, const CxWriter* out);
+cx_hmap_api_ CxError cx_hmap_name_(_mapped_open)(const char* path, cx_hmap_name* m);
+cx_hmap_api_ void cx_hmap_name_(_mapped_close)(cx_hmap_name* m);
+#endif
 
 
 //
@@ -295,12 +466,24 @@ cx_hmap_api_ cx_hmap_name_(_entry)* cx_hmap_name_(_next)(cx_hmap_name* m, cx_hma
     #define cx_hmap_empty_  (0)
     #define cx_hmap_full_   (1)
     #define cx_hmap_del_    (2)
+    #define cx_hmap_pending_ (3)    // Entry being placed again by _retain()
     #define cx_hmap_op_set_ (0)
     #define cx_hmap_op_get_ (1)
     #define cx_hmap_op_del_ (2)
+    #define cx_hmap_op_ins_ (3)
 
-    // Declaration of function to hash keys
+#ifdef cx_hmap_robin_hood
+    // The status of a full bucket is the probe distance of its entry plus 1
+    #define cx_hmap_is_full_(st)    ((st) != cx_hmap_empty_)
+    #define cx_hmap_max_dist_       (UINT8_MAX - 1)
+#else
+    #define cx_hmap_is_full_(st)    ((st) == cx_hmap_full_)
+#endif
+
+    // Declaration of functions to hash keys
     uint32_t cx_hmap_hash_fnv1a32(const void *buf, size_t len);
+    uint64_t cx_hmap_hash_wy64(const void* buf, size_t len);
+    uint64_t cx_hmap_hash_wy64_str(const char* str);
 
     // Declaration of function to compare keys of strings with fixed size.
     int cx_hmap_cmp_key_str_arr(const void* k1, const void* k2, size_t size);
@@ -321,7 +504,7 @@ cx_hmap_api_ cx_hmap_name_(_entry)* cx_hmap_name_(_next)(cx_hmap_name* m, cx_hma
         }
 #   if defined(cx_hmap_free_key) || defined(cx_hmap_free_val)
         for (size_t i = 0; i < m->nbuckets_; i++) {
-            if (m->status_[i] == cx_hmap_full_) {
+            if (cx_hmap_is_full_(m->status_[i])) {
                 cx_hmap_free_key_(&m->buckets_[i].key);
                 cx_hmap_free_val_(&m->buckets_[i].val);
             }
@@ -329,34 +512,212 @@ cx_hmap_api_ cx_hmap_name_(_entry)* cx_hmap_name_(_next)(cx_hmap_name* m, cx_hma
 #   endif
     }
 
+#ifdef cx_hmap_robin_hood
+
+    // Returns if an entry can be inserted at 'idx' with probe distance 'dist'
+    // without exceeding the maximum probe distance of the entries it displaces.
+    static inline bool cx_hmap_name_(_rh_check_)(const cx_hmap_name* m, size_t idx, size_t dist) {
+
+        while (dist <= cx_hmap_max_dist_) {
+            if (m->status_[idx] == cx_hmap_empty_) {
+                return true;
+            }
+            // The entry with the smallest distance is the one carried forward
+            const size_t d = m->status_[idx] - 1;
+            if (d < dist) {
+                dist = d;
+            }
+            idx = (idx + 1) & (m->nbuckets_ - 1);
+            dist++;
+        }
+        return false;
+    }
+
+    // Inserts entry at 'idx' with probe distance 'dist' and moves forward
+    // the entries which are closer to their initial buckets.
+    static inline void cx_hmap_name_(_rh_place_)(cx_hmap_name* m, const cx_hmap_name_(_entry)* e, size_t idx, size_t dist) {
+
+        cx_hmap_name_(_entry) carried = *e;
+        while (m->status_[idx] != cx_hmap_empty_) {
+            const size_t d = m->status_[idx] - 1;
+            if (d < dist) {
+                cx_hmap_name_(_entry) tmp = m->buckets_[idx];
+                m->buckets_[idx] = carried;
+                m->status_[idx] = dist + 1;
+                carried = tmp;
+                dist = d;
+            }
+            idx = (idx + 1) & (m->nbuckets_ - 1);
+            dist++;
+        }
+        m->buckets_[idx] = carried;
+        m->status_[idx] = dist + 1;
+    }
+
+    // Deletes entry at 'idx' shifting back the following entries
+    // which are not in their initial buckets.
+    static inline void cx_hmap_name_(_rh_remove_)(cx_hmap_name* m, size_t idx) {
+
+        size_t next = (idx + 1) & (m->nbuckets_ - 1);
+        while (m->status_[next] > 1) {
+            m->buckets_[idx] = m->buckets_[next];
+            m->status_[idx] = m->status_[next] - 1;
+            idx = next;
+            next = (next + 1) & (m->nbuckets_ - 1);
+        }
+        m->status_[idx] = cx_hmap_empty_;
+    }
+
+#endif
+
+    // Rehash map to the specified power of 2 number of buckets
+    cx_hmap_api_ void cx_hmap_name_(_rehash_)(cx_hmap_name* m, size_t nbuckets) {
+
+        cx_hmap_name_(_entry)* old_buckets = m->buckets_;
+        uint8_t* old_status = m->status_;
+        const size_t old_nbuckets = m->nbuckets_;
+        m->nbuckets_ = nbuckets;
+        m->buckets_ = cx_hmap_alloc_(m, m->nbuckets_ * sizeof(*m->buckets_));
+        m->status_ = cx_hmap_alloc_(m, m->nbuckets_ * sizeof(*m->status_));
+        memset(m->status_, cx_hmap_empty_, m->nbuckets_ * sizeof(*m->status_));
+        m->deleted_ = 0;
+
+        // Moves the entries to the first empty bucket from their new index.
+        // The new bucket array has no deleted buckets and no duplicated keys.
+        for (size_t i = 0; i < old_nbuckets; i++) {
+            if (!cx_hmap_is_full_(old_status[i])) {
+                continue;
+            }
+            cx_hmap_name_(_entry)* e = old_buckets + i;
+            size_t idx = cx_hmap_fib_index_(cx_hmap_entry_hash_(e), m->nbuckets_);
+#ifdef cx_hmap_robin_hood
+            size_t dist = 0;
+            while (m->status_[idx] != cx_hmap_empty_ && m->status_[idx] - 1u >= dist) {
+                idx = (idx + 1) & (m->nbuckets_ - 1);
+                dist++;
+            }
+            if (!cx_hmap_name_(_rh_check_)(m, idx, dist)) {
+                fprintf(stderr, "CX_HMAP OVERFLOW\n");
+                abort();
+            }
+            cx_hmap_name_(_rh_place_)(m, e, idx, dist);
+#else
+            while (m->status_[idx] != cx_hmap_empty_) {
+                idx = (idx + 1) & (m->nbuckets_ - 1);
+            }
+            memcpy(m->buckets_ + idx, e, sizeof(*e));
+            m->status_[idx] = cx_hmap_full_;
+#endif
+        }
+        // Free original keeping ENTRIES.
+        cx_hmap_free_(m, old_buckets, old_nbuckets * sizeof(*m->buckets_));
+        cx_hmap_free_(m, old_status, old_nbuckets * sizeof(*m->status_));
+        //printf("RESIZED:%lu/%lu\n", m->nbuckets_,m->count_);
+    }
+
+    // Doubles the number of buckets
+    cx_hmap_api_ void cx_hmap_name_(_resize_)(cx_hmap_name* m) {
+
+        cx_hmap_name_(_rehash_)(m, m->nbuckets_ * 2);
+    }
+
     // Resize hash map if load exceeded
     cx_hmap_api_ void cx_hmap_name_(_check_resize_)(cx_hmap_name* m) {
 
         if (m->count_ + m->deleted_ + 1 < (float)(m->nbuckets_) * cx_hmap_resize_load) {
             return;
         }
+        cx_hmap_name_(_resize_)(m);
+    }
 
-        cx_hmap_name new;
-#ifdef cx_hmap_instance_allocator
-        new = cx_hmap_name_(_init)(m->alloc_, m->nbuckets_*2);
-#else
-        new = cx_hmap_name_(_init)(m->nbuckets_*2);
+#ifdef cx_hmap_robin_hood
+
+    // Map operations using Robin Hood insertion and backward shift deletion.
+    // For "Del" the returned pointer only indicates that the entry was found.
+    // For "Ins" returns the found entry or the inserted entry with the value not initialized.
+    cx_hmap_api_ cx_hmap_name_(_entry)* cx_hmap_name_(_oper_)(cx_hmap_name* m, int op, cx_hmap_key* key, size_t hash, size_t* nprobes) {
+
+        if (m->buckets_ == NULL) {
+            if (op == cx_hmap_op_get_ || op == cx_hmap_op_del_) {
+                return NULL;
+            }
+            // Allows for static initialization of maps
+            if (m->nbuckets_ == 0) {
+                m->nbuckets_ = cx_hmap_next_pow2(cx_hmap_def_nbuckets);
+            }
+            m->buckets_ = cx_hmap_alloc_(m, m->nbuckets_ * sizeof(*m->buckets_));
+            m->status_ = cx_hmap_alloc_(m, m->nbuckets_ * sizeof(*m->status_));
+            memset(m->status_, cx_hmap_empty_, m->nbuckets_ * sizeof(*m->status_));
+        }
+
+        if (op == cx_hmap_op_set_ || op == cx_hmap_op_ins_) {
+            cx_hmap_name_(_check_resize_)(m);
+        }
+
+        bool resized = false;
+        while (true) {
+            // Probes while the entries are not closer to their initial buckets than the key
+            size_t idx = cx_hmap_fib_index_(hash, m->nbuckets_);
+            size_t dist = 0;
+            while (m->status_[idx] != cx_hmap_empty_ && m->status_[idx] - 1u >= dist) {
+                cx_hmap_name_(_entry)* e = m->buckets_ + idx;
+                // Only entries with the same probe distance have the same initial bucket
+                if (m->status_[idx] - 1u == dist && cx_hmap_hash_eq_(e, hash) &&
+                    cx_hmap_cmp_key(&e->key, key, sizeof(cx_hmap_key)) == 0) {
+                    if (nprobes) {
+                        *nprobes = dist;
+                    }
+                    if (op == cx_hmap_op_get_ || op == cx_hmap_op_ins_) {
+                        return e;
+                    }
+                    if (op == cx_hmap_op_set_) {
+#ifdef cx_hmap_free_key
+                        cx_hmap_free_key_(&e->key);
+                        memcpy(&e->key, key, sizeof(cx_hmap_key));
 #endif
-        for (size_t i = 0; i < m->nbuckets_; i++) {
-            if (m->status_[i] == cx_hmap_full_) {
-                cx_hmap_name_(_entry)* e = &m->buckets_[i];
-                cx_hmap_name_(_set)(&new, e->key, e->val);
+                        cx_hmap_free_val_(&e->val);
+                        return e;
+                    }
+                    cx_hmap_free_key_(&e->key);
+                    cx_hmap_free_val_(&e->val);
+                    cx_hmap_name_(_rh_remove_)(m, idx);
+                    m->count_--;
+                    return e;
+                }
+                idx = (idx + 1) & (m->nbuckets_ - 1);
+                dist++;
+            }
+            if (nprobes) {
+                *nprobes = dist;
+            }
+            if (op == cx_hmap_op_get_ || op == cx_hmap_op_del_) {
+                return NULL;
+            }
+            // Resizes once and probes again if any probe distance would not fit in the bucket status.
+            // If it still does not fit, the keys have too many equal hashes and more
+            // resizes would not shorten the probe distances.
+            if (!cx_hmap_name_(_rh_check_)(m, idx, dist)) {
+                if (resized) {
+                    fprintf(stderr, "CX_HMAP OVERFLOW\n");
+                    abort();
+                }
+                cx_hmap_name_(_resize_)(m);
+                resized = true;
+                continue;
             }
+            cx_hmap_name_(_entry) e = {0};
+            cx_hmap_set_hash_(&e, hash);
+            memcpy(&e.key, key, sizeof(cx_hmap_key));
+            cx_hmap_name_(_rh_place_)(m, &e, idx, dist);
+            m->count_++;
+            return m->buckets_ + idx;
         }
-        // Free original keeping ENTRIES.
-        cx_hmap_free_(m, m->buckets_, m->nbuckets_ * sizeof(*m->buckets_));
-        cx_hmap_free_(m, m->status_, m->nbuckets_ * sizeof(*m->status_));
-        //printf("RESIZED:%lu/%lu/%lu\n", m->nbuckets_,m->count_,new.count_);
-        *m = new;
     }
 
+#else
+
     // Map operations
-    cx_hmap_api_ cx_hmap_name_(_entry)* cx_hmap_name_(_oper_)(cx_hmap_name* m, int op, cx_hmap_key* key, size_t* nprobes) {
+    cx_hmap_api_ cx_hmap_name_(_entry)* cx_hmap_name_(_oper_)(cx_hmap_name* m, int op, cx_hmap_key* key, size_t hash, size_t* nprobes) {
 
         if (m->buckets_ == NULL) {
             if (op == cx_hmap_op_get_) {
@@ -365,10 +726,10 @@ cx_hmap_api_ cx_hmap_name_(_entry)* cx_hmap_name_(_next)(cx_hmap_name* m, cx_hma
             if (op == cx_hmap_op_del_) {
                 return NULL;
             }
-            if (op == cx_hmap_op_set_) {
+            if (op == cx_hmap_op_set_ || op == cx_hmap_op_ins_) {
                 // Allows for static initialization of maps
                 if (m->nbuckets_ == 0) {
-                    m->nbuckets_ = cx_hmap_def_nbuckets;
+                    m->nbuckets_ = cx_hmap_next_pow2(cx_hmap_def_nbuckets);
                 }
                 size_t allocSize = m->nbuckets_ * sizeof(*m->buckets_);
                 m->buckets_ = cx_hmap_alloc_(m, allocSize);
@@ -378,18 +739,18 @@ cx_hmap_api_ cx_hmap_name_(_entry)* cx_hmap_name_(_next)(cx_hmap_name* m, cx_hma
             }
         }
 
-        if (op == cx_hmap_op_set_) {
+        if (op == cx_hmap_op_set_ || op == cx_hmap_op_ins_) {
             cx_hmap_name_(_check_resize_)(m);
         }
 
-        // Hash the key and calculates the bucket index
-        const size_t hash = cx_hmap_hash_key((char*)key, sizeof(cx_hmap_key));
-        size_t idx = hash % m->nbuckets_;
+        // Calculates the bucket index from the key hash
+        size_t idx = cx_hmap_fib_index_(hash, m->nbuckets_);
 
         if (nprobes) {
             *nprobes = 0;
         }
         size_t startIdx = idx;
+        size_t delIdx = SIZE_MAX;
         while (true) {
             cx_hmap_name_(_entry)* e = m->buckets_ + idx;
             // Bucket is empty
@@ -398,7 +759,14 @@ cx_hmap_api_ cx_hmap_name_(_entry)* cx_hmap_name_(_next)(cx_hmap_name* m, cx_hma
                 if (op == cx_hmap_op_get_ || op == cx_hmap_op_del_) {
                     return NULL;
                 }
+                // Reuses the first deleted bucket of the probe sequence
+                if (delIdx != SIZE_MAX) {
+                    e = m->buckets_ + delIdx;
+                    idx = delIdx;
+                    m->deleted_--;
+                }
                 // Sets the bucket key
+                cx_hmap_set_hash_(e, hash);
                 memcpy(&e->key, key, sizeof(cx_hmap_key));
                 m->count_++;
                 m->status_[idx] = cx_hmap_full_;
@@ -407,17 +775,19 @@ cx_hmap_api_ cx_hmap_name_(_entry)* cx_hmap_name_(_next)(cx_hmap_name* m, cx_hma
             // Bucket is full
             if (m->status_[idx] == cx_hmap_full_) {
                 // Checks current bucket key
-                if (cx_hmap_cmp_key(&e->key, key, sizeof(cx_hmap_key)) == 0) {
-                    // For "Get" just returns the pointer to this entry.
-                    if (op == cx_hmap_op_get_) {
+                if (cx_hmap_hash_eq_(e, hash) && cx_hmap_cmp_key(&e->key, key, sizeof(cx_hmap_key)) == 0) {
+                    // For "Get" and "Ins" just returns the pointer to this entry.
+                    if (op == cx_hmap_op_get_ || op == cx_hmap_op_ins_) {
                         return e;
                     }
-                    // For "Set" optionally free and updates the key pointer
+                    // For "Set" optionally free and updates the key pointer and frees the value.
+                    // The value will be updated by the caller
                     if (op == cx_hmap_op_set_) {
 #ifdef cx_hmap_free_key
                         cx_hmap_free_key_(&e->key);
                         memcpy(&e->key, key, sizeof(cx_hmap_key));
 #endif
+                        cx_hmap_free_val_(&e->val);
                         return e;
                     }
                     // For "Del" sets this bucket as deleted
@@ -429,19 +799,12 @@ cx_hmap_api_ cx_hmap_name_(_entry)* cx_hmap_name_(_next)(cx_hmap_name* m, cx_hma
                     return e;
                 }
             }
-            // Bucket is deleted
-            if (m->status_[idx] == cx_hmap_del_) {
-                if (op == cx_hmap_op_set_ && idx == startIdx) {
-                    memcpy(&e->key, key, sizeof(cx_hmap_key));
-                    m->count_++;
-                    m->deleted_--;
-                    m->status_[idx] = cx_hmap_full_;
-                    return e;
-                }
+            // Bucket is deleted: the key may still be in a following bucket
+            if (m->status_[idx] == cx_hmap_del_ && delIdx == SIZE_MAX) {
+                delIdx = idx;
             }
             // Linear probing
-            idx++;
-            idx %= m->nbuckets_;
+            idx = (idx + 1) & (m->nbuckets_ - 1);
             if (nprobes) {
                 (*nprobes)++;
             }
@@ -453,12 +816,14 @@ cx_hmap_api_ cx_hmap_name_(_entry)* cx_hmap_name_(_next)(cx_hmap_name* m, cx_hma
         }
     }
 
+#endif
+
 #ifdef cx_hmap_instance_allocator
 
     cx_hmap_api_ cx_hmap_name cx_hmap_name_(_init)(const CxAllocator* alloc, size_t nbuckets) {
         return (cx_hmap_name){
             .alloc_ = alloc == NULL ? cx_def_allocator() : alloc,
-            .nbuckets_ = nbuckets == 0 ? cx_hmap_def_nbuckets : nbuckets,
+            .nbuckets_ = cx_hmap_next_pow2(nbuckets == 0 ? cx_hmap_def_nbuckets : nbuckets),
         };
     }
 
@@ -466,7 +831,7 @@ cx_hmap_api_ cx_hmap_name_(_entry)* cx_hmap_name_(_next)(cx_hmap_name* m, cx_hma
 
     cx_hmap_api_ cx_hmap_name cx_hmap_name_(_init)(size_t nbuckets) {
         return (cx_hmap_name){
-            .nbuckets_ = nbuckets == 0 ? cx_hmap_def_nbuckets : nbuckets,
+            .nbuckets_ = cx_hmap_next_pow2(nbuckets == 0 ? cx_hmap_def_nbuckets : nbuckets),
         };
     }
 
@@ -487,24 +852,168 @@ cx_hmap_api_ void cx_hmap_name_(_free)(cx_hmap_name* m) {
 cx_hmap_api_ void cx_hmap_name_(_set)(cx_hmap_name* m, cx_hmap_key k, cx_hmap_val v) {
 
     assert(m);
-    cx_hmap_name_(_entry)* e = cx_hmap_name_(_oper_)(m, cx_hmap_op_set_, &k, NULL);
+    cx_hmap_name_(_entry)* e = cx_hmap_name_(_oper_)(m, cx_hmap_op_set_, &k, cx_hmap_hash_(&k), NULL);
     e->val = v;
 }
 
 cx_hmap_api_ cx_hmap_val* cx_hmap_name_(_get)(const cx_hmap_name* m, cx_hmap_key k) {
 
     assert(m);
-    cx_hmap_name_(_entry)* e = cx_hmap_name_(_oper_)((cx_hmap_name*)m, cx_hmap_op_get_, &k, NULL);
+    cx_hmap_name_(_entry)* e = cx_hmap_name_(_oper_)((cx_hmap_name*)m, cx_hmap_op_get_, &k, cx_hmap_hash_(&k), NULL);
     return e == NULL ? NULL : &e->val;
 }
 
 cx_hmap_api_ bool cx_hmap_name_(_del)(cx_hmap_name* m, cx_hmap_key k) {
 
     assert(m);
-    cx_hmap_name_(_entry)* e = cx_hmap_name_(_oper_)(m, cx_hmap_op_del_, &k, NULL);
+    cx_hmap_name_(_entry)* e = cx_hmap_name_(_oper_)(m, cx_hmap_op_del_, &k, cx_hmap_hash_(&k), NULL);
     return e == NULL ? false : true;
 }
 
+cx_hmap_api_ cx_hmap_val* cx_hmap_name_(_emplace)(cx_hmap_name* m, cx_hmap_key const* k, bool* inserted) {
+
+    assert(m);
+    const size_t count = m->count_;
+    cx_hmap_name_(_entry)* e = cx_hmap_name_(_oper_)(m, cx_hmap_op_ins_, (cx_hmap_key*)k, cx_hmap_hash_(k), NULL);
+    const bool ins = m->count_ != count;
+    if (ins) {
+        memset(&e->val, 0, sizeof(e->val));
+    }
+    if (inserted) {
+        *inserted = ins;
+    }
+    return &e->val;
+}
+
+cx_hmap_api_ void cx_hmap_name_(_set_ptr)(cx_hmap_name* m, cx_hmap_key const* k, cx_hmap_val const* v) {
+
+    assert(m);
+    cx_hmap_name_(_entry)* e = cx_hmap_name_(_oper_)(m, cx_hmap_op_set_, (cx_hmap_key*)k, cx_hmap_hash_(k), NULL);
+    memcpy(&e->val, v, sizeof(e->val));
+}
+
+cx_hmap_api_ bool cx_hmap_name_(_upsert)(cx_hmap_name* m, cx_hmap_key k, void (*fn)(cx_hmap_val* val, bool found, void* ctx), void* ctx) {
+
+    assert(m);
+    bool inserted;
+    cx_hmap_val* v = cx_hmap_name_(_emplace)(m, &k, &inserted);
+#ifdef cx_hmap_free_key
+    if (!inserted) {
+        cx_hmap_free_key(&k);
+    }
+#endif
+    fn(v, !inserted, ctx);
+    return !inserted;
+}
+
+#ifdef cx_hmap_cmp_keyn
+
+    // Returns the entry with the key equal to the specified key view or NULL if not found
+    static cx_hmap_name_(_entry)* cx_hmap_name_(_findn_)(const cx_hmap_name* m, const void* key, size_t len, size_t hash) {
+
+        if (m->buckets_ == NULL) {
+            return NULL;
+        }
+        size_t idx = cx_hmap_fib_index_(hash, m->nbuckets_);
+        const size_t start = idx;
+#ifdef cx_hmap_robin_hood
+        size_t dist = 0;
+        while (m->status_[idx] != cx_hmap_empty_ && m->status_[idx] - 1u >= dist) {
+            cx_hmap_name_(_entry)* e = m->buckets_ + idx;
+            if (m->status_[idx] - 1u == dist && cx_hmap_hash_eq_(e, hash) && cx_hmap_cmp_keyn(&e->key, key, len) == 0) {
+                return e;
+            }
+            idx = (idx + 1) & (m->nbuckets_ - 1);
+            dist++;
+        }
+#else
+        while (m->status_[idx] != cx_hmap_empty_) {
+            cx_hmap_name_(_entry)* e = m->buckets_ + idx;
+            if (m->status_[idx] == cx_hmap_full_ && cx_hmap_hash_eq_(e, hash) && cx_hmap_cmp_keyn(&e->key, key, len) == 0) {
+                return e;
+            }
+            idx = (idx + 1) & (m->nbuckets_ - 1);
+            if (idx == start) {
+                break;
+            }
+        }
+#endif
+        return NULL;
+    }
+
+cx_hmap_api_ cx_hmap_val* cx_hmap_name_(_getn)(const cx_hmap_name* m, const void* key, size_t len, size_t hash) {
+
+    assert(m);
+    cx_hmap_name_(_entry)* e = cx_hmap_name_(_findn_)(m, key, len, hash);
+    return e == NULL ? NULL : &e->val;
+}
+
+cx_hmap_api_ bool cx_hmap_name_(_deln)(cx_hmap_name* m, const void* key, size_t len, size_t hash) {
+
+    assert(m);
+    cx_hmap_name_(_entry)* e = cx_hmap_name_(_findn_)(m, key, len, hash);
+    if (e == NULL) {
+        return false;
+    }
+    // Deletes using a copy of the stored key which is equal to the key view
+    cx_hmap_key k = e->key;
+    cx_hmap_name_(_oper_)(m, cx_hmap_op_del_, &k, hash, NULL);
+    return true;
+}
+
+#endif
+
+cx_hmap_api_ size_t cx_hmap_name_(_get_batch)(const cx_hmap_name* m, cx_hmap_key const* keys, size_t n, cx_hmap_val** vals) {
+
+    assert(m);
+    size_t found = 0;
+    size_t hashes[cx_hmap_batch_];
+    for (size_t b = 0; b < n; b += cx_hmap_batch_) {
+        const size_t count = n - b < cx_hmap_batch_ ? n - b : cx_hmap_batch_;
+        cx_hmap_key* pk = (cx_hmap_key*)keys + b;
+        for (size_t i = 0; i < count; i++) {
+            hashes[i] = cx_hmap_hash_(&pk[i]);
+        }
+        if (m->buckets_ != NULL) {
+            for (size_t i = 0; i < count; i++) {
+                const size_t idx = cx_hmap_fib_index_(hashes[i], m->nbuckets_);
+                __builtin_prefetch(m->status_ + idx, 0);
+                __builtin_prefetch(m->buckets_ + idx, 0);
+            }
+        }
+        for (size_t i = 0; i < count; i++) {
+            cx_hmap_name_(_entry)* e = cx_hmap_name_(_oper_)((cx_hmap_name*)m, cx_hmap_op_get_, &pk[i], hashes[i], NULL);
+            vals[b + i] = e == NULL ? NULL : &e->val;
+            found += e != NULL;
+        }
+    }
+    return found;
+}
+
+cx_hmap_api_ void cx_hmap_name_(_set_batch)(cx_hmap_name* m, cx_hmap_key const* keys, cx_hmap_val const* vals, size_t n) {
+
+    assert(m);
+    size_t hashes[cx_hmap_batch_];
+    for (size_t b = 0; b < n; b += cx_hmap_batch_) {
+        const size_t count = n - b < cx_hmap_batch_ ? n - b : cx_hmap_batch_;
+        cx_hmap_key* pk = (cx_hmap_key*)keys + b;
+        for (size_t i = 0; i < count; i++) {
+            hashes[i] = cx_hmap_hash_(&pk[i]);
+        }
+        if (m->buckets_ != NULL) {
+            for (size_t i = 0; i < count; i++) {
+                const size_t idx = cx_hmap_fib_index_(hashes[i], m->nbuckets_);
+                __builtin_prefetch(m->status_ + idx, 1);
+                __builtin_prefetch(m->buckets_ + idx, 1);
+            }
+        }
+        for (size_t i = 0; i < count; i++) {
+            cx_hmap_name_(_entry)* e = cx_hmap_name_(_oper_)(m, cx_hmap_op_set_, &pk[i], hashes[i], NULL);
+            e->val = vals[b + i];
+        }
+    }
+}
+
 cx_hmap_api_ void cx_hmap_name_(_clear)(cx_hmap_name* m) {
 
     assert(m);
@@ -517,26 +1026,411 @@ cx_hmap_api_ void cx_hmap_name_(_clear)(cx_hmap_name* m) {
     m->deleted_ = 0;
 }
 
+#ifdef cx_hmap_robin_hood
+
+cx_hmap_api_ void cx_hmap_name_(_retain)(cx_hmap_name* m, bool (*pred)(cx_hmap_name_(_entry)* e, void* ctx), void* ctx) {
+
+    assert(m);
+    assert(pred);
+    if (m->count_ == 0) {
+        return;
+    }
+    // Starts after an empty bucket, so the entries shifted back by a removal
+    // are always from buckets not yet visited.
+    size_t start = 0;
+    while (m->status_[start] != cx_hmap_empty_) {
+        start++;
+    }
+    size_t n = 0;
+    while (n < m->nbuckets_) {
+        const size_t idx = (start + n) & (m->nbuckets_ - 1);
+        if (m->status_[idx] != cx_hmap_empty_) {
+            cx_hmap_name_(_entry)* e = m->buckets_ + idx;
+            if (!pred(e, ctx)) {
+                cx_hmap_free_key_(&e->key);
+                cx_hmap_free_val_(&e->val);
+                cx_hmap_name_(_rh_remove_)(m, idx);
+                m->count_--;
+                continue;
+            }
+        }
+        n++;
+    }
+}
+
+#else
+
+cx_hmap_api_ void cx_hmap_name_(_retain)(cx_hmap_name* m, bool (*pred)(cx_hmap_name_(_entry)* e, void* ctx), void* ctx) {
+
+    assert(m);
+    assert(pred);
+    if (m->count_ == 0 && m->deleted_ == 0) {
+        return;
+    }
+    // Removes the entries not retained and clears the deleted buckets.
+    // A retained entry is kept in its bucket if all the buckets from its initial
+    // bucket are also kept, otherwise it is marked as pending to be placed again.
+    // Entries with probe sequences wrapping to the start of the array are always placed again.
+    size_t kept_from = 0;   // All visited buckets from this one are kept
+    size_t pending = 0;
+    size_t i = 0;
+    while (i < m->nbuckets_) {
+        // Clears 8 status bytes at a time without full buckets
+        if (i + 8 <= m->nbuckets_) {
+            uint64_t w;
+            memcpy(&w, m->status_ + i, sizeof(w));
+            if ((w & 0x0101010101010101ull) == 0) {
+                memset(m->status_ + i, cx_hmap_empty_, 8);
+                i += 8;
+                kept_from = i;
+                continue;
+            }
+        }
+        if (m->status_[i] == cx_hmap_full_) {
+            cx_hmap_name_(_entry)* e = m->buckets_ + i;
+            if (pred(e, ctx)) {
+                const size_t home = cx_hmap_fib_index_(cx_hmap_entry_hash_(e), m->nbuckets_);
+                if (home > i || home < kept_from) {
+                    m->status_[i] = cx_hmap_pending_;
+                    kept_from = i + 1;
+                    pending++;
+                }
+                i++;
+                continue;
+            }
+            cx_hmap_free_key_(&e->key);
+            cx_hmap_free_val_(&e->val);
+            m->count_--;
+        }
+        m->status_[i] = cx_hmap_empty_;
+        i++;
+        kept_from = i;
+    }
+    m->deleted_ = 0;
+
+    // Places each pending entry at the first bucket from its initial bucket which
+    // is not full. This bucket is never after the entry own bucket and the buckets
+    // before it in the probe sequence are full and stay full.
+    // If the bucket has other pending entry, the entries are swapped and
+    // the entry moved into this bucket is placed next.
+    for (i = 0; pending > 0; i++) {
+        while (m->status_[i] == cx_hmap_pending_) {
+            pending--;
+            cx_hmap_name_(_entry)* e = m->buckets_ + i;
+            size_t idx = cx_hmap_fib_index_(cx_hmap_entry_hash_(e), m->nbuckets_);
+            while (m->status_[idx] == cx_hmap_full_) {
+                idx = (idx + 1) & (m->nbuckets_ - 1);
+            }
+            if (idx == i) {
+                m->status_[i] = cx_hmap_full_;
+                break;
+            }
+            if (m->status_[idx] == cx_hmap_empty_) {
+                m->buckets_[idx] = *e;
+                m->status_[idx] = cx_hmap_full_;
+                m->status_[i] = cx_hmap_empty_;
+                break;
+            }
+            const cx_hmap_name_(_entry) tmp = m->buckets_[idx];
+            m->buckets_[idx] = *e;
+            m->status_[idx] = cx_hmap_full_;
+            *e = tmp;
+        }
+    }
+}
+
+#endif
+
+cx_hmap_api_ void cx_hmap_name_(_shrink_to_fit)(cx_hmap_name* m) {
+
+    assert(m);
+    if (m->status_ == NULL) {
+        return;
+    }
+    if (m->count_ == 0) {
+        cx_hmap_free_(m, m->buckets_, m->nbuckets_ * sizeof(*m->buckets_));
+        cx_hmap_free_(m, m->status_, m->nbuckets_ * sizeof(*m->status_));
+        m->buckets_ = NULL;
+        m->status_ = NULL;
+        m->nbuckets_ = cx_hmap_next_pow2(cx_hmap_def_nbuckets);
+        m->deleted_ = 0;
+        return;
+    }
+    // Smallest number of buckets which would not be resized by the next insert
+    size_t nbuckets = cx_hmap_next_pow2(m->count_);
+    while (m->count_ + 1 >= (float)nbuckets * cx_hmap_resize_load) {
+        nbuckets *= 2;
+    }
+    if (nbuckets < m->nbuckets_ || m->deleted_ > 0) {
+        cx_hmap_name_(_rehash_)(m, nbuckets);
+    }
+}
+
 cx_hmap_api_ size_t cx_hmap_name_(_count)(const cx_hmap_name* m) {
 
     assert(m);
     return m->count_;
 }
 
+    // Returns mask with the high bit set of each byte of the word
+    // with 8 status bytes which is of a full bucket.
+    static inline uint64_t cx_hmap_name_(_full_mask_)(uint64_t w) {
+    #ifdef cx_hmap_robin_hood
+        // Any non zero status
+        return (((w & 0x7F7F7F7F7F7F7F7Full) + 0x7F7F7F7F7F7F7F7Full) | w) & 0x8080808080808080ull;
+    #else
+        // Only the status of full buckets (1) has the low bit set
+        return (w & 0x0101010101010101ull) << 7;
+    #endif
+    }
+
 cx_hmap_api_ cx_hmap_name_(_entry)* cx_hmap_name_(_next)(cx_hmap_name* m, cx_hmap_name_(_iter)* iter) {
 
     assert(m);
     assert(iter);
-    for (size_t i = iter->bucket_; i < m->nbuckets_; i++) {
-        if (m->status_[i] == cx_hmap_full_) {
+    if (m->status_ == NULL) {
+        return NULL;
+    }
+    const size_t end = iter->end_ == 0 ? m->nbuckets_ : iter->end_;
+    size_t i = iter->bucket_;
+    // Checks 8 status bytes at a time
+    while (i + 8 <= end) {
+        uint64_t w;
+        memcpy(&w, m->status_ + i, sizeof(w));
+        const uint64_t mask = cx_hmap_name_(_full_mask_)(w);
+        if (mask) {
+        #if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+            i += __builtin_ctzll(mask) / 8;
+        #else
+            i += __builtin_clzll(mask) / 8;
+        #endif
+            iter->bucket_ = i + 1;
+            return &m->buckets_[i];
+        }
+        i += 8;
+    }
+    for (; i < end; i++) {
+        if (cx_hmap_is_full_(m->status_[i])) {
             iter->bucket_ = i + 1;
             return &m->buckets_[i];
         }
     }
-    iter->bucket_ = m->nbuckets_;
+    iter->bucket_ = end;
     return NULL;
 }
 
+cx_hmap_api_ cx_hmap_name_(_iter) cx_hmap_name_(_iter_range)(const cx_hmap_name* m, size_t begin, size_t end) {
+
+    assert(m);
+    if (end > m->nbuckets_) {
+        end = m->nbuckets_;
+    }
+    if (begin >= end) {
+        return (cx_hmap_name_(_iter)){.bucket_ = m->nbuckets_, .end_ = m->nbuckets_};
+    }
+    return (cx_hmap_name_(_iter)){.bucket_ = begin, .end_ = end};
+}
+
+cx_hmap_api_ size_t cx_hmap_name_(_iter_split)(const cx_hmap_name* m, size_t n, cx_hmap_name_(_iter)* iters) {
+
+    assert(m);
+    assert(iters);
+    if (m->status_ == NULL || n == 0) {
+        return 0;
+    }
+    // Ranges are multiple of 64 buckets, so threads don't share cache lines of the status array
+    const size_t nunits = (m->nbuckets_ + 63) / 64;
+    if (n > nunits) {
+        n = nunits;
+    }
+    for (size_t i = 0; i < n; i++) {
+        iters[i] = cx_hmap_name_(_iter_range)(m, (nunits * i / n) * 64, (nunits * (i + 1) / n) * 64);
+    }
+    return n;
+}
+
+#ifdef cx_hmap_freeze
+
+#ifndef CX_HMAP2_FROZEN_HDR_
+#define CX_HMAP2_FROZEN_HDR_
+
+    // Header of frozen map file
+    typedef struct CxHmap2FrozenHdr {
+        char        magic[8];       // "CXHMAP2"
+        uint32_t    version;        // Layout version
+        uint32_t    flags;          // Map options which change the layout
+        uint64_t    key_size;       // Size of the key type
+        uint64_t    val_size;       // Size of the value type
+        uint64_t    entry_size;     // Size of the entry type
+        uint64_t    nbuckets;       // Number of buckets
+        uint64_t    count;          // Number of entries
+        uint64_t    deleted;        // Number of deleted buckets
+    } CxHmap2FrozenHdr;
+
+    #define CX_HMAP2_FROZEN_MAGIC       "CXHMAP2"
+    #define CX_HMAP2_FROZEN_VERSION     (1)
+    #define CX_HMAP2_FROZEN_ALIGN       (64)
+    #define CX_HMAP2_FROZEN_ROBIN_HOOD  (1u << 0)
+    #define CX_HMAP2_FROZEN_CACHE_HASH  (1u << 1)
+
+    // Offsets of the status and bucket arrays in the file
+    #define cx_hmap2_frozen_align_(n)           (((n) + CX_HMAP2_FROZEN_ALIGN - 1) & ~(size_t)(CX_HMAP2_FROZEN_ALIGN - 1))
+    #define cx_hmap2_frozen_status_off_         cx_hmap2_frozen_align_(sizeof(CxHmap2FrozenHdr))
+    #define cx_hmap2_frozen_buckets_off_(nb)    cx_hmap2_frozen_align_(cx_hmap2_frozen_status_off_ + (nb))
+
+#endif
+
+#ifdef cx_hmap_robin_hood
+    #define cx_hmap_frozen_flags_rh_    CX_HMAP2_FROZEN_ROBIN_HOOD
+#else
+    #define cx_hmap_frozen_flags_rh_    (0)
+#endif
+#ifdef cx_hmap_cache_hash
+    #define cx_hmap_frozen_flags_       (cx_hmap_frozen_flags_rh_ | CX_HMAP2_FROZEN_CACHE_HASH)
+#else
+    #define cx_hmap_frozen_flags_       (cx_hmap_frozen_flags_rh_)
+#endif
+
+// Number of entries copied to the stack buffer for each write
+#define cx_hmap_frozen_chunk_\
+    (sizeof(cx_hmap_name_(_entry)) >= 4096 ? 1 : 4096/sizeof(cx_hmap_name_(_entry)))
+
+cx_hmap_api_ CxError cx_hmap_name_(_freeze)(const cx_hmap_name* m, const CxWriter* out) {
+
+    assert(m);
+    if (m->nbuckets_ == 0) {
+        return CXERR("Map not initialized");
+    }
+    CxHmap2FrozenHdr hdr = {
+        .magic = CX_HMAP2_FROZEN_MAGIC,
+        .version = CX_HMAP2_FROZEN_VERSION,
+        .flags = cx_hmap_frozen_flags_,
+        .key_size = sizeof(cx_hmap_key),
+        .val_size = sizeof(cx_hmap_val),
+        .entry_size = sizeof(cx_hmap_name_(_entry)),
+        .nbuckets = m->nbuckets_,
+        .count = m->buckets_ == NULL ? 0 : m->count_,
+        .deleted = m->buckets_ == NULL ? 0 : m->deleted_,
+    };
+    if (cx_writer_write(out, &hdr, sizeof(hdr)) < (int)sizeof(hdr)) {
+        return CXERR("Error writing map header");
+    }
+
+    // Writes the status array and the padding before and after it.
+    // Uses zeros for the status of a map without allocated buckets.
+    static const uint8_t zeros[CX_HMAP2_FROZEN_ALIGN];
+    size_t len = cx_hmap2_frozen_status_off_ - sizeof(hdr);
+    if (len && cx_writer_write(out, zeros, len) < (int)len) {
+        return CXERR("Error writing map status");
+    }
+    for (size_t i = 0; i < m->nbuckets_; i += len) {
+        len = m->status_ == NULL ? sizeof(zeros) : (1u << 20);
+        len = m->nbuckets_ - i < len ? m->nbuckets_ - i : len;
+        const uint8_t* data = m->status_ == NULL ? zeros : m->status_ + i;
+        if (cx_writer_write(out, data, len) < (int)len) {
+            return CXERR("Error writing map status");
+        }
+    }
+    len = cx_hmap2_frozen_buckets_off_(m->nbuckets_) - (cx_hmap2_frozen_status_off_ + m->nbuckets_);
+    if (len && cx_writer_write(out, zeros, len) < (int)len) {
+        return CXERR("Error writing map status");
+    }
+
+    // Writes the bucket array, copying only the fields of the full buckets,
+    // so the file does not depend on uninitialized memory.
+    cx_hmap_name_(_entry) buf[cx_hmap_frozen_chunk_];
+    for (size_t i = 0; i < m->nbuckets_; i += cx_hmap_frozen_chunk_) {
+        const size_t count = m->nbuckets_ - i < cx_hmap_frozen_chunk_ ? m->nbuckets_ - i : cx_hmap_frozen_chunk_;
+        memset(buf, 0, count * sizeof(buf[0]));
+        for (size_t j = 0; m->buckets_ != NULL && j < count; j++) {
+            if (!cx_hmap_is_full_(m->status_[i + j])) {
+                continue;
+            }
+            const cx_hmap_name_(_entry)* e = m->buckets_ + i + j;
+            cx_hmap_set_hash_(&buf[j], cx_hmap_entry_hash_(e));
+            memcpy(&buf[j].key, &e->key, sizeof(e->key));
+            memcpy(&buf[j].val, &e->val, sizeof(e->val));
+        }
+        len = count * sizeof(buf[0]);
+        if (cx_writer_write(out, buf, len) < (int)len) {
+            return CXERR("Error writing map buckets");
+        }
+    }
+    return CXOK();
+}
+
+cx_hmap_api_ CxError cx_hmap_name_(_mapped_open)(const char* path, cx_hmap_name* m) {
+
+    assert(m);
+    const int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return CXERR("Error opening file");
+    }
+    struct stat st;
+    if (fstat(fd, &st) < 0) {
+        close(fd);
+        return CXERR("Error getting file size");
+    }
+    if ((size_t)st.st_size < sizeof(CxHmap2FrozenHdr)) {
+        close(fd);
+        return CXERR("Invalid map file");
+    }
+    uint8_t* addr = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (addr == MAP_FAILED) {
+        return CXERR("Error mapping file");
+    }
+
+    // Checks if the file layout is the same as of this map type
+    const CxHmap2FrozenHdr* hdr = (const CxHmap2FrozenHdr*)addr;
+    CxError err = CXOK();
+    if (memcmp(hdr->magic, CX_HMAP2_FROZEN_MAGIC, sizeof(hdr->magic)) != 0 ||
+        hdr->version != CX_HMAP2_FROZEN_VERSION) {
+        err = CXERR("Invalid map file");
+    } else if (hdr->flags != cx_hmap_frozen_flags_ ||
+        hdr->key_size != sizeof(cx_hmap_key) ||
+        hdr->val_size != sizeof(cx_hmap_val) ||
+        hdr->entry_size != sizeof(cx_hmap_name_(_entry))) {
+        err = CXERR("Map file type is not compatible");
+    } else if (hdr->nbuckets < 2 || (hdr->nbuckets & (hdr->nbuckets - 1)) != 0 ||
+        hdr->nbuckets > (SIZE_MAX - cx_hmap2_frozen_buckets_off_(0)) / (sizeof(cx_hmap_name_(_entry)) + 1) ||
+        (size_t)st.st_size != cx_hmap2_frozen_buckets_off_(hdr->nbuckets) + hdr->nbuckets * sizeof(cx_hmap_name_(_entry))) {
+        err = CXERR("Invalid map file size");
+    }
+    if (err.msg) {
+        munmap(addr, st.st_size);
+        return err;
+    }
+
+    *m = (cx_hmap_name){
+#ifdef cx_hmap_instance_allocator
+        .alloc_ = cx_def_allocator(),
+#endif
+        .nbuckets_ = hdr->nbuckets,
+        .count_ = hdr->count,
+        .deleted_ = hdr->deleted,
+        .status_ = addr + cx_hmap2_frozen_status_off_,
+        .buckets_ = (cx_hmap_name_(_entry)*)(addr + cx_hmap2_frozen_buckets_off_(hdr->nbuckets)),
+    };
+    return CXOK();
+}
+
+cx_hmap_api_ void cx_hmap_name_(_mapped_close)(cx_hmap_name* m) {
+
+    assert(m);
+    if (m->status_ == NULL) {
+        return;
+    }
+    uint8_t* addr = m->status_ - cx_hmap2_frozen_status_off_;
+    munmap(addr, cx_hmap2_frozen_buckets_off_(m->nbuckets_) + m->nbuckets_ * sizeof(cx_hmap_name_(_entry)));
+    m->status_ = NULL;
+    m->buckets_ = NULL;
+    m->count_ = 0;
+    m->deleted_ = 0;
+}
+
+#endif // cx_hmap_freeze
+
 #ifdef cx_hmap_stats
 
     typedef struct cx_hmap_name_(_stats) {
@@ -562,10 +1456,10 @@ cx_hmap_api_ cx_hmap_name_(_entry)* cx_hmap_name_(_next)(cx_hmap_name* m, cx_hma
                 s.empty++;
                 continue;
             }
-            if (m->status_[i] == cx_hmap_full_) {
+            if (cx_hmap_is_full_(m->status_[i])) {
                 cx_hmap_name_(_entry)* e = m->buckets_ + i;
-                size_t nprobes = 89;
-                cx_hmap_name_(_oper_)((cx_hmap_name*)m, cx_hmap_op_get_, &e->key, &nprobes);
+                size_t nprobes = 0;
+                cx_hmap_name_(_oper_)((cx_hmap_name*)m, cx_hmap_op_get_, &e->key, cx_hmap_hash_(&e->key), &nprobes);
                 s.probes += nprobes;
                 if (nprobes > s.max_probe) {
                     s.max_probe = nprobes;
@@ -620,6 +1514,7 @@ cx_hmap_api_ cx_hmap_name_(_entry)* cx_hmap_name_(_next)(cx_hmap_name* m, cx_hma
 #undef cx_hmap_def_nbuckets
 #undef cx_hmap_resize_load
 #undef cx_hmap_cmp_key
+#undef cx_hmap_cmp_keyn
 #undef cx_hmap_hash_key
 #undef cx_hmap_free_key
 #undef cx_hmap_free_val
@@ -628,6 +1523,9 @@ cx_hmap_api_ cx_hmap_name_(_entry)* cx_hmap_name_(_next)(cx_hmap_name* m, cx_hma
 #undef cx_hmap_static
 #undef cx_hmap_inline
 #undef cx_hmap_implement
+#undef cx_hmap_cache_hash
+#undef cx_hmap_robin_hood
+#undef cx_hmap_freeze
 
 // Undefine internal macros
 #undef cx_hmap_concat2_
@@ -639,13 +1537,26 @@ cx_hmap_api_ cx_hmap_name_(_entry)* cx_hmap_name_(_next)(cx_hmap_name* m, cx_hma
 #undef cx_hmap_alloc_
 #undef cx_hmap_free_
 #undef cx_hmap_free_key_
+#undef cx_hmap_hash_
+#undef cx_hmap_batch_
 #undef cx_hmap_free_val_
 #undef cx_hmap_empty_
 #undef cx_hmap_full_
+#undef cx_hmap_is_full_
+#undef cx_hmap_max_dist_
 #undef cx_hmap_del_
+#undef cx_hmap_pending_
 #undef cx_hmap_op_set_
 #undef cx_hmap_op_get_
 #undef cx_hmap_op_del_
+#undef cx_hmap_op_ins_
+#undef cx_hmap_frozen_flags_rh_
+#undef cx_hmap_frozen_flags_
+#undef cx_hmap_frozen_chunk_
+#undef cx_hmap_hash_field_
+#undef cx_hmap_entry_hash_
+#undef cx_hmap_hash_eq_
+#undef cx_hmap_set_hash_
 
 
 
@@ -0,0 +1,1065 @@
+/*
+Hashmap Implementation
+----------------------
+- Uses open addressing with group probing ("Swiss table" layout).
+- Each bucket has an associated control byte which indicates if the bucket is
+  empty, deleted or, if full, contains 7 bits of the key hash.
+- Control bytes are probed in groups of 16 buckets, which are matched
+  using SSE2 instructions if available or a portable scalar fallback.
+  Most lookups resolve with a single group compare and at most one key comparison.
+- Uses global type allocator initialized with default allocator.
+- Can be configured to use custom allocator per instance.
+
+Example
+-------
+
+#include <stdio.h>
+#include <assert.h>
+#define cx_hmap_name map
+#define cx_hmap_key int
+#define cx_hmap_val double
+#define cx_hmap_implement
+#include "cx_hmap3.h"
+
+int main() {
+
+    // Initialize map with default number of buckets
+    map m1 = map_init(0);
+
+    // Set keys and values
+    size_t size = 100;
+    for (size_t i = 0; i < size; i++) {
+        map_set(&m1, i, i * 2.0);
+    }
+    assert(map_count(&m1) == size);
+
+    // Get keys and values
+    for (size_t i = 0; i < size; i++) {
+        assert(*map_get(&m1, i) == i * 2.0);
+    }
+
+    // Iterate over keys and values
+    map_iter iter = {0};
+    map_entry* e = NULL;
+    while ((e = map_next(&m1, &iter)) != NULL) {
+        printf("key:%d val:%f\n", e->key, e->val);
+    }
+
+    // Delete even keys
+    for (size_t i = 0; i < size; i++) {
+        if (i % 2 == 0) {
+            map_del(&m1, i);
+        }
+    }
+    assert(map_count(&m1) == size/2);
+    map_free(&m1);
+    return 0;
+}
+
+
+Configuration
+-------------
+
+Define the name of the map type (mandatory):
+    #define cx_hmap_name <name>
+
+Define the type of the map key (mandatory):
+    #define cx_hmap_key <type>
+
+Define the type of the map value (mandatory):
+    #define cx_hmap_val <type>
+
+Define the default initial number of buckets,
+when map is initialized with nbuckets = 0.
+The number of buckets is always rounded to a power of 2 multiple of the group size (16).
+    #define cx_hmap_def_nbuckets <n>
+
+Define the maximum load ((count + deleted)/number of buckets)
+which, if exceeded, will imply in the rehash of the hash map.
+Must be less than 1.0
+    #define cx_hmap_resize_load <lf>
+
+Define the key comparison function:
+int (*cmp)(const void* k1, const void* k2, size_t size);
+The default comparison function is a single integer comparison
+for keys with size of 1, 2, 4 or 8 bytes and memcmp() otherwise.
+    #define cx_hmap_cmp_key(pk1,pk2,s) <cmp_func>
+
+Define the key hash function:
+size_t (*hash)(const void* key, size_t size);
+The default hash function is a multiplicative mixer for keys with size of
+1, 2, 4 or 8 bytes and cx_hmap_hash_wy64() otherwise, a 64 bit hash which processes
+16 bytes per iteration. cx_hmap_hash_fnv1a32() is also available.
+    #define cx_hmap_hash_key(pk,s) <hash_func>
+
+Define function to compare the key pointed by 'pk' with a borrowed key view
+with the specified pointer and length, returning 0 if they are equal.
+Enables the _getn() and _deln() functions.
+    #define cx_hmap_cmp_keyn(pk,key,len) <cmp_func>
+    example for map<char*, T>:
+        #define cx_hmap_cmp_keyn(pk,key,len)\
+            (strncmp(*(char**)(pk),key,len) || (*(char**)(pk))[len])
+
+Define function to free the key of deleted entries:
+void (*free)(void* key);
+By default no function is defined.
+    #define cx_hmap_free_key(pk) <free_func>
+
+Define function to free the value of deleted entries:
+void (*free)(void* val);
+By default no function is defined.
+    #define cx_hmap_free_val <free_func>
+
+Define optional custom allocator pointer or function call which return pointer to allocator.
+Uses default allocator if not defined.
+This allocator will be used for all instances of this type.
+    #define cx_hmap_allocator <allocator>
+
+Sets if map uses custom allocator per instance.
+If set, it is necessary to initialize each array with the desired allocator.
+    #define cx_hmap_instance_allocator
+
+Sets if all map functions are prefixed with 'static'
+    #define cx_hmap_static
+
+Sets if all map functions are prefixed with 'inline'
+    #define cx_hmap_inline
+
+Sets to implement functions in this translation unit:
+    #define cx_hmap_implement
+
+Enable implementation of stats function.
+Used mainly for development and benchmarking
+    #define cx_hmap_stats
+
+Disables the use of SSE2 instructions for group matching,
+even if they are available.
+Must be defined before the first inclusion of this file in the translation unit.
+    #define cx_hmap_no_simd
+
+
+API
+---
+
+Assuming:
+#define cx_hmap_name hmap       // Map type name
+#define cx_hmap_key  ktype      // Type of key
+#define cx_hmap_val  vtype      // Type of value
+
+Initialize hashmap defined with custom allocator
+If the specified number of bucket is 0, the default will be used.
+    hmap hmap_init(const CxAllocator* alloc, size_t nbuckets);
+
+Initialize hashmap NOT defined with custom allocator
+If the specified number of bucket is 0, the default will be used.
+    hmap hmap_init(size_t nbuckets);
+
+Free hashmap allocated memory
+    void hmap_free(hmap* m);
+
+Inserts or updates specified key and value
+    void hmap_set(hmap* m, ktype k, vtype v);
+
+Returns pointer to value associated with specified key.
+Returns NULL if not found.
+    vtype* hmap_get(const hmap* m, ktype k);
+
+Deletes entry with the specified key.
+Returns true if found or false otherwise.
+    bool hmap_del(hmap* m, ktype k);
+
+Returns pointer to the value associated with the key pointed by 'k',
+inserting a new entry with the value zeroed if the key is not found,
+using a single probe. Sets 'inserted' (if not NULL) to indicate if
+the entry was inserted. The key is copied to the map only if inserted,
+otherwise it is still owned by the caller.
+    vtype* hmap_emplace(hmap* m, ktype const* k, bool* inserted);
+
+Inserts or updates the key and value pointed by 'k' and 'v',
+copying them directly to the entry.
+    void hmap_set_ptr(hmap* m, ktype const* k, vtype const* v);
+
+Calls 'fn' with pointer to the value associated with the specified key,
+inserting a new entry with the value zeroed if the key is not found,
+using a single probe. The key is moved to the map as in 'set'.
+Returns true if the key was found or false if it was inserted.
+    bool hmap_upsert(hmap* m, ktype k, void (*fn)(vtype* val, bool found, void* ctx), void* ctx);
+
+Returns pointer to value associated with the key equal to the specified key view
+with 'len' bytes and precomputed 'hash', which must be the same hash calculated by
+the key hash function for the equal key (only if cx_hmap_cmp_keyn is defined).
+Returns NULL if not found.
+    vtype* hmap_getn(const hmap* m, const void* key, size_t len, size_t hash);
+
+Deletes entry with the key equal to the specified key view with 'len' bytes and
+precomputed 'hash' (only if cx_hmap_cmp_keyn is defined).
+Returns true if found or false otherwise.
+    bool hmap_deln(hmap* m, const void* key, size_t len, size_t hash);
+
+Gets the values of 'n' keys, setting each element of 'vals' to the pointer
+to the value associated with the corresponding key or NULL if not found.
+The keys are hashed and their buckets prefetched in batches, overlapping the
+memory latency of several lookups. Returns the number of keys found.
+    size_t hmap_get_batch(const hmap* m, const ktype* keys, size_t n, vtype** vals);
+
+Inserts or updates 'n' keys and values, hashing the keys and prefetching
+their buckets in batches.
+    void hmap_set_batch(hmap* m, const ktype* keys, const vtype* vals, size_t n);
+
+Returns the number of entries in the hashmap
+    size_t hmap_count(const hmap* m);
+
+Clears the map without deallocating memory.
+The current number of buckets is not changed.
+    void hmap_clear(hmap* m);
+
+Removes in a single sweep the entries for which 'pred' returns false,
+calling it once for each entry.
+    void hmap_retain(hmap* m, bool (*pred)(hmap_entry* e, void* ctx), void* ctx);
+
+Rehashes the map to the smallest number of buckets for the current number of
+entries which does not exceed the resize load factor, releasing the memory
+of the map if it is empty.
+    void hmap_shrink_to_fit(hmap* m);
+
+Returns the next hashmap entry from the specified iterator.
+Returns NULL after the last entry.
+    hmap_entry* hmap_next(const hmap* m, hmap_iter* iter);
+
+Returns iterator over the entries of the buckets from 'begin' up to but not including 'end'.
+The map must not be modified while the iterator is in use.
+    hmap_iter hmap_iter_range(const hmap* m, size_t begin, size_t end);
+
+Splits the buckets of the map in up to 'n' disjoint ranges with about the same number
+of buckets, and so of entries, setting the first elements of 'iters' with their iterators.
+Returns the number of ranges, which is less than 'n' for small maps.
+The ranges of a map which is not modified can be iterated concurrently by different threads.
+    size_t hmap_iter_split(const hmap* m, size_t n, hmap_iter* iters);
+
+Returns statistics for the specified map (if enabled)
+    hmap_stats hmap_get_stats(const cx_hmap_name* m);
+
+*/
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <stdio.h>
+#include "cx_alloc.h"
+#include "cx_hmap_util.h"
+
+#ifndef cx_hmap_name
+    #error "cx_hmap_name not defined"
+#endif
+#ifndef cx_hmap_key
+    #error "cx_hmap_key not defined"
+#endif
+#ifndef cx_hmap_val
+    #error "cx_hmap_val not defined"
+#endif
+
+#ifndef cx_hmap_def_nbuckets
+    #define cx_hmap_def_nbuckets (16)
+#endif
+
+#ifndef cx_hmap_resize_load
+    #define cx_hmap_resize_load (0.875)
+#endif
+
+// Default key comparison function:
+// single integer compare for keys with 1, 2, 4 or 8 bytes, memcmp() otherwise.
+#ifndef cx_hmap_cmp_key
+    #define cx_hmap_cmp_key(pk1,pk2,s)\
+        (cx_hmap_int_key_(s) ? cx_hmap_cmp_int_(pk1,pk2,s) : memcmp(pk1,pk2,s))
+#endif
+
+// Default key hash function:
+// multiplicative mixer for keys with 1, 2, 4 or 8 bytes, cx_hmap_hash_wy64() otherwise.
+#ifndef cx_hmap_hash_key
+    #define cx_hmap_hash_key(pk,s)\
+        (cx_hmap_int_key_(s) ? cx_hmap_hash_int_(pk,s) : cx_hmap_hash_wy64(pk,s))
+#endif
+
+// Hash of the key pointed by 'pk'
+#define cx_hmap_hash_(pk) cx_hmap_hash_key((char*)(pk), sizeof(cx_hmap_key))
+
+// Number of keys hashed and prefetched at once by the batch functions
+#define cx_hmap_batch_ (16)
+
+// Default free key function
+#ifndef cx_hmap_free_key
+    #define cx_hmap_free_key_(key)
+#else
+    #define cx_hmap_free_key_(key) cx_hmap_free_key(key)
+#endif
+
+// Default free value function
+#ifndef cx_hmap_free_val
+    #define cx_hmap_free_val_(val)
+#else
+    #define cx_hmap_free_val_(val) cx_hmap_free_val(val)
+#endif
+
+// Auxiliary internal macros
+#define cx_hmap_concat2_(a, b) a ## b
+#define cx_hmap_concat1_(a, b) cx_hmap_concat2_(a, b)
+#define cx_hmap_name_(name) cx_hmap_concat1_(cx_hmap_name, name)
+
+// API attributes
+#if defined(cx_hmap_static) && defined(cx_hmap_inline)
+    #define cx_hmap_api_ static inline
+#elif defined(cx_hmap_static)
+    #define cx_hmap_api_ static
+#elif defined(cx_hmap_inline)
+    #define cx_hmap_api_ inline
+#else
+    #define cx_hmap_api_
+#endif
+
+// Default allocator
+#ifndef cx_hmap_allocator
+    #define cx_hmap_allocator cx_def_allocator()
+#endif
+
+// Use custom instance allocator
+#ifdef cx_hmap_instance_allocator
+    #define cx_hmap_alloc_field_\
+        const CxAllocator* alloc_;
+    #define cx_hmap_alloc_global_
+    #define cx_hmap_alloc_(s,n)\
+        cx_alloc_malloc((s)->alloc_, n)
+    #define cx_hmap_free_(s,p,n)\
+        cx_alloc_free((s)->alloc_, p, n)
+// Use global type allocator
+#else
+    #define cx_hmap_alloc_field_
+    #define cx_hmap_alloc_(m,n)\
+        cx_alloc_malloc(cx_hmap_allocator,n)
+    #define cx_hmap_free_(m,p,n)\
+        cx_alloc_free(cx_hmap_allocator,p,n)
+#endif
+
+//
+// Group matching functions shared by all map types
+//
+#ifndef CX_HMAP3_GROUP_
+#define CX_HMAP3_GROUP_
+
+    // Number of control bytes in a group
+    #define CX_HMAP3_GROUP_SIZE     (16)
+
+    // Control byte values. Full buckets contains the 7 lower bits of the hash.
+    #define CX_HMAP3_EMPTY          ((int8_t)-128)
+    #define CX_HMAP3_DELETED        ((int8_t)-2)
+
+    #if defined(__SSE2__) && !defined(cx_hmap_no_simd)
+        #include <emmintrin.h>
+
+        // Returns bit mask of the group control bytes which are equal to 'h'
+        static inline uint32_t cx_hmap3_match_(const int8_t* g, int8_t h) {
+            const __m128i ctrl = _mm_loadu_si128((const __m128i*)g);
+            return (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_set1_epi8(h), ctrl));
+        }
+
+        // Returns bit mask of the group control bytes which are empty or deleted
+        static inline uint32_t cx_hmap3_match_free_(const int8_t* g) {
+            const __m128i ctrl = _mm_loadu_si128((const __m128i*)g);
+            return (uint32_t)_mm_movemask_epi8(ctrl);
+        }
+    #else
+        static inline uint32_t cx_hmap3_match_(const int8_t* g, int8_t h) {
+            uint32_t mask = 0;
+            for (int i = 0; i < CX_HMAP3_GROUP_SIZE; i++) {
+                mask |= (uint32_t)(g[i] == h) << i;
+            }
+            return mask;
+        }
+
+        static inline uint32_t cx_hmap3_match_free_(const int8_t* g) {
+            uint32_t mask = 0;
+            for (int i = 0; i < CX_HMAP3_GROUP_SIZE; i++) {
+                mask |= (uint32_t)(g[i] < 0) << i;
+            }
+            return mask;
+        }
+    #endif
+
+    // Returns bit mask of the group control bytes which are empty
+    static inline uint32_t cx_hmap3_match_empty_(const int8_t* g) {
+        return cx_hmap3_match_(g, CX_HMAP3_EMPTY);
+    }
+
+    // Returns the index of the lowest bit set in a non zero mask
+    static inline size_t cx_hmap3_first_(uint32_t mask) {
+        return (size_t)__builtin_ctz(mask);
+    }
+
+#endif // CX_HMAP3_GROUP_
+
+//
+// Declarations
+//
+
+typedef struct cx_hmap_name_(_entry) {
+    cx_hmap_key key;
+    cx_hmap_val val;
+} cx_hmap_name_(_entry);
+
+typedef struct cx_hmap_name {
+    cx_hmap_alloc_field_
+    size_t      nbuckets_;  // Number of buckets (power of 2 multiple of group size)
+    size_t      count_;     // Number of full buckets
+    size_t      deleted_;   // Number of deleted buckets
+    int8_t*     ctrl_;      // Array of control bytes, one per bucket
+    cx_hmap_name_(_entry)* buckets_;
+} cx_hmap_name;
+
+typedef struct cx_hmap_name_(_iter) {
+    size_t bucket_;
+    size_t end_;        // End bucket of range or 0 for all buckets
+} cx_hmap_name_(_iter);
+
+#ifdef cx_hmap_instance_allocator
+    cx_hmap_api_ cx_hmap_name cx_hmap_name_(_init)(const CxAllocator* alloc, size_t nbuckets);
+#else
+    cx_hmap_api_ cx_hmap_name cx_hmap_name_(_init)(size_t nbuckets);
+#endif
+cx_hmap_api_ void cx_hmap_name_(_free)(cx_hmap_name* m);
+cx_hmap_api_ void cx_hmap_name_(_set)(cx_hmap_name* m, cx_hmap_key k, cx_hmap_val v);
+cx_hmap_api_ cx_hmap_val* cx_hmap_name_(_get)(const cx_hmap_name* m, cx_hmap_key k);
+cx_hmap_api_ bool cx_hmap_name_(_del)(cx_hmap_name* m, cx_hmap_key k);
+cx_hmap_api_ cx_hmap_val* cx_hmap_name_(_emplace)(cx_hmap_name* m, cx_hmap_key const* k, bool* inserted);
+cx_hmap_api_ void cx_hmap_name_(_set_ptr)(cx_hmap_name* m, cx_hmap_key const* k, cx_hmap_val const* v);
+cx_hmap_api_ bool cx_hmap_name_(_upsert)(cx_hmap_name* m, cx_hmap_key k, void (*fn)(cx_hmap_val* val, bool found, void* ctx), void* ctx);
+#ifdef cx_hmap_cmp_keyn
+cx_hmap_api_ cx_hmap_val* cx_hmap_name_(_getn)(const cx_hmap_name* m, const void* key, size_t len, size_t hash);
+cx_hmap_api_ bool cx_hmap_name_(_deln)(cx_hmap_name* m, const void* key, size_t len, size_t hash);
+#endif
+cx_hmap_api_ size_t cx_hmap_name_(_get_batch)(const cx_hmap_name* m, cx_hmap_key const* keys, size_t n, cx_hmap_val** vals);
+cx_hmap_api_ void cx_hmap_name_(_set_batch)(cx_hmap_name* m, cx_hmap_key const* keys, cx_hmap_val const* vals, size_t n);
+cx_hmap_api_ void cx_hmap_name_(_clear)(cx_hmap_name* m);
+cx_hmap_api_ size_t cx_hmap_name_(_count)(const cx_hmap_name* m);
+cx_hmap_api_ void cx_hmap_name_(_retain)(cx_hmap_name* m, bool (*pred)(cx_hmap_name_(_entry)* e, void* ctx), void* ctx);
+cx_hmap_api_ void cx_hmap_name_(_shrink_to_fit)(cx_hmap_name* m);
+cx_hmap_api_ cx_hmap_name_(_entry)* cx_hmap_name_(_next)(const cx_hmap_name* m, cx_hmap_name_(_iter)* iter);
+cx_hmap_api_ cx_hmap_name_(_iter) cx_hmap_name_(_iter_range)(const cx_hmap_name* m, size_t begin, size_t end);
+cx_hmap_api_ size_t cx_hmap_name_(_iter_split)(const cx_hmap_name* m, size_t n, cx_hmap_name_(_iter)* iters);
+
+
+//
+// Implementation
+//
+#ifdef cx_hmap_implement
+    #define cx_hmap_op_set_ (0)
+    #define cx_hmap_op_get_ (1)
+    #define cx_hmap_op_del_ (2)
+    #define cx_hmap_op_ins_ (3)
+
+    // Declaration of functions to hash keys
+    uint32_t cx_hmap_hash_fnv1a32(const void *buf, size_t len);
+    uint64_t cx_hmap_hash_wy64(const void* buf, size_t len);
+    uint64_t cx_hmap_hash_wy64_str(const char* str);
+
+    // Returns the number of buckets for the specified requested number of buckets
+    cx_hmap_api_ size_t cx_hmap_name_(_nbuckets_)(size_t nbuckets) {
+
+        size_t n = CX_HMAP3_GROUP_SIZE;
+        while (n < nbuckets) {
+            n *= 2;
+        }
+        return n;
+    }
+
+    // Allocates the control bytes and buckets arrays for the current number of buckets.
+    cx_hmap_api_ void cx_hmap_name_(_alloc_buckets_)(cx_hmap_name* m) {
+
+        m->buckets_ = cx_hmap_alloc_(m, m->nbuckets_ * sizeof(*m->buckets_));
+        m->ctrl_ = cx_hmap_alloc_(m, m->nbuckets_ * sizeof(*m->ctrl_));
+        memset(m->ctrl_, CX_HMAP3_EMPTY, m->nbuckets_ * sizeof(*m->ctrl_));
+    }
+
+    // Internal function to free the map entries
+    cx_hmap_api_ void cx_hmap_name_(_free_entries_)(cx_hmap_name* m) {
+        if (m == NULL || m->count_ == 0) {
+            return;
+        }
+#   if defined(cx_hmap_free_key) || defined(cx_hmap_free_val)
+        for (size_t i = 0; i < m->nbuckets_; i++) {
+            if (m->ctrl_[i] >= 0) {
+                cx_hmap_free_key_(&m->buckets_[i].key);
+                cx_hmap_free_val_(&m->buckets_[i].val);
+            }
+        }
+#   endif
+    }
+
+    // Returns the index of a free bucket for the specified hash.
+    // The map must have at least one empty bucket.
+    cx_hmap_api_ size_t cx_hmap_name_(_find_free_)(const cx_hmap_name* m, size_t hash) {
+
+        const size_t gmask = m->nbuckets_/CX_HMAP3_GROUP_SIZE - 1;
+        size_t g = (hash >> 7) & gmask;
+        for (size_t i = 1; ; i++) {
+            const int8_t* grp = m->ctrl_ + g * CX_HMAP3_GROUP_SIZE;
+            const uint32_t mask = cx_hmap3_match_free_(grp);
+            if (mask) {
+                return g * CX_HMAP3_GROUP_SIZE + cx_hmap3_first_(mask);
+            }
+            // Triangular probing visits all groups as the number of groups is a power of 2
+            g = (g + i) & gmask;
+        }
+    }
+
+    // Rehash map to the specified number of buckets
+    cx_hmap_api_ void cx_hmap_name_(_rehash_)(cx_hmap_name* m, size_t nbuckets) {
+
+        cx_hmap_name new = *m; // copy eventual allocator
+        new.nbuckets_ = nbuckets;
+        new.count_ = m->count_;
+        new.deleted_ = 0;
+        cx_hmap_name_(_alloc_buckets_)(&new);
+        for (size_t i = 0; i < m->nbuckets_; i++) {
+            if (m->ctrl_[i] < 0) {
+                continue;
+            }
+            cx_hmap_name_(_entry)* e = &m->buckets_[i];
+            const size_t hash = cx_hmap_hash_(&e->key);
+            const size_t idx = cx_hmap_name_(_find_free_)(&new, hash);
+            new.ctrl_[idx] = (int8_t)(hash & 0x7F);
+            new.buckets_[idx] = *e;
+        }
+        // Free original keeping ENTRIES.
+        cx_hmap_free_(m, m->buckets_, m->nbuckets_ * sizeof(*m->buckets_));
+        cx_hmap_free_(m, m->ctrl_, m->nbuckets_ * sizeof(*m->ctrl_));
+        *m = new;
+    }
+
+    // Resize hash map if load exceeded
+    cx_hmap_api_ void cx_hmap_name_(_check_resize_)(cx_hmap_name* m) {
+
+        if (m->count_ + m->deleted_ + 1 < (double)(m->nbuckets_) * cx_hmap_resize_load) {
+            return;
+        }
+        // If most of the load is from deleted buckets, rehash to the same size
+        size_t nbuckets = m->nbuckets_;
+        if (m->count_ + 1 >= (double)(m->nbuckets_) * cx_hmap_resize_load / 2) {
+            nbuckets *= 2;
+        }
+        cx_hmap_name_(_rehash_)(m, nbuckets);
+    }
+
+    // Map operations
+    cx_hmap_api_ cx_hmap_name_(_entry)* cx_hmap_name_(_oper_)(cx_hmap_name* m, int op, cx_hmap_key* key, size_t hash, size_t* nprobes) {
+
+        if (m->buckets_ == NULL) {
+            if (op == cx_hmap_op_get_ || op == cx_hmap_op_del_) {
+                return NULL;
+            }
+            // Allows for static initialization of maps
+            m->nbuckets_ = cx_hmap_name_(_nbuckets_)(m->nbuckets_ == 0 ? cx_hmap_def_nbuckets : m->nbuckets_);
+            cx_hmap_name_(_alloc_buckets_)(m);
+        }
+
+        if (op == cx_hmap_op_set_ || op == cx_hmap_op_ins_) {
+            cx_hmap_name_(_check_resize_)(m);
+        }
+
+        // The 7 lower bits of the hash are stored in the control byte
+        // and the remaining bits selects the first group to probe.
+        const int8_t h2 = (int8_t)(hash & 0x7F);
+        const size_t gmask = m->nbuckets_/CX_HMAP3_GROUP_SIZE - 1;
+        size_t g = (hash >> 7) & gmask;
+
+        if (nprobes) {
+            *nprobes = 0;
+        }
+        for (size_t i = 1; ; i++) {
+            const int8_t* grp = m->ctrl_ + g * CX_HMAP3_GROUP_SIZE;
+            uint32_t mask = cx_hmap3_match_(grp, h2);
+            while (mask) {
+                const size_t idx = g * CX_HMAP3_GROUP_SIZE + cx_hmap3_first_(mask);
+                cx_hmap_name_(_entry)* e = m->buckets_ + idx;
+                if (cx_hmap_cmp_key(&e->key, key, sizeof(cx_hmap_key)) == 0) {
+                    // For "Get" and "Ins" just returns the pointer to this entry.
+                    if (op == cx_hmap_op_get_ || op == cx_hmap_op_ins_) {
+                        return e;
+                    }
+                    // For "Set" optionally free and updates the key and frees the value.
+                    // The value will be updated by the caller
+                    if (op == cx_hmap_op_set_) {
+#ifdef cx_hmap_free_key
+                        cx_hmap_free_key_(&e->key);
+                        memcpy(&e->key, key, sizeof(cx_hmap_key));
+#endif
+                        cx_hmap_free_val_(&e->val);
+                        return e;
+                    }
+                    // For "Del" if this group has an empty bucket, no probe sequence
+                    // went past it and the bucket can be set as empty.
+                    cx_hmap_free_key_(&e->key);
+                    cx_hmap_free_val_(&e->val);
+                    m->count_--;
+                    if (cx_hmap3_match_empty_(grp)) {
+                        m->ctrl_[idx] = CX_HMAP3_EMPTY;
+                    } else {
+                        m->ctrl_[idx] = CX_HMAP3_DELETED;
+                        m->deleted_++;
+                    }
+                    return e;
+                }
+                mask &= mask - 1;
+            }
+            // If group has an empty bucket the key is not in the map
+            if (cx_hmap3_match_empty_(grp)) {
+                break;
+            }
+            g = (g + i) & gmask;
+            if (nprobes) {
+                (*nprobes)++;
+            }
+        }
+
+        // For "Get" or "Del" returns NULL pointer indicating entry not found
+        if (op == cx_hmap_op_get_ || op == cx_hmap_op_del_) {
+            return NULL;
+        }
+
+        // Inserts the key at the first free bucket of the probe sequence
+        const size_t idx = cx_hmap_name_(_find_free_)(m, hash);
+        if (m->ctrl_[idx] == CX_HMAP3_DELETED) {
+            m->deleted_--;
+        }
+        m->ctrl_[idx] = h2;
+        m->count_++;
+        cx_hmap_name_(_entry)* e = m->buckets_ + idx;
+        memcpy(&e->key, key, sizeof(cx_hmap_key));
+        return e;
+    }
+
+#ifdef cx_hmap_instance_allocator
+
+    cx_hmap_api_ cx_hmap_name cx_hmap_name_(_init)(const CxAllocator* alloc, size_t nbuckets) {
+        return (cx_hmap_name){
+            .alloc_ = alloc == NULL ? cx_def_allocator() : alloc,
+            .nbuckets_ = cx_hmap_name_(_nbuckets_)(nbuckets == 0 ? cx_hmap_def_nbuckets : nbuckets),
+        };
+    }
+
+#else
+
+    cx_hmap_api_ cx_hmap_name cx_hmap_name_(_init)(size_t nbuckets) {
+        return (cx_hmap_name){
+            .nbuckets_ = cx_hmap_name_(_nbuckets_)(nbuckets == 0 ? cx_hmap_def_nbuckets : nbuckets),
+        };
+    }
+
+#endif
+
+cx_hmap_api_ void cx_hmap_name_(_free)(cx_hmap_name* m) {
+
+    assert(m);
+    if (m->buckets_ == NULL) {
+        return;
+    }
+    cx_hmap_name_(_free_entries_)(m);
+    cx_hmap_free_(m, m->buckets_, m->nbuckets_ * sizeof(*m->buckets_));
+    cx_hmap_free_(m, m->ctrl_, m->nbuckets_ * sizeof(*m->ctrl_));
+    m->buckets_ = NULL;
+    m->ctrl_ = NULL;
+    m->count_ = 0;
+    m->deleted_ = 0;
+}
+
+cx_hmap_api_ void cx_hmap_name_(_set)(cx_hmap_name* m, cx_hmap_key k, cx_hmap_val v) {
+
+    assert(m);
+    cx_hmap_name_(_entry)* e = cx_hmap_name_(_oper_)(m, cx_hmap_op_set_, &k, cx_hmap_hash_(&k), NULL);
+    e->val = v;
+}
+
+cx_hmap_api_ cx_hmap_val* cx_hmap_name_(_get)(const cx_hmap_name* m, cx_hmap_key k) {
+
+    assert(m);
+    cx_hmap_name_(_entry)* e = cx_hmap_name_(_oper_)((cx_hmap_name*)m, cx_hmap_op_get_, &k, cx_hmap_hash_(&k), NULL);
+    return e == NULL ? NULL : &e->val;
+}
+
+cx_hmap_api_ bool cx_hmap_name_(_del)(cx_hmap_name* m, cx_hmap_key k) {
+
+    assert(m);
+    cx_hmap_name_(_entry)* e = cx_hmap_name_(_oper_)(m, cx_hmap_op_del_, &k, cx_hmap_hash_(&k), NULL);
+    return e == NULL ? false : true;
+}
+
+cx_hmap_api_ cx_hmap_val* cx_hmap_name_(_emplace)(cx_hmap_name* m, cx_hmap_key const* k, bool* inserted) {
+
+    assert(m);
+    const size_t count = m->count_;
+    cx_hmap_name_(_entry)* e = cx_hmap_name_(_oper_)(m, cx_hmap_op_ins_, (cx_hmap_key*)k, cx_hmap_hash_(k), NULL);
+    const bool ins = m->count_ != count;
+    if (ins) {
+        memset(&e->val, 0, sizeof(e->val));
+    }
+    if (inserted) {
+        *inserted = ins;
+    }
+    return &e->val;
+}
+
+cx_hmap_api_ void cx_hmap_name_(_set_ptr)(cx_hmap_name* m, cx_hmap_key const* k, cx_hmap_val const* v) {
+
+    assert(m);
+    cx_hmap_name_(_entry)* e = cx_hmap_name_(_oper_)(m, cx_hmap_op_set_, (cx_hmap_key*)k, cx_hmap_hash_(k), NULL);
+    memcpy(&e->val, v, sizeof(e->val));
+}
+
+cx_hmap_api_ bool cx_hmap_name_(_upsert)(cx_hmap_name* m, cx_hmap_key k, void (*fn)(cx_hmap_val* val, bool found, void* ctx), void* ctx) {
+
+    assert(m);
+    bool inserted;
+    cx_hmap_val* v = cx_hmap_name_(_emplace)(m, &k, &inserted);
+#ifdef cx_hmap_free_key
+    if (!inserted) {
+        cx_hmap_free_key(&k);
+    }
+#endif
+    fn(v, !inserted, ctx);
+    return !inserted;
+}
+
+#ifdef cx_hmap_cmp_keyn
+
+    // Returns the entry with the key equal to the specified key view or NULL if not found
+    static cx_hmap_name_(_entry)* cx_hmap_name_(_findn_)(const cx_hmap_name* m, const void* key, size_t len, size_t hash) {
+
+        if (m->buckets_ == NULL) {
+            return NULL;
+        }
+        const int8_t h2 = (int8_t)(hash & 0x7F);
+        const size_t gmask = m->nbuckets_/CX_HMAP3_GROUP_SIZE - 1;
+        size_t g = (hash >> 7) & gmask;
+        for (size_t i = 1; ; i++) {
+            const int8_t* grp = m->ctrl_ + g * CX_HMAP3_GROUP_SIZE;
+            uint32_t mask = cx_hmap3_match_(grp, h2);
+            while (mask) {
+                cx_hmap_name_(_entry)* e = m->buckets_ + g * CX_HMAP3_GROUP_SIZE + cx_hmap3_first_(mask);
+                if (cx_hmap_cmp_keyn(&e->key, key, len) == 0) {
+                    return e;
+                }
+                mask &= mask - 1;
+            }
+            if (cx_hmap3_match_empty_(grp)) {
+                return NULL;
+            }
+            g = (g + i) & gmask;
+        }
+    }
+
+cx_hmap_api_ cx_hmap_val* cx_hmap_name_(_getn)(const cx_hmap_name* m, const void* key, size_t len, size_t hash) {
+
+    assert(m);
+    cx_hmap_name_(_entry)* e = cx_hmap_name_(_findn_)(m, key, len, hash);
+    return e == NULL ? NULL : &e->val;
+}
+
+cx_hmap_api_ bool cx_hmap_name_(_deln)(cx_hmap_name* m, const void* key, size_t len, size_t hash) {
+
+    assert(m);
+    cx_hmap_name_(_entry)* e = cx_hmap_name_(_findn_)(m, key, len, hash);
+    if (e == NULL) {
+        return false;
+    }
+    // Deletes using a copy of the stored key which is equal to the key view
+    cx_hmap_key k = e->key;
+    cx_hmap_name_(_oper_)(m, cx_hmap_op_del_, &k, hash, NULL);
+    return true;
+}
+
+#endif
+
+cx_hmap_api_ size_t cx_hmap_name_(_get_batch)(const cx_hmap_name* m, cx_hmap_key const* keys, size_t n, cx_hmap_val** vals) {
+
+    assert(m);
+    size_t found = 0;
+    size_t hashes[cx_hmap_batch_];
+    for (size_t b = 0; b < n; b += cx_hmap_batch_) {
+        const size_t count = n - b < cx_hmap_batch_ ? n - b : cx_hmap_batch_;
+        cx_hmap_key* pk = (cx_hmap_key*)keys + b;
+        for (size_t i = 0; i < count; i++) {
+            hashes[i] = cx_hmap_hash_(&pk[i]);
+        }
+        if (m->buckets_ != NULL) {
+            for (size_t i = 0; i < count; i++) {
+                const size_t idx = ((hashes[i] >> 7) & (m->nbuckets_/CX_HMAP3_GROUP_SIZE - 1)) * CX_HMAP3_GROUP_SIZE;
+                __builtin_prefetch(m->ctrl_ + idx, 0);
+                __builtin_prefetch(m->buckets_ + idx, 0);
+            }
+        }
+        for (size_t i = 0; i < count; i++) {
+            cx_hmap_name_(_entry)* e = cx_hmap_name_(_oper_)((cx_hmap_name*)m, cx_hmap_op_get_, &pk[i], hashes[i], NULL);
+            vals[b + i] = e == NULL ? NULL : &e->val;
+            found += e != NULL;
+        }
+    }
+    return found;
+}
+
+cx_hmap_api_ void cx_hmap_name_(_set_batch)(cx_hmap_name* m, cx_hmap_key const* keys, cx_hmap_val const* vals, size_t n) {
+
+    assert(m);
+    size_t hashes[cx_hmap_batch_];
+    for (size_t b = 0; b < n; b += cx_hmap_batch_) {
+        const size_t count = n - b < cx_hmap_batch_ ? n - b : cx_hmap_batch_;
+        cx_hmap_key* pk = (cx_hmap_key*)keys + b;
+        for (size_t i = 0; i < count; i++) {
+            hashes[i] = cx_hmap_hash_(&pk[i]);
+        }
+        if (m->buckets_ != NULL) {
+            for (size_t i = 0; i < count; i++) {
+                const size_t idx = ((hashes[i] >> 7) & (m->nbuckets_/CX_HMAP3_GROUP_SIZE - 1)) * CX_HMAP3_GROUP_SIZE;
+                __builtin_prefetch(m->ctrl_ + idx, 1);
+                __builtin_prefetch(m->buckets_ + idx, 1);
+            }
+        }
+        for (size_t i = 0; i < count; i++) {
+            cx_hmap_name_(_entry)* e = cx_hmap_name_(_oper_)(m, cx_hmap_op_set_, &pk[i], hashes[i], NULL);
+            e->val = vals[b + i];
+        }
+    }
+}
+
+cx_hmap_api_ void cx_hmap_name_(_clear)(cx_hmap_name* m) {
+
+    assert(m);
+    cx_hmap_name_(_free_entries_)(m);
+    if (m->count_ == 0 && m->deleted_ == 0) {
+        return;
+    }
+    memset(m->ctrl_, CX_HMAP3_EMPTY, m->nbuckets_ * sizeof(*m->ctrl_));
+    m->count_ = 0;
+    m->deleted_ = 0;
+}
+
+cx_hmap_api_ size_t cx_hmap_name_(_count)(const cx_hmap_name* m) {
+
+    assert(m);
+    return m->count_;
+}
+
+cx_hmap_api_ void cx_hmap_name_(_retain)(cx_hmap_name* m, bool (*pred)(cx_hmap_name_(_entry)* e, void* ctx), void* ctx) {
+
+    assert(m);
+    assert(pred);
+    for (size_t i = 0; m->count_ > 0 && i < m->nbuckets_; i++) {
+        if (m->ctrl_[i] < 0) {
+            continue;
+        }
+        cx_hmap_name_(_entry)* e = m->buckets_ + i;
+        if (pred(e, ctx)) {
+            continue;
+        }
+        cx_hmap_free_key_(&e->key);
+        cx_hmap_free_val_(&e->val);
+        m->count_--;
+        // As for "Del", if the group has an empty bucket the bucket can be set as empty
+        if (cx_hmap3_match_empty_(m->ctrl_ + (i / CX_HMAP3_GROUP_SIZE) * CX_HMAP3_GROUP_SIZE)) {
+            m->ctrl_[i] = CX_HMAP3_EMPTY;
+        } else {
+            m->ctrl_[i] = CX_HMAP3_DELETED;
+            m->deleted_++;
+        }
+    }
+}
+
+cx_hmap_api_ void cx_hmap_name_(_shrink_to_fit)(cx_hmap_name* m) {
+
+    assert(m);
+    if (m->buckets_ == NULL) {
+        return;
+    }
+    if (m->count_ == 0) {
+        cx_hmap_free_(m, m->buckets_, m->nbuckets_ * sizeof(*m->buckets_));
+        cx_hmap_free_(m, m->ctrl_, m->nbuckets_ * sizeof(*m->ctrl_));
+        m->buckets_ = NULL;
+        m->ctrl_ = NULL;
+        m->nbuckets_ = cx_hmap_name_(_nbuckets_)(cx_hmap_def_nbuckets);
+        m->deleted_ = 0;
+        return;
+    }
+    // Smallest number of buckets which would not be resized by the next insert
+    size_t nbuckets = cx_hmap_name_(_nbuckets_)(m->count_);
+    while (m->count_ + 1 >= (double)nbuckets * cx_hmap_resize_load) {
+        nbuckets *= 2;
+    }
+    if (nbuckets < m->nbuckets_ || m->deleted_ > 0) {
+        cx_hmap_name_(_rehash_)(m, nbuckets);
+    }
+}
+
+cx_hmap_api_ cx_hmap_name_(_entry)* cx_hmap_name_(_next)(const cx_hmap_name* m, cx_hmap_name_(_iter)* iter) {
+
+    assert(m);
+    assert(iter);
+    if (m->buckets_ == NULL) {
+        return NULL;
+    }
+    // Checks the full buckets of each group starting from the current iterator bucket
+    const size_t end = iter->end_ == 0 ? m->nbuckets_ : iter->end_;
+    size_t i = iter->bucket_;
+    while (i < end) {
+        const size_t g = i / CX_HMAP3_GROUP_SIZE;
+        uint32_t mask = ~cx_hmap3_match_free_(m->ctrl_ + g * CX_HMAP3_GROUP_SIZE) & 0xFFFF;
+        mask &= 0xFFFF << (i % CX_HMAP3_GROUP_SIZE);
+        if (mask) {
+            const size_t idx = g * CX_HMAP3_GROUP_SIZE + cx_hmap3_first_(mask);
+            if (idx >= end) {
+                break;
+            }
+            iter->bucket_ = idx + 1;
+            return &m->buckets_[idx];
+        }
+        i = (g + 1) * CX_HMAP3_GROUP_SIZE;
+    }
+    iter->bucket_ = end;
+    return NULL;
+}
+
+cx_hmap_api_ cx_hmap_name_(_iter) cx_hmap_name_(_iter_range)(const cx_hmap_name* m, size_t begin, size_t end) {
+
+    assert(m);
+    if (end > m->nbuckets_) {
+        end = m->nbuckets_;
+    }
+    if (begin >= end) {
+        return (cx_hmap_name_(_iter)){.bucket_ = m->nbuckets_, .end_ = m->nbuckets_};
+    }
+    return (cx_hmap_name_(_iter)){.bucket_ = begin, .end_ = end};
+}
+
+cx_hmap_api_ size_t cx_hmap_name_(_iter_split)(const cx_hmap_name* m, size_t n, cx_hmap_name_(_iter)* iters) {
+
+    assert(m);
+    assert(iters);
+    if (m->buckets_ == NULL || n == 0) {
+        return 0;
+    }
+    // Ranges are multiple of 64 buckets, so threads don't share cache lines of the control array
+    const size_t nunits = (m->nbuckets_ + 63) / 64;
+    if (n > nunits) {
+        n = nunits;
+    }
+    for (size_t i = 0; i < n; i++) {
+        iters[i] = cx_hmap_name_(_iter_range)(m, (nunits * i / n) * 64, (nunits * (i + 1) / n) * 64);
+    }
+    return n;
+}
+
+#ifdef cx_hmap_stats
+
+    typedef struct cx_hmap_name_(_stats) {
+        size_t nbuckets;        // Number of buckets
+        size_t count;           // Number of used buckets
+        size_t deleted;         // Number of deleted buckets
+        size_t empty;           // Number of empty buckets
+        size_t probes;          // Total number of extra group probes
+        size_t max_probe;       // Maximum number of extra group probes
+        size_t min_probe;       // Minimum number of extra group probes
+        double avg_probe;       // Average number of extra group probes
+        double load_factor;     // Current load factor
+    } cx_hmap_name_(_stats);
+
+    cx_hmap_api_ cx_hmap_name_(_stats) cx_hmap_name_(_get_stats)(const cx_hmap_name* m) {
+
+        assert(m);
+        cx_hmap_name_(_stats) s = {0};
+        s.nbuckets = m->nbuckets_;
+        s.min_probe = UINT64_MAX;
+        for (size_t i = 0; m->ctrl_ && i < m->nbuckets_; i++) {
+            if (m->ctrl_[i] == CX_HMAP3_EMPTY) {
+                s.empty++;
+                continue;
+            }
+            if (m->ctrl_[i] == CX_HMAP3_DELETED) {
+                s.deleted++;
+                continue;
+            }
+            cx_hmap_name_(_entry)* e = m->buckets_ + i;
+            size_t nprobes = 0;
+            cx_hmap_name_(_oper_)((cx_hmap_name*)m, cx_hmap_op_get_, &e->key, cx_hmap_hash_(&e->key), &nprobes);
+            s.probes += nprobes;
+            if (nprobes > s.max_probe) {
+                s.max_probe = nprobes;
+            }
+            if (nprobes < s.min_probe) {
+                s.min_probe = nprobes;
+            }
+            s.count++;
+        }
+        s.avg_probe = (double)s.probes/(double)s.count;
+        s.load_factor = (double)s.count / (double)s.nbuckets;
+        return s;
+    }
+
+    cx_hmap_api_ void cx_hmap_name_(_print_stats)(const cx_hmap_name_(_stats)* ps) {
+
+        printf( "nbuckets...: %lu\n"
+                "count......: %lu\n"
+                "deleted....: %lu\n"
+                "empty......: %lu\n"
+                "probes.....: %lu\n"
+                "max_probe..: %lu\n"
+                "min_probe..: %lu\n"
+                "avg_probe..: %.2f\n"
+                "load_factor: %.2f\n",
+                ps->nbuckets,
+                ps->count,
+                ps->deleted,
+                ps->empty,
+                ps->probes,
+                ps->max_probe,
+                ps->min_probe,
+                ps->avg_probe,
+                ps->load_factor);
+    }
+
+#endif // cx_hmap_stats
+#endif // cx_hmap_implement
+
+// Undefine config  macros
+#undef cx_hmap_name
+#undef cx_hmap_key
+#undef cx_hmap_val
+#undef cx_hmap_def_nbuckets
+#undef cx_hmap_resize_load
+#undef cx_hmap_cmp_key
+#undef cx_hmap_cmp_keyn
+#undef cx_hmap_hash_key
+#undef cx_hmap_free_key
+#undef cx_hmap_free_val
+#undef cx_hmap_allocator
+#undef cx_hmap_instance_allocator
+#undef cx_hmap_static
+#undef cx_hmap_inline
+#undef cx_hmap_implement
+#undef cx_hmap_stats
+#undef cx_hmap_no_simd
+
+// Undefine internal macros
+#undef cx_hmap_concat2_
+#undef cx_hmap_concat1_
+#undef cx_hmap_name_
+#undef cx_hmap_api_
+#undef cx_hmap_alloc_field_
+#undef cx_hmap_alloc_global
+#undef cx_hmap_alloc_
+#undef cx_hmap_free_
+#undef cx_hmap_free_key_
+#undef cx_hmap_hash_
+#undef cx_hmap_batch_
+#undef cx_hmap_free_val_
+#undef cx_hmap_op_set_
+#undef cx_hmap_op_get_
+#undef cx_hmap_op_del_
+#undef cx_hmap_op_ins_
+
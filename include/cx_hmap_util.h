@@ -0,0 +1,84 @@
+/*
+Hashmap utilities
+-----------------
+Internal functions shared by the hashmap templates:
+- Default key comparison and hash for keys with size of 1, 2, 4 or 8 bytes,
+  using a single integer compare and a multiplicative mixer.
+  The key size is a compile time constant, so the branches are eliminated.
+- Bucket selection for power of two number of buckets using Fibonacci hashing.
+- 64 bit mixer used to derive seeded hashes from the key hash.
+- Hash functions for nul terminated strings.
+*/
+#ifndef CX_HMAP_UTIL_H
+#define CX_HMAP_UTIL_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+// Returns if the key size can be loaded as an unsigned integer
+#define cx_hmap_int_key_(size) ((size) == 1 || (size) == 2 || (size) == 4 || (size) == 8)
+
+// Loads key of 1, 2, 4 or 8 bytes as an unsigned integer
+static inline uint64_t cx_hmap_load_int_(const void* pk, size_t size) {
+
+    switch (size) {
+        case 1: { uint8_t v;  memcpy(&v, pk, sizeof(v)); return v; }
+        case 2: { uint16_t v; memcpy(&v, pk, sizeof(v)); return v; }
+        case 4: { uint32_t v; memcpy(&v, pk, sizeof(v)); return v; }
+        default: { uint64_t v; memcpy(&v, pk, sizeof(v)); return v; }
+    }
+}
+
+// Compares keys of 1, 2, 4 or 8 bytes.
+// Returns 0 if the keys are equal (as memcmp() but only for equality)
+static inline int cx_hmap_cmp_int_(const void* pk1, const void* pk2, size_t size) {
+
+    return cx_hmap_load_int_(pk1, size) != cx_hmap_load_int_(pk2, size);
+}
+
+// Hashes keys of 1, 2, 4 or 8 bytes
+static inline uint64_t cx_hmap_hash_int_(const void* pk, size_t size) {
+
+    uint64_t x = cx_hmap_load_int_(pk, size);
+    x ^= x >> 32;
+    x *= 0xd6e8feb86659fd93ull;
+    x ^= x >> 32;
+    return x;
+}
+
+// Mixes all the bits of the specified 64 bit value (finalizer of MurmurHash3)
+static inline uint64_t cx_hmap_mix64_(uint64_t x) {
+
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdull;
+    x ^= x >> 33;
+    x *= 0xc4ceb9fe1a85ec53ull;
+    x ^= x >> 33;
+    return x;
+}
+
+// Returns bucket index for the specified hash and power of two number of buckets (>= 2).
+// Multiplies the hash by 2^64/phi and uses the upper bits of the product.
+static inline size_t cx_hmap_fib_index_(uint64_t hash, size_t nbuckets) {
+
+    return (size_t)((hash * 0x9e3779b97f4a7c15ull) >> (64 - __builtin_ctzll(nbuckets)));
+}
+
+// Returns the smallest power of two >= n and >= 2
+size_t cx_hmap_next_pow2(size_t n);
+
+// Returns the same hash as cx_hmap_hash_wy64(str, strlen(str)).
+uint64_t cx_hmap_hash_wy64_str(const char* str);
+
+// Returns the same hash as cx_hmap_hash_wy64_str() finding the terminator while hashing.
+// WARNING: reads blocks of 16 bytes which may extend past the terminator into memory not
+// owned by the string (up to the end of its page, so it never faults). The bytes read past
+// the terminator do not change the hash, but they may be concurrently written or freed by
+// other code, which is reported by Valgrind and by sanitizers not disabled for this function
+// (address, thread and memory sanitizers are disabled). Only use it for strings from trusted
+// sources when the speed of hashing long keys matters.
+uint64_t cx_hmap_hash_wy64_str_fast(const char* str);
+
+#endif
+
@@ -0,0 +1,663 @@
+/*
+Hash Set Implementation
+-----------------------
+- Stores only the keys, packed in a single array without value or padding.
+- Uses open addressing with linear probing.
+- The number of buckets is a power of 2 and the initial probe index is selected using Fibonacci hashing.
+- A separate status byte for each bucket stores 7 bits of the key hash,
+  so most probes of other keys don't compare the keys.
+- Deletes shift back the following entries of the probe sequence instead of
+  leaving deleted buckets, so probe lengths do not grow with repeated inserts and deletes.
+- Membership tests and inserts can be done in batches which hash the keys
+  and prefetch their buckets before probing.
+- Uses global type allocator initialized with default allocator.
+- Can be configured to use custom allocator per instance.
+- Optionally stores the hash of each key.
+
+Example
+-------
+
+#include <stdio.h>
+#include <assert.h>
+#define cx_hset_name set
+#define cx_hset_key uint64_t
+#define cx_hset_implement
+#include "cx_hset.h"
+
+int main() {
+
+    set s1 = set_init(0);
+    set s2 = set_init(0);
+    for (size_t i = 0; i < 100; i++) {
+        set_add(&s1, i);
+        set_add(&s2, i * 2);
+    }
+    assert(set_contains(&s1, 10));
+
+    // Removes from s1 the keys not in s2
+    set_intersect(&s1, &s2);
+    assert(set_count(&s1) == 50);
+
+    // Iterate over keys
+    set_iter iter = {0};
+    uint64_t* k;
+    while ((k = set_next(&s1, &iter)) != NULL) {
+        printf("key:%lu\n", *k);
+    }
+    set_free(&s1);
+    set_free(&s2);
+    return 0;
+}
+
+
+Configuration
+-------------
+
+Define the name of the set type (mandatory):
+    #define cx_hset_name <name>
+
+Define the type of the set key (mandatory):
+    #define cx_hset_key <type>
+
+Define the default initial number of buckets,
+when set is initialized with nbuckets = 0.
+The number of buckets is always rounded to a power of 2.
+    #define cx_hset_def_nbuckets <n>
+
+Define the load factor (number of keys/number of buckets)
+which, if exceeded, doubles the number of buckets.
+    #define cx_hset_resize_load <lf>
+
+Define the key comparison function, as for cx_hmap2.h:
+int (*cmp)(const void* k1, const void* k2, size_t size);
+The default comparison function is a single integer comparison
+for keys with size of 1, 2, 4 or 8 bytes and memcmp() otherwise.
+    #define cx_hset_cmp_key(pk1,pk2,s) <cmp_func>
+
+Define the key hash function, as for cx_hmap2.h:
+size_t (*hash)(const void* key, size_t size);
+The default hash function is a multiplicative mixer for keys with size of
+1, 2, 4 or 8 bytes and cx_hmap_hash_wy64() otherwise.
+    #define cx_hset_hash_key(pk,s) <hash_func>
+
+Stores the hash of the key in each entry.
+Recommended for keys with expensive hash and comparison, such as strings.
+    #define cx_hset_cache_hash
+
+Define function to free the keys of the set:
+void (*free)(void* key);
+By default no function is defined.
+    #define cx_hset_free_key(pk) <free_func>
+
+Define optional custom allocator pointer or function call which return pointer to allocator.
+Uses default allocator if not defined.
+This allocator will be used for all instances of this type.
+    #define cx_hset_allocator <allocator>
+
+Sets if set uses custom allocator per instance.
+If set, it is necessary to initialize each set with the desired allocator.
+    #define cx_hset_instance_allocator
+
+Sets if all set functions are prefixed with 'static'
+    #define cx_hset_static
+
+Sets if all set functions are prefixed with 'inline'
+    #define cx_hset_inline
+
+Sets to implement functions in this translation unit:
+    #define cx_hset_implement
+
+
+API
+---
+
+Assuming:
+#define cx_hset_name hset       // Set type name
+#define cx_hset_key  ktype      // Type of key
+
+Initialize set defined with custom allocator
+If the specified number of bucket is 0, the default will be used.
+    hset hset_init(const CxAllocator* alloc, size_t nbuckets);
+
+Initialize set NOT defined with custom allocator
+If the specified number of bucket is 0, the default will be used.
+    hset hset_init(size_t nbuckets);
+
+Free set allocated memory
+    void hset_free(hset* s);
+
+Adds the specified key to the set.
+Returns true if the key was inserted or false if it was already in the set,
+in which case the set does not take ownership of the key.
+    bool hset_add(hset* s, ktype k);
+
+Returns if the specified key is in the set
+    bool hset_contains(const hset* s, ktype k);
+
+Deletes the specified key.
+Returns true if found or false otherwise.
+    bool hset_del(hset* s, ktype k);
+
+Checks if each of the 'n' keys is in the set, setting the corresponding element of 'found'.
+The keys are hashed and their buckets prefetched in batches, overlapping the
+memory latency of several lookups. Returns the number of keys found.
+    size_t hset_contains_batch(const hset* s, const ktype* keys, size_t n, bool* found);
+
+Adds 'n' keys, hashing the keys and prefetching their buckets in batches.
+Sets the elements of 'inserted' (if not NULL) to indicate which keys were inserted.
+Returns the number of keys inserted.
+    size_t hset_add_batch(hset* s, const ktype* keys, size_t n, bool* inserted);
+
+Adds to 'dst' all the keys of 'src' (only if cx_hset_free_key is not defined).
+    void hset_union(hset* dst, const hset* src);
+
+Removes from 'dst' the keys which are not in 'src'.
+    void hset_intersect(hset* dst, const hset* src);
+
+Removes from 'dst' the keys which are in 'src'.
+    void hset_difference(hset* dst, const hset* src);
+
+Returns the number of keys in the set
+    size_t hset_count(const hset* s);
+
+Clears the set without deallocating memory.
+The current number of buckets is not changed.
+    void hset_clear(hset* s);
+
+Returns pointer to the next key from the specified iterator.
+Returns NULL after the last key.
+    ktype* hset_next(const hset* s, hset_iter* iter);
+
+*/
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include "cx_alloc.h"
+#include "cx_hmap_util.h"
+
+#ifndef cx_hset_name
+    #error "cx_hset_name not defined"
+#endif
+#ifndef cx_hset_key
+    #error "cx_hset_key not defined"
+#endif
+
+#ifndef cx_hset_def_nbuckets
+    #define cx_hset_def_nbuckets (16)
+#endif
+
+#ifndef cx_hset_resize_load
+    #define cx_hset_resize_load (0.8)
+#endif
+
+// Default key comparison function
+#ifndef cx_hset_cmp_key
+    #define cx_hset_cmp_key(pk1,pk2,s)\
+        (cx_hmap_int_key_(s) ? cx_hmap_cmp_int_(pk1,pk2,s) : memcmp(pk1,pk2,s))
+#endif
+
+// Default key hash function
+#ifndef cx_hset_hash_key
+    #define cx_hset_hash_key(pk,s)\
+        (cx_hmap_int_key_(s) ? cx_hmap_hash_int_(pk,s) : cx_hmap_hash_wy64(pk,s))
+#endif
+
+// Hash of the key pointed by 'pk'
+#define cx_hset_hash_(pk) cx_hset_hash_key((char*)(pk), sizeof(cx_hset_key))
+
+// Stored hash of entries
+#ifdef cx_hset_cache_hash
+    #define cx_hset_hash_field_         size_t hash_;
+    #define cx_hset_entry_hash_(e)      ((e)->hash_)
+    #define cx_hset_hash_eq_(e,h)       ((e)->hash_ == (h))
+    #define cx_hset_set_hash_(e,h)      (e)->hash_ = (h)
+#else
+    #define cx_hset_hash_field_
+    #define cx_hset_entry_hash_(e)      cx_hset_hash_(&(e)->key)
+    #define cx_hset_hash_eq_(e,h)       (true)
+    #define cx_hset_set_hash_(e,h)
+#endif
+
+// Default free key function
+#ifndef cx_hset_free_key
+    #define cx_hset_free_key_(key)
+#else
+    #define cx_hset_free_key_(key) cx_hset_free_key(key)
+#endif
+
+// Status of empty bucket and of full bucket with the 7 lower bits of the key hash
+#define cx_hset_empty_      (0)
+#define cx_hset_tag_(hash)  ((uint8_t)(0x80 | ((hash) & 0x7F)))
+
+// Number of keys hashed and prefetched at once by the batch functions
+#define cx_hset_batch_ (16)
+
+// Auxiliary internal macros
+#define cx_hset_concat2_(a, b) a ## b
+#define cx_hset_concat1_(a, b) cx_hset_concat2_(a, b)
+#define cx_hset_name_(name) cx_hset_concat1_(cx_hset_name, name)
+
+// API attributes
+#if defined(cx_hset_static) && defined(cx_hset_inline)
+    #define cx_hset_api_ static inline
+#elif defined(cx_hset_static)
+    #define cx_hset_api_ static
+#elif defined(cx_hset_inline)
+    #define cx_hset_api_ inline
+#else
+    #define cx_hset_api_
+#endif
+
+// Default allocator
+#ifndef cx_hset_allocator
+    #define cx_hset_allocator cx_def_allocator()
+#endif
+
+// Use custom instance allocator
+#ifdef cx_hset_instance_allocator
+    #define cx_hset_alloc_field_\
+        const CxAllocator* alloc_;
+    #define cx_hset_alloc_(s,n)\
+        cx_alloc_malloc((s)->alloc_, n)
+    #define cx_hset_free_(s,p,n)\
+        cx_alloc_free((s)->alloc_, p, n)
+// Use global type allocator
+#else
+    #define cx_hset_alloc_field_
+    #define cx_hset_alloc_(s,n)\
+        cx_alloc_malloc(cx_hset_allocator,n)
+    #define cx_hset_free_(s,p,n)\
+        cx_alloc_free(cx_hset_allocator,p,n)
+#endif
+
+//
+// Declarations
+//
+
+typedef struct cx_hset_name_(_entry) {
+    cx_hset_hash_field_
+    cx_hset_key key;
+} cx_hset_name_(_entry);
+
+typedef struct cx_hset_name {
+    cx_hset_alloc_field_
+    size_t      nbuckets_;
+    size_t      count_;
+    uint8_t*    status_;
+    cx_hset_name_(_entry)* buckets_;
+} cx_hset_name;
+
+typedef struct cx_hset_name_(_iter) {
+    size_t bucket_;
+} cx_hset_name_(_iter);
+
+#ifdef cx_hset_instance_allocator
+    cx_hset_api_ cx_hset_name cx_hset_name_(_init)(const CxAllocator* alloc, size_t nbuckets);
+#else
+    cx_hset_api_ cx_hset_name cx_hset_name_(_init)(size_t nbuckets);
+#endif
+cx_hset_api_ void cx_hset_name_(_free)(cx_hset_name* s);
+cx_hset_api_ bool cx_hset_name_(_add)(cx_hset_name* s, cx_hset_key k);
+cx_hset_api_ bool cx_hset_name_(_contains)(const cx_hset_name* s, cx_hset_key k);
+cx_hset_api_ bool cx_hset_name_(_del)(cx_hset_name* s, cx_hset_key k);
+cx_hset_api_ size_t cx_hset_name_(_contains_batch)(const cx_hset_name* s, cx_hset_key const* keys, size_t n, bool* found);
+cx_hset_api_ size_t cx_hset_name_(_add_batch)(cx_hset_name* s, cx_hset_key const* keys, size_t n, bool* inserted);
+#ifndef cx_hset_free_key
+cx_hset_api_ void cx_hset_name_(_union)(cx_hset_name* dst, const cx_hset_name* src);
+#endif
+cx_hset_api_ void cx_hset_name_(_intersect)(cx_hset_name* dst, const cx_hset_name* src);
+cx_hset_api_ void cx_hset_name_(_difference)(cx_hset_name* dst, const cx_hset_name* src);
+cx_hset_api_ size_t cx_hset_name_(_count)(const cx_hset_name* s);
+cx_hset_api_ void cx_hset_name_(_clear)(cx_hset_name* s);
+cx_hset_api_ cx_hset_key* cx_hset_name_(_next)(const cx_hset_name* s, cx_hset_name_(_iter)* iter);
+
+//
+// Implementation
+//
+#ifdef cx_hset_implement
+
+    // Declaration of function to hash keys
+    uint64_t cx_hmap_hash_wy64(const void* buf, size_t len);
+
+    // Allocates the bucket arrays
+    static void cx_hset_name_(_alloc_buckets_)(cx_hset_name* s) {
+
+        if (s->nbuckets_ == 0) {
+            s->nbuckets_ = cx_hmap_next_pow2(cx_hset_def_nbuckets);
+        }
+        s->buckets_ = cx_hset_alloc_(s, s->nbuckets_ * sizeof(*s->buckets_));
+        s->status_ = cx_hset_alloc_(s, s->nbuckets_ * sizeof(*s->status_));
+        memset(s->status_, cx_hset_empty_, s->nbuckets_ * sizeof(*s->status_));
+    }
+
+    // Returns the index of the bucket with the specified key and hash
+    // or the index of the empty bucket where the probe stopped.
+    static inline size_t cx_hset_name_(_find_)(const cx_hset_name* s, cx_hset_key* key, size_t hash) {
+
+        const uint8_t tag = cx_hset_tag_(hash);
+        size_t idx = cx_hmap_fib_index_(hash, s->nbuckets_);
+        while (s->status_[idx] != cx_hset_empty_) {
+            const cx_hset_name_(_entry)* e = s->buckets_ + idx;
+            if (s->status_[idx] == tag && cx_hset_hash_eq_(e, hash) &&
+                cx_hset_cmp_key(&e->key, key, sizeof(cx_hset_key)) == 0) {
+                return idx;
+            }
+            idx = (idx + 1) & (s->nbuckets_ - 1);
+        }
+        return idx;
+    }
+
+    // Doubles the number of buckets
+    static void cx_hset_name_(_resize_)(cx_hset_name* s) {
+
+        cx_hset_name_(_entry)* old_buckets = s->buckets_;
+        uint8_t* old_status = s->status_;
+        const size_t old_nbuckets = s->nbuckets_;
+        s->nbuckets_ *= 2;
+        cx_hset_name_(_alloc_buckets_)(s);
+        for (size_t i = 0; i < old_nbuckets; i++) {
+            if (old_status[i] == cx_hset_empty_) {
+                continue;
+            }
+            const cx_hset_name_(_entry)* e = old_buckets + i;
+            size_t idx = cx_hmap_fib_index_(cx_hset_entry_hash_(e), s->nbuckets_);
+            while (s->status_[idx] != cx_hset_empty_) {
+                idx = (idx + 1) & (s->nbuckets_ - 1);
+            }
+            s->buckets_[idx] = *e;
+            s->status_[idx] = old_status[i];
+        }
+        cx_hset_free_(s, old_buckets, old_nbuckets * sizeof(*old_buckets));
+        cx_hset_free_(s, old_status, old_nbuckets * sizeof(*old_status));
+    }
+
+    // Inserts the key with the specified hash if not found.
+    // Returns true if inserted.
+    static inline bool cx_hset_name_(_insert_)(cx_hset_name* s, cx_hset_key* key, size_t hash) {
+
+        if (s->buckets_ == NULL) {
+            cx_hset_name_(_alloc_buckets_)(s);
+        }
+        size_t idx = cx_hset_name_(_find_)(s, key, hash);
+        if (s->status_[idx] != cx_hset_empty_) {
+            return false;
+        }
+        // Resizes only for new keys, so the key may point to an entry of this set
+        if (s->count_ + 1 > (double)s->nbuckets_ * cx_hset_resize_load) {
+            cx_hset_name_(_resize_)(s);
+            idx = cx_hset_name_(_find_)(s, key, hash);
+        }
+        cx_hset_name_(_entry)* e = s->buckets_ + idx;
+        cx_hset_set_hash_(e, hash);
+        memcpy(&e->key, key, sizeof(cx_hset_key));
+        s->status_[idx] = cx_hset_tag_(hash);
+        s->count_++;
+        return true;
+    }
+
+    // Deletes the key at 'idx' shifting back the following entries of the probe
+    // sequence which can be moved closer to their initial buckets.
+    static void cx_hset_name_(_remove_)(cx_hset_name* s, size_t idx) {
+
+        cx_hset_free_key_(&s->buckets_[idx].key);
+        const size_t mask = s->nbuckets_ - 1;
+        size_t next = (idx + 1) & mask;
+        while (s->status_[next] != cx_hset_empty_) {
+            const size_t home = cx_hmap_fib_index_(cx_hset_entry_hash_(&s->buckets_[next]), s->nbuckets_);
+            // Moves the entry if the hole is in the cyclic range [home, next)
+            if (((next - home) & mask) >= ((next - idx) & mask)) {
+                s->buckets_[idx] = s->buckets_[next];
+                s->status_[idx] = s->status_[next];
+                idx = next;
+            }
+            next = (next + 1) & mask;
+        }
+        s->status_[idx] = cx_hset_empty_;
+        s->count_--;
+    }
+
+#ifdef cx_hset_instance_allocator
+
+    cx_hset_api_ cx_hset_name cx_hset_name_(_init)(const CxAllocator* alloc, size_t nbuckets) {
+        return (cx_hset_name){
+            .alloc_ = alloc == NULL ? cx_def_allocator() : alloc,
+            .nbuckets_ = cx_hmap_next_pow2(nbuckets == 0 ? cx_hset_def_nbuckets : nbuckets),
+        };
+    }
+
+#else
+
+    cx_hset_api_ cx_hset_name cx_hset_name_(_init)(size_t nbuckets) {
+        return (cx_hset_name){
+            .nbuckets_ = cx_hmap_next_pow2(nbuckets == 0 ? cx_hset_def_nbuckets : nbuckets),
+        };
+    }
+
+#endif
+
+cx_hset_api_ void cx_hset_name_(_free)(cx_hset_name* s) {
+
+    assert(s);
+    if (s->buckets_ == NULL) {
+        return;
+    }
+    cx_hset_name_(_clear)(s);
+    cx_hset_free_(s, s->buckets_, s->nbuckets_ * sizeof(*s->buckets_));
+    cx_hset_free_(s, s->status_, s->nbuckets_ * sizeof(*s->status_));
+    s->buckets_ = NULL;
+    s->status_ = NULL;
+}
+
+cx_hset_api_ bool cx_hset_name_(_add)(cx_hset_name* s, cx_hset_key k) {
+
+    assert(s);
+    return cx_hset_name_(_insert_)(s, &k, cx_hset_hash_(&k));
+}
+
+cx_hset_api_ bool cx_hset_name_(_contains)(const cx_hset_name* s, cx_hset_key k) {
+
+    assert(s);
+    if (s->buckets_ == NULL) {
+        return false;
+    }
+    return s->status_[cx_hset_name_(_find_)(s, &k, cx_hset_hash_(&k))] != cx_hset_empty_;
+}
+
+cx_hset_api_ bool cx_hset_name_(_del)(cx_hset_name* s, cx_hset_key k) {
+
+    assert(s);
+    if (s->buckets_ == NULL) {
+        return false;
+    }
+    const size_t idx = cx_hset_name_(_find_)(s, &k, cx_hset_hash_(&k));
+    if (s->status_[idx] == cx_hset_empty_) {
+        return false;
+    }
+    cx_hset_name_(_remove_)(s, idx);
+    return true;
+}
+
+cx_hset_api_ size_t cx_hset_name_(_contains_batch)(const cx_hset_name* s, cx_hset_key const* keys, size_t n, bool* found) {
+
+    assert(s);
+    if (s->buckets_ == NULL) {
+        memset(found, 0, n * sizeof(*found));
+        return 0;
+    }
+    size_t count = 0;
+    size_t hashes[cx_hset_batch_];
+    for (size_t b = 0; b < n; b += cx_hset_batch_) {
+        const size_t nb = n - b < cx_hset_batch_ ? n - b : cx_hset_batch_;
+        cx_hset_key* pk = (cx_hset_key*)keys + b;
+        for (size_t i = 0; i < nb; i++) {
+            hashes[i] = cx_hset_hash_(&pk[i]);
+            const size_t idx = cx_hmap_fib_index_(hashes[i], s->nbuckets_);
+            __builtin_prefetch(s->status_ + idx, 0);
+            __builtin_prefetch(s->buckets_ + idx, 0);
+        }
+        for (size_t i = 0; i < nb; i++) {
+            found[b + i] = s->status_[cx_hset_name_(_find_)(s, &pk[i], hashes[i])] != cx_hset_empty_;
+            count += found[b + i];
+        }
+    }
+    return count;
+}
+
+cx_hset_api_ size_t cx_hset_name_(_add_batch)(cx_hset_name* s, cx_hset_key const* keys, size_t n, bool* inserted) {
+
+    assert(s);
+    size_t count = 0;
+    size_t hashes[cx_hset_batch_];
+    for (size_t b = 0; b < n; b += cx_hset_batch_) {
+        const size_t nb = n - b < cx_hset_batch_ ? n - b : cx_hset_batch_;
+        cx_hset_key* pk = (cx_hset_key*)keys + b;
+        for (size_t i = 0; i < nb; i++) {
+            hashes[i] = cx_hset_hash_(&pk[i]);
+        }
+        if (s->buckets_ != NULL) {
+            for (size_t i = 0; i < nb; i++) {
+                const size_t idx = cx_hmap_fib_index_(hashes[i], s->nbuckets_);
+                __builtin_prefetch(s->status_ + idx, 1);
+                __builtin_prefetch(s->buckets_ + idx, 1);
+            }
+        }
+        for (size_t i = 0; i < nb; i++) {
+            const bool ins = cx_hset_name_(_insert_)(s, &pk[i], hashes[i]);
+            if (inserted) {
+                inserted[b + i] = ins;
+            }
+            count += ins;
+        }
+    }
+    return count;
+}
+
+#ifndef cx_hset_free_key
+
+cx_hset_api_ void cx_hset_name_(_union)(cx_hset_name* dst, const cx_hset_name* src) {
+
+    assert(dst && src);
+    if (dst == src) {
+        return;
+    }
+    for (size_t i = 0; src->buckets_ != NULL && i < src->nbuckets_; i++) {
+        if (src->status_[i] != cx_hset_empty_) {
+            cx_hset_name_(_entry)* e = src->buckets_ + i;
+            cx_hset_name_(_insert_)(dst, &e->key, cx_hset_entry_hash_(e));
+        }
+    }
+}
+
+#endif
+
+    // Removes from 'dst' the keys which are in 'src' or the keys not in 'src'.
+    // After removing the key at 'i' the same bucket is checked again, as it may
+    // contain a following entry shifted back.
+    static void cx_hset_name_(_filter_)(cx_hset_name* dst, const cx_hset_name* src, bool in_src) {
+
+        if (dst->buckets_ == NULL) {
+            return;
+        }
+        size_t i = 0;
+        while (i < dst->nbuckets_) {
+            if (dst->status_[i] != cx_hset_empty_) {
+                cx_hset_name_(_entry)* e = dst->buckets_ + i;
+                const bool found = src->buckets_ != NULL &&
+                    src->status_[cx_hset_name_(_find_)(src, &e->key, cx_hset_entry_hash_(e))] != cx_hset_empty_;
+                if (found == in_src) {
+                    cx_hset_name_(_remove_)(dst, i);
+                    continue;
+                }
+            }
+            i++;
+        }
+    }
+
+cx_hset_api_ void cx_hset_name_(_intersect)(cx_hset_name* dst, const cx_hset_name* src) {
+
+    assert(dst && src);
+    cx_hset_name_(_filter_)(dst, src, false);
+}
+
+cx_hset_api_ void cx_hset_name_(_difference)(cx_hset_name* dst, const cx_hset_name* src) {
+
+    assert(dst && src);
+    cx_hset_name_(_filter_)(dst, src, true);
+}
+
+cx_hset_api_ size_t cx_hset_name_(_count)(const cx_hset_name* s) {
+
+    assert(s);
+    return s->count_;
+}
+
+cx_hset_api_ void cx_hset_name_(_clear)(cx_hset_name* s) {
+
+    assert(s);
+    if (s->count_ == 0) {
+        return;
+    }
+#ifdef cx_hset_free_key
+    for (size_t i = 0; i < s->nbuckets_; i++) {
+        if (s->status_[i] != cx_hset_empty_) {
+            cx_hset_free_key_(&s->buckets_[i].key);
+        }
+    }
+#endif
+    memset(s->status_, cx_hset_empty_, s->nbuckets_ * sizeof(*s->status_));
+    s->count_ = 0;
+}
+
+cx_hset_api_ cx_hset_key* cx_hset_name_(_next)(const cx_hset_name* s, cx_hset_name_(_iter)* iter) {
+
+    assert(s);
+    assert(iter);
+    if (s->buckets_ == NULL) {
+        return NULL;
+    }
+    for (size_t i = iter->bucket_; i < s->nbuckets_; i++) {
+        if (s->status_[i] != cx_hset_empty_) {
+            iter->bucket_ = i + 1;
+            return &s->buckets_[i].key;
+        }
+    }
+    iter->bucket_ = s->nbuckets_;
+    return NULL;
+}
+
+#endif // cx_hset_implement
+
+// Undefine config  macros
+#undef cx_hset_name
+#undef cx_hset_key
+#undef cx_hset_def_nbuckets
+#undef cx_hset_resize_load
+#undef cx_hset_cmp_key
+#undef cx_hset_hash_key
+#undef cx_hset_cache_hash
+#undef cx_hset_free_key
+#undef cx_hset_allocator
+#undef cx_hset_instance_allocator
+#undef cx_hset_static
+#undef cx_hset_inline
+#undef cx_hset_implement
+
+// Undefine internal macros
+#undef cx_hset_hash_
+#undef cx_hset_hash_field_
+#undef cx_hset_entry_hash_
+#undef cx_hset_hash_eq_
+#undef cx_hset_set_hash_
+#undef cx_hset_free_key_
+#undef cx_hset_empty_
+#undef cx_hset_tag_
+#undef cx_hset_batch_
+#undef cx_hset_concat2_
+#undef cx_hset_concat1_
+#undef cx_hset_name_
+#undef cx_hset_api_
+#undef cx_hset_alloc_field_
+#undef cx_hset_alloc_
+#undef cx_hset_free_
@@ -0,0 +1,774 @@
+/*
+Static Perfect Hashmap Implementation
+-------------------------------------
+- Map for a key set which is known when the map is built and not changed afterwards.
+- The entries are added and then the map is built using the CHD algorithm
+  (Compress, Hash and Displace), producing a minimal perfect hash function:
+  each key is mapped to a distinct position of the entries array which has
+  exactly the number of entries, without empty slots.
+- The keys are hashed and grouped in displacement buckets with an average of
+  'cx_phmap_lambda' keys. The displacement 'd' of each bucket is searched,
+  starting with the largest buckets, so the positions of all its keys,
+  calculated from the key hash and 'd', are free.
+- Lookups hash the key, read the displacement of its bucket and
+  compare the key at the single calculated position.
+  The position is calculated with multiplications only (no division).
+- Uses global type allocator initialized with default allocator.
+- Can be configured to use custom allocator per instance.
+- Optionally the built map can be saved to a file and opened mapped in memory.
+
+Example
+-------
+
+#include <stdio.h>
+#include <assert.h>
+#define cx_phmap_name pmap
+#define cx_phmap_key int
+#define cx_phmap_val double
+#define cx_phmap_implement
+#include "cx_phmap.h"
+
+int main() {
+
+    pmap m = pmap_init();
+
+    // Adds keys and values and builds the map
+    size_t size = 100;
+    for (size_t i = 0; i < size; i++) {
+        pmap_add(&m, i, i * 2.0);
+    }
+    assert(pmap_build(&m));
+
+    // Get values
+    for (size_t i = 0; i < size; i++) {
+        assert(*pmap_get(&m, i) == i * 2.0);
+    }
+    assert(pmap_get(&m, size) == NULL);
+
+    // Iterate over keys and values
+    for (size_t i = 0; i < pmap_count(&m); i++) {
+        pmap_entry* e = pmap_at(&m, i);
+        printf("key:%d val:%f\n", e->key, e->val);
+    }
+    pmap_free(&m);
+    return 0;
+}
+
+The entries of a finished hashmap can be added iterating over the map:
+
+    hmap_iter iter = {0};
+    hmap_entry* e;
+    while ((e = hmap_next(&m1, &iter)) != NULL) {
+        pmap_add(&m2, e->key, e->val);
+    }
+    pmap_build(&m2);
+
+
+Configuration
+-------------
+
+Define the name of the map type (mandatory):
+    #define cx_phmap_name <name>
+
+Define the type of the map key (mandatory):
+    #define cx_phmap_key <type>
+
+Define the type of the map value (mandatory):
+    #define cx_phmap_val <type>
+
+Define the average number of keys in each displacement bucket (default = 4).
+Larger values use less memory for the displacements and take longer to build.
+    #define cx_phmap_lambda <n>
+
+Define the key comparison function, as for cx_hmap2.h:
+int (*cmp)(const void* k1, const void* k2, size_t size);
+The default comparison function is a single integer comparison
+for keys with size of 1, 2, 4 or 8 bytes and memcmp() otherwise.
+    #define cx_phmap_cmp_key(pk1,pk2,s) <cmp_func>
+
+Define the key hash function, as for cx_hmap2.h:
+size_t (*hash)(const void* key, size_t size);
+The default hash function is a multiplicative mixer for keys with size of
+1, 2, 4 or 8 bytes and cx_hmap_hash_wy64() otherwise.
+The seeded hashes used by the map are derived from this hash, so keys
+with the same hash can not be distinguished and the build fails.
+    #define cx_phmap_hash_key(pk,s) <hash_func>
+
+Define function to free the key of the entries:
+void (*free)(void* key);
+By default no function is defined.
+    #define cx_phmap_free_key(pk) <free_func>
+
+Define function to free the value of the entries:
+void (*free)(void* val);
+By default no function is defined.
+    #define cx_phmap_free_val(pv) <free_func>
+
+Define optional custom allocator pointer or function call which return pointer to allocator.
+Uses default allocator if not defined.
+This allocator will be used for all instances of this type.
+    #define cx_phmap_allocator <allocator>
+
+Sets if map uses custom allocator per instance.
+If set, it is necessary to initialize each map with the desired allocator.
+    #define cx_phmap_instance_allocator
+
+Enable the functions to save the built map to a file and to open a saved map
+mapped in memory. The key and value types must be plain data without pointers
+and the key hash function must be the same for the processes sharing the file.
+    #define cx_phmap_freeze
+
+Sets if all map functions are prefixed with 'static'
+    #define cx_phmap_static
+
+Sets if all map functions are prefixed with 'inline'
+    #define cx_phmap_inline
+
+Sets to implement functions in this translation unit:
+    #define cx_phmap_implement
+
+
+API
+---
+
+Assuming:
+#define cx_phmap_name pmap      // Map type name
+#define cx_phmap_key  ktype     // Type of key
+#define cx_phmap_val  vtype     // Type of value
+
+Initialize map defined with custom allocator
+    pmap pmap_init(const CxAllocator* alloc);
+
+Initialize map NOT defined with custom allocator
+    pmap pmap_init(void);
+
+Free map allocated memory
+    void pmap_free(pmap* m);
+
+Adds entry with the specified key and value.
+The map is not usable for lookups until pmap_build() is called.
+    void pmap_add(pmap* m, ktype k, vtype v);
+
+Builds the perfect hash function for the added entries, reordering them.
+Returns false if there are duplicated keys, keys with the same hash
+or if the build failed for all the tried seeds.
+    bool pmap_build(pmap* m);
+
+Returns pointer to value associated with specified key.
+Returns NULL if not found or if the map was not built.
+    vtype* pmap_get(const pmap* m, ktype k);
+
+Returns the number of entries in the map
+    size_t pmap_count(const pmap* m);
+
+Returns pointer to the entry at the specified position.
+Returns NULL if the position is invalid.
+    pmap_entry* pmap_at(const pmap* m, size_t pos);
+
+Writes the built map to the specified writer (only if cx_phmap_freeze is defined).
+The file has a header followed by the displacement array and the entries array,
+at offsets relative to the start of the file, in the native byte order.
+    CxError pmap_freeze(const pmap* m, const CxWriter* out);
+
+Opens file previously written by pmap_freeze(), mapping it read only in memory
+without copying it (only if cx_phmap_freeze is defined).
+The map can be used with pmap_get(), pmap_count() and pmap_at()
+and must be closed with pmap_mapped_close().
+    CxError pmap_mapped_open(const char* path, pmap* m);
+
+Unmaps map opened with pmap_mapped_open() (only if cx_phmap_freeze is defined).
+    void pmap_mapped_close(pmap* m);
+
+*/
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include "cx_alloc.h"
+#include "cx_hmap_util.h"
+#ifdef cx_phmap_freeze
+    #include <fcntl.h>
+    #include <unistd.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include "cx_error.h"
+    #include "cx_writer.h"
+#endif
+
+#ifndef cx_phmap_name
+    #error "cx_phmap_name not defined"
+#endif
+#ifndef cx_phmap_key
+    #error "cx_phmap_key not defined"
+#endif
+#ifndef cx_phmap_val
+    #error "cx_phmap_val not defined"
+#endif
+#ifdef cx_phmap_freeze
+    #if defined(cx_phmap_free_key) || defined(cx_phmap_free_val)
+        #error "cx_phmap_freeze requires keys and values without free functions"
+    #endif
+#endif
+
+#ifndef cx_phmap_lambda
+    #define cx_phmap_lambda (4)
+#endif
+
+// Default key comparison function
+#ifndef cx_phmap_cmp_key
+    #define cx_phmap_cmp_key(pk1,pk2,s)\
+        (cx_hmap_int_key_(s) ? cx_hmap_cmp_int_(pk1,pk2,s) : memcmp(pk1,pk2,s))
+#endif
+
+// Default key hash function
+#ifndef cx_phmap_hash_key
+    #define cx_phmap_hash_key(pk,s)\
+        (cx_hmap_int_key_(s) ? cx_hmap_hash_int_(pk,s) : cx_hmap_hash_wy64(pk,s))
+#endif
+
+// Hash of the key pointed by 'pk'
+#define cx_phmap_hash_(pk) cx_phmap_hash_key((char*)(pk), sizeof(cx_phmap_key))
+
+// Default free key function
+#ifndef cx_phmap_free_key
+    #define cx_phmap_free_key_(key)
+#else
+    #define cx_phmap_free_key_(key) cx_phmap_free_key(key)
+#endif
+
+// Default free value function
+#ifndef cx_phmap_free_val
+    #define cx_phmap_free_val_(val)
+#else
+    #define cx_phmap_free_val_(val) cx_phmap_free_val(val)
+#endif
+
+// Number of seeds tried by the build
+#define cx_phmap_max_seeds_ (32)
+
+// Returns value in the range [0, n) from the 32 bit value 'x' (Lemire's fast range)
+#define cx_phmap_range_(x,n) ((uint32_t)(((uint64_t)(uint32_t)(x) * (n)) >> 32))
+
+// Auxiliary internal macros
+#define cx_phmap_concat2_(a, b) a ## b
+#define cx_phmap_concat1_(a, b) cx_phmap_concat2_(a, b)
+#define cx_phmap_name_(name) cx_phmap_concat1_(cx_phmap_name, name)
+
+// API attributes
+#if defined(cx_phmap_static) && defined(cx_phmap_inline)
+    #define cx_phmap_api_ static inline
+#elif defined(cx_phmap_static)
+    #define cx_phmap_api_ static
+#elif defined(cx_phmap_inline)
+    #define cx_phmap_api_ inline
+#else
+    #define cx_phmap_api_
+#endif
+
+// Default allocator
+#ifndef cx_phmap_allocator
+    #define cx_phmap_allocator cx_def_allocator()
+#endif
+
+// Use custom instance allocator
+#ifdef cx_phmap_instance_allocator
+    #define cx_phmap_alloc_field_\
+        const CxAllocator* alloc_;
+    #define cx_phmap_alloc_(m,n)\
+        cx_alloc_malloc((m)->alloc_, n)
+    #define cx_phmap_free_(m,p,n)\
+        cx_alloc_free((m)->alloc_, p, n)
+// Use global type allocator
+#else
+    #define cx_phmap_alloc_field_
+    #define cx_phmap_alloc_(m,n)\
+        cx_alloc_malloc(cx_phmap_allocator,n)
+    #define cx_phmap_free_(m,p,n)\
+        cx_alloc_free(cx_phmap_allocator,p,n)
+#endif
+
+//
+// Declarations
+//
+
+typedef struct cx_phmap_name_(_entry) {
+    cx_phmap_key key;
+    cx_phmap_val val;
+} cx_phmap_name_(_entry);
+
+typedef struct cx_phmap_name {
+    cx_phmap_alloc_field_
+    size_t      count_;                     // Number of entries
+    size_t      cap_;                       // Capacity of the entries array
+    size_t      nbuckets_;                  // Number of displacement buckets or 0 if not built
+    uint64_t    seed_;                      // Seed of the built hash function
+    cx_phmap_name_(_entry)* entries_;       // Entries array
+    uint32_t*   disps_;                     // Displacements of the buckets
+} cx_phmap_name;
+
+#ifdef cx_phmap_instance_allocator
+    cx_phmap_api_ cx_phmap_name cx_phmap_name_(_init)(const CxAllocator* alloc);
+#else
+    cx_phmap_api_ cx_phmap_name cx_phmap_name_(_init)(void);
+#endif
+cx_phmap_api_ void cx_phmap_name_(_free)(cx_phmap_name* m);
+cx_phmap_api_ void cx_phmap_name_(_add)(cx_phmap_name* m, cx_phmap_key k, cx_phmap_val v);
+cx_phmap_api_ bool cx_phmap_name_(_build)(cx_phmap_name* m);
+cx_phmap_api_ cx_phmap_val* cx_phmap_name_(_get)(const cx_phmap_name* m, cx_phmap_key k);
+cx_phmap_api_ size_t cx_phmap_name_(_count)(const cx_phmap_name* m);
+cx_phmap_api_ cx_phmap_name_(_entry)* cx_phmap_name_(_at)(const cx_phmap_name* m, size_t pos);
+#ifdef cx_phmap_freeze
+cx_phmap_api_ CxError cx_phmap_name_(_freeze)(const cx_phmap_name* m, const CxWriter* out);
+cx_phmap_api_ CxError cx_phmap_name_(_mapped_open)(const char* path, cx_phmap_name* m);
+cx_phmap_api_ void cx_phmap_name_(_mapped_close)(cx_phmap_name* m);
+#endif
+
+//
+// Implementation
+//
+#ifdef cx_phmap_implement
+
+    // Declaration of function to hash keys
+    uint64_t cx_hmap_hash_wy64(const void* buf, size_t len);
+
+    // Seeded hashes of a key: displacement bucket and position hash
+    typedef struct cx_phmap_name_(_khash_) {
+        uint32_t g;
+        uint64_t h;
+    } cx_phmap_name_(_khash_);
+
+    // Calculates the seeded hashes of the key with the specified hash
+    static inline cx_phmap_name_(_khash_) cx_phmap_name_(_khash_calc_)(uint64_t hash, uint64_t seed, size_t nbuckets) {
+
+        uint64_t h = (hash ^ seed) * 0xff51afd7ed558ccdull;
+        h ^= h >> 32;
+        return (cx_phmap_name_(_khash_)){.g = cx_phmap_range_(h >> 32, nbuckets), .h = h};
+    }
+
+    // Returns the position of the key with the specified position hash and bucket displacement
+    static inline size_t cx_phmap_name_(_pos_)(uint64_t h, uint32_t d, size_t n) {
+
+        const uint64_t x = (h ^ ((uint64_t)d * 0x9e3779b97f4a7c15ull)) * 0xc4ceb9fe1a85ec53ull;
+        return cx_phmap_range_(x >> 32, n);
+    }
+
+    // Searches the displacements of all the buckets for the specified seed.
+    // Sets 'pos' with the position of each key and returns 0 if found,
+    // 1 if the search failed for this seed or -1 if there are duplicated keys.
+    static int cx_phmap_name_(_search_)(cx_phmap_name* m, uint64_t seed, cx_phmap_name_(_khash_)* hashes,
+        uint32_t* start, uint32_t* keys, uint32_t* order, uint64_t* slots, uint32_t* pos) {
+
+        const size_t n = m->count_;
+        const size_t nb = m->nbuckets_;
+
+        // Calculates the key hashes and groups the keys by bucket (counting sort)
+        memset(start, 0, (nb + 1) * sizeof(*start));
+        size_t max_size = 0;
+        for (size_t i = 0; i < n; i++) {
+            hashes[i] = cx_phmap_name_(_khash_calc_)(cx_phmap_hash_(&m->entries_[i].key), seed, nb);
+            start[hashes[i].g + 1]++;
+        }
+        for (size_t b = 0; b < nb; b++) {
+            const size_t size = start[b + 1];
+            max_size = size > max_size ? size : max_size;
+            start[b + 1] += start[b];
+        }
+        for (size_t i = 0; i < n; i++) {
+            keys[start[hashes[i].g]++] = i;
+        }
+        for (size_t b = nb; b > 0; b--) {
+            start[b] = start[b - 1];
+        }
+        start[0] = 0;
+
+        // Keys in the same bucket with the same position hash always collide:
+        // they are duplicated or a new seed is necessary.
+        for (size_t b = 0; b < nb; b++) {
+            for (size_t i = start[b]; i < start[b + 1]; i++) {
+                for (size_t j = i + 1; j < start[b + 1]; j++) {
+                    if (hashes[keys[i]].h != hashes[keys[j]].h) {
+                        continue;
+                    }
+                    if (cx_phmap_cmp_key(&m->entries_[keys[i]].key, &m->entries_[keys[j]].key, sizeof(cx_phmap_key)) == 0) {
+                        return -1;
+                    }
+                    return 1;
+                }
+            }
+        }
+
+        // Orders the buckets by decreasing size (counting sort)
+        size_t norder = 0;
+        for (size_t size = max_size; size > 0; size--) {
+            for (size_t b = 0; b < nb; b++) {
+                if (start[b + 1] - start[b] == size) {
+                    order[norder++] = b;
+                }
+            }
+        }
+
+        // Searches the displacement of each bucket, from the largest.
+        // A slot is taken if UINT64_MAX or tried by the current displacement if equal to 'gen'.
+        // The last buckets have 1 key and few free slots, needing about n tries.
+        memset(slots, 0, n * sizeof(*slots));
+        memset(m->disps_, 0, nb * sizeof(*m->disps_));
+        uint64_t gen = 0;
+        const uint64_t max_d = 64 * (uint64_t)n + 1024 < UINT32_MAX ? 64 * (uint64_t)n + 1024 : UINT32_MAX;
+        for (size_t o = 0; o < norder; o++) {
+            const size_t b = order[o];
+            bool found = false;
+            uint64_t d;
+            for (d = 0; d < max_d && !found; d += !found) {
+                gen++;
+                found = true;
+                for (size_t i = start[b]; i < start[b + 1]; i++) {
+                    const size_t p = cx_phmap_name_(_pos_)(hashes[keys[i]].h, d, n);
+                    if (slots[p] == UINT64_MAX || slots[p] == gen) {
+                        found = false;
+                        break;
+                    }
+                    slots[p] = gen;
+                    pos[keys[i]] = p;
+                }
+            }
+            if (!found) {
+                return 1;
+            }
+            for (size_t i = start[b]; i < start[b + 1]; i++) {
+                slots[pos[keys[i]]] = UINT64_MAX;
+            }
+            m->disps_[b] = d;
+        }
+        return 0;
+    }
+
+#ifdef cx_phmap_instance_allocator
+
+    cx_phmap_api_ cx_phmap_name cx_phmap_name_(_init)(const CxAllocator* alloc) {
+        return (cx_phmap_name){
+            .alloc_ = alloc == NULL ? cx_def_allocator() : alloc,
+        };
+    }
+
+#else
+
+    cx_phmap_api_ cx_phmap_name cx_phmap_name_(_init)(void) {
+        return (cx_phmap_name){0};
+    }
+
+#endif
+
+cx_phmap_api_ void cx_phmap_name_(_free)(cx_phmap_name* m) {
+
+    assert(m);
+#if defined(cx_phmap_free_key) || defined(cx_phmap_free_val)
+    for (size_t i = 0; i < m->count_; i++) {
+        cx_phmap_free_key_(&m->entries_[i].key);
+        cx_phmap_free_val_(&m->entries_[i].val);
+    }
+#endif
+    cx_phmap_free_(m, m->entries_, m->cap_ * sizeof(*m->entries_));
+    cx_phmap_free_(m, m->disps_, m->nbuckets_ * sizeof(*m->disps_));
+    m->entries_ = NULL;
+    m->disps_ = NULL;
+    m->count_ = 0;
+    m->cap_ = 0;
+    m->nbuckets_ = 0;
+}
+
+cx_phmap_api_ void cx_phmap_name_(_add)(cx_phmap_name* m, cx_phmap_key k, cx_phmap_val v) {
+
+    assert(m);
+    // The map must be built again
+    if (m->nbuckets_) {
+        cx_phmap_free_(m, m->disps_, m->nbuckets_ * sizeof(*m->disps_));
+        m->disps_ = NULL;
+        m->nbuckets_ = 0;
+    }
+    if (m->count_ == m->cap_) {
+        const size_t cap = m->cap_ == 0 ? 16 : m->cap_ * 2;
+        cx_phmap_name_(_entry)* entries = cx_phmap_alloc_(m, cap * sizeof(*entries));
+        if (m->count_) {
+            memcpy(entries, m->entries_, m->count_ * sizeof(*entries));
+        }
+        cx_phmap_free_(m, m->entries_, m->cap_ * sizeof(*entries));
+        m->entries_ = entries;
+        m->cap_ = cap;
+    }
+    m->entries_[m->count_++] = (cx_phmap_name_(_entry)){.key = k, .val = v};
+}
+
+cx_phmap_api_ bool cx_phmap_name_(_build)(cx_phmap_name* m) {
+
+    assert(m);
+    assert(m->count_ <= UINT32_MAX);
+    if (m->nbuckets_) {
+        cx_phmap_free_(m, m->disps_, m->nbuckets_ * sizeof(*m->disps_));
+        m->disps_ = NULL;
+        m->nbuckets_ = 0;
+    }
+    const size_t n = m->count_;
+    if (n == 0) {
+        return true;
+    }
+    m->nbuckets_ = (n + cx_phmap_lambda - 1) / cx_phmap_lambda;
+    m->disps_ = cx_phmap_alloc_(m, m->nbuckets_ * sizeof(*m->disps_));
+
+    // Temporary arrays used by the search
+    const size_t nb = m->nbuckets_;
+    cx_phmap_name_(_khash_)* hashes = cx_phmap_alloc_(m, n * sizeof(*hashes));
+    uint32_t* start = cx_phmap_alloc_(m, (nb + 1) * sizeof(*start));
+    uint32_t* keys = cx_phmap_alloc_(m, n * sizeof(*keys));
+    uint32_t* order = cx_phmap_alloc_(m, nb * sizeof(*order));
+    uint64_t* slots = cx_phmap_alloc_(m, n * sizeof(*slots));
+    uint32_t* pos = cx_phmap_alloc_(m, n * sizeof(*pos));
+
+    int res = 1;
+    for (size_t s = 0; s < cx_phmap_max_seeds_ && res > 0; s++) {
+        m->seed_ = cx_hmap_mix64_(s + 1);
+        res = cx_phmap_name_(_search_)(m, m->seed_, hashes, start, keys, order, slots, pos);
+    }
+
+    // Moves the entries to their positions
+    if (res == 0) {
+        cx_phmap_name_(_entry)* entries = cx_phmap_alloc_(m, n * sizeof(*entries));
+        for (size_t i = 0; i < n; i++) {
+            entries[pos[i]] = m->entries_[i];
+        }
+        cx_phmap_free_(m, m->entries_, m->cap_ * sizeof(*entries));
+        m->entries_ = entries;
+        m->cap_ = n;
+    } else {
+        cx_phmap_free_(m, m->disps_, nb * sizeof(*m->disps_));
+        m->disps_ = NULL;
+        m->nbuckets_ = 0;
+    }
+    cx_phmap_free_(m, hashes, n * sizeof(*hashes));
+    cx_phmap_free_(m, start, (nb + 1) * sizeof(*start));
+    cx_phmap_free_(m, keys, n * sizeof(*keys));
+    cx_phmap_free_(m, order, nb * sizeof(*order));
+    cx_phmap_free_(m, slots, n * sizeof(*slots));
+    cx_phmap_free_(m, pos, n * sizeof(*pos));
+    return res == 0;
+}
+
+cx_phmap_api_ cx_phmap_val* cx_phmap_name_(_get)(const cx_phmap_name* m, cx_phmap_key k) {
+
+    assert(m);
+    if (m->nbuckets_ == 0) {
+        return NULL;
+    }
+    const cx_phmap_name_(_khash_) h = cx_phmap_name_(_khash_calc_)(cx_phmap_hash_(&k), m->seed_, m->nbuckets_);
+    cx_phmap_name_(_entry)* e = m->entries_ + cx_phmap_name_(_pos_)(h.h, m->disps_[h.g], m->count_);
+    if (cx_phmap_cmp_key(&e->key, &k, sizeof(cx_phmap_key)) == 0) {
+        return &e->val;
+    }
+    return NULL;
+}
+
+cx_phmap_api_ size_t cx_phmap_name_(_count)(const cx_phmap_name* m) {
+
+    assert(m);
+    return m->count_;
+}
+
+cx_phmap_api_ cx_phmap_name_(_entry)* cx_phmap_name_(_at)(const cx_phmap_name* m, size_t pos) {
+
+    assert(m);
+    if (pos >= m->count_) {
+        return NULL;
+    }
+    return m->entries_ + pos;
+}
+
+#ifdef cx_phmap_freeze
+
+#ifndef CX_PHMAP_FROZEN_HDR_
+#define CX_PHMAP_FROZEN_HDR_
+
+    // Header of frozen map file
+    typedef struct CxPhmapFrozenHdr {
+        char        magic[8];       // "CXPHMAP"
+        uint32_t    version;        // Layout version
+        uint32_t    lambda;         // Average number of keys per bucket (informative)
+        uint64_t    key_size;       // Size of the key type
+        uint64_t    val_size;       // Size of the value type
+        uint64_t    entry_size;     // Size of the entry type
+        uint64_t    count;          // Number of entries
+        uint64_t    nbuckets;       // Number of displacement buckets
+        uint64_t    seed;           // Seed of the hash function
+    } CxPhmapFrozenHdr;
+
+    #define CX_PHMAP_FROZEN_MAGIC       "CXPHMAP"
+    #define CX_PHMAP_FROZEN_VERSION     (1)
+    #define CX_PHMAP_FROZEN_ALIGN       (64)
+
+    // Offsets of the displacement and entries arrays in the file
+    #define cx_phmap_frozen_align_(n)           (((n) + CX_PHMAP_FROZEN_ALIGN - 1) & ~(size_t)(CX_PHMAP_FROZEN_ALIGN - 1))
+    #define cx_phmap_frozen_disps_off_          cx_phmap_frozen_align_(sizeof(CxPhmapFrozenHdr))
+    #define cx_phmap_frozen_entries_off_(nb)    cx_phmap_frozen_align_(cx_phmap_frozen_disps_off_ + (nb) * sizeof(uint32_t))
+
+#endif
+
+    // Writes 'len' bytes of zeros
+    static CxError cx_phmap_name_(_write_zeros_)(const CxWriter* out, size_t len) {
+
+        static const uint8_t zeros[CX_PHMAP_FROZEN_ALIGN];
+        assert(len <= sizeof(zeros));
+        if (len && cx_writer_write(out, zeros, len) < (int)len) {
+            return CXERR("Error writing map");
+        }
+        return CXOK();
+    }
+
+cx_phmap_api_ CxError cx_phmap_name_(_freeze)(const cx_phmap_name* m, const CxWriter* out) {
+
+    assert(m);
+    if (m->count_ && m->nbuckets_ == 0) {
+        return CXERR("Map not built");
+    }
+    const CxPhmapFrozenHdr hdr = {
+        .magic = CX_PHMAP_FROZEN_MAGIC,
+        .version = CX_PHMAP_FROZEN_VERSION,
+        .lambda = cx_phmap_lambda,
+        .key_size = sizeof(cx_phmap_key),
+        .val_size = sizeof(cx_phmap_val),
+        .entry_size = sizeof(cx_phmap_name_(_entry)),
+        .count = m->count_,
+        .nbuckets = m->nbuckets_,
+        .seed = m->seed_,
+    };
+    if (cx_writer_write(out, &hdr, sizeof(hdr)) < (int)sizeof(hdr)) {
+        return CXERR("Error writing map header");
+    }
+    CXERR_RET(cx_phmap_name_(_write_zeros_)(out, cx_phmap_frozen_disps_off_ - sizeof(hdr)));
+
+    // Writes the displacements and the entries in chunks
+    const size_t chunk = 1u << 20;
+    const uint8_t* data = (const uint8_t*)m->disps_;
+    const size_t dlen = m->nbuckets_ * sizeof(*m->disps_);
+    for (size_t off = 0; off < dlen; off += chunk) {
+        const size_t len = dlen - off < chunk ? dlen - off : chunk;
+        if (cx_writer_write(out, data + off, len) < (int)len) {
+            return CXERR("Error writing map displacements");
+        }
+    }
+    CXERR_RET(cx_phmap_name_(_write_zeros_)(out,
+        cx_phmap_frozen_entries_off_(m->nbuckets_) - (cx_phmap_frozen_disps_off_ + dlen)));
+
+    // Copies only the fields of the entries, so the file does not depend on struct padding
+    cx_phmap_name_(_entry) buf[64];
+    for (size_t i = 0; i < m->count_; i += 64) {
+        const size_t count = m->count_ - i < 64 ? m->count_ - i : 64;
+        memset(buf, 0, count * sizeof(buf[0]));
+        for (size_t j = 0; j < count; j++) {
+            memcpy(&buf[j].key, &m->entries_[i + j].key, sizeof(buf[j].key));
+            memcpy(&buf[j].val, &m->entries_[i + j].val, sizeof(buf[j].val));
+        }
+        const size_t len = count * sizeof(buf[0]);
+        if (cx_writer_write(out, buf, len) < (int)len) {
+            return CXERR("Error writing map entries");
+        }
+    }
+    return CXOK();
+}
+
+cx_phmap_api_ CxError cx_phmap_name_(_mapped_open)(const char* path, cx_phmap_name* m) {
+
+    assert(m);
+    const int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return CXERR("Error opening file");
+    }
+    struct stat st;
+    if (fstat(fd, &st) < 0) {
+        close(fd);
+        return CXERR("Error getting file size");
+    }
+    if ((size_t)st.st_size < sizeof(CxPhmapFrozenHdr)) {
+        close(fd);
+        return CXERR("Invalid map file");
+    }
+    uint8_t* addr = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (addr == MAP_FAILED) {
+        return CXERR("Error mapping file");
+    }
+
+    // Checks if the file layout is the same as of this map type
+    const CxPhmapFrozenHdr* hdr = (const CxPhmapFrozenHdr*)addr;
+    CxError err = CXOK();
+    if (memcmp(hdr->magic, CX_PHMAP_FROZEN_MAGIC, sizeof(hdr->magic)) != 0 ||
+        hdr->version != CX_PHMAP_FROZEN_VERSION) {
+        err = CXERR("Invalid map file");
+    } else if (hdr->key_size != sizeof(cx_phmap_key) ||
+        hdr->val_size != sizeof(cx_phmap_val) ||
+        hdr->entry_size != sizeof(cx_phmap_name_(_entry))) {
+        err = CXERR("Map file type is not compatible");
+    } else if (hdr->count > UINT32_MAX || hdr->nbuckets > hdr->count ||
+        (hdr->count && hdr->nbuckets == 0) ||
+        (size_t)st.st_size != cx_phmap_frozen_entries_off_(hdr->nbuckets) + hdr->count * sizeof(cx_phmap_name_(_entry))) {
+        err = CXERR("Invalid map file size");
+    }
+    if (err.msg) {
+        munmap(addr, st.st_size);
+        return err;
+    }
+
+    *m = (cx_phmap_name){
+#ifdef cx_phmap_instance_allocator
+        .alloc_ = cx_def_allocator(),
+#endif
+        .count_ = hdr->count,
+        .nbuckets_ = hdr->nbuckets,
+        .seed_ = hdr->seed,
+        .disps_ = (uint32_t*)(addr + cx_phmap_frozen_disps_off_),
+        .entries_ = (cx_phmap_name_(_entry)*)(addr + cx_phmap_frozen_entries_off_(hdr->nbuckets)),
+    };
+    return CXOK();
+}
+
+cx_phmap_api_ void cx_phmap_name_(_mapped_close)(cx_phmap_name* m) {
+
+    assert(m);
+    if (m->disps_ == NULL) {
+        return;
+    }
+    uint8_t* addr = (uint8_t*)m->disps_ - cx_phmap_frozen_disps_off_;
+    munmap(addr, cx_phmap_frozen_entries_off_(m->nbuckets_) + m->count_ * sizeof(cx_phmap_name_(_entry)));
+    *m = (cx_phmap_name){0};
+}
+
+#endif // cx_phmap_freeze
+#endif // cx_phmap_implement
+
+// Undefine config  macros
+#undef cx_phmap_name
+#undef cx_phmap_key
+#undef cx_phmap_val
+#undef cx_phmap_lambda
+#undef cx_phmap_cmp_key
+#undef cx_phmap_hash_key
+#undef cx_phmap_free_key
+#undef cx_phmap_free_val
+#undef cx_phmap_allocator
+#undef cx_phmap_instance_allocator
+#undef cx_phmap_freeze
+#undef cx_phmap_static
+#undef cx_phmap_inline
+#undef cx_phmap_implement
+
+// Undefine internal macros
+#undef cx_phmap_hash_
+#undef cx_phmap_free_key_
+#undef cx_phmap_free_val_
+#undef cx_phmap_max_seeds_
+#undef cx_phmap_range_
+#undef cx_phmap_concat2_
+#undef cx_phmap_concat1_
+#undef cx_phmap_name_
+#undef cx_phmap_api_
+#undef cx_phmap_alloc_field_
+#undef cx_phmap_alloc_
+#undef cx_phmap_free_
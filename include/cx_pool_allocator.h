@@ -1,6 +1,7 @@
 #ifndef CX_ALLOC_POOL_H
 #define CX_ALLOC_POOL_H
 #include <stddef.h>
+#include <stdbool.h>
 #include "cx_alloc.h"
 
 // Pool allocator opaque type
@@ -12,8 +13,30 @@ typedef struct CxPoolAllocatorStats {
     size_t nbytes;      // Total number of requested bytes
     size_t usedBlocks;  // Number of allocated used blocks
     size_t freeBlocks;  // Number of allocated blocks in free list
+    size_t usedBytes;   // Total size of the used blocks
+    size_t freeBytes;   // Total size of the blocks in free list
+    size_t wastedBytes; // Bytes of the used blocks lost in alignment padding and left unused at their ends
 } CxPoolAllocatorStats;
 
+// Pool allocator checkpoint returned by cx_pool_allocator_mark()
+typedef struct CxPoolAllocatorMark {
+    void*   block_;
+    void*   prev_;
+    size_t  used_;
+    size_t  nallocs_;
+    size_t  nbytes_;
+    size_t  usedBlocks_;
+    size_t  usedBytes_;
+    size_t  wastedBytes_;
+} CxPoolAllocatorMark;
+
+// Scope of temporary allocations from the scratch allocator of a thread
+typedef struct CxPoolScratch {
+    CxPoolAllocator*    pool;   // Scratch pool allocator of the thread
+    const CxAllocator*  alloc;  // Interface of the scratch pool allocator
+    CxPoolAllocatorMark mark;   // Checkpoint at the beginning of the scope
+} CxPoolScratch;
+
 // Creates an block allocator using the specified minimum blocksize and
 // using the specified memory allocator. If NULL is passed as the allocator,
 // the default global allocator (malloc/free) will be used.
@@ -21,6 +44,15 @@ typedef struct CxPoolAllocatorStats {
 // as required.
 CxPoolAllocator* cx_pool_allocator_create(size_t blockSize, const CxAllocator* ca);
 
+// Enables thread caches when chunkSize is not zero, or disables them.
+// In this mode each thread allocating from the pool takes chunks of chunkSize bytes
+// from the shared blocks and allocates from its chunk without locking.
+// Allocations greater than chunkSize/4 always use the shared blocks.
+// The memory of the thread chunks is reclaimed by cx_pool_allocator_clear() and
+// cx_pool_allocator_free(), which must not be called concurrently with allocations.
+// Must be called before the allocator is shared between threads.
+void cx_pool_allocator_set_thread_cache(CxPoolAllocator* a, size_t chunkSize);
+
 // Destroy a previously created block allocator freeing all allocated memory.
 void cx_pool_allocator_destroy(CxPoolAllocator* a);
 
@@ -31,11 +63,40 @@ void* cx_pool_allocator_alloc(CxPoolAllocator* a, size_t size);
 void* cx_pool_allocator_alloc2(CxPoolAllocator* a, size_t size, size_t align);
 
 // Reallocates new area and copy old area to new area.
+// The last allocated area is grown or shrunk in place if possible.
 void* cx_pool_allocator_realloc(CxPoolAllocator* a, void* old_ptr, size_t old_size, size_t size);
 
-// Clears the allocator keeping the memory allocated from parent allocator
+// Grows or shrinks in place the last area allocated from the current block
+// (or from the current chunk of the calling thread if thread caches are enabled).
+// Returns false, without changing the area, if it is not the last allocated area
+// or if there is no room in the block for the new size.
+bool cx_pool_allocator_resize(CxPoolAllocator* a, void* ptr, size_t old_size, size_t size);
+
+// Clears the allocator keeping the memory allocated from parent allocator.
+// The released blocks are reused for new allocations by size, and blocks
+// 4 or more times larger than a requested block size are kept for larger requests.
 void cx_pool_allocator_clear(CxPoolAllocator* a);
 
+// Returns a checkpoint of the current allocation state.
+// If thread caches are enabled, releases the current chunks of all the threads,
+// so it must not be called concurrently with allocations.
+CxPoolAllocatorMark cx_pool_allocator_mark(CxPoolAllocator* a);
+
+// Releases all the memory allocated after the checkpoint, keeping the memory allocated
+// from parent allocator for reuse. The memory allocated before the checkpoint remains valid.
+// Checkpoints taken after this one become invalid, but this one remains valid
+// and can be rewound again. Clear and free invalidate all checkpoints.
+// Must not be called concurrently with allocations.
+void cx_pool_allocator_rewind(CxPoolAllocator* a, CxPoolAllocatorMark mark);
+
+// Begins a scope of temporary allocations using the scratch pool allocator of the calling thread,
+// which is created on first use and destroyed when the thread exits.
+// Scopes can be nested and must be ended in reverse order.
+CxPoolScratch cx_pool_allocator_scratch_begin(void);
+
+// Ends the scope releasing all the memory allocated from the scratch allocator since its beginning
+void cx_pool_allocator_scratch_end(CxPoolScratch* s);
+
 // Free all allocated memory from upstream allocator.
 // This allocator can continue to be used
 void cx_pool_allocator_free(CxPoolAllocator* a);
@@ -0,0 +1,811 @@
+/*
+Read Mostly Hashmap Implementation
+----------------------------------
+- Optimized for maps which are read very frequently and updated rarely.
+- Readers never lock: they atomically load the current version of the table,
+  which is immutable after being published.
+- Writers are serialized by a mutex. Each update copies the current table,
+  modifies the copy and atomically publishes it as the new version.
+  Batch updates build a single new version for several keys.
+- Each version uses the same flat layout of cx_hmap2.h (array of entries and
+  array of bucket status with linear probing) in a single allocation.
+  As versions are never modified after published, deleted entries are removed
+  by shifting back the following entries instead of leaving tombstones.
+- Replaced versions are reclaimed by the writers using epochs: each reader
+  registers a slot which stores the epoch observed when it started reading,
+  and a version is freed only after all readers active when it was replaced
+  have finished reading.
+
+Example
+-------
+
+// Read mostly map for int -> double
+#define cx_rmap_name   rmap
+#define cx_rmap_key    int
+#define cx_rmap_val    double
+#define cx_rmap_static
+#define cx_rmap_implement
+#include "cx_rmap.h"
+
+int main() {
+
+    rmap m = rmap_init(0);
+    // Writer
+    rmap_set(&m, 1, 2.0);
+
+    // Reader (each reader thread registers its own reader)
+    rmap_reader* r = rmap_reader_add(&m);
+    rmap_read_begin(r);
+    double const* pval = rmap_get(r, 1);
+    if (pval) {
+        printf("val:%f\n", *pval);
+    }
+    rmap_read_end(r);
+    rmap_reader_del(r);
+
+    rmap_free(&m);
+    return 0;
+}
+
+Configuration
+-------------
+
+Define the name of the map type (mandatory):
+    #define cx_rmap_name <name>
+
+Define the type of the map key (mandatory):
+    #define cx_rmap_key <type>
+
+Define the type of the map value (mandatory):
+    #define cx_rmap_val <type>
+
+Define the maximum number of concurrent registered readers (default = 64).
+    #define cx_rmap_max_readers <n>
+
+Define the key comparison function:
+int (*cmp)(const void* k1, const void* k2, size_t size);
+The default comparison function is a single integer comparison
+for keys with size of 1, 2, 4 or 8 bytes and memcmp() otherwise.
+    #define cx_rmap_cmp_key(pk1,pk2,s) <cmp_func>
+
+Define the key hash function:
+size_t (*hash)(const void* key, size_t size);
+The default hash function is a multiplicative mixer for keys with size of
+1, 2, 4 or 8 bytes and cx_hmap_hash_wy64() otherwise.
+    #define cx_rmap_hash_key(pk,s) <hash_func>
+
+Define function to free the key of replaced or deleted entries:
+void (*free)(void* key);
+The key is only freed after the version which contains it is reclaimed.
+By default no function is defined.
+    #define cx_rmap_free_key(pk) <free_func>
+
+Define function to free the value of replaced or deleted entries:
+void (*free)(void* val);
+The value is only freed after the version which contains it is reclaimed.
+By default no function is defined.
+    #define cx_rmap_free_val <free_func>
+
+Define optional custom allocator pointer or function call which return pointer to allocator.
+Uses default allocator if not defined.
+This allocator will be used for all instances of this type.
+    #define cx_rmap_allocator <allocator>
+
+Sets if map uses custom allocator per instance.
+If set, it is necessary to initialize each map with the desired allocator.
+    #define cx_rmap_instance_allocator
+
+Sets if all map functions are prefixed with 'static'
+    #define cx_rmap_static
+
+Sets if all map functions are prefixed with 'inline'
+    #define cx_rmap_inline
+
+Sets to implement functions in this translation unit:
+    #define cx_rmap_implement
+
+
+API
+---
+
+Assuming:
+#define cx_rmap_name rmap       // Map type name
+#define cx_rmap_key  ktype      // Type of key
+#define cx_rmap_val  vtype      // Type of value
+
+Initialize map defined with custom allocator.
+If the specified number of bucket is 0, the default will be used.
+    rmap rmap_init(const CxAllocator* alloc, size_t nbuckets);
+
+Initialize map NOT defined with custom allocator
+    rmap rmap_init(size_t nbuckets);
+
+Free map allocated memory including all the pending versions.
+Must not be called concurrently with other operations and all readers must be deleted.
+    void rmap_free(rmap* m);
+
+Registers a reader for the calling thread.
+Returns NULL if the maximum number of readers was reached.
+    rmap_reader* rmap_reader_add(rmap* m);
+
+Unregisters reader
+    void rmap_reader_del(rmap_reader* r);
+
+Starts reading: loads the current version of the map.
+While reading, the reader sees the same version and its entries are not freed.
+    void rmap_read_begin(rmap_reader* r);
+
+Finishes reading
+    void rmap_read_end(rmap_reader* r);
+
+Returns pointer to the value associated with the specified key in the
+version loaded by the reader or NULL if not found.
+Must be called between rmap_read_begin() and rmap_read_end()
+and the returned pointer is only valid before rmap_read_end().
+    vtype const* rmap_get(rmap_reader* r, ktype k);
+
+Copies the value associated with the specified key in the current version to 'val'.
+Must be called outside of rmap_read_begin() and rmap_read_end().
+Returns true if found or false otherwise.
+    bool rmap_get_copy(rmap_reader* r, ktype k, vtype* val);
+
+Returns the number of entries in the current version of the map.
+Can be called at any time, concurrently with readers and writers.
+    size_t rmap_count(rmap* m);
+
+Publishes new version with the specified key and value inserted or updated.
+    void rmap_set(rmap* m, ktype k, vtype v);
+
+Publishes new version with the specified keys and values inserted or updated.
+    void rmap_set_batch(rmap* m, ktype const* keys, vtype const* vals, size_t n);
+
+Publishes new version without the entry with the specified key.
+Returns true if found or false otherwise.
+    bool rmap_del(rmap* m, ktype k);
+
+Publishes new version without the entries with the specified keys.
+Returns the number of keys deleted.
+    size_t rmap_del_batch(rmap* m, ktype const* keys, size_t n);
+
+Publishes new empty version
+    void rmap_clear(rmap* m);
+
+Frees the replaced versions not used anymore by readers.
+Writers call this function after publishing a new version.
+Returns the number of replaced versions not freed yet.
+    size_t rmap_reclaim(rmap* m);
+
+*/
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include "cx_alloc.h"
+#include "cx_hmap_util.h"
+
+#ifndef cx_rmap_name
+    #error "cx_rmap_name not defined"
+#endif
+#ifndef cx_rmap_key
+    #error "cx_rmap_key not defined"
+#endif
+#ifndef cx_rmap_val
+    #error "cx_rmap_val not defined"
+#endif
+
+#ifndef cx_rmap_max_readers
+    #define cx_rmap_max_readers (64)
+#endif
+
+#ifndef cx_rmap_def_nbuckets
+    #define cx_rmap_def_nbuckets (16)
+#endif
+
+#ifndef cx_rmap_resize_load
+    #define cx_rmap_resize_load (0.8)
+#endif
+
+// Default key comparison function
+#ifndef cx_rmap_cmp_key
+    #define cx_rmap_cmp_key(pk1,pk2,s)\
+        (cx_hmap_int_key_(s) ? cx_hmap_cmp_int_(pk1,pk2,s) : memcmp(pk1,pk2,s))
+#endif
+
+// Default key hash function
+#ifndef cx_rmap_hash_key
+    #define cx_rmap_hash_key(pk,s)\
+        (cx_hmap_int_key_(s) ? cx_hmap_hash_int_(pk,s) : cx_hmap_hash_wy64(pk,s))
+#endif
+
+// Hash of the key pointed by 'pk'
+#define cx_rmap_hash_(pk) cx_rmap_hash_key((char*)(pk), sizeof(cx_rmap_key))
+
+// Replaced and deleted entries are only kept if they need to be freed
+#if defined(cx_rmap_free_key) || defined(cx_rmap_free_val)
+    #define cx_rmap_garbage_(m,e) cx_rmap_name_(_add_garbage_)(m,e)
+#else
+    #define cx_rmap_garbage_(m,e)
+#endif
+
+// Default free key function
+#ifndef cx_rmap_free_key
+    #define cx_rmap_free_key_(key)
+#else
+    #define cx_rmap_free_key_(key) cx_rmap_free_key(key)
+#endif
+
+// Default free value function
+#ifndef cx_rmap_free_val
+    #define cx_rmap_free_val_(val)
+#else
+    #define cx_rmap_free_val_(val) cx_rmap_free_val(val)
+#endif
+
+// Auxiliary internal macros
+#define cx_rmap_concat2_(a, b) a ## b
+#define cx_rmap_concat1_(a, b) cx_rmap_concat2_(a, b)
+#define cx_rmap_name_(name) cx_rmap_concat1_(cx_rmap_name, name)
+
+// API attributes
+#if defined(cx_rmap_static) && defined(cx_rmap_inline)
+    #define cx_rmap_api_ static inline
+#elif defined(cx_rmap_static)
+    #define cx_rmap_api_ static
+#elif defined(cx_rmap_inline)
+    #define cx_rmap_api_ inline
+#else
+    #define cx_rmap_api_
+#endif
+
+// Default allocator
+#ifndef cx_rmap_allocator
+    #define cx_rmap_allocator cx_def_allocator()
+#endif
+
+// Use custom instance allocator
+#ifdef cx_rmap_instance_allocator
+    #define cx_rmap_alloc_field_\
+        const CxAllocator* alloc_;
+    #define cx_rmap_alloc_(m,n)\
+        cx_alloc_malloc((m)->alloc_, n)
+    #define cx_rmap_free_(m,p,n)\
+        cx_alloc_free((m)->alloc_, p, n)
+// Use global type allocator
+#else
+    #define cx_rmap_alloc_field_
+    #define cx_rmap_alloc_(m,n)\
+        cx_alloc_malloc(cx_rmap_allocator,n)
+    #define cx_rmap_free_(m,p,n)\
+        cx_alloc_free(cx_rmap_allocator,p,n)
+#endif
+
+//
+// Declarations
+//
+
+typedef struct cx_rmap_name_(_entry) {
+    cx_rmap_key key;
+    cx_rmap_val val;
+} cx_rmap_name_(_entry);
+
+// Immutable version of the map in a single allocation:
+// the array of entries is followed by the array of bucket status.
+typedef struct cx_rmap_name_(_table_) {
+    size_t      nbuckets_;
+    size_t      count_;
+    uint8_t*    status_;
+    cx_rmap_name_(_entry) buckets_[];
+} cx_rmap_name_(_table_);
+
+// Replaced version waiting for the readers to finish
+typedef struct cx_rmap_name_(_retired_) {
+    struct cx_rmap_name_(_retired_)* next_;
+    uint64_t    epoch_;             // Epoch when the version was replaced
+    cx_rmap_name_(_table_)* table_; // Replaced version
+    size_t      ngarbage_;          // Number of replaced entries to free
+    cx_rmap_name_(_entry) garbage_[];
+} cx_rmap_name_(_retired_);
+
+// Reader slot aligned to cache line to avoid false sharing between readers
+typedef struct cx_rmap_name_(_reader) {
+    atomic_bool     used_;          // Slot is used by a reader
+    atomic_uint_least64_t epoch_;   // Epoch when the reader started reading or 0
+    cx_rmap_name_(_table_)* table_; // Version loaded by the reader
+    struct cx_rmap_name* map_;
+} __attribute__((aligned(64))) cx_rmap_name_(_reader);
+
+typedef struct cx_rmap_name {
+    cx_rmap_alloc_field_
+    _Atomic(cx_rmap_name_(_table_)*) table_;   // Current version
+    atomic_uint_least64_t epoch_;               // Current epoch (> 0)
+    atomic_size_t       count_;                 // Number of entries of the current version
+    void*               mem_;                   // Allocated memory for the readers
+    cx_rmap_name_(_reader)* readers_;           // Array of readers aligned to cache line
+    pthread_mutex_t     lock_;                  // Writers lock
+    size_t              nbuckets_;              // Initial number of buckets
+    cx_rmap_name_(_retired_)* retired_;         // List of replaced versions
+    cx_rmap_name_(_entry)* garbage_;            // Replaced entries of the version being built
+    size_t              ngarbage_;
+    size_t              capgarbage_;
+} cx_rmap_name;
+
+#ifdef cx_rmap_instance_allocator
+    cx_rmap_api_ cx_rmap_name cx_rmap_name_(_init)(const CxAllocator* alloc, size_t nbuckets);
+#else
+    cx_rmap_api_ cx_rmap_name cx_rmap_name_(_init)(size_t nbuckets);
+#endif
+cx_rmap_api_ void cx_rmap_name_(_free)(cx_rmap_name* m);
+cx_rmap_api_ cx_rmap_name_(_reader)* cx_rmap_name_(_reader_add)(cx_rmap_name* m);
+cx_rmap_api_ void cx_rmap_name_(_reader_del)(cx_rmap_name_(_reader)* r);
+cx_rmap_api_ void cx_rmap_name_(_read_begin)(cx_rmap_name_(_reader)* r);
+cx_rmap_api_ void cx_rmap_name_(_read_end)(cx_rmap_name_(_reader)* r);
+cx_rmap_api_ cx_rmap_val const* cx_rmap_name_(_get)(cx_rmap_name_(_reader)* r, cx_rmap_key k);
+cx_rmap_api_ bool cx_rmap_name_(_get_copy)(cx_rmap_name_(_reader)* r, cx_rmap_key k, cx_rmap_val* val);
+cx_rmap_api_ size_t cx_rmap_name_(_count)(cx_rmap_name* m);
+cx_rmap_api_ void cx_rmap_name_(_set)(cx_rmap_name* m, cx_rmap_key k, cx_rmap_val v);
+cx_rmap_api_ void cx_rmap_name_(_set_batch)(cx_rmap_name* m, cx_rmap_key const* keys, cx_rmap_val const* vals, size_t n);
+cx_rmap_api_ bool cx_rmap_name_(_del)(cx_rmap_name* m, cx_rmap_key k);
+cx_rmap_api_ size_t cx_rmap_name_(_del_batch)(cx_rmap_name* m, cx_rmap_key const* keys, size_t n);
+cx_rmap_api_ void cx_rmap_name_(_clear)(cx_rmap_name* m);
+cx_rmap_api_ size_t cx_rmap_name_(_reclaim)(cx_rmap_name* m);
+
+//
+// Implementation
+//
+#ifdef cx_rmap_implement
+
+    #define cx_rmap_empty_  (0)
+    #define cx_rmap_full_   (1)
+
+    // Declaration of function to hash keys
+    uint64_t cx_hmap_hash_wy64(const void* buf, size_t len);
+
+    // Returns the allocation size of a version with the specified number of buckets
+    static inline size_t cx_rmap_name_(_table_size_)(size_t nbuckets) {
+
+        return sizeof(cx_rmap_name_(_table_)) + nbuckets * (sizeof(cx_rmap_name_(_entry)) + 1);
+    }
+
+    // Allocates empty version
+    static cx_rmap_name_(_table_)* cx_rmap_name_(_table_alloc_)(cx_rmap_name* m, size_t nbuckets) {
+
+        cx_rmap_name_(_table_)* t = cx_rmap_alloc_(m, cx_rmap_name_(_table_size_)(nbuckets));
+        t->nbuckets_ = nbuckets;
+        t->count_ = 0;
+        t->status_ = (uint8_t*)(t->buckets_ + nbuckets);
+        memset(t->status_, cx_rmap_empty_, nbuckets);
+        return t;
+    }
+
+    static void cx_rmap_name_(_table_free_)(cx_rmap_name* m, cx_rmap_name_(_table_)* t) {
+
+        cx_rmap_free_(m, t, cx_rmap_name_(_table_size_)(t->nbuckets_));
+    }
+
+    // Returns the bucket index of the specified key or the index
+    // of the empty bucket where it should be inserted.
+    static inline size_t cx_rmap_name_(_table_find_)(const cx_rmap_name_(_table_)* t, cx_rmap_key const* key, size_t hash) {
+
+        size_t idx = cx_hmap_fib_index_(hash, t->nbuckets_);
+        while (t->status_[idx] == cx_rmap_full_) {
+            if (cx_rmap_cmp_key(&t->buckets_[idx].key, key, sizeof(cx_rmap_key)) == 0) {
+                break;
+            }
+            idx = (idx + 1) & (t->nbuckets_ - 1);
+        }
+        return idx;
+    }
+
+    // Copies the specified version with enough buckets for 'count' entries.
+    // The copy is private to the writer until published.
+    static cx_rmap_name_(_table_)* cx_rmap_name_(_table_copy_)(cx_rmap_name* m, const cx_rmap_name_(_table_)* t, size_t count) {
+
+        size_t nbuckets = t->nbuckets_;
+        while (count + 1 >= (float)nbuckets * cx_rmap_resize_load) {
+            nbuckets *= 2;
+        }
+        if (nbuckets == t->nbuckets_) {
+            cx_rmap_name_(_table_)* copy = cx_rmap_alloc_(m, cx_rmap_name_(_table_size_)(nbuckets));
+            memcpy(copy, t, cx_rmap_name_(_table_size_)(nbuckets));
+            copy->status_ = (uint8_t*)(copy->buckets_ + nbuckets);
+            return copy;
+        }
+
+        // Reinserts all the entries in the larger version
+        cx_rmap_name_(_table_)* copy = cx_rmap_name_(_table_alloc_)(m, nbuckets);
+        for (size_t i = 0; i < t->nbuckets_; i++) {
+            if (t->status_[i] != cx_rmap_full_) {
+                continue;
+            }
+            cx_rmap_name_(_entry) const* e = t->buckets_ + i;
+            size_t idx = cx_hmap_fib_index_(cx_rmap_hash_(&e->key), nbuckets);
+            while (copy->status_[idx] != cx_rmap_empty_) {
+                idx = (idx + 1) & (nbuckets - 1);
+            }
+            copy->buckets_[idx] = *e;
+            copy->status_[idx] = cx_rmap_full_;
+        }
+        copy->count_ = t->count_;
+        return copy;
+    }
+
+    // Saves replaced or deleted entry to be freed when the version being built is published
+    // and the current version is reclaimed.
+    static void cx_rmap_name_(_add_garbage_)(cx_rmap_name* m, cx_rmap_name_(_entry) const* e) {
+
+        if (m->ngarbage_ >= m->capgarbage_) {
+            const size_t cap = m->capgarbage_ == 0 ? 8 : m->capgarbage_ * 2;
+            cx_rmap_name_(_entry)* garbage = cx_rmap_alloc_(m, cap * sizeof(*garbage));
+            if (m->ngarbage_) {
+                memcpy(garbage, m->garbage_, m->ngarbage_ * sizeof(*garbage));
+            }
+            cx_rmap_free_(m, m->garbage_, m->capgarbage_ * sizeof(*garbage));
+            m->garbage_ = garbage;
+            m->capgarbage_ = cap;
+        }
+        m->garbage_[m->ngarbage_++] = *e;
+    }
+
+    // Inserts or updates entry in the private version being built
+    static void cx_rmap_name_(_table_set_)(cx_rmap_name* m, cx_rmap_name_(_table_)* t, cx_rmap_key const* key, cx_rmap_val const* val) {
+
+        const size_t idx = cx_rmap_name_(_table_find_)(t, key, cx_rmap_hash_(key));
+        cx_rmap_name_(_entry)* e = t->buckets_ + idx;
+        if (t->status_[idx] == cx_rmap_full_) {
+            cx_rmap_garbage_(m, e);
+#ifdef cx_rmap_free_key
+            memcpy(&e->key, key, sizeof(cx_rmap_key));
+#endif
+        } else {
+            memcpy(&e->key, key, sizeof(cx_rmap_key));
+            t->status_[idx] = cx_rmap_full_;
+            t->count_++;
+        }
+        memcpy(&e->val, val, sizeof(cx_rmap_val));
+    }
+
+    // Deletes entry from the private version being built shifting back
+    // the following entries of the same probe sequence.
+    static bool cx_rmap_name_(_table_del_)(cx_rmap_name* m, cx_rmap_name_(_table_)* t, cx_rmap_key const* key) {
+
+        size_t idx = cx_rmap_name_(_table_find_)(t, key, cx_rmap_hash_(key));
+        if (t->status_[idx] != cx_rmap_full_) {
+            return false;
+        }
+        cx_rmap_garbage_(m, &t->buckets_[idx]);
+        const size_t mask = t->nbuckets_ - 1;
+        size_t next = (idx + 1) & mask;
+        while (t->status_[next] == cx_rmap_full_) {
+            // Moves the next entry to the hole if its home bucket is not
+            // cyclically between the hole and its current position.
+            const size_t home = cx_hmap_fib_index_(cx_rmap_hash_(&t->buckets_[next].key), t->nbuckets_);
+            if (((next - home) & mask) >= ((next - idx) & mask)) {
+                t->buckets_[idx] = t->buckets_[next];
+                idx = next;
+            }
+            next = (next + 1) & mask;
+        }
+        t->status_[idx] = cx_rmap_empty_;
+        t->count_--;
+        return true;
+    }
+
+    // Returns the minimum epoch of the active readers or UINT64_MAX if no reader is active
+    static uint64_t cx_rmap_name_(_min_epoch_)(cx_rmap_name* m) {
+
+        uint64_t min = UINT64_MAX;
+        for (size_t i = 0; i < cx_rmap_max_readers; i++) {
+            const uint64_t epoch = atomic_load(&m->readers_[i].epoch_);
+            if (epoch != 0 && epoch < min) {
+                min = epoch;
+            }
+        }
+        return min;
+    }
+
+    // Frees retired version and its replaced entries
+    static void cx_rmap_name_(_retired_free_)(cx_rmap_name* m, cx_rmap_name_(_retired_)* rt) {
+
+        for (size_t i = 0; i < rt->ngarbage_; i++) {
+            cx_rmap_free_key_(&rt->garbage_[i].key);
+            cx_rmap_free_val_(&rt->garbage_[i].val);
+        }
+        cx_rmap_name_(_table_free_)(m, rt->table_);
+        cx_rmap_free_(m, rt, sizeof(*rt) + rt->ngarbage_ * sizeof(rt->garbage_[0]));
+    }
+
+    // Frees retired versions which cannot be used by readers.
+    // Must be called with the writer lock.
+    static size_t cx_rmap_name_(_reclaim_)(cx_rmap_name* m) {
+
+        const uint64_t min = cx_rmap_name_(_min_epoch_)(m);
+        size_t pending = 0;
+        cx_rmap_name_(_retired_)** prt = &m->retired_;
+        while (*prt) {
+            cx_rmap_name_(_retired_)* rt = *prt;
+            // Readers which started at or after the epoch when this version
+            // was replaced loaded the new version.
+            if (rt->epoch_ <= min) {
+                *prt = rt->next_;
+                cx_rmap_name_(_retired_free_)(m, rt);
+                continue;
+            }
+            pending++;
+            prt = &rt->next_;
+        }
+        return pending;
+    }
+
+    // Publishes the new version built by the writer and retires the current version.
+    // Must be called with the writer lock.
+    static void cx_rmap_name_(_publish_)(cx_rmap_name* m, cx_rmap_name_(_table_)* t) {
+
+        cx_rmap_name_(_table_)* old = atomic_exchange(&m->table_, t);
+        atomic_store(&m->count_, t->count_);
+        const uint64_t epoch = atomic_fetch_add(&m->epoch_, 1) + 1;
+
+        cx_rmap_name_(_retired_)* rt = cx_rmap_alloc_(m, sizeof(*rt) + m->ngarbage_ * sizeof(rt->garbage_[0]));
+        rt->epoch_ = epoch;
+        rt->table_ = old;
+        rt->ngarbage_ = m->ngarbage_;
+        if (m->ngarbage_) {
+            memcpy(rt->garbage_, m->garbage_, m->ngarbage_ * sizeof(rt->garbage_[0]));
+        }
+        m->ngarbage_ = 0;
+        rt->next_ = m->retired_;
+        m->retired_ = rt;
+        cx_rmap_name_(_reclaim_)(m);
+    }
+
+    static void cx_rmap_name_(_lock_)(cx_rmap_name* m) {
+
+        int res = pthread_mutex_lock(&m->lock_);
+        assert(res == 0); (void)res;
+    }
+
+    static void cx_rmap_name_(_unlock_)(cx_rmap_name* m) {
+
+        int res = pthread_mutex_unlock(&m->lock_);
+        assert(res == 0); (void)res;
+    }
+
+    // Allocates the readers and the initial empty version
+    cx_rmap_api_ void cx_rmap_name_(_init_)(cx_rmap_name* m, size_t nbuckets) {
+
+        const size_t align = _Alignof(cx_rmap_name_(_reader));
+        m->mem_ = cx_rmap_alloc_(m, cx_rmap_max_readers * sizeof(cx_rmap_name_(_reader)) + align);
+        m->readers_ = (cx_rmap_name_(_reader)*)(((uintptr_t)m->mem_ + align - 1) & ~(uintptr_t)(align - 1));
+        for (size_t i = 0; i < cx_rmap_max_readers; i++) {
+            atomic_init(&m->readers_[i].used_, false);
+            atomic_init(&m->readers_[i].epoch_, 0);
+            m->readers_[i].table_ = NULL;
+            m->readers_[i].map_ = NULL;
+        }
+        m->nbuckets_ = cx_hmap_next_pow2(nbuckets == 0 ? cx_rmap_def_nbuckets : nbuckets);
+        atomic_init(&m->table_, cx_rmap_name_(_table_alloc_)(m, m->nbuckets_));
+        atomic_init(&m->epoch_, 1);
+        atomic_init(&m->count_, 0);
+        int res = pthread_mutex_init(&m->lock_, NULL);
+        assert(res == 0); (void)res;
+    }
+
+#ifdef cx_rmap_instance_allocator
+
+    cx_rmap_api_ cx_rmap_name cx_rmap_name_(_init)(const CxAllocator* alloc, size_t nbuckets) {
+
+        cx_rmap_name m = {.alloc_ = alloc == NULL ? cx_def_allocator() : alloc};
+        cx_rmap_name_(_init_)(&m, nbuckets);
+        return m;
+    }
+
+#else
+
+    cx_rmap_api_ cx_rmap_name cx_rmap_name_(_init)(size_t nbuckets) {
+
+        cx_rmap_name m = {0};
+        cx_rmap_name_(_init_)(&m, nbuckets);
+        return m;
+    }
+
+#endif
+
+cx_rmap_api_ void cx_rmap_name_(_free)(cx_rmap_name* m) {
+
+    if (m->readers_ == NULL) {
+        return;
+    }
+    while (m->retired_) {
+        cx_rmap_name_(_retired_)* rt = m->retired_;
+        m->retired_ = rt->next_;
+        cx_rmap_name_(_retired_free_)(m, rt);
+    }
+    cx_rmap_name_(_table_)* t = atomic_load(&m->table_);
+#if defined(cx_rmap_free_key) || defined(cx_rmap_free_val)
+    for (size_t i = 0; i < t->nbuckets_; i++) {
+        if (t->status_[i] == cx_rmap_full_) {
+            cx_rmap_free_key_(&t->buckets_[i].key);
+            cx_rmap_free_val_(&t->buckets_[i].val);
+        }
+    }
+#endif
+    cx_rmap_name_(_table_free_)(m, t);
+    atomic_store(&m->table_, NULL);
+    atomic_store(&m->count_, 0);
+    cx_rmap_free_(m, m->garbage_, m->capgarbage_ * sizeof(*m->garbage_));
+    m->garbage_ = NULL;
+    m->capgarbage_ = 0;
+    const size_t align = _Alignof(cx_rmap_name_(_reader));
+    cx_rmap_free_(m, m->mem_, cx_rmap_max_readers * sizeof(cx_rmap_name_(_reader)) + align);
+    m->mem_ = NULL;
+    m->readers_ = NULL;
+    pthread_mutex_destroy(&m->lock_);
+}
+
+cx_rmap_api_ cx_rmap_name_(_reader)* cx_rmap_name_(_reader_add)(cx_rmap_name* m) {
+
+    for (size_t i = 0; i < cx_rmap_max_readers; i++) {
+        cx_rmap_name_(_reader)* r = m->readers_ + i;
+        bool used = false;
+        if (atomic_compare_exchange_strong(&r->used_, &used, true)) {
+            r->map_ = m;
+            return r;
+        }
+    }
+    return NULL;
+}
+
+cx_rmap_api_ void cx_rmap_name_(_reader_del)(cx_rmap_name_(_reader)* r) {
+
+    assert(atomic_load(&r->epoch_) == 0);
+    r->table_ = NULL;
+    atomic_store(&r->used_, false);
+}
+
+cx_rmap_api_ void cx_rmap_name_(_read_begin)(cx_rmap_name_(_reader)* r) {
+
+    // The epoch must be visible to writers before the version is loaded
+    atomic_store(&r->epoch_, atomic_load(&r->map_->epoch_));
+    r->table_ = atomic_load(&r->map_->table_);
+}
+
+cx_rmap_api_ void cx_rmap_name_(_read_end)(cx_rmap_name_(_reader)* r) {
+
+    atomic_store_explicit(&r->epoch_, 0, memory_order_release);
+}
+
+cx_rmap_api_ cx_rmap_val const* cx_rmap_name_(_get)(cx_rmap_name_(_reader)* r, cx_rmap_key k) {
+
+    assert(r->table_);
+    const cx_rmap_name_(_table_)* t = r->table_;
+    const size_t idx = cx_rmap_name_(_table_find_)(t, &k, cx_rmap_hash_(&k));
+    if (t->status_[idx] != cx_rmap_full_) {
+        return NULL;
+    }
+    return &t->buckets_[idx].val;
+}
+
+cx_rmap_api_ bool cx_rmap_name_(_get_copy)(cx_rmap_name_(_reader)* r, cx_rmap_key k, cx_rmap_val* val) {
+
+    cx_rmap_name_(_read_begin)(r);
+    cx_rmap_val const* pv = cx_rmap_name_(_get)(r, k);
+    if (pv) {
+        *val = *pv;
+    }
+    cx_rmap_name_(_read_end)(r);
+    return pv != NULL;
+}
+
+cx_rmap_api_ size_t cx_rmap_name_(_count)(cx_rmap_name* m) {
+
+    // The current version may be replaced and freed at any time by a writer,
+    // so its count is copied to the map when published.
+    return atomic_load(&m->count_);
+}
+
+cx_rmap_api_ void cx_rmap_name_(_set)(cx_rmap_name* m, cx_rmap_key k, cx_rmap_val v) {
+
+    cx_rmap_name_(_set_batch)(m, &k, &v, 1);
+}
+
+cx_rmap_api_ void cx_rmap_name_(_set_batch)(cx_rmap_name* m, cx_rmap_key const* keys, cx_rmap_val const* vals, size_t n) {
+
+    cx_rmap_name_(_lock_)(m);
+    const cx_rmap_name_(_table_)* t = atomic_load(&m->table_);
+    cx_rmap_name_(_table_)* copy = cx_rmap_name_(_table_copy_)(m, t, t->count_ + n);
+    for (size_t i = 0; i < n; i++) {
+        cx_rmap_name_(_table_set_)(m, copy, &keys[i], &vals[i]);
+    }
+    cx_rmap_name_(_publish_)(m, copy);
+    cx_rmap_name_(_unlock_)(m);
+}
+
+cx_rmap_api_ bool cx_rmap_name_(_del)(cx_rmap_name* m, cx_rmap_key k) {
+
+    return cx_rmap_name_(_del_batch)(m, &k, 1) == 1;
+}
+
+cx_rmap_api_ size_t cx_rmap_name_(_del_batch)(cx_rmap_name* m, cx_rmap_key const* keys, size_t n) {
+
+    cx_rmap_name_(_lock_)(m);
+    const cx_rmap_name_(_table_)* t = atomic_load(&m->table_);
+
+    // Does not publish a new version if none of the keys is found
+    size_t i;
+    for (i = 0; i < n; i++) {
+        if (t->status_[cx_rmap_name_(_table_find_)(t, &keys[i], cx_rmap_hash_(&keys[i]))] == cx_rmap_full_) {
+            break;
+        }
+    }
+    size_t count = 0;
+    if (i < n) {
+        cx_rmap_name_(_table_)* copy = cx_rmap_name_(_table_copy_)(m, t, t->count_);
+        for (; i < n; i++) {
+            count += cx_rmap_name_(_table_del_)(m, copy, &keys[i]);
+        }
+        cx_rmap_name_(_publish_)(m, copy);
+    }
+    cx_rmap_name_(_unlock_)(m);
+    return count;
+}
+
+cx_rmap_api_ void cx_rmap_name_(_clear)(cx_rmap_name* m) {
+
+    cx_rmap_name_(_lock_)(m);
+#if defined(cx_rmap_free_key) || defined(cx_rmap_free_val)
+    const cx_rmap_name_(_table_)* t = atomic_load(&m->table_);
+    for (size_t i = 0; i < t->nbuckets_; i++) {
+        if (t->status_[i] == cx_rmap_full_) {
+            cx_rmap_garbage_(m, &t->buckets_[i]);
+        }
+    }
+#endif
+    cx_rmap_name_(_publish_)(m, cx_rmap_name_(_table_alloc_)(m, m->nbuckets_));
+    cx_rmap_name_(_unlock_)(m);
+}
+
+cx_rmap_api_ size_t cx_rmap_name_(_reclaim)(cx_rmap_name* m) {
+
+    cx_rmap_name_(_lock_)(m);
+    const size_t pending = cx_rmap_name_(_reclaim_)(m);
+    cx_rmap_name_(_unlock_)(m);
+    return pending;
+}
+
+#undef cx_rmap_empty_
+#undef cx_rmap_full_
+
+#endif // cx_rmap_implement
+
+// Undefine config  macros
+#undef cx_rmap_name
+#undef cx_rmap_key
+#undef cx_rmap_val
+#undef cx_rmap_max_readers
+#undef cx_rmap_def_nbuckets
+#undef cx_rmap_resize_load
+#undef cx_rmap_cmp_key
+#undef cx_rmap_hash_key
+#undef cx_rmap_free_key
+#undef cx_rmap_free_val
+#undef cx_rmap_allocator
+#undef cx_rmap_instance_allocator
+#undef cx_rmap_static
+#undef cx_rmap_inline
+#undef cx_rmap_implement
+
+// Undefine internal macros
+#undef cx_rmap_hash_
+#undef cx_rmap_garbage_
+#undef cx_rmap_free_key_
+#undef cx_rmap_free_val_
+#undef cx_rmap_concat2_
+#undef cx_rmap_concat1_
+#undef cx_rmap_name_
+#undef cx_rmap_api_
+#undef cx_rmap_alloc_field_
+#undef cx_rmap_alloc_
+#undef cx_rmap_free_
+
@@ -0,0 +1,56 @@
+#ifndef CX_SLAB_ALLOCATOR_H
+#define CX_SLAB_ALLOCATOR_H
+#include <stddef.h>
+#include "cx_alloc.h"
+
+// Slab allocator opaque type
+typedef struct CxSlabAllocator CxSlabAllocator;
+
+// Slab allocator stats
+typedef struct CxSlabAllocatorStats {
+    size_t nallocs;     // Number of individual allocations
+    size_t nfrees;      // Number of individual frees
+    size_t nslabs;      // Number of slabs allocated from the upstream allocator
+    size_t slabBytes;   // Total size of the allocated slabs
+} CxSlabAllocatorStats;
+
+// Creates a slab allocator with the specified slab size using the specified memory allocator.
+// If NULL is passed as the allocator, the default global allocator (malloc/free) will be used.
+// Allocations are rounded up to size classes (multiples of 16 bytes up to 128 bytes and then
+// four classes for each power of two) and served from slabs of 'slabSize' bytes dedicated
+// to each class. Freed areas are kept in the free list of their class for reuse.
+// Allocations greater than the largest class which fits 8 times in a slab (at most 4096 bytes)
+// are forwarded to the upstream allocator.
+// Pass 0 as slabSize to use the default size of 64KB.
+// The allocator is thread safe.
+CxSlabAllocator* cx_slab_allocator_create(size_t slabSize, const CxAllocator* ca);
+
+// Destroy a previously created slab allocator freeing all allocated memory.
+// Allocations greater than the largest class must have been freed.
+void cx_slab_allocator_destroy(CxSlabAllocator* a);
+
+// Enables per thread magazines with the specified capacity when not zero, or disables them.
+// Each thread allocates from and frees to its own magazine of each size class without locking,
+// transferring half of the magazine capacity from or to the shared free lists when the
+// magazine is empty or full. Areas in the magazine of a thread which has finished are
+// only released when the allocator is destroyed.
+// Must be called before the allocator is used.
+void cx_slab_allocator_set_magazine(CxSlabAllocator* a, size_t capacity);
+
+// Allocates size bytes using standard alignment and return its pointer
+void* cx_slab_allocator_alloc(CxSlabAllocator* a, size_t size);
+
+// Frees area of the specified size previously allocated by this allocator
+void cx_slab_allocator_free(CxSlabAllocator* a, void* ptr, size_t size);
+
+// Reallocates area to the new size, keeping the area if the size class does not change.
+void* cx_slab_allocator_realloc(CxSlabAllocator* a, void* old_ptr, size_t old_size, size_t size);
+
+// Returns allocator interface
+const CxAllocator* cx_slab_allocator_iface(const CxSlabAllocator* a);
+
+// Returns allocator statistics
+CxSlabAllocatorStats cx_slab_allocator_stats(CxSlabAllocator* a);
+
+#endif
+
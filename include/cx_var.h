@@ -112,10 +112,19 @@ CxVar* cx_var_get_map_len(const CxVar* map, size_t* len);
 // Returns NULl if order is invalid.
 const char* cx_var_get_map_key(const CxVar* map, size_t order);
 
+// Returns the map value at the order it was inserted and optionally its key.
+// Returns NULL if order is invalid.
+CxVar* cx_var_get_map_at(const CxVar* map, size_t order, const char** key);
+
 // Get value of map element at the specified key
 // Returns NULL on errors.
 CxVar* cx_var_get_map_val(const CxVar* map, const char* key);
 
+// Get value of map element at the specified key with 'key_len' bytes,
+// which does not need to be NUL terminated.
+// Returns NULL on errors.
+CxVar* cx_var_get_map_valn(const CxVar* map, const char* key, size_t key_len);
+
 // Utility map element getters
 CxVar* cx_var_get_map_null(const CxVar* map, const char* key);
 CxVar* cx_var_get_map_bool(const CxVar* map, const char* key, bool* pbool);
@@ -0,0 +1,227 @@
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <assert.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <stdatomic.h>
+
+#include "cx_alloc.h"
+#include "cx_arena_allocator.h"
+
+// Size of transparent huge pages (PMD size) used to align the arena range
+#define HUGE_PAGE_SIZE (2*1024*1024)
+
+// Arena Allocator state
+typedef struct CxArenaAllocator {
+    CxAllocator         iface;          // Allocator interface
+    CxAllocatorErrorFn  error_fn;       // Optional error function
+    void*               error_udata;    // Optional error function userdata
+    CxArenaFlags        flags;          // Creation flags
+    char*               base;           // Start of the reserved range
+    size_t              reserved;       // Size of the reserved range
+    size_t              pageSize;       // Size of the pages of the range
+    size_t              touched;        // Maximum used size before the last clear
+    _Atomic size_t      used;           // Offset of the next free byte of the range
+    _Atomic size_t      nallocs;        // Number of allocations
+    _Atomic size_t      nbytes;         // Number of bytes requested
+} CxArenaAllocator;
+
+// Local functions
+static void arenaFree(void* ctx, void* p, size_t size);
+static void prefault(CxArenaAllocator* a);
+static inline size_t alignSize(size_t size, size_t align);
+
+
+CxArenaAllocator* cx_arena_allocator_create(size_t reserve, CxArenaFlags flags) {
+
+    const size_t pageSize = (flags & CxArenaFlagHugePages) ? HUGE_PAGE_SIZE : (size_t)sysconf(_SC_PAGESIZE);
+    const size_t reserved = alignSize(reserve > 0 ? reserve : 1, pageSize);
+
+    // Huge pages are only used for ranges aligned to the huge page size, so reserves
+    // an extra huge page and unmaps the unaligned head and tail of the mapping.
+    int mflags = MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE;
+    size_t mapSize = reserved;
+    if (flags & CxArenaFlagHugePages) {
+        mapSize += HUGE_PAGE_SIZE;
+    } else if (flags & CxArenaFlagPrefault) {
+        mflags = MAP_PRIVATE | MAP_ANONYMOUS | MAP_POPULATE;
+    }
+    char* map = mmap(NULL, mapSize, PROT_READ | PROT_WRITE, mflags, -1, 0);
+    if (map == MAP_FAILED) {
+        return NULL;
+    }
+    char* base = map;
+    if (flags & CxArenaFlagHugePages) {
+        base = (char*)alignSize((uintptr_t)map, HUGE_PAGE_SIZE);
+        if (base > map) {
+            munmap(map, base - map);
+        }
+        if (map + mapSize > base + reserved) {
+            munmap(base + reserved, map + mapSize - (base + reserved));
+        }
+        // Fails if transparent huge pages are disabled, and then the range uses normal pages.
+        madvise(base, reserved, MADV_HUGEPAGE);
+    }
+
+    CxArenaAllocator* a = malloc(sizeof(CxArenaAllocator));
+    if (a == NULL) {
+        munmap(base, reserved);
+        return NULL;
+    }
+    a->iface = (CxAllocator){
+        .ctx = a,
+        .alloc = (CxAllocatorAllocFn)cx_arena_allocator_alloc,
+        .free = arenaFree,
+        .realloc = (CxAllocatorReallocFn)cx_arena_allocator_realloc,
+    };
+    a->error_fn = NULL;
+    a->error_udata = NULL;
+    a->flags = flags;
+    a->base = base;
+    a->reserved = reserved;
+    a->pageSize = pageSize;
+    a->touched = 0;
+    atomic_init(&a->used, 0);
+    atomic_init(&a->nallocs, 0);
+    atomic_init(&a->nbytes, 0);
+    if ((flags & CxArenaFlagHugePages) && (flags & CxArenaFlagPrefault)) {
+        prefault(a);
+    }
+    return a;
+}
+
+void cx_arena_allocator_destroy(CxArenaAllocator* a) {
+
+    munmap(a->base, a->reserved);
+    free(a);
+}
+
+void cx_arena_allocator_set_error_fn(CxArenaAllocator* a, CxAllocatorErrorFn fn, void* userdata) {
+
+    a->error_fn = fn;
+    a->error_udata = userdata;
+}
+
+void* cx_arena_allocator_alloc(CxArenaAllocator* a, size_t size) {
+
+    return cx_arena_allocator_alloc2(a, size, _Alignof(long double));
+}
+
+void* cx_arena_allocator_alloc2(CxArenaAllocator* a, size_t size, size_t align) {
+
+    // Alignment must be power of 2
+    assert((align & (align-1)) == 0);
+    const uintptr_t base = (uintptr_t)a->base;
+    size_t used = atomic_load_explicit(&a->used, memory_order_relaxed);
+    size_t start;
+    do {
+        start = alignSize(base + used, align) - base;
+        if (start > a->reserved || size > a->reserved - start) {
+            if (a->error_fn) {
+                a->error_fn("Arena reserved range exhausted", a->error_udata);
+            }
+            return NULL;
+        }
+    } while (!atomic_compare_exchange_weak_explicit(&a->used, &used, start + size,
+        memory_order_relaxed, memory_order_relaxed));
+    atomic_fetch_add_explicit(&a->nallocs, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&a->nbytes, size, memory_order_relaxed);
+    return a->base + start;
+}
+
+void* cx_arena_allocator_realloc(CxArenaAllocator* a, void* old_ptr, size_t old_size, size_t size) {
+
+    if (old_ptr == NULL) {
+        return cx_arena_allocator_alloc(a, size);
+    }
+
+    // Grows or shrinks the last allocated area in place
+    const size_t start = (char*)old_ptr - a->base;
+    size_t end = start + old_size;
+    if (size <= a->reserved - start &&
+        atomic_compare_exchange_strong_explicit(&a->used, &end, start + size,
+            memory_order_relaxed, memory_order_relaxed)) {
+        atomic_fetch_add_explicit(&a->nbytes, size - old_size, memory_order_relaxed);
+        return old_ptr;
+    }
+    // Other areas are kept when shrunk
+    if (size <= old_size) {
+        return old_ptr;
+    }
+    void* p = cx_arena_allocator_alloc(a, size);
+    if (p != NULL) {
+        memcpy(p, old_ptr, old_size);
+    }
+    return p;
+}
+
+void cx_arena_allocator_clear(CxArenaAllocator* a) {
+
+    const size_t used = atomic_load_explicit(&a->used, memory_order_relaxed);
+    if (used > a->touched) {
+        a->touched = used;
+    }
+    atomic_store_explicit(&a->used, 0, memory_order_relaxed);
+    atomic_store_explicit(&a->nallocs, 0, memory_order_relaxed);
+    atomic_store_explicit(&a->nbytes, 0, memory_order_relaxed);
+}
+
+void cx_arena_allocator_free(CxArenaAllocator* a) {
+
+    cx_arena_allocator_clear(a);
+    if (a->touched > 0) {
+        madvise(a->base, alignSize(a->touched, a->pageSize), MADV_DONTNEED);
+        a->touched = 0;
+    }
+}
+
+const CxAllocator* cx_arena_allocator_iface(const CxArenaAllocator* a) {
+
+    return &a->iface;
+}
+
+CxArenaAllocatorStats cx_arena_allocator_stats(CxArenaAllocator* a) {
+
+    return (CxArenaAllocatorStats){
+        .nallocs = atomic_load_explicit(&a->nallocs, memory_order_relaxed),
+        .nbytes = atomic_load_explicit(&a->nbytes, memory_order_relaxed),
+        .usedBytes = atomic_load_explicit(&a->used, memory_order_relaxed),
+        .reservedBytes = a->reserved,
+    };
+}
+
+// Releases the area if it is the last allocated area
+static void arenaFree(void* ctx, void* p, size_t size) {
+
+    CxArenaAllocator* a = ctx;
+    if (p == NULL) {
+        return;
+    }
+    size_t end = (char*)p - a->base + size;
+    atomic_compare_exchange_strong_explicit(&a->used, &end, (char*)p - a->base,
+        memory_order_relaxed, memory_order_relaxed);
+}
+
+// Maps all the pages of the range after it was advised to use huge pages.
+// MAP_POPULATE would map normal pages before the advice.
+static void prefault(CxArenaAllocator* a) {
+
+#ifdef MADV_POPULATE_WRITE
+    if (madvise(a->base, a->reserved, MADV_POPULATE_WRITE) == 0) {
+        return;
+    }
+#endif
+    // Writes the first byte of each page
+    const size_t pageSize = sysconf(_SC_PAGESIZE);
+    for (size_t i = 0; i < a->reserved; i += pageSize) {
+        ((volatile char*)a->base)[i] = 0;
+    }
+}
+
+// Returns the size rounded up to the specified power of 2 alignment
+static inline size_t alignSize(size_t size, size_t align) {
+
+    return (size + align - 1) & ~(align - 1);
+}
+
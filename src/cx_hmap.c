@@ -1,5 +1,7 @@
 #include <stdlib.h>
 #include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
 
 // FNV1-a hash function for 32 bit hashes.
 #define FNV_32_INIT     ((uint32_t)0x811c9dc5)
@@ -17,6 +19,139 @@ uint32_t cx_hmap_hash_fnv1a32(const void *buf, size_t len) {
     return hval;
 }
 
+// Constants for 64 bit multiply-mix hash functions (from wyhash)
+#define WY_SEED         ((uint64_t)0xa0761d6478bd642full)
+#define WY_P1           ((uint64_t)0xe7037ed1a0b428dbull)
+#define WY_P2           ((uint64_t)0x8ebc6af09c88c6e3ull)
+#define WY_P3           ((uint64_t)0x589965cc75374cc3ull)
+
+// Multiplies two 64 bit values and returns the XOR of the high and low 64 bits of the product
+static inline uint64_t cx_hmap_mum(uint64_t a, uint64_t b) {
+
+#ifdef __SIZEOF_INT128__
+    const __uint128_t r = (__uint128_t)a * b;
+    return (uint64_t)r ^ (uint64_t)(r >> 64);
+#else
+    const uint64_t ha = a >> 32, hb = b >> 32, la = (uint32_t)a, lb = (uint32_t)b;
+    const uint64_t rh = ha * hb, rm0 = ha * lb, rm1 = hb * la, rl = la * lb;
+    const uint64_t t = rl + (rm0 << 32);
+    uint64_t c = t < rl;
+    const uint64_t lo = t + (rm1 << 32);
+    c += lo < t;
+    const uint64_t hi = rh + (rm0 >> 32) + (rm1 >> 32) + c;
+    return lo ^ hi;
+#endif
+}
+
+// Reads 64 bit little endian word from unaligned address
+static inline uint64_t cx_hmap_read64(const uint8_t* p) {
+
+    uint64_t v;
+    memcpy(&v, p, sizeof(v));
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    v = __builtin_bswap64(v);
+#endif
+    return v;
+}
+
+// Mixes 16 bytes block into the hash state
+#define WY_BLOCK(h,a,b)     h = cx_hmap_mum((a) ^ WY_P1, (b) ^ (h))
+
+// Mixes the last block and the total length into the hash state
+#define WY_FINAL(h,a,b,len) (WY_BLOCK(h,a,b), cx_hmap_mum((h) ^ WY_P2, (uint64_t)(len) ^ WY_P3))
+
+// 64 bit hash function processing 16 bytes per iteration.
+// The last partial block is zero padded and the length is mixed at the end,
+// so the hash can also be calculated in one pass over nul terminated strings.
+uint64_t cx_hmap_hash_wy64(const void* buf, size_t len) {
+
+    const uint8_t* p = buf;
+    size_t rem = len;
+    uint64_t h = WY_SEED;
+    while (rem >= 16) {
+        WY_BLOCK(h, cx_hmap_read64(p), cx_hmap_read64(p + 8));
+        p += 16;
+        rem -= 16;
+    }
+    uint8_t tail[16] = {0};
+    memcpy(tail, p, rem);
+    return WY_FINAL(h, cx_hmap_read64(tail), cx_hmap_read64(tail + 8), len);
+}
+
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+
+// Unaligned word type which may alias the characters of the string
+typedef uint64_t __attribute__((may_alias, aligned(1))) cx_hmap_word;
+
+// Returns mask with the high bit set for zero bytes of 'x'.
+// Only the lowest set bit is exact: bits above it may be false positives.
+#define WY_ZERO_BYTES(x)    (((x) - 0x0101010101010101ull) & ~(x) & 0x8080808080808080ull)
+
+// Returns word with only the bytes before the first zero byte indicated by 'zeros'
+#define WY_BEFORE_ZERO(x,zeros) (__builtin_ctzll(zeros) < 8 ? 0 : (x) & ((1ull << (__builtin_ctzll(zeros) & ~7)) - 1))
+
+// Disables the sanitizers which report reads past the end of objects
+#ifdef __clang__
+#define WY_NO_SANITIZE __attribute__((no_sanitize("address", "thread", "memory")))
+#else
+#define WY_NO_SANITIZE __attribute__((no_sanitize("address", "thread")))
+#endif
+
+// Same as cx_hmap_hash_wy64(str, strlen(str)) but finds the string terminator
+// while hashing. Reads 16 bytes blocks which may include bytes after the
+// terminator but never cross a page boundary.
+WY_NO_SANITIZE
+uint64_t cx_hmap_hash_wy64_str_fast(const char* str) {
+
+    const char* p = str;
+    uint64_t h = WY_SEED;
+    while (true) {
+        if (((uintptr_t)p & 4095) <= 4096 - 16) {
+            const uint64_t a = *(const cx_hmap_word*)p;
+            const uint64_t b = *(const cx_hmap_word*)(p + 8);
+            const uint64_t za = WY_ZERO_BYTES(a);
+            const uint64_t zb = WY_ZERO_BYTES(b);
+            if (za) {
+                return WY_FINAL(h, WY_BEFORE_ZERO(a, za), 0, p - str + __builtin_ctzll(za)/8);
+            }
+            if (zb) {
+                return WY_FINAL(h, a, WY_BEFORE_ZERO(b, zb), p - str + 8 + __builtin_ctzll(zb)/8);
+            }
+            WY_BLOCK(h, a, b);
+            p += 16;
+            continue;
+        }
+        // The block crosses a page boundary: copy its bytes up to the terminator
+        uint8_t block[16] = {0};
+        size_t n = 0;
+        while (n < 16 && p[n] != 0) {
+            block[n] = p[n];
+            n++;
+        }
+        if (n < 16) {
+            return WY_FINAL(h, cx_hmap_read64(block), cx_hmap_read64(block + 8), p - str + n);
+        }
+        WY_BLOCK(h, cx_hmap_read64(block), cx_hmap_read64(block + 8));
+        p += 16;
+    }
+}
+
+#else
+
+uint64_t cx_hmap_hash_wy64_str_fast(const char* str) {
+
+    return cx_hmap_hash_wy64(str, strlen(str));
+}
+
+#endif
+
+// Same as cx_hmap_hash_wy64(str, strlen(str)).
+// Only reads the bytes of the string and its terminator.
+uint64_t cx_hmap_hash_wy64_str(const char* str) {
+
+    return cx_hmap_hash_wy64(str, strlen(str));
+}
+
 // Utility function for freeing key/val "malloc" allocated C nul terminated string
 void cx_hmap_free_str(char** str) {
     free(*str);
@@ -57,6 +192,16 @@ static size_t cx_hmap_prime_numbers[] = {
     0,
 };
 
+// Returns the smallest power of two >= n and >= 2
+size_t cx_hmap_next_pow2(size_t n) {
+
+    size_t p = 2;
+    while (p < n) {
+        p *= 2;
+    }
+    return p;
+}
+
 // Returns 'n' if 'n' is prime or the next prime ~2*n
 size_t cx_hmap_next_prime(size_t n) {
 
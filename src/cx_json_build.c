@@ -172,11 +172,8 @@ static int cx_json_build_map(BuildState* bs, const CxVar* var) {
     size_t order = 0;
     CHKW(cx_writer_write_str(bs->out, "{"));
     while (true) {
-        const char* key = cx_var_get_map_key(var, order);
-        if (key == NULL) {
-            break;
-        }
-        CxVar* value = cx_var_get_map_val(var, key);
+        const char* key;
+        CxVar* value = cx_var_get_map_at(var, order, &key);
         if (value == NULL) {
             break;
         }
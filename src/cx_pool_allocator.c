@@ -5,8 +5,10 @@
 #include <assert.h>
 #include <time.h>
 #include <pthread.h>
+#include <stdatomic.h>
 
 #include "cx_alloc.h"
+#include "cx_error.h"
 #include "cx_pool_allocator.h"
 
 // Block header
@@ -17,26 +19,89 @@ typedef struct Block {
     char    data[];     // Block data
 } Block;
 
+// Thread cache: chunk of a pool block used by a single thread to allocate without locking
+typedef struct ThreadCache ThreadCache;
+typedef struct ThreadCache {
+    uintptr_t           start;      // Start address of the current chunk
+    uintptr_t           curr;       // Next free address of the current chunk (0 if none)
+    uintptr_t           end;        // End address of the current chunk
+    _Atomic size_t      nallocs;    // Number of individual allocations from this cache
+    _Atomic size_t      nbytes;     // Total bytes requested from this cache
+    pthread_t           owner;      // Thread which owns this cache
+    ThreadCache*        next;       // Next cache of the pool
+    char                pad[64];    // Keeps the fields of different caches in different cache lines
+} ThreadCache;
+
+// Number of bins of free blocks, with 4 bins for each power of two of the block size
+// ratio to the minimum block size. The last bin contains all the larger blocks.
+#define NBINS (64)
+
+// Maximum number of bins above the bin of a requested size to look for free blocks,
+// so blocks 4 times larger than the requested size are not used.
+#define MAX_BIN_DIST (8)
+
 // Block Allocator state
 typedef struct CxPoolAllocator {
     pthread_mutex_t     lock;
+    uint64_t            id;             // Unique allocator id used by the thread local cache table
+    size_t              chunkSize;      // Size of thread cache chunks (0 if disabled)
+    ThreadCache*        caches;         // List of thread caches
     const CxAllocator*  alloc;          // Allocator for blocks
     CxAllocator         iface;          // Allocator interface
     CxAllocatorErrorFn  error_fn;       // Optional error function
     void*               error_udata;    // Optional error function userdata
     size_t              blockSize;      // Minimum block size
-    Block*              nextFree;       // Next free block of the free chain
+    Block*              bins[NBINS];    // Free blocks segregated by size
+    uint64_t            binMask;        // Bit i is set if bins[i] is not empty
+    Block*              cleared;        // Blocks released by clear and not yet moved to the bins
     Block*              firstBlock;     // First block of the allocated chain
     Block*              currBlock;      // Current block of the allocated chain
+    Block*              prevBlock;      // Block before the current block in the allocated chain
+    Block*              markBlock;      // Block of the last mark or rewind
+    size_t              markUsed;       // Bytes allocated in the block of the last mark or rewind
     size_t              used;           // Bytes allocated in current block (not including block header)
     size_t              nallocs;        // Number of individual allocations
     size_t              nbytes;         // Total bytes requested for allocation
+    size_t              usedBlocks;     // Number of blocks in the allocated chain
+    size_t              usedBytes;      // Total size of the blocks in the allocated chain
+    size_t              freeBlocks;     // Number of free blocks
+    size_t              freeBytes;      // Total size of the free blocks
+    size_t              wastedBytes;    // Bytes lost in alignment and at the end of used blocks
 } CxPoolAllocator;
 
 
+// Source of unique allocator ids
+static _Atomic uint64_t nextId = 1;
+
+// Thread local table of the caches of the last used pools, indexed by pool id
+#define TLS_CACHES (8)
+static _Thread_local struct {
+    uint64_t        id;
+    ThreadCache*    tc;
+} tlsCaches[TLS_CACHES];
+
+// Scratch pool allocator of each thread
+#define SCRATCH_BLOCK_SIZE (64*1024)
+static pthread_key_t scratchKey;
+static pthread_once_t scratchOnce = PTHREAD_ONCE_INIT;
+static _Thread_local CxPoolAllocator* scratchPool;
+
 // Local functions forward declarations
 static void cxAllocPoolDummyFree(void* ctx, void* p, size_t n);
+static void* allocShared(CxPoolAllocator* a, size_t size, size_t align);
+static inline void* allocLocked(CxPoolAllocator* a, size_t size, size_t align);
+static ThreadCache* threadCache(CxPoolAllocator* a);
+static void resetCaches(CxPoolAllocator* a);
+static void releaseChunks(CxPoolAllocator* a);
+static void scratchInit(void);
+static void scratchDestroy(void* pool);
+static inline void addStat(_Atomic size_t* v, size_t n);
 static inline int newBlock(CxPoolAllocator* p, size_t size);
+static void* reallocBlock(CxPoolAllocator* a, void* ptr, size_t old_size, size_t size);
+static inline Block* takeFreeBlock(CxPoolAllocator* a, size_t size);
+static inline void putFreeBlock(CxPoolAllocator* a, Block* b);
+static inline size_t binIndex(CxPoolAllocator* a, size_t size);
+static void freeChain(CxPoolAllocator* a, Block* b);
 static inline uintptr_t alignForward(uintptr_t ptr, size_t align);
 
 
@@ -53,15 +118,30 @@ CxPoolAllocator* cx_pool_allocator_create(size_t blockSize, const CxAllocator* a
         .free = cxAllocPoolDummyFree,
         .realloc = (CxAllocatorReallocFn)cx_pool_allocator_realloc,
     };
-    assert(pthread_mutex_init(&a->lock, NULL) == 0);
-
-    a->blockSize = blockSize;
-    a->nextFree = NULL;
+    CXCHKZ(pthread_mutex_init(&a->lock, NULL));
+
+    a->id = atomic_fetch_add(&nextId, 1);
+    a->chunkSize = 0;
+    a->caches = NULL;
+    a->error_fn = NULL;
+    a->error_udata = NULL;
+    a->blockSize = blockSize > 0 ? blockSize : 1;
+    memset(a->bins, 0, sizeof(a->bins));
+    a->binMask = 0;
+    a->cleared = NULL;
     a->firstBlock = NULL;
     a->currBlock = NULL;
+    a->prevBlock = NULL;
+    a->markBlock = NULL;
+    a->markUsed = 0;
     a->used = 0;
     a->nallocs = 0;
     a->nbytes = 0;
+    a->usedBlocks = 0;
+    a->usedBytes = 0;
+    a->freeBlocks = 0;
+    a->freeBytes = 0;
+    a->wastedBytes = 0;
     return a;
 }
 
@@ -71,10 +151,23 @@ void cx_pool_allocator_set_error_fn(CxPoolAllocator* a, CxAllocatorErrorFn fn, v
     a->error_udata = userdata;
 }
 
+void cx_pool_allocator_set_thread_cache(CxPoolAllocator* a, size_t chunkSize) {
+
+    CXCHKZ(pthread_mutex_lock(&a->lock));
+    a->chunkSize = chunkSize;
+    CXCHKZ(pthread_mutex_unlock(&a->lock));
+}
+
 void cx_pool_allocator_destroy(CxPoolAllocator* a) {
 
     cx_pool_allocator_free(a);
-    assert(pthread_mutex_destroy(&a->lock) == 0);
+    ThreadCache* tc = a->caches;
+    while (tc != NULL) {
+        ThreadCache* next = tc->next;
+        cx_alloc_free(a->alloc, tc, sizeof(ThreadCache));
+        tc = next;
+    }
+    CXCHKZ(pthread_mutex_destroy(&a->lock));
     cx_alloc_free(a->alloc, a, sizeof(CxPoolAllocator));
 }
 
@@ -85,38 +178,54 @@ void* cx_pool_allocator_alloc(CxPoolAllocator* a, size_t size) {
 
 void* cx_pool_allocator_alloc2(CxPoolAllocator* a, size_t size, size_t align) {
 
-    assert(pthread_mutex_lock(&a->lock) == 0);
-    void* pdata = NULL;
-    uintptr_t padding = 0;
-    if (a->currBlock) {
-        padding = alignForward(a->used, align) - a->used;
+    // Large allocations and allocators without thread cache use the shared blocks
+    const size_t limit = a->chunkSize / 4;
+    if (size > limit || align > limit) {
+        return allocShared(a, size, align);
     }
-    int res = 0;
-    if (a->currBlock == NULL || (a->used + padding + size > a->currBlock->size)) {
-        res = newBlock(a, size);
-        if (res) {
-            goto exit;
-        }
-        padding = 0;
+    ThreadCache* tc = threadCache(a);
+    if (tc == NULL) {
+        return allocShared(a, size, align);
     }
-    pdata = a->currBlock->data + a->used + padding;
-    a->used += padding + size;
-    a->nallocs++;
-    a->nbytes += size;
 
-exit:
-    assert(pthread_mutex_unlock(&a->lock) == 0);
-    if (res && a->error_fn) {
-        a->error_fn("Error allocating new block", a->error_udata);
+    // If the current chunk is exhausted, takes a new chunk from the shared blocks
+    uintptr_t p = alignForward(tc->curr, align);
+    if (tc->curr == 0 || p + size > tc->end) {
+        CXCHKZ(pthread_mutex_lock(&a->lock));
+        void* chunk = allocLocked(a, a->chunkSize, _Alignof(long double));
+        if (chunk != NULL && tc->curr != 0) {
+            a->wastedBytes += tc->end - tc->curr;
+        }
+        CXCHKZ(pthread_mutex_unlock(&a->lock));
+        if (chunk == NULL) {
+            if (a->error_fn) {
+                a->error_fn("Error allocating new block", a->error_udata);
+            }
+            return NULL;
+        }
+        tc->start = (uintptr_t)chunk;
+        tc->curr = tc->start;
+        tc->end = tc->curr + a->chunkSize;
+        p = alignForward(tc->curr, align);
     }
-    return pdata;
+    tc->curr = p + size;
+    addStat(&tc->nallocs, 1);
+    addStat(&tc->nbytes, size);
+    return (void*)p;
 }
 
 void* cx_pool_allocator_realloc(CxPoolAllocator* a, void* old_ptr, size_t old_size, size_t size) {
 
+    if (cx_pool_allocator_resize(a, old_ptr, old_size, size)) {
+        return old_ptr;
+    }
     if (size <= old_size) {
         return old_ptr;
     }
+    void* pblock = reallocBlock(a, old_ptr, old_size, size);
+    if (pblock != NULL) {
+        return pblock;
+    }
 
     void* pnew = cx_pool_allocator_alloc(a, size);
     if (pnew == NULL) {
@@ -124,65 +233,180 @@ void* cx_pool_allocator_realloc(CxPoolAllocator* a, void* old_ptr, size_t old_si
     }
 
     if (old_ptr != NULL) {
-        assert(pthread_mutex_lock(&a->lock) == 0);
         memcpy(pnew, old_ptr, old_size);
-        assert(pthread_mutex_unlock(&a->lock) == 0);
     }
     return pnew;
 }
 
-void cx_pool_allocator_clear(CxPoolAllocator* a) {
+bool cx_pool_allocator_resize(CxPoolAllocator* a, void* ptr, size_t old_size, size_t size) {
 
-    assert(pthread_mutex_lock(&a->lock) == 0);
-    if (a->firstBlock == NULL) {
-        goto exit;
+    if (ptr == NULL) {
+        return false;
+    }
+    const uintptr_t p = (uintptr_t)ptr;
+
+    // Last allocation from the chunk of the calling thread
+    if (a->chunkSize) {
+        const size_t idx = a->id % TLS_CACHES;
+        ThreadCache* tc = tlsCaches[idx].id == a->id ? tlsCaches[idx].tc : NULL;
+        if (tc != NULL && tc->curr != 0 && p >= tc->start && p + old_size == tc->curr) {
+            if (p + size > tc->end) {
+                return false;
+            }
+            tc->curr = p + size;
+            if (size > old_size) {
+                addStat(&tc->nbytes, size - old_size);
+            }
+            return true;
+        }
     }
-    // Join free blocks chain with the used blocks
-    if (a->nextFree != NULL) {
-        Block *curr = a->nextFree;
-        Block *next = a->nextFree->next;
-        while (next != NULL) {
-            curr = next;
-            next = curr->next;
+
+    // Last allocation from the current shared block
+    bool res = false;
+    CXCHKZ(pthread_mutex_lock(&a->lock));
+    const Block* b = a->currBlock;
+    if (b != NULL) {
+        const uintptr_t data = (uintptr_t)b->data;
+        const uintptr_t floor = b == a->markBlock ? data + a->markUsed : data;
+        if (p >= floor && p + old_size == data + a->used && p + size <= data + b->size) {
+            a->used = p + size - data;
+            if (size > old_size) {
+                a->nbytes += size - old_size;
+            }
+            res = true;
         }
-        curr->next = a->firstBlock;
+    }
+    CXCHKZ(pthread_mutex_unlock(&a->lock));
+    return res;
+}
+
+CxPoolAllocatorMark cx_pool_allocator_mark(CxPoolAllocator* a) {
+
+    CXCHKZ(pthread_mutex_lock(&a->lock));
+    // Following allocations from thread caches must use new chunks.
+    // Writes the caches of other threads, which must not be allocating.
+    releaseChunks(a);
+    a->markBlock = a->currBlock;
+    a->markUsed = a->used;
+    CxPoolAllocatorMark mark = {
+        .block_ = a->currBlock,
+        .prev_ = a->prevBlock,
+        .used_ = a->used,
+        .nallocs_ = a->nallocs,
+        .nbytes_ = a->nbytes,
+        .usedBlocks_ = a->usedBlocks,
+        .usedBytes_ = a->usedBytes,
+        .wastedBytes_ = a->wastedBytes,
+    };
+    CXCHKZ(pthread_mutex_unlock(&a->lock));
+    return mark;
+}
+
+void cx_pool_allocator_rewind(CxPoolAllocator* a, CxPoolAllocatorMark mark) {
+
+    CXCHKZ(pthread_mutex_lock(&a->lock));
+    releaseChunks(a);
+    // Prepends the blocks allocated after the mark to the chain of cleared blocks
+    Block* b = mark.block_;
+    Block* rest = b != NULL ? b->next : a->firstBlock;
+    if (rest != NULL) {
+        a->currBlock->next = a->cleared;
+        a->cleared = rest;
+        a->freeBlocks += a->usedBlocks - mark.usedBlocks_;
+        a->freeBytes += a->usedBytes - mark.usedBytes_;
+    }
+    if (b != NULL) {
+        b->next = NULL;
     } else {
-        a->nextFree = a->firstBlock;
+        a->firstBlock = NULL;
+    }
+    a->currBlock = b;
+    a->prevBlock = mark.prev_;
+    a->used = mark.used_;
+    a->markBlock = b;
+    a->markUsed = mark.used_;
+    a->nallocs = mark.nallocs_;
+    a->nbytes = mark.nbytes_;
+    a->usedBlocks = mark.usedBlocks_;
+    a->usedBytes = mark.usedBytes_;
+    a->wastedBytes = mark.wastedBytes_;
+    CXCHKZ(pthread_mutex_unlock(&a->lock));
+}
+
+CxPoolScratch cx_pool_allocator_scratch_begin(void) {
+
+    if (scratchPool == NULL) {
+        CXCHKZ(pthread_once(&scratchOnce, scratchInit));
+        scratchPool = cx_pool_allocator_create(SCRATCH_BLOCK_SIZE, NULL);
+        CXCHKZ(pthread_setspecific(scratchKey, scratchPool));
+    }
+    return (CxPoolScratch){
+        .pool = scratchPool,
+        .alloc = cx_pool_allocator_iface(scratchPool),
+        .mark = cx_pool_allocator_mark(scratchPool),
+    };
+}
+
+void cx_pool_allocator_scratch_end(CxPoolScratch* s) {
+
+    cx_pool_allocator_rewind(s->pool, s->mark);
+}
+
+void cx_pool_allocator_clear(CxPoolAllocator* a) {
+
+    CXCHKZ(pthread_mutex_lock(&a->lock));
+    if (a->firstBlock == NULL) {
+        goto exit;
     }
+    // Prepends the used blocks chain to the chain of cleared blocks,
+    // which are moved to the bins only when searched for a new block.
+    a->currBlock->next = a->cleared;
+    a->cleared = a->firstBlock;
+    a->freeBlocks += a->usedBlocks;
+    a->freeBytes += a->usedBytes;
     a->firstBlock = NULL;
     a->currBlock = NULL;
+    a->prevBlock = NULL;
+    a->markBlock = NULL;
+    a->markUsed = 0;
     a->used = 0;
     a->nallocs = 0;
     a->nbytes = 0;
+    a->usedBlocks = 0;
+    a->usedBytes = 0;
+    a->wastedBytes = 0;
+    resetCaches(a);
 
 exit:
-    assert(pthread_mutex_unlock(&a->lock) == 0);
+    CXCHKZ(pthread_mutex_unlock(&a->lock));
 }
 
 void cx_pool_allocator_free(CxPoolAllocator* a) {
 
-    assert(pthread_mutex_lock(&a->lock) == 0);
-    // Free used blocks
-    Block *b = a->firstBlock;
-    while (b != NULL) {
-        Block* next = b->next;
-        cx_alloc_free(a->alloc, b, sizeof(Block));
-        b = next;
+    CXCHKZ(pthread_mutex_lock(&a->lock));
+    freeChain(a, a->firstBlock);
+    freeChain(a, a->cleared);
+    for (size_t i = 0; i < NBINS; i++) {
+        freeChain(a, a->bins[i]);
+        a->bins[i] = NULL;
     }
-    // Free unused blocks
-    b = a->nextFree;
-    while (b != NULL) {
-        Block* next = b->next;
-        cx_alloc_free(a->alloc, b, sizeof(Block));
-        b = next;
-    }
-    a->nextFree = NULL;
+    a->binMask = 0;
+    a->cleared = NULL;
     a->currBlock = NULL;
+    a->prevBlock = NULL;
+    a->markBlock = NULL;
+    a->markUsed = 0;
     a->firstBlock = NULL;
     a->used = 0;
     a->nallocs = 0;
     a->nbytes = 0;
-    assert(pthread_mutex_unlock(&a->lock) == 0);
+    a->usedBlocks = 0;
+    a->usedBytes = 0;
+    a->freeBlocks = 0;
+    a->freeBytes = 0;
+    a->wastedBytes = 0;
+    resetCaches(a);
+    CXCHKZ(pthread_mutex_unlock(&a->lock));
 }
 
 static void cxAllocPoolDummyFree(void* ctx, void* p, size_t n) {}
@@ -194,55 +418,154 @@ const CxAllocator* cx_pool_allocator_iface(const CxPoolAllocator* a) {
 
 CxPoolAllocatorStats cx_pool_allocator_stats(CxPoolAllocator* a) {
 
-    assert(pthread_mutex_lock(&a->lock) == 0);
+    CXCHKZ(pthread_mutex_lock(&a->lock));
     CxPoolAllocatorStats stats = {
         .nallocs = a->nallocs,
         .nbytes = a->nbytes,
+        .usedBlocks = a->usedBlocks,
+        .freeBlocks = a->freeBlocks,
+        .usedBytes = a->usedBytes,
+        .freeBytes = a->freeBytes,
+        .wastedBytes = a->wastedBytes,
     };
 
-    // Counts number of used blocks
-    Block* curr = a->firstBlock;
-    while (curr != NULL) {
-        stats.usedBlocks++;
-        curr = curr->next;
+    // Adds the allocations from the thread caches
+    for (ThreadCache* tc = a->caches; tc != NULL; tc = tc->next) {
+        stats.nallocs += atomic_load_explicit(&tc->nallocs, memory_order_relaxed);
+        stats.nbytes += atomic_load_explicit(&tc->nbytes, memory_order_relaxed);
     }
+    CXCHKZ(pthread_mutex_unlock(&a->lock));
+    return stats;
+}
+
+// Allocates from the shared blocks, locking the allocator
+static void* allocShared(CxPoolAllocator* a, size_t size, size_t align) {
 
-    // Counts number of unused blocks
-    curr = a->nextFree;
-    while (curr != NULL) {
-        stats.freeBlocks++;
-        curr = curr->next;
+    CXCHKZ(pthread_mutex_lock(&a->lock));
+    void* pdata = allocLocked(a, size, align);
+    if (pdata) {
+        a->nallocs++;
+        a->nbytes += size;
     }
-    assert(pthread_mutex_unlock(&a->lock) == 0);
-    return stats;
+    CXCHKZ(pthread_mutex_unlock(&a->lock));
+    if (pdata == NULL && a->error_fn) {
+        a->error_fn("Error allocating new block", a->error_udata);
+    }
+    return pdata;
 }
 
-// Allocates a new block for with the specified size.
-static inline int newBlock(CxPoolAllocator* a, size_t size) {
+// Allocates from the current block or from a new block.
+// Must be called with the allocator locked.
+static inline void* allocLocked(CxPoolAllocator* a, size_t size, size_t align) {
 
-    // Adjusts block size
-    size = size > a->blockSize ? size : a->blockSize;
+    uintptr_t padding = 0;
+    if (a->currBlock) {
+        padding = alignForward(a->used, align) - a->used;
+    }
+    if (a->currBlock == NULL || (a->used + padding + size > a->currBlock->size)) {
+        const size_t left = a->currBlock ? a->currBlock->size - a->used : 0;
+        if (newBlock(a, size)) {
+            return NULL;
+        }
+        a->wastedBytes += left;
+        padding = 0;
+    }
+    void* pdata = a->currBlock->data + a->used + padding;
+    a->used += padding + size;
+    a->wastedBytes += padding;
+    return pdata;
+}
+
+// Returns the cache of the calling thread for the specified allocator,
+// creating it if necessary. Returns NULL if the cache could not be allocated.
+static ThreadCache* threadCache(CxPoolAllocator* a) {
 
-    Block* new = NULL;
-    // Looks for free block which fits requested size
-    if (a->nextFree != NULL) {
-        Block* prev = NULL;
-        Block* curr = a->nextFree;
-        while (curr != NULL && curr->size < size) {
-            prev = curr;
-            curr = curr->next;
+    const size_t idx = a->id % TLS_CACHES;
+    if (tlsCaches[idx].id == a->id) {
+        return tlsCaches[idx].tc;
+    }
+
+    // The cache of this thread may have been evicted from the thread local table
+    // by another allocator, so looks for it before creating a new one.
+    const pthread_t self = pthread_self();
+    CXCHKZ(pthread_mutex_lock(&a->lock));
+    ThreadCache* tc = a->caches;
+    while (tc != NULL && !pthread_equal(tc->owner, self)) {
+        tc = tc->next;
+    }
+    if (tc == NULL) {
+        tc = cx_alloc_mallocz(a->alloc, sizeof(ThreadCache));
+        if (tc != NULL) {
+            tc->owner = self;
+            tc->next = a->caches;
+            a->caches = tc;
         }
-        if (curr != NULL) {
-            new = curr;
-            if (prev != NULL) {
-                prev->next = curr->next;
-            } else {
-                a->nextFree = curr->next;
-            }
+    }
+    CXCHKZ(pthread_mutex_unlock(&a->lock));
+    if (tc != NULL) {
+        tlsCaches[idx].id = a->id;
+        tlsCaches[idx].tc = tc;
+    }
+    return tc;
+}
+
+// Drops the current chunks and statistics of all thread caches.
+// Must be called with the allocator locked.
+static void resetCaches(CxPoolAllocator* a) {
+
+    for (ThreadCache* tc = a->caches; tc != NULL; tc = tc->next) {
+        tc->start = 0;
+        tc->curr = 0;
+        tc->end = 0;
+        atomic_store_explicit(&tc->nallocs, 0, memory_order_relaxed);
+        atomic_store_explicit(&tc->nbytes, 0, memory_order_relaxed);
+    }
+}
+
+// Drops the current chunks of all thread caches and moves their statistics to the allocator.
+// Must be called with the allocator locked and without concurrent allocations.
+static void releaseChunks(CxPoolAllocator* a) {
+
+    for (ThreadCache* tc = a->caches; tc != NULL; tc = tc->next) {
+        if (tc->curr != 0) {
+            a->wastedBytes += tc->end - tc->curr;
         }
+        tc->start = 0;
+        tc->curr = 0;
+        tc->end = 0;
+        a->nallocs += atomic_load_explicit(&tc->nallocs, memory_order_relaxed);
+        a->nbytes += atomic_load_explicit(&tc->nbytes, memory_order_relaxed);
+        atomic_store_explicit(&tc->nallocs, 0, memory_order_relaxed);
+        atomic_store_explicit(&tc->nbytes, 0, memory_order_relaxed);
     }
+}
+
+// Creates the key used to destroy the scratch allocators of the threads
+static void scratchInit(void) {
+
+    CXCHKZ(pthread_key_create(&scratchKey, scratchDestroy));
+}
+
+// Destroys the scratch allocator of a finished thread
+static void scratchDestroy(void* pool) {
+
+    cx_pool_allocator_destroy(pool);
+}
+
+// Adds to a statistic counter which is only updated by the owner thread
+static inline void addStat(_Atomic size_t* v, size_t n) {
+
+    atomic_store_explicit(v, atomic_load_explicit(v, memory_order_relaxed) + n, memory_order_relaxed);
+}
+
+// Allocates a new block for with the specified size.
+static inline int newBlock(CxPoolAllocator* a, size_t size) {
+
+    // Adjusts block size
+    size = size > a->blockSize ? size : a->blockSize;
 
     // If no free block found with requested size, allocates a new block
+    Block* new = takeFreeBlock(a, size);
     if (new == NULL) {
         const size_t allocSize = sizeof(Block) + size;
         new = cx_alloc_malloc(a->alloc, allocSize);
@@ -257,16 +580,148 @@ static inline int newBlock(CxPoolAllocator* a, size_t size) {
     if (a->currBlock != NULL) {
         a->currBlock->next = new;
     }
+    a->prevBlock = a->currBlock;
     a->currBlock = new;
 
     // Saves the pointer of first block of the used block chain
     if (a->firstBlock == NULL) {
         a->firstBlock = new;
     }
+    a->usedBlocks++;
+    a->usedBytes += new->size;
     a->used = 0;
     return 0;
 }
 
+// If the specified area is the only one in the current block, replaces the block by
+// a free block of the new size, releasing the old block to the free bins, or if there is
+// none, reallocates the block from the upstream allocator, which may be able to grow it
+// without copying. Returns the new pointer of the area or NULL if the area is not the only one.
+static void* reallocBlock(CxPoolAllocator* a, void* ptr, size_t old_size, size_t size) {
+
+    void* pdata = NULL;
+    CXCHKZ(pthread_mutex_lock(&a->lock));
+    Block* b = a->currBlock;
+    if (b == NULL || b == a->markBlock || ptr != (void*)b->data || old_size != a->used) {
+        goto exit;
+    }
+    const size_t bsize = size > a->blockSize ? size : a->blockSize;
+    Block* new = takeFreeBlock(a, bsize);
+    if (new != NULL) {
+        memcpy(new->data, b->data, old_size);
+        a->usedBytes -= b->size;
+        a->freeBlocks++;
+        a->freeBytes += b->size;
+        putFreeBlock(a, b);
+    } else {
+        new = cx_alloc_realloc(a->alloc, b, sizeof(Block) + b->size, sizeof(Block) + bsize);
+        if (new == NULL) {
+            goto exit;
+        }
+        a->usedBytes -= new->size;
+        new->size = bsize;
+    }
+    new->next = NULL;
+    if (a->prevBlock != NULL) {
+        a->prevBlock->next = new;
+    } else {
+        a->firstBlock = new;
+    }
+    a->currBlock = new;
+    a->usedBytes += new->size;
+    a->used = size;
+    a->nbytes += size - old_size;
+    pdata = new->data;
+
+exit:
+    CXCHKZ(pthread_mutex_unlock(&a->lock));
+    return pdata;
+}
+
+// Removes and returns a free block with at least the specified size,
+// which must not be less than the minimum block size.
+// Returns NULL if no suitable block is found.
+static inline Block* takeFreeBlock(CxPoolAllocator* a, size_t size) {
+
+    const size_t bin = binIndex(a, size);
+    Block* b = NULL;
+    // The blocks of the bin of the requested size may be smaller than it,
+    // but the blocks of the next bins are always large enough.
+    Block** pb = &a->bins[bin];
+    if (bin == NBINS - 1) {
+        while (*pb != NULL && (*pb)->size < size) {
+            pb = &(*pb)->next;
+        }
+    }
+    if (*pb != NULL && (*pb)->size >= size) {
+        b = *pb;
+        *pb = b->next;
+        if (a->bins[bin] == NULL) {
+            a->binMask &= ~((uint64_t)1 << bin);
+        }
+        goto found;
+    }
+    const uint64_t above = bin + 1 < NBINS ? a->binMask >> (bin + 1) : 0;
+    const uint64_t range = ((uint64_t)1 << MAX_BIN_DIST) - 1;
+    if (above & range) {
+        const size_t next = bin + 1 + __builtin_ctzll(above & range);
+        b = a->bins[next];
+        a->bins[next] = b->next;
+        if (a->bins[next] == NULL) {
+            a->binMask &= ~((uint64_t)1 << next);
+        }
+        goto found;
+    }
+
+    // Moves the cleared blocks to their bins until finding a suitable one
+    while (a->cleared != NULL) {
+        Block* curr = a->cleared;
+        a->cleared = curr->next;
+        const size_t cbin = binIndex(a, curr->size);
+        if (curr->size >= size && cbin <= bin + MAX_BIN_DIST) {
+            b = curr;
+            goto found;
+        }
+        putFreeBlock(a, curr);
+    }
+    return NULL;
+
+found:
+    a->freeBlocks--;
+    a->freeBytes -= b->size;
+    return b;
+}
+
+// Inserts free block in its bin without updating the free blocks statistics
+static inline void putFreeBlock(CxPoolAllocator* a, Block* b) {
+
+    const size_t bin = binIndex(a, b->size);
+    b->next = a->bins[bin];
+    a->bins[bin] = b;
+    a->binMask |= (uint64_t)1 << bin;
+}
+
+// Returns the index of the bin for blocks of the specified size,
+// which must not be less than the minimum block size.
+static inline size_t binIndex(CxPoolAllocator* a, size_t size) {
+
+    // Size ratio in quarters of the minimum block size, at least 4
+    const size_t q = size > SIZE_MAX / 4 ? SIZE_MAX : size * 4 / a->blockSize;
+    const size_t e = 63 - __builtin_clzll(q);
+    const size_t bin = (e - 2) * 4 + ((q >> (e - 2)) & 3);
+    return bin < NBINS ? bin : NBINS - 1;
+}
+
+// Frees all the blocks of the chain to the upstream allocator
+static void freeChain(CxPoolAllocator* a, Block* b) {
+
+    while (b != NULL) {
+        Block* next = b->next;
+        cx_alloc_free(a->alloc, b, sizeof(Block) + b->size);
+        b = next;
+    }
+}
+
 // Returns the aligned pointer for the specified pointer and desired alignment
 static inline uintptr_t alignForward(uintptr_t ptr, size_t align) {
 
@@ -0,0 +1,366 @@
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+#include <pthread.h>
+#include <stdatomic.h>
+
+#include "cx_alloc.h"
+#include "cx_error.h"
+#include "cx_slab_allocator.h"
+
+// Sizes of the size classes
+static const uint32_t classSizes[] = {
+    16, 32, 48, 64, 80, 96, 112, 128,
+    160, 192, 224, 256,
+    320, 384, 448, 512,
+    640, 768, 896, 1024,
+    1280, 1536, 1792, 2048,
+    2560, 3072, 3584, 4096,
+};
+#define NCLASSES (sizeof(classSizes)/sizeof(classSizes[0]))
+#define DEF_SLAB_SIZE (64*1024)
+#define MIN_SLAB_SIZE (1024)
+
+// Slab header
+typedef struct Slab Slab;
+typedef struct Slab {
+    Slab*   next;       // Pointer to next slab of the size class
+    size_t  size;       // Size of this slab (not including this header)
+    char    data[];     // Slab data
+} Slab;
+
+// Free area, linked in the free list of its size class
+typedef struct FreeArea FreeArea;
+typedef struct FreeArea {
+    FreeArea* next;
+} FreeArea;
+
+// Size class state
+typedef struct SizeClass {
+    pthread_mutex_t     lock;
+    FreeArea*           free;       // List of free areas
+    char*               curr;       // Next area never allocated of the current slab
+    char*               end;        // End of the current slab
+    Slab*               slabs;      // List of slabs of this class
+    size_t              nallocs;    // Number of allocations from the shared list
+    size_t              nfrees;     // Number of frees to the shared list
+    char                pad[64];    // Keeps the locks of different classes in different cache lines
+} SizeClass;
+
+// Thread cache with one magazine of free areas for each size class
+typedef struct ThreadCache ThreadCache;
+typedef struct ThreadCache {
+    _Atomic size_t      nallocs;            // Number of allocations from the magazines
+    _Atomic size_t      nfrees;             // Number of frees to the magazines
+    uint32_t            count[NCLASSES];    // Number of areas in each magazine
+    pthread_t           owner;              // Thread which owns this cache
+    ThreadCache*        next;               // Next cache of the allocator
+    void*               areas[];            // Magazines of all classes
+} ThreadCache;
+
+// Slab Allocator state
+typedef struct CxSlabAllocator {
+    SizeClass           classes[NCLASSES];
+    pthread_mutex_t     lock;               // Protects the list of thread caches
+    uint64_t            id;                 // Unique allocator id used by the thread local cache table
+    const CxAllocator*  alloc;              // Allocator for slabs and large areas
+    CxAllocator         iface;              // Allocator interface
+    size_t              slabSize;           // Size of slabs
+    size_t              nclasses;           // Number of size classes used
+    size_t              magazine;           // Capacity of the thread magazines (0 if disabled)
+    ThreadCache*        caches;             // List of thread caches
+    _Atomic size_t      nlarge;             // Number of allocations forwarded to upstream allocator
+    _Atomic size_t      nlargeFrees;        // Number of frees forwarded to upstream allocator
+} CxSlabAllocator;
+
+
+// Source of unique allocator ids
+static _Atomic uint64_t nextId = 1;
+
+// Thread local table of the caches of the last used allocators, indexed by allocator id
+#define TLS_CACHES (8)
+static _Thread_local struct {
+    uint64_t        id;
+    ThreadCache*    tc;
+} tlsCaches[TLS_CACHES];
+
+// Local functions forward declarations
+static inline size_t classIndex(size_t size);
+static inline void* classAlloc(CxSlabAllocator* a, size_t ci);
+static inline void classFree(CxSlabAllocator* a, size_t ci, void* p);
+static ThreadCache* threadCache(CxSlabAllocator* a);
+static inline void addStat(_Atomic size_t* v, size_t n);
+
+
+CxSlabAllocator* cx_slab_allocator_create(size_t slabSize, const CxAllocator* alloc) {
+
+    if (alloc == NULL) {
+        alloc = cx_def_allocator();
+    }
+    if (slabSize == 0) {
+        slabSize = DEF_SLAB_SIZE;
+    }
+    if (slabSize < MIN_SLAB_SIZE) {
+        slabSize = MIN_SLAB_SIZE;
+    }
+    CxSlabAllocator* a = cx_alloc_mallocz(alloc, sizeof(CxSlabAllocator));
+    a->alloc = alloc;
+    a->iface = (CxAllocator){
+        .ctx = a,
+        .alloc = (CxAllocatorAllocFn)cx_slab_allocator_alloc,
+        .free = (CxAllocatorFreeFn)cx_slab_allocator_free,
+        .realloc = (CxAllocatorReallocFn)cx_slab_allocator_realloc,
+    };
+    CXCHKZ(pthread_mutex_init(&a->lock, NULL));
+    for (size_t ci = 0; ci < NCLASSES; ci++) {
+        CXCHKZ(pthread_mutex_init(&a->classes[ci].lock, NULL));
+    }
+    a->id = atomic_fetch_add(&nextId, 1);
+    a->slabSize = slabSize;
+    // Uses the classes which fit at least 8 times in a slab
+    while (a->nclasses < NCLASSES && classSizes[a->nclasses] * 8 <= slabSize) {
+        a->nclasses++;
+    }
+    return a;
+}
+
+void cx_slab_allocator_destroy(CxSlabAllocator* a) {
+
+    for (size_t ci = 0; ci < NCLASSES; ci++) {
+        SizeClass* c = &a->classes[ci];
+        Slab* s = c->slabs;
+        while (s != NULL) {
+            Slab* next = s->next;
+            cx_alloc_free(a->alloc, s, sizeof(Slab) + s->size);
+            s = next;
+        }
+        CXCHKZ(pthread_mutex_destroy(&c->lock));
+    }
+    ThreadCache* tc = a->caches;
+    while (tc != NULL) {
+        ThreadCache* next = tc->next;
+        cx_alloc_free(a->alloc, tc, sizeof(ThreadCache) + NCLASSES * a->magazine * sizeof(void*));
+        tc = next;
+    }
+    CXCHKZ(pthread_mutex_destroy(&a->lock));
+    cx_alloc_free(a->alloc, a, sizeof(CxSlabAllocator));
+}
+
+void cx_slab_allocator_set_magazine(CxSlabAllocator* a, size_t capacity) {
+
+    assert(a->caches == NULL);
+    a->magazine = capacity == 1 ? 2 : capacity;
+}
+
+void* cx_slab_allocator_alloc(CxSlabAllocator* a, size_t size) {
+
+    const size_t ci = classIndex(size);
+    if (ci >= a->nclasses) {
+        atomic_fetch_add_explicit(&a->nlarge, 1, memory_order_relaxed);
+        return cx_alloc_malloc(a->alloc, size);
+    }
+    ThreadCache* tc = a->magazine ? threadCache(a) : NULL;
+    if (tc == NULL) {
+        SizeClass* c = &a->classes[ci];
+        CXCHKZ(pthread_mutex_lock(&c->lock));
+        void* p = classAlloc(a, ci);
+        c->nallocs += p != NULL;
+        CXCHKZ(pthread_mutex_unlock(&c->lock));
+        return p;
+    }
+
+    // If the magazine is empty, fills half of it from the shared list
+    void** mag = tc->areas + ci * a->magazine;
+    if (tc->count[ci] == 0) {
+        SizeClass* c = &a->classes[ci];
+        CXCHKZ(pthread_mutex_lock(&c->lock));
+        for (size_t i = 0; i < a->magazine / 2; i++) {
+            void* p = classAlloc(a, ci);
+            if (p == NULL) {
+                break;
+            }
+            mag[tc->count[ci]++] = p;
+        }
+        CXCHKZ(pthread_mutex_unlock(&c->lock));
+        if (tc->count[ci] == 0) {
+            return NULL;
+        }
+    }
+    addStat(&tc->nallocs, 1);
+    return mag[--tc->count[ci]];
+}
+
+void cx_slab_allocator_free(CxSlabAllocator* a, void* ptr, size_t size) {
+
+    if (ptr == NULL) {
+        return;
+    }
+    const size_t ci = classIndex(size);
+    if (ci >= a->nclasses) {
+        atomic_fetch_add_explicit(&a->nlargeFrees, 1, memory_order_relaxed);
+        cx_alloc_free(a->alloc, ptr, size);
+        return;
+    }
+    ThreadCache* tc = a->magazine ? threadCache(a) : NULL;
+    if (tc == NULL) {
+        SizeClass* c = &a->classes[ci];
+        CXCHKZ(pthread_mutex_lock(&c->lock));
+        classFree(a, ci, ptr);
+        c->nfrees++;
+        CXCHKZ(pthread_mutex_unlock(&c->lock));
+        return;
+    }
+
+    // If the magazine is full, returns half of it to the shared list
+    void** mag = tc->areas + ci * a->magazine;
+    if (tc->count[ci] == a->magazine) {
+        SizeClass* c = &a->classes[ci];
+        CXCHKZ(pthread_mutex_lock(&c->lock));
+        for (size_t i = 0; i < a->magazine / 2; i++) {
+            classFree(a, ci, mag[--tc->count[ci]]);
+        }
+        CXCHKZ(pthread_mutex_unlock(&c->lock));
+    }
+    mag[tc->count[ci]++] = ptr;
+    addStat(&tc->nfrees, 1);
+}
+
+void* cx_slab_allocator_realloc(CxSlabAllocator* a, void* old_ptr, size_t old_size, size_t size) {
+
+    if (old_ptr == NULL) {
+        return cx_slab_allocator_alloc(a, size);
+    }
+    const size_t ci = classIndex(size);
+    if (ci < a->nclasses && ci == classIndex(old_size)) {
+        return old_ptr;
+    }
+    void* pnew = cx_slab_allocator_alloc(a, size);
+    if (pnew == NULL) {
+        return NULL;
+    }
+    memcpy(pnew, old_ptr, old_size < size ? old_size : size);
+    cx_slab_allocator_free(a, old_ptr, old_size);
+    return pnew;
+}
+
+const CxAllocator* cx_slab_allocator_iface(const CxSlabAllocator* a) {
+
+    return &a->iface;
+}
+
+CxSlabAllocatorStats cx_slab_allocator_stats(CxSlabAllocator* a) {
+
+    CxSlabAllocatorStats stats = {
+        .nallocs = atomic_load_explicit(&a->nlarge, memory_order_relaxed),
+        .nfrees = atomic_load_explicit(&a->nlargeFrees, memory_order_relaxed),
+    };
+    for (size_t ci = 0; ci < a->nclasses; ci++) {
+        SizeClass* c = &a->classes[ci];
+        CXCHKZ(pthread_mutex_lock(&c->lock));
+        stats.nallocs += c->nallocs;
+        stats.nfrees += c->nfrees;
+        for (Slab* s = c->slabs; s != NULL; s = s->next) {
+            stats.nslabs++;
+            stats.slabBytes += s->size;
+        }
+        CXCHKZ(pthread_mutex_unlock(&c->lock));
+    }
+    CXCHKZ(pthread_mutex_lock(&a->lock));
+    for (ThreadCache* tc = a->caches; tc != NULL; tc = tc->next) {
+        stats.nallocs += atomic_load_explicit(&tc->nallocs, memory_order_relaxed);
+        stats.nfrees += atomic_load_explicit(&tc->nfrees, memory_order_relaxed);
+    }
+    CXCHKZ(pthread_mutex_unlock(&a->lock));
+    return stats;
+}
+
+// Returns the index of the size class for the specified size
+static inline size_t classIndex(size_t size) {
+
+    if (size <= 128) {
+        return size == 0 ? 0 : (size - 1) / 16;
+    }
+    // Four classes for each power of two
+    const size_t s = size - 1;
+    const size_t e = 63 - __builtin_clzll(s);
+    return 8 + (e - 7) * 4 + ((s >> (e - 2)) & 3);
+}
+
+// Allocates area from the free list or from the current slab of the size class.
+// Must be called with the class locked.
+static inline void* classAlloc(CxSlabAllocator* a, size_t ci) {
+
+    SizeClass* c = &a->classes[ci];
+    if (c->free != NULL) {
+        FreeArea* p = c->free;
+        c->free = p->next;
+        return p;
+    }
+    const size_t size = classSizes[ci];
+    if (c->curr == NULL || c->curr + size > c->end) {
+        Slab* s = cx_alloc_malloc(a->alloc, sizeof(Slab) + a->slabSize);
+        if (s == NULL) {
+            return NULL;
+        }
+        s->size = a->slabSize;
+        s->next = c->slabs;
+        c->slabs = s;
+        c->curr = s->data;
+        c->end = s->data + s->size;
+    }
+    void* p = c->curr;
+    c->curr += size;
+    return p;
+}
+
+// Inserts area in the free list of the size class.
+// Must be called with the class locked.
+static inline void classFree(CxSlabAllocator* a, size_t ci, void* p) {
+
+    SizeClass* c = &a->classes[ci];
+    FreeArea* area = p;
+    area->next = c->free;
+    c->free = area;
+}
+
+// Returns the cache of the calling thread for the specified allocator,
+// creating it if necessary. Returns NULL if the cache could not be allocated.
+static ThreadCache* threadCache(CxSlabAllocator* a) {
+
+    const size_t idx = a->id % TLS_CACHES;
+    if (tlsCaches[idx].id == a->id) {
+        return tlsCaches[idx].tc;
+    }
+
+    // The cache of this thread may have been evicted from the thread local table
+    // by another allocator, so looks for it before creating a new one.
+    const pthread_t self = pthread_self();
+    CXCHKZ(pthread_mutex_lock(&a->lock));
+    ThreadCache* tc = a->caches;
+    while (tc != NULL && !pthread_equal(tc->owner, self)) {
+        tc = tc->next;
+    }
+    if (tc == NULL) {
+        tc = cx_alloc_mallocz(a->alloc, sizeof(ThreadCache) + NCLASSES * a->magazine * sizeof(void*));
+        if (tc != NULL) {
+            tc->owner = self;
+            tc->next = a->caches;
+            a->caches = tc;
+        }
+    }
+    CXCHKZ(pthread_mutex_unlock(&a->lock));
+    if (tc != NULL) {
+        tlsCaches[idx].id = a->id;
+        tlsCaches[idx].tc = tc;
+    }
+    return tc;
+}
+
+// Adds to a statistic counter which is only updated by the owner thread
+static inline void addStat(_Atomic size_t* v, size_t n) {
+
+    atomic_store_explicit(v, atomic_load_explicit(v, memory_order_relaxed) + n, memory_order_relaxed);
+}
+
@@ -34,34 +34,30 @@ typedef struct CxVar CxVar;
 #define cx_array_implement
 #include "cx_array.h"
 
-// Define array to store map keys in order
-#define cx_array_name cxvar_keys
-#define cx_array_type char*
-#define cx_array_instance_allocator
-#define cx_array_static
-#define cx_array_implement
-#include "cx_array.h"
-
-// Define hash map used in CxVar
-#define cx_hmap_name cxvar_map
-#define cx_hmap_key char*
-#define cx_hmap_val CxVar*
-#define cx_hmap_cmp_key(pk1,pk2)    strcmp(*pk1,*pk2)
-#define cx_hmap_hash_key(pk)        cx_hmap_hash_fnv1a32(*pk, strlen(*pk))
-#define cx_hmap_instance_allocator
-#define cx_hmap_static
-#define cx_hmap_implement
-#include "cx_hmap.h"
+// Define dictionary used in CxVar, which keeps the order of the keys inserted
+uint64_t cx_hmap_hash_wy64(const void* buf, size_t len);
+uint64_t cx_hmap_hash_wy64_str(const char* str);
+
+// Compares NUL terminated key with key with the specified length
+static inline int cxvar_cmp_keyn(const char* s, const char* key, size_t len) {
+    return strncmp(s, key, len) != 0 || strnlen(s, len + 1) != len;
+}
+
+#define cx_dict_name cxvar_map
+#define cx_dict_key char*
+#define cx_dict_val CxVar*
+#define cx_dict_cmp_key(pk1,pk2,s)  strcmp(*(char**)(pk1),*(char**)(pk2))
+#define cx_dict_hash_key(pk,s)      cx_hmap_hash_wy64_str(*(char**)(pk))
+#define cx_dict_cmp_keyn(pk,key,len) cxvar_cmp_keyn(*(char**)(pk),key,len)
+#define cx_dict_cache_hash
+#define cx_dict_instance_allocator
+#define cx_dict_static
+#define cx_dict_implement
+#include "cx_dict.h"
 
 #include "cx_alloc.h"
 #include "cx_var.h"
 
-// CxVar map contains an array to keep the order of the keys inserted
-typedef struct cxvar_maparr {
-    cxvar_keys keys;
-    cxvar_map  map;     
-} cxvar_maparr;
-
 // Declare CxVar state
 typedef struct CxVar {
     const CxAllocator*  alloc;
@@ -73,7 +69,7 @@ typedef struct CxVar {
         cxvar_str*      str;
         cxvar_arr*      arr;
         cxvar_buf*      buf;
-        cxvar_maparr*   map;
+        cxvar_map*      map;
     } v;
 } CxVar;
 
@@ -166,12 +162,10 @@ CxVar* cx_var_set_map(CxVar* var) {
     if (var->type != CxVarMap) {
         cx_var_free_cont(var);
         var->type = CxVarMap;
-        var->v.map = cx_alloc_malloc(var->alloc, sizeof(cxvar_maparr));
-        var->v.map->keys = cxvar_keys_init(var->alloc);
-        var->v.map->map = cxvar_map_init(var->alloc, 0);
+        var->v.map = cx_alloc_malloc(var->alloc, sizeof(cxvar_map));
+        *var->v.map = cxvar_map_init(var->alloc);
     }
-    cxvar_keys_clear(&var->v.map->keys);
-    cxvar_map_clear(&var->v.map->map);
+    cxvar_map_clear(var->v.map);
     return var;
 }
 
@@ -257,17 +251,17 @@ CxVar* cx_var_set_map_valn(CxVar* map, const char* key, size_t key_len, CxVar* v
         return NULL;
     }
 
-    // If no current value at this key, sets with the specified 'val'
-    CxVar** curr = cxvar_map_get(&map->v.map->map, (char*)key);
-    if (curr == NULL) {
-        char* key_copy = cx_alloc_malloc(map->alloc, key_len + 1);
-        strcpy(key_copy, key);
-        cxvar_map_set(&map->v.map->map, key_copy, val);
-        cxvar_keys_push(&map->v.map->keys, key_copy);
-        return val;
+    // Copies the key only if a new entry was inserted, otherwise replaces the current value
+    bool inserted;
+    cxvar_map_entry* e = cxvar_map_emplacen(map->v.map, key, key_len, cx_hmap_hash_wy64(key, key_len), &inserted);
+    if (inserted) {
+        e->key = cx_alloc_malloc(map->alloc, key_len + 1);
+        memcpy(e->key, key, key_len);
+        e->key[key_len] = 0;
+    } else {
+        cx_var_del(e->val);
     }
-    cx_var_del(*curr);
-    cxvar_map_set(&map->v.map->map, (char*)key, val);
+    e->val = val;
     return val;
 }
 
@@ -495,7 +489,7 @@ CxVar* cx_var_get_map_len(const CxVar* map, size_t* len) {
     if (map->type != CxVarMap) {
         return NULL;
     }
-    *len = cxvar_map_count(&map->v.map->map);
+    *len = cxvar_map_count(map->v.map);
     return (CxVar*)map;
 }
 
@@ -504,10 +498,26 @@ const char* cx_var_get_map_key(const CxVar* map, size_t order) {
     if (map->type != CxVarMap) {
         return NULL;
     }
-    if (order >= cxvar_keys_len(&map->v.map->keys)) {
+    cxvar_map_entry* e = cxvar_map_at(map->v.map, order);
+    if (e == NULL) {
         return NULL;
     }
-    return map->v.map->keys.data[order];
+    return e->key;
+}
+
+CxVar* cx_var_get_map_at(const CxVar* map, size_t order, const char** key) {
+
+    if (map->type != CxVarMap) {
+        return NULL;
+    }
+    cxvar_map_entry* e = cxvar_map_at(map->v.map, order);
+    if (e == NULL) {
+        return NULL;
+    }
+    if (key) {
+        *key = e->key;
+    }
+    return e->val;
 }
 
 CxVar* cx_var_get_map_val(const CxVar* map, const char* key) {
@@ -515,7 +525,19 @@ CxVar* cx_var_get_map_val(const CxVar* map, const char* key) {
     if (map->type != CxVarMap) {
         return NULL;
     }
-    CxVar** val = cxvar_map_get(&map->v.map->map, (char*)key);
+    CxVar** val = cxvar_map_get(map->v.map, (char*)key);
+    if (val == NULL) {
+        return NULL;
+    }
+    return *val;
+}
+
+CxVar* cx_var_get_map_valn(const CxVar* map, const char* key, size_t key_len) {
+
+    if (map->type != CxVarMap) {
+        return NULL;
+    }
+    CxVar** val = cxvar_map_getn(map->v.map, key, key_len, cx_hmap_hash_wy64(key, key_len));
     if (val == NULL) {
         return NULL;
     }
@@ -671,8 +693,8 @@ CxVar* cx_var_cpy_val(const CxVar* src, CxVar* dst) {
             size_t len;
             cx_var_get_map_len(src, &len);
             for (size_t i = 0; i < len; i++) {
-                const char* key = cx_var_get_map_key(src, i);
-                CxVar* src_val = cx_var_get_map_val(src, key);
+                const char* key;
+                CxVar* src_val = cx_var_get_map_at(src, i, &key);
                 CxVar* dst_val = cx_var_new(dst->alloc);
                 cx_var_cpy_val(src_val, dst_val);
                 cx_var_set_map_val(dst, key, dst_val);
@@ -708,17 +730,13 @@ static void cx_var_free_cont(CxVar* var) {
             var->v.arr = NULL;
             break;
         case CxVarMap: {
-            cxvar_keys_free(&var->v.map->keys);
             cxvar_map_iter iter = {0};
-            while (true) {
-                cxvar_map_entry* e = cxvar_map_next(&var->v.map->map, &iter);
-                if (e == NULL) {
-                    break;
-                }
+            cxvar_map_entry* e;
+            while ((e = cxvar_map_next(var->v.map, &iter)) != NULL) {
                 cx_alloc_free(var->alloc, e->key, strlen(e->key)+1);
                 cx_var_del(e->val);
             }
-            cxvar_map_free(&var->v.map->map);
+            cxvar_map_free(var->v.map);
             cx_alloc_free(var->alloc, var->v.map, sizeof(cxvar_map));
             var->v.map = NULL;
             break;
@@ -1,19 +1,24 @@
 #include <stdio.h>
-#include <assert.h>
 #include <stdlib.h>
+#include <stdint.h>
 #include <time.h>
+#include <pthread.h>
 
 #include "registry.h"
+#include "cx_arena_allocator.h"
 #include "cx_pool_allocator.h"
+#include "cx_slab_allocator.h"
 #include "logger.h"
+#include "util.h"
 
 
-static void test_alloc_pool(size_t allocs, size_t blockSize, size_t ncycles) {
+static void test_alloc_pool(size_t allocs, size_t blockSize, size_t ncycles, size_t chunkSize) {
 
-    LOGI("alloc pool test. allocs=%lu blockSize=%lu cycles:%lu ", allocs, blockSize, ncycles);
+    LOGI("alloc pool test. allocs=%lu blockSize=%lu cycles:%lu chunkSize:%lu", allocs, blockSize, ncycles, chunkSize);
 
     // Creates pool allocator
     CxPoolAllocator* pa = cx_pool_allocator_create(blockSize, NULL);
+    cx_pool_allocator_set_thread_cache(pa, chunkSize);
     const CxAllocator* alloc = cx_pool_allocator_iface(pa);
 
     // Allocation group
@@ -50,7 +55,7 @@ static void test_alloc_pool(size_t allocs, size_t blockSize, size_t ncycles) {
         // Check all groups
         for (size_t i = 0; i < allocs; i++) {
             for (size_t j = 0; j < groups[i].count; j++) {
-                assert(groups[i].p[j] == groups[i].value);
+                CHK(groups[i].p[j] == groups[i].value);
             }
         }
         // Clear the allocator before restarting the cycle
@@ -77,11 +82,531 @@ void test_alloc_pool_print(CxPoolAllocator* pa) {
     );
 }
 
+// Checks the reuse of blocks by size after clear and the fragmentation statistics
+static void test_alloc_pool_reuse(void) {
+
+    LOGI("alloc pool reuse test");
+    CxPoolAllocator* pa = cx_pool_allocator_create(1024, NULL);
+
+    // Allocation which doesn't fit in the current block wastes its end
+    cx_pool_allocator_alloc(pa, 1000);
+    cx_pool_allocator_alloc(pa, 100);
+    CxPoolAllocatorStats stats = cx_pool_allocator_stats(pa);
+    CHK(stats.usedBlocks == 2 && stats.usedBytes == 2048 && stats.wastedBytes == 24);
+    // Large allocation uses its own block
+    cx_pool_allocator_alloc(pa, 10000);
+    stats = cx_pool_allocator_stats(pa);
+    CHK(stats.usedBlocks == 3 && stats.usedBytes == 2048 + 10000);
+
+    cx_pool_allocator_clear(pa);
+    stats = cx_pool_allocator_stats(pa);
+    CHK(stats.usedBlocks == 0 && stats.usedBytes == 0 && stats.wastedBytes == 0);
+    CHK(stats.freeBlocks == 3 && stats.freeBytes == 2048 + 10000);
+
+    // Small allocations reuse the small blocks, and then allocate new blocks
+    // instead of using the large block
+    for (size_t i = 0; i < 3; i++) {
+        cx_pool_allocator_alloc(pa, 1000);
+    }
+    stats = cx_pool_allocator_stats(pa);
+    CHK(stats.usedBlocks == 3 && stats.usedBytes == 3 * 1024);
+    CHK(stats.freeBlocks == 1 && stats.freeBytes == 10000);
+    // Large allocation of similar size reuses the large block
+    cx_pool_allocator_alloc(pa, 9000);
+    stats = cx_pool_allocator_stats(pa);
+    CHK(stats.usedBlocks == 4 && stats.freeBlocks == 0 && stats.freeBytes == 0);
+
+    // Repeated cycles don't allocate new blocks
+    for (size_t cycle = 0; cycle < 10; cycle++) {
+        cx_pool_allocator_clear(pa);
+        for (size_t i = 0; i < 3; i++) {
+            cx_pool_allocator_alloc(pa, 1000);
+        }
+        cx_pool_allocator_alloc(pa, 9000);
+        stats = cx_pool_allocator_stats(pa);
+        CHK(stats.usedBlocks == 4 && stats.freeBlocks == 0);
+    }
+    cx_pool_allocator_destroy(pa);
+}
+
+// Checks in place growth and shrink of the last allocated area
+static void test_alloc_pool_resize(size_t chunkSize) {
+
+    LOGI("alloc pool resize test. chunkSize:%lu", chunkSize);
+    CxPoolAllocator* pa = cx_pool_allocator_create(64*1024, NULL);
+    cx_pool_allocator_set_thread_cache(pa, chunkSize);
+    const CxAllocator* alloc = cx_pool_allocator_iface(pa);
+    const size_t maxSize = chunkSize ? chunkSize / 4 : 32*1024;
+
+    // Growing a single buffer geometrically doesn't move it
+    size_t size = 16;
+    unsigned char* buf = cx_alloc_malloc(alloc, size);
+    memset(buf, 1, size);
+    while (size * 2 <= maxSize) {
+        unsigned char* p = cx_alloc_realloc(alloc, buf, size, size * 2);
+        CHK(p == buf);
+        memset(p + size, 1, size);
+        size *= 2;
+    }
+    for (size_t i = 0; i < size; i++) {
+        CHK(buf[i] == 1);
+    }
+    CxPoolAllocatorStats stats = cx_pool_allocator_stats(pa);
+    CHK(stats.nallocs == 1 && stats.nbytes == size);
+
+    // Shrinking the last area releases its end for the next allocation
+    CHK(cx_alloc_realloc(alloc, buf, size, 100) == buf);
+    unsigned char* next = cx_alloc_malloc(alloc, 16);
+    CHK(next == buf + 112);
+
+    // Areas which are not the last are not resized
+    CHK(!cx_pool_allocator_resize(pa, buf, 100, 200));
+    unsigned char* p = cx_alloc_realloc(alloc, buf, 100, 200);
+    CHK(p != buf);
+    for (size_t i = 0; i < 100; i++) {
+        CHK(p[i] == 1);
+    }
+    CHK(cx_pool_allocator_resize(pa, p, 200, 50));
+    CHK(cx_pool_allocator_resize(pa, p, 50, 300));
+    CHK(!cx_pool_allocator_resize(pa, p, 300, 2 * maxSize + 64*1024));
+    CHK(!cx_pool_allocator_resize(pa, NULL, 0, 10));
+
+    // Area which is the only one in its block is grown by reallocating the block
+    cx_pool_allocator_clear(pa);
+    size = 64*1024;
+    buf = cx_alloc_malloc(alloc, size);
+    memset(buf, 2, size);
+    while (size < 1024*1024) {
+        buf = cx_alloc_realloc(alloc, buf, size, size * 2);
+        for (size_t i = 0; i < size; i++) {
+            CHK(buf[i] == 2);
+        }
+        memset(buf + size, 2, size);
+        size *= 2;
+        stats = cx_pool_allocator_stats(pa);
+        CHK(stats.usedBlocks == 1 && stats.usedBytes == size);
+    }
+    // After clear, the free block 16 times larger is not used for the new area,
+    // and growing the area larger than all the free blocks reallocates its block
+    cx_pool_allocator_clear(pa);
+    buf = cx_alloc_malloc(alloc, 64*1024);
+    buf = cx_alloc_realloc(alloc, buf, 64*1024, 2*1024*1024);
+    stats = cx_pool_allocator_stats(pa);
+    CHK(stats.usedBlocks == 1 && stats.usedBytes == 2*1024*1024);
+    CHK(stats.freeBlocks == 1 && stats.freeBytes == 1024*1024);
+    cx_pool_allocator_destroy(pa);
+}
+
+// Checks releasing the allocations after checkpoints
+static void test_alloc_pool_mark(size_t chunkSize) {
+
+    LOGI("alloc pool mark test. chunkSize:%lu", chunkSize);
+    CxPoolAllocator* pa = cx_pool_allocator_create(1024, NULL);
+    cx_pool_allocator_set_thread_cache(pa, chunkSize);
+
+    // Rewinding a checkpoint of the empty allocator releases all blocks
+    CxPoolAllocatorMark empty = cx_pool_allocator_mark(pa);
+    for (size_t i = 0; i < 100; i++) {
+        cx_pool_allocator_alloc(pa, 100);
+    }
+    cx_pool_allocator_rewind(pa, empty);
+    CxPoolAllocatorStats stats = cx_pool_allocator_stats(pa);
+    CHK(stats.nallocs == 0 && stats.usedBlocks == 0 && stats.freeBlocks > 0);
+
+    unsigned char* first = cx_pool_allocator_alloc(pa, 100);
+    memset(first, 1, 100);
+    const CxPoolAllocatorMark m1 = cx_pool_allocator_mark(pa);
+    const CxPoolAllocatorStats s1 = cx_pool_allocator_stats(pa);
+    size_t nblocks = 0;
+    for (size_t cycle = 0; cycle < 10; cycle++) {
+        for (size_t i = 0; i < 50; i++) {
+            memset(cx_pool_allocator_alloc(pa, 100), 2, 100);
+        }
+        // Nested checkpoint
+        const CxPoolAllocatorMark m2 = cx_pool_allocator_mark(pa);
+        const CxPoolAllocatorStats s2 = cx_pool_allocator_stats(pa);
+        for (size_t i = 0; i < 50; i++) {
+            memset(cx_pool_allocator_alloc(pa, 200), 3, 200);
+        }
+        cx_pool_allocator_rewind(pa, m2);
+        stats = cx_pool_allocator_stats(pa);
+        CHK(stats.nallocs == s2.nallocs && stats.usedBlocks == s2.usedBlocks && stats.usedBytes == s2.usedBytes);
+
+        // Area allocated before the checkpoint is not grown in place
+        unsigned char* p = cx_alloc_realloc(cx_pool_allocator_iface(pa), first, 100, 110);
+        CHK(p != first);
+        cx_pool_allocator_rewind(pa, m1);
+        stats = cx_pool_allocator_stats(pa);
+        CHK(stats.nallocs == s1.nallocs && stats.nbytes == s1.nbytes);
+        CHK(stats.usedBlocks == s1.usedBlocks && stats.usedBytes == s1.usedBytes);
+        CHK(stats.wastedBytes == s1.wastedBytes);
+        // The following cycles reuse the same blocks
+        if (cycle == 0) {
+            nblocks = stats.usedBlocks + stats.freeBlocks;
+        } else {
+            CHK(stats.usedBlocks + stats.freeBlocks == nblocks);
+        }
+    }
+    for (size_t i = 0; i < 100; i++) {
+        CHK(first[i] == 1);
+    }
+    if (chunkSize == 0) {
+        CHK(cx_pool_allocator_alloc(pa, 16) == first + 112);
+    }
+
+    // Area which is the only one in its block is not moved with the block after a checkpoint
+    cx_pool_allocator_free(pa);
+    unsigned char* large = cx_pool_allocator_alloc(pa, 4096);
+    memset(large, 4, 4096);
+    const CxPoolAllocatorMark m3 = cx_pool_allocator_mark(pa);
+    unsigned char* p = cx_alloc_realloc(cx_pool_allocator_iface(pa), large, 4096, 8192);
+    CHK(p != large);
+    cx_pool_allocator_rewind(pa, m3);
+    for (size_t i = 0; i < 4096; i++) {
+        CHK(large[i] == 4);
+    }
+    cx_pool_allocator_destroy(pa);
+}
+
+// Uses nested scopes of the thread scratch allocator
+static void* scratch_worker(void* arg) {
+
+    size_t nblocks = 0;
+    for (size_t cycle = 0; cycle < 10; cycle++) {
+        CxPoolScratch s1 = cx_pool_allocator_scratch_begin();
+        unsigned char* p1 = cx_alloc_malloc(s1.alloc, 1000);
+        memset(p1, 1, 1000);
+        for (size_t i = 0; i < 3; i++) {
+            CxPoolScratch s2 = cx_pool_allocator_scratch_begin();
+            CHK(s2.pool == s1.pool);
+            for (size_t j = 0; j < 100; j++) {
+                memset(cx_alloc_malloc(s2.alloc, 1000), 2, 1000);
+            }
+            cx_pool_allocator_scratch_end(&s2);
+        }
+        for (size_t i = 0; i < 1000; i++) {
+            CHK(p1[i] == 1);
+        }
+        cx_pool_allocator_scratch_end(&s1);
+        CxPoolAllocatorStats stats = cx_pool_allocator_stats(s1.pool);
+        CHK(stats.nallocs == 0 && stats.usedBlocks == 0);
+        if (cycle == 0) {
+            nblocks = stats.freeBlocks;
+        } else {
+            CHK(stats.freeBlocks == nblocks);
+        }
+    }
+    return NULL;
+}
+
+static void test_alloc_pool_scratch(size_t nthreads) {
+
+    LOGI("alloc pool scratch test. threads:%lu", nthreads);
+    pthread_t ids[nthreads];
+    for (size_t i = 0; i < nthreads; i++) {
+        CHKZ(pthread_create(&ids[i], NULL, scratch_worker, NULL));
+    }
+    for (size_t i = 0; i < nthreads; i++) {
+        CHKZ(pthread_join(ids[i], NULL));
+    }
+}
+
+typedef struct Worker {
+    const CxAllocator*  alloc;
+    size_t              nallocs;
+    size_t              nbytes;
+    unsigned            seed;
+    unsigned char       fill;
+    unsigned char**     ptrs;
+    size_t*             sizes;
+} Worker;
+
+// Allocates areas of random sizes, filling each area with the thread fill value
+static void* alloc_worker(void* arg) {
+
+    Worker* w = arg;
+    w->nbytes = 0;
+    for (size_t i = 0; i < w->nallocs; i++) {
+        const size_t size = 1 + rand_r(&w->seed) % 300;
+        unsigned char* p = cx_alloc_malloc(w->alloc, size);
+        CHK(((uintptr_t)p % _Alignof(long double)) == 0);
+        memset(p, w->fill, size);
+        w->ptrs[i] = p;
+        w->sizes[i] = size;
+        w->nbytes += size;
+        // Grows some areas, which must keep their contents
+        if (i % 16 == 0) {
+            p = cx_alloc_realloc(w->alloc, p, size, size * 2);
+            for (size_t j = 0; j < size; j++) {
+                CHK(p[j] == w->fill);
+            }
+            memset(p, w->fill, size * 2);
+            w->ptrs[i] = p;
+            w->sizes[i] = size * 2;
+            w->nbytes += size * 2;
+        }
+    }
+    return NULL;
+}
+
+// Allocates concurrently from several threads and checks that the areas don't overlap
+static void test_alloc_pool_threads(size_t nthreads, size_t nallocs, size_t chunkSize) {
+
+    LOGI("alloc pool threads test. threads=%lu allocs=%lu chunkSize:%lu", nthreads, nallocs, chunkSize);
+    CxPoolAllocator* pa = cx_pool_allocator_create(16*1024, NULL);
+    cx_pool_allocator_set_thread_cache(pa, chunkSize);
+    Worker workers[nthreads];
+    pthread_t ids[nthreads];
+
+    for (size_t cycle = 0; cycle < 3; cycle++) {
+        size_t total_allocs = 0;
+        size_t total_bytes = 0;
+        for (size_t i = 0; i < nthreads; i++) {
+            workers[i] = (Worker){
+                .alloc = cx_pool_allocator_iface(pa),
+                .nallocs = nallocs,
+                .seed = i + 1,
+                .fill = i + 1,
+                .ptrs = malloc(nallocs * sizeof(*workers[i].ptrs)),
+                .sizes = malloc(nallocs * sizeof(*workers[i].sizes)),
+            };
+            CHKZ(pthread_create(&ids[i], NULL, alloc_worker, &workers[i]));
+        }
+        for (size_t i = 0; i < nthreads; i++) {
+            CHKZ(pthread_join(ids[i], NULL));
+        }
+        for (size_t i = 0; i < nthreads; i++) {
+            for (size_t n = 0; n < nallocs; n++) {
+                for (size_t j = 0; j < workers[i].sizes[n]; j++) {
+                    CHK(workers[i].ptrs[n][j] == workers[i].fill);
+                }
+            }
+            total_allocs += nallocs + (nallocs + 15) / 16;
+            total_bytes += workers[i].nbytes;
+            free(workers[i].ptrs);
+            free(workers[i].sizes);
+        }
+        CxPoolAllocatorStats stats = cx_pool_allocator_stats(pa);
+        // Reallocations in place are not counted as allocations and only add the size increase
+        CHK(stats.nallocs <= total_allocs && stats.nallocs >= nthreads * nallocs);
+        CHK(stats.nbytes <= total_bytes);
+
+        // Clear reclaims the memory of the thread chunks
+        cx_pool_allocator_clear(pa);
+        stats = cx_pool_allocator_stats(pa);
+        CHK(stats.nallocs == 0 && stats.nbytes == 0 && stats.usedBlocks == 0);
+    }
+    cx_pool_allocator_free(pa);
+    CxPoolAllocatorStats stats = cx_pool_allocator_stats(pa);
+    CHK(stats.usedBlocks == 0 && stats.freeBlocks == 0);
+    cx_pool_allocator_destroy(pa);
+}
+
+typedef struct SlabWorker {
+    CxSlabAllocator*    sa;
+    size_t              nops;
+    unsigned            seed;
+    unsigned char       fill;
+} SlabWorker;
+
+// Allocates, reallocates and frees areas of random sizes, checking their contents
+static void* slab_worker(void* arg) {
+
+    SlabWorker* w = arg;
+    const CxAllocator* alloc = cx_slab_allocator_iface(w->sa);
+    enum { NAREAS = 256 };
+    unsigned char* ptrs[NAREAS] = {0};
+    size_t sizes[NAREAS] = {0};
+    for (size_t i = 0; i < w->nops; i++) {
+        const size_t idx = rand_r(&w->seed) % NAREAS;
+        const size_t size = rand_r(&w->seed) % (i % 100 == 0 ? 10000 : 600);
+        if (ptrs[idx] == NULL) {
+            ptrs[idx] = cx_alloc_malloc(alloc, size);
+            CHK(((uintptr_t)ptrs[idx] % _Alignof(long double)) == 0);
+            memset(ptrs[idx], w->fill, size);
+            sizes[idx] = size;
+            continue;
+        }
+        for (size_t j = 0; j < sizes[idx]; j++) {
+            CHK(ptrs[idx][j] == w->fill);
+        }
+        if (i % 4 == 0) {
+            ptrs[idx] = cx_alloc_realloc(alloc, ptrs[idx], sizes[idx], size);
+            for (size_t j = 0; j < sizes[idx] && j < size; j++) {
+                CHK(ptrs[idx][j] == w->fill);
+            }
+            memset(ptrs[idx], w->fill, size);
+            sizes[idx] = size;
+        } else {
+            cx_alloc_free(alloc, ptrs[idx], sizes[idx]);
+            ptrs[idx] = NULL;
+        }
+    }
+    for (size_t i = 0; i < NAREAS; i++) {
+        cx_alloc_free(alloc, ptrs[i], sizes[i]);
+    }
+    return NULL;
+}
+
+static void test_alloc_slab(size_t slabSize, size_t magazine, size_t nthreads, size_t nops) {
+
+    LOGI("alloc slab test. slabSize=%lu magazine=%lu threads=%lu ops=%lu", slabSize, magazine, nthreads, nops);
+    CxSlabAllocator* sa = cx_slab_allocator_create(slabSize, NULL);
+    cx_slab_allocator_set_magazine(sa, magazine);
+
+    // Freed areas are reused
+    const CxAllocator* alloc = cx_slab_allocator_iface(sa);
+    void* p1 = cx_alloc_malloc(alloc, 100);
+    cx_alloc_free(alloc, p1, 100);
+    void* p2 = cx_alloc_malloc(alloc, 110);
+    CHK(p1 == p2);
+    // Reallocation in the same size class keeps the area
+    CHK(cx_alloc_realloc(alloc, p2, 110, 112) == p2);
+    cx_alloc_free(alloc, p2, 112);
+
+    SlabWorker workers[nthreads];
+    pthread_t ids[nthreads];
+    size_t nslabs = 0;
+    for (size_t cycle = 0; cycle < 3; cycle++) {
+        for (size_t i = 0; i < nthreads; i++) {
+            workers[i] = (SlabWorker){.sa = sa, .nops = nops, .seed = i + 1, .fill = i + 1};
+            CHKZ(pthread_create(&ids[i], NULL, slab_worker, &workers[i]));
+        }
+        for (size_t i = 0; i < nthreads; i++) {
+            CHKZ(pthread_join(ids[i], NULL));
+        }
+        CxSlabAllocatorStats stats = cx_slab_allocator_stats(sa);
+        CHK(stats.nallocs == stats.nfrees);
+        // Repeating the same operations in a single thread reuses the slabs
+        if (cycle == 0) {
+            nslabs = stats.nslabs;
+        } else if (nthreads == 1) {
+            CHK(stats.nslabs == nslabs);
+        }
+    }
+    cx_slab_allocator_destroy(sa);
+}
+
+typedef struct ArenaWorker {
+    CxArenaAllocator*   aa;
+    size_t              nops;
+    unsigned char       fill;
+} ArenaWorker;
+
+// Allocates areas with the worker fill value and checks that no other thread overwrote them
+static void* arena_worker(void* arg) {
+
+    ArenaWorker* w = arg;
+    const CxAllocator* alloc = cx_arena_allocator_iface(w->aa);
+    unsigned char* ptrs[w->nops];
+    for (size_t i = 0; i < w->nops; i++) {
+        const size_t size = 1 + i % 200;
+        ptrs[i] = cx_alloc_malloc(alloc, size);
+        CHK(((uintptr_t)ptrs[i] % _Alignof(long double)) == 0);
+        memset(ptrs[i], w->fill, size);
+    }
+    for (size_t i = 0; i < w->nops; i++) {
+        for (size_t j = 0; j < 1 + i % 200; j++) {
+            CHK(ptrs[i][j] == w->fill);
+        }
+    }
+    return NULL;
+}
+
+static size_t arenaErrors = 0;
+static void arena_error(const char* emsg, void* userdata) {
+
+    arenaErrors++;
+}
+
+static void test_alloc_arena(CxArenaFlags flags, size_t nthreads) {
+
+    LOGI("alloc arena test. flags:%d threads:%lu", flags, nthreads);
+    const size_t reserve = 3*1024*1024;
+    CxArenaAllocator* aa = cx_arena_allocator_create(reserve, flags);
+    CHK(aa != NULL);
+    cx_arena_allocator_set_error_fn(aa, arena_error, NULL);
+    CxArenaAllocatorStats stats = cx_arena_allocator_stats(aa);
+    CHK(stats.reservedBytes >= reserve && stats.usedBytes == 0);
+
+    // Last area is grown, shrunk and freed in place
+    const CxAllocator* alloc = cx_arena_allocator_iface(aa);
+    unsigned char* p1 = cx_alloc_malloc(alloc, 100);
+    memset(p1, 1, 100);
+    CHK(cx_alloc_realloc(alloc, p1, 100, 1000) == p1);
+    CHK(cx_alloc_realloc(alloc, p1, 1000, 50) == p1);
+    CHK(cx_arena_allocator_stats(aa).usedBytes == 50);
+    unsigned char* p2 = cx_arena_allocator_alloc2(aa, 10, 256);
+    CHK(((uintptr_t)p2 % 256) == 0);
+    cx_alloc_free(alloc, p2, 10);
+    CHK(cx_alloc_malloc(alloc, 10) == p2);
+    // Other areas are copied when grown
+    unsigned char* p3 = cx_alloc_realloc(alloc, p1, 50, 100);
+    CHK(p3 > p2);
+    for (size_t i = 0; i < 50; i++) {
+        CHK(p3[i] == 1);
+    }
+
+    // Allocations greater than the remaining range fail
+    CHK(cx_alloc_malloc(alloc, stats.reservedBytes) == NULL);
+    CHK(arenaErrors == 1);
+    arenaErrors = 0;
+
+    // Cleared arena reuses the range
+    cx_arena_allocator_clear(aa);
+    stats = cx_arena_allocator_stats(aa);
+    CHK(stats.nallocs == 0 && stats.usedBytes == 0);
+    CHK(cx_alloc_malloc(alloc, 100) == p1);
+    for (size_t i = 0; i < 50; i++) {
+        CHK(p1[i] == 1);
+    }
+
+    ArenaWorker workers[nthreads];
+    pthread_t ids[nthreads];
+    for (size_t i = 0; i < nthreads; i++) {
+        workers[i] = (ArenaWorker){.aa = aa, .nops = 5000, .fill = i + 1};
+        CHKZ(pthread_create(&ids[i], NULL, arena_worker, &workers[i]));
+    }
+    for (size_t i = 0; i < nthreads; i++) {
+        CHKZ(pthread_join(ids[i], NULL));
+    }
+    stats = cx_arena_allocator_stats(aa);
+    CHK(stats.nallocs == 1 + nthreads * 5000);
+
+    // Freed arena returns zeroed pages
+    cx_arena_allocator_free(aa);
+    p1 = cx_alloc_malloc(alloc, 1000);
+    for (size_t i = 0; i < 1000; i++) {
+        CHK(p1[i] == 0);
+    }
+    cx_arena_allocator_destroy(aa);
+}
+
 static void test_alloc(void) {
 
-    test_alloc_pool(999, 1*1024, 10);
-    test_alloc_pool(1999, 2*1024, 10);
-    test_alloc_pool(2999, 3*1024, 10);
+    test_alloc_pool(999, 1*1024, 10, 0);
+    test_alloc_pool(1999, 2*1024, 10, 0);
+    test_alloc_pool(2999, 3*1024, 10, 0);
+    test_alloc_pool(1999, 2*1024, 10, 4*1024);
+    test_alloc_pool_reuse();
+    test_alloc_pool_resize(0);
+    test_alloc_pool_resize(4*1024);
+    test_alloc_pool_mark(0);
+    test_alloc_pool_mark(512);
+    test_alloc_pool_scratch(4);
+    test_alloc_pool_threads(1, 10000, 0);
+    test_alloc_pool_threads(8, 10000, 0);
+    test_alloc_pool_threads(8, 10000, 4*1024);
+    test_alloc_pool_threads(8, 10000, 64*1024);
+    test_alloc_slab(0, 0, 1, 100000);
+    test_alloc_slab(1024, 0, 1, 100000);
+    test_alloc_slab(0, 0, 8, 20000);
+    test_alloc_slab(0, 32, 1, 100000);
+    test_alloc_slab(16*1024, 16, 8, 20000);
+    test_alloc_arena(0, 1);
+    test_alloc_arena(CxArenaFlagPrefault, 4);
+    test_alloc_arena(CxArenaFlagHugePages, 4);
+    test_alloc_arena(CxArenaFlagHugePages|CxArenaFlagPrefault, 4);
 }
 
 __attribute__((constructor))
@@ -0,0 +1,390 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <time.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#include "cx_arena_allocator.h"
+#include "cx_pool_allocator.h"
+#include "cx_slab_allocator.h"
+#include "cx_var.h"
+#include "registry.h"
+#include "logger.h"
+#include "util.h"
+
+// Hash map and array used by the arena benchmark
+#define cx_hmap_name amap
+#define cx_hmap_key  uint64_t
+#define cx_hmap_val  uint64_t
+#define cx_hmap_instance_allocator
+#define cx_hmap_static
+#define cx_hmap_implement
+#include "cx_hmap2.h"
+
+#define cx_array_name aarr
+#define cx_array_type uint64_t
+#define cx_array_instance_allocator
+#define cx_array_static
+#define cx_array_implement
+#include "cx_array.h"
+
+typedef struct Bench {
+    const CxAllocator*  alloc;
+    size_t              nops;
+    unsigned            seed;
+    uint64_t            sum;
+} Bench;
+
+// Returns elapsed time in nanoseconds between two times
+static size_t elapsed_ns(const struct timespec* start, const struct timespec* stop) {
+    return (stop->tv_sec - start->tv_sec)*1000000000 + stop->tv_nsec - start->tv_nsec;
+}
+
+// Allocates small areas of random sizes, touching each area
+static void* worker_alloc(void* arg) {
+
+    Bench* b = arg;
+    for (size_t i = 0; i < b->nops; i++) {
+        const size_t size = 8 + rand_r(&b->seed) % 120;
+        uint8_t* p = cx_alloc_malloc(b->alloc, size);
+        p[0] = i;
+        b->sum += (uintptr_t)p;
+    }
+    return NULL;
+}
+
+// Runs the worker in the specified number of threads using the pool allocator
+// and returns the elapsed wall time
+static size_t bench_run(CxPoolAllocator* pa, size_t nops, size_t nthreads) {
+
+    Bench benchs[nthreads];
+    pthread_t ids[nthreads];
+    struct timespec start;
+    struct timespec stop;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (size_t i = 0; i < nthreads; i++) {
+        benchs[i] = (Bench){.alloc = cx_pool_allocator_iface(pa), .nops = nops, .seed = i + 1};
+        CHK(pthread_create(&ids[i], NULL, worker_alloc, &benchs[i]) == 0);
+    }
+    for (size_t i = 0; i < nthreads; i++) {
+        CHK(pthread_join(ids[i], NULL) == 0);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &stop);
+    CHK(cx_pool_allocator_stats(pa).nallocs == nthreads * nops);
+    cx_pool_allocator_clear(pa);
+    return elapsed_ns(&start, &stop);
+}
+
+void bench_alloc(void) {
+
+    const size_t nops = 500000;
+    const size_t chunkSize = 16*1024;
+    LOGI("%s: %zu allocations of 8-128 bytes per thread", __func__, nops);
+
+    CxPoolAllocator* locked = cx_pool_allocator_create(64*1024, NULL);
+    CxPoolAllocator* cached = cx_pool_allocator_create(64*1024, NULL);
+    cx_pool_allocator_set_thread_cache(cached, chunkSize);
+    for (size_t nthreads = 1; nthreads <= 32; nthreads *= 2) {
+        const size_t tl = bench_run(locked, nops, nthreads);
+        const size_t tc = bench_run(cached, nops, nthreads);
+        const double ops = (double)nthreads * nops;
+        LOGI("\tthreads:%3zu shared lock:%8.2f Mops/s  thread cache (%zu):%8.2f Mops/s",
+            nthreads, ops * 1000 / tl, chunkSize, ops * 1000 / tc);
+    }
+    cx_pool_allocator_destroy(locked);
+    cx_pool_allocator_destroy(cached);
+
+    // Request cycles with small and some large allocations followed by clear
+    const size_t ncycles = 200;
+    const size_t nallocs = 100000;
+    LOGI("%s: %zu cycles of %zu allocations with clear", __func__, ncycles, nallocs);
+    CxPoolAllocator* pa = cx_pool_allocator_create(4*1024, NULL);
+    unsigned seed = 1;
+    struct timespec start;
+    struct timespec stop;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (size_t c = 0; c < ncycles; c++) {
+        for (size_t i = 0; i < nallocs; i++) {
+            const size_t size = i % 1000 == 0 ? 4096 + rand_r(&seed) % 60000 : 8 + rand_r(&seed) % 120;
+            CHK(cx_pool_allocator_alloc(pa, size) != NULL);
+        }
+        cx_pool_allocator_clear(pa);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &stop);
+    const CxPoolAllocatorStats stats = cx_pool_allocator_stats(pa);
+    LOGI("\t%.2f ms/cycle blocks:%zu bytes:%zu", elapsed_ns(&start, &stop) / 1e6 / ncycles,
+        stats.freeBlocks, stats.freeBytes);
+    cx_pool_allocator_destroy(pa);
+
+    // Growth of buffers by doubling, one at a time (in place) or two interleaved (copied)
+    const size_t maxSize = 1024*1024;
+    LOGI("%s: growth of buffers from 16 bytes to %zu bytes by doubling", __func__, maxSize);
+    for (size_t nbufs = 1; nbufs <= 2; nbufs++) {
+        pa = cx_pool_allocator_create(64*1024, NULL);
+        const CxAllocator* alloc = cx_pool_allocator_iface(pa);
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        for (size_t c = 0; c < ncycles; c++) {
+            void* bufs[2] = {0};
+            for (size_t size = 16; size <= maxSize; size *= 2) {
+                for (size_t b = 0; b < nbufs; b++) {
+                    bufs[b] = cx_alloc_realloc(alloc, bufs[b], size / 2, size);
+                    memset(bufs[b], 0, size);
+                }
+            }
+            if (c + 1 < ncycles) {
+                cx_pool_allocator_clear(pa);
+            }
+        }
+        clock_gettime(CLOCK_MONOTONIC, &stop);
+        const CxPoolAllocatorStats stats = cx_pool_allocator_stats(pa);
+        LOGI("\tbuffers:%zu %.3f ms/cycle arena bytes used:%zu (%.2fx the buffers size)", nbufs,
+            elapsed_ns(&start, &stop) / 1e6 / ncycles, stats.usedBytes, (double)stats.usedBytes / (nbufs * maxSize));
+        cx_pool_allocator_destroy(pa);
+    }
+
+    // Temporary allocations released at the end of each request by the default allocator
+    // or by rewinding the thread scratch allocator
+    const size_t ntemps = 1000;
+    LOGI("%s: %zu requests with %zu temporary allocations of 8-256 bytes", __func__, ncycles * 50, ntemps);
+    void* temps[ntemps];
+    const CxAllocator* def = cx_def_allocator();
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (size_t c = 0; c < ncycles * 50; c++) {
+        for (size_t i = 0; i < ntemps; i++) {
+            temps[i] = cx_alloc_malloc(def, 8 + rand_r(&seed) % 248);
+            CHK(temps[i] != NULL);
+        }
+        for (size_t i = 0; i < ntemps; i++) {
+            cx_alloc_free(def, temps[i], 0);
+        }
+    }
+    clock_gettime(CLOCK_MONOTONIC, &stop);
+    const size_t tdef = elapsed_ns(&start, &stop);
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (size_t c = 0; c < ncycles * 50; c++) {
+        CxPoolScratch s = cx_pool_allocator_scratch_begin();
+        for (size_t i = 0; i < ntemps; i++) {
+            CHK(cx_alloc_malloc(s.alloc, 8 + rand_r(&seed) % 248) != NULL);
+        }
+        cx_pool_allocator_scratch_end(&s);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &stop);
+    const size_t tscr = elapsed_ns(&start, &stop);
+    LOGI("\tdefault malloc/free:%8.2f us/request  scratch rewind:%8.2f us/request",
+        tdef / 1e3 / (ncycles * 50), tscr / 1e3 / (ncycles * 50));
+}
+
+// Keeps a set of live areas of random small sizes, replacing a random area at each operation
+static void* worker_churn(void* arg) {
+
+    Bench* b = arg;
+    enum { NAREAS = 4096 };
+    uint8_t* ptrs[NAREAS] = {0};
+    size_t sizes[NAREAS] = {0};
+    for (size_t i = 0; i < b->nops; i++) {
+        const size_t idx = rand_r(&b->seed) % NAREAS;
+        cx_alloc_free(b->alloc, ptrs[idx], sizes[idx]);
+        sizes[idx] = 8 + rand_r(&b->seed) % 250;
+        ptrs[idx] = cx_alloc_malloc(b->alloc, sizes[idx]);
+        ptrs[idx][0] = i;
+    }
+    for (size_t i = 0; i < NAREAS; i++) {
+        cx_alloc_free(b->alloc, ptrs[i], sizes[i]);
+    }
+    return NULL;
+}
+
+// Builds and deletes CxVar maps with integer, string and array fields
+static void* worker_var(void* arg) {
+
+    Bench* b = arg;
+    char key[32];
+    for (size_t i = 0; i < b->nops; i++) {
+        CxVar* var = cx_var_new(b->alloc);
+        cx_var_set_map(var);
+        for (size_t f = 0; f < 16; f++) {
+            snprintf(key, sizeof(key), "field%zu", f);
+            switch (f % 3) {
+            case 0:
+                cx_var_set_map_int(var, key, i);
+                break;
+            case 1:
+                cx_var_set_map_str(var, key, "a string value of some length");
+                break;
+            case 2: {
+                CxVar* arr = cx_var_set_map_arr(var, key);
+                for (size_t j = 0; j < 4; j++) {
+                    cx_var_push_arr_int(arr, j);
+                }
+                break;
+            }
+            }
+        }
+        cx_var_del(var);
+    }
+    return NULL;
+}
+
+// Runs the worker in the specified number of threads with the specified allocator
+// and returns the elapsed wall time
+static size_t bench_run_worker(void* (*worker)(void*), const CxAllocator* alloc, size_t nops, size_t nthreads) {
+
+    Bench benchs[nthreads];
+    pthread_t ids[nthreads];
+    struct timespec start;
+    struct timespec stop;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (size_t i = 0; i < nthreads; i++) {
+        benchs[i] = (Bench){.alloc = alloc, .nops = nops, .seed = i + 1};
+        CHK(pthread_create(&ids[i], NULL, worker, &benchs[i]) == 0);
+    }
+    for (size_t i = 0; i < nthreads; i++) {
+        CHK(pthread_join(ids[i], NULL) == 0);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &stop);
+    return elapsed_ns(&start, &stop);
+}
+
+void bench_slab(void) {
+
+    const struct {
+        const char* name;
+        void* (*worker)(void*);
+        size_t nops;
+    } works[] = {
+        {"alloc/free churn", worker_churn, 1000000},
+        {"CxVar map build/delete", worker_var, 20000},
+    };
+    for (size_t w = 0; w < sizeof(works)/sizeof(works[0]); w++) {
+        LOGI("%s: %s, %zu ops per thread", __func__, works[w].name, works[w].nops);
+        for (size_t nthreads = 1; nthreads <= 8; nthreads *= 2) {
+            CxSlabAllocator* slab = cx_slab_allocator_create(0, NULL);
+            CxSlabAllocator* slabm = cx_slab_allocator_create(0, NULL);
+            cx_slab_allocator_set_magazine(slabm, 64);
+            const size_t td = bench_run_worker(works[w].worker, cx_def_allocator(), works[w].nops, nthreads);
+            const size_t ts = bench_run_worker(works[w].worker, cx_slab_allocator_iface(slab), works[w].nops, nthreads);
+            const size_t tm = bench_run_worker(works[w].worker, cx_slab_allocator_iface(slabm), works[w].nops, nthreads);
+            const CxSlabAllocatorStats stats = cx_slab_allocator_stats(slab);
+            CHK(stats.nallocs == stats.nfrees);
+            const double ops = (double)nthreads * works[w].nops;
+            LOGI("\tthreads:%3zu default:%8.2f Mops/s  slab:%8.2f Mops/s  slab+magazine:%8.2f Mops/s  slabs:%zu",
+                nthreads, ops * 1000 / td, ops * 1000 / ts, ops * 1000 / tm, stats.nslabs);
+            cx_slab_allocator_destroy(slab);
+            cx_slab_allocator_destroy(slabm);
+        }
+    }
+}
+
+// Opens a counter of the data TLB read misses of the calling thread in user space.
+// Returns -1 if the counter is not available.
+static int dtlb_counter_open(void) {
+
+    struct perf_event_attr attr = {
+        .type = PERF_TYPE_HW_CACHE,
+        .size = sizeof(attr),
+        .config = PERF_COUNT_HW_CACHE_DTLB | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16),
+        .disabled = 1,
+        .exclude_kernel = 1,
+        .exclude_hv = 1,
+    };
+    return syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+// Returns the number of minor page faults of the process
+static size_t minor_faults(void) {
+
+    struct rusage ru;
+    CHK(getrusage(RUSAGE_SELF, &ru) == 0);
+    return ru.ru_minflt;
+}
+
+// Builds a hash map and an array with the specified allocator and reads random elements of both,
+// reporting the page faults of the build and the data TLB misses of the reads.
+static void bench_tables(const char* name, const CxAllocator* alloc, size_t nkeys, size_t nreads) {
+
+    struct timespec start;
+    struct timespec stop;
+    const size_t faults = minor_faults();
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    amap m = amap_init(alloc, 0);
+    aarr arr = aarr_init(alloc);
+    for (uint64_t i = 0; i < nkeys; i++) {
+        amap_set(&m, i * 0x9E3779B97F4A7C15, i);
+        for (size_t j = 0; j < 4; j++) {
+            aarr_push(&arr, i);
+        }
+    }
+    clock_gettime(CLOCK_MONOTONIC, &stop);
+    const size_t tbuild = elapsed_ns(&start, &stop);
+    const size_t nfaults = minor_faults() - faults;
+
+    const int fd = dtlb_counter_open();
+    if (fd >= 0) {
+        ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+        ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+    }
+    uint64_t seed = 1;
+    uint64_t sum = 0;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (size_t i = 0; i < nreads; i++) {
+        seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+        const uint64_t k = (seed >> 33) % nkeys;
+        sum += *amap_get(&m, k * 0x9E3779B97F4A7C15);
+        sum += arr.data[(seed >> 11) % aarr_len(&arr)];
+    }
+    clock_gettime(CLOCK_MONOTONIC, &stop);
+    char misses[32] = "n/a";
+    if (fd >= 0) {
+        uint64_t count = 0;
+        ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+        if (read(fd, &count, sizeof(count)) == sizeof(count)) {
+            snprintf(misses, sizeof(misses), "%.3f", (double)count / nreads);
+        }
+        close(fd);
+    }
+    CHK(sum > 0);
+    LOGI("\t%-26s build:%8.1f ms page faults:%8zu  reads:%6.1f ns/op dTLB misses/op:%s",
+        name, tbuild / 1e6, nfaults, (double)elapsed_ns(&start, &stop) / nreads, misses);
+    amap_free(&m);
+    aarr_free(&arr);
+}
+
+void bench_arena(void) {
+
+    const size_t nkeys = 4*1024*1024;
+    const size_t nreads = 10000000;
+    const size_t reserve = 1024*1024*1024;
+    LOGI("%s: hash map with %zu keys and array with %zu elements, %zu random reads", __func__,
+        nkeys, 4 * nkeys, nreads);
+    bench_tables("default", cx_def_allocator(), nkeys, nreads);
+    const struct {
+        const char*     name;
+        CxArenaFlags    flags;
+    } arenas[] = {
+        {"arena", 0},
+        {"arena prefault", CxArenaFlagPrefault},
+        {"arena huge pages", CxArenaFlagHugePages},
+        {"arena huge pages prefault", CxArenaFlagHugePages | CxArenaFlagPrefault},
+    };
+    for (size_t i = 0; i < sizeof(arenas)/sizeof(arenas[0]); i++) {
+        CxArenaAllocator* aa = cx_arena_allocator_create(reserve, arenas[i].flags);
+        CHK(aa != NULL);
+        bench_tables(arenas[i].name, cx_arena_allocator_iface(aa), nkeys, nreads);
+        cx_arena_allocator_destroy(aa);
+    }
+}
+
+__attribute__((constructor))
+static void reg_bench_alloc(void) {
+
+    reg_add_test("alloc", bench_alloc);
+    reg_add_test("slab", bench_slab);
+    reg_add_test("arena", bench_arena);
+}
@@ -0,0 +1,145 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <time.h>
+#include <pthread.h>
+#include "registry.h"
+#include "logger.h"
+#include "util.h"
+
+// Sharded concurrent map
+#define cx_chmap_name cmap
+#define cx_chmap_key  uint64_t
+#define cx_chmap_val  uint64_t
+#define cx_chmap_static
+#define cx_chmap_implement
+#include "cx_chmap.h"
+
+// Single lock map for comparison
+#define cx_hmap_name lmap
+#define cx_hmap_key  uint64_t
+#define cx_hmap_val  uint64_t
+#define cx_hmap_static
+#define cx_hmap_implement
+#include "cx_hmap2.h"
+
+typedef struct Bench {
+    cmap*               cm;
+    lmap*               lm;
+    pthread_rwlock_t*   lock;
+    size_t              nkeys;
+    size_t              nops;
+    unsigned            seed;
+    uint64_t            sum;
+} Bench;
+
+// Returns elapsed time in nanoseconds between two times
+static size_t elapsed_ns(const struct timespec* start, const struct timespec* stop) {
+    return (stop->tv_sec - start->tv_sec)*1000000000 + stop->tv_nsec - start->tv_nsec;
+}
+
+static void incr(uint64_t* val, bool found, void* ctx) {
+
+    (*val)++;
+}
+
+// 90% lookups and 10% updates of random keys on the sharded map
+static void* worker_cmap(void* arg) {
+
+    Bench* b = arg;
+    for (size_t i = 0; i < b->nops; i++) {
+        const uint64_t key = rand_r(&b->seed) % b->nkeys;
+        if (i % 10 == 0) {
+            cmap_update(b->cm, key, incr, NULL);
+        } else {
+            uint64_t v;
+            if (cmap_get_copy(b->cm, key, &v)) {
+                b->sum += v;
+            }
+        }
+    }
+    return NULL;
+}
+
+// 90% lookups and 10% updates of random keys on the single lock map
+static void* worker_lmap(void* arg) {
+
+    Bench* b = arg;
+    for (size_t i = 0; i < b->nops; i++) {
+        const uint64_t key = rand_r(&b->seed) % b->nkeys;
+        if (i % 10 == 0) {
+            pthread_rwlock_wrlock(b->lock);
+            uint64_t* v = lmap_get(b->lm, key);
+            if (v) {
+                (*v)++;
+            } else {
+                lmap_set(b->lm, key, 1);
+            }
+            pthread_rwlock_unlock(b->lock);
+        } else {
+            pthread_rwlock_rdlock(b->lock);
+            uint64_t* v = lmap_get(b->lm, key);
+            if (v) {
+                b->sum += *v;
+            }
+            pthread_rwlock_unlock(b->lock);
+        }
+    }
+    return NULL;
+}
+
+// Runs worker in the specified number of threads and returns the elapsed wall time
+static size_t bench_run(void* (*worker)(void*), Bench* tmpl, size_t nthreads) {
+
+    Bench benchs[nthreads];
+    pthread_t ids[nthreads];
+    struct timespec start;
+    struct timespec stop;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (size_t i = 0; i < nthreads; i++) {
+        benchs[i] = *tmpl;
+        benchs[i].seed = i + 1;
+        CHK(pthread_create(&ids[i], NULL, worker, &benchs[i]) == 0);
+    }
+    for (size_t i = 0; i < nthreads; i++) {
+        CHK(pthread_join(ids[i], NULL) == 0);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &stop);
+    return elapsed_ns(&start, &stop);
+}
+
+void bench_chmap(void) {
+
+    const size_t nkeys = 100000;
+    const size_t nops = 200000;
+    LOGI("%s: %zu keys, %zu ops per thread (90%% get, 10%% update)", __func__, nkeys, nops);
+
+    for (size_t nthreads = 1; nthreads <= 64; nthreads *= 2) {
+        cmap cm = cmap_init(nkeys);
+        lmap lm = lmap_init(nkeys);
+        pthread_rwlock_t lock;
+        pthread_rwlock_init(&lock, NULL);
+        for (size_t i = 0; i < nkeys; i++) {
+            cmap_set(&cm, i, i);
+            lmap_set(&lm, i, i);
+        }
+
+        Bench tmpl = {.cm = &cm, .lm = &lm, .lock = &lock, .nkeys = nkeys, .nops = nops};
+        const size_t tc = bench_run(worker_cmap, &tmpl, nthreads);
+        const size_t tl = bench_run(worker_lmap, &tmpl, nthreads);
+        const double ops = (double)nthreads * nops;
+        LOGI("\tthreads:%3zu chmap:%8.2f Mops/s  single lock hmap2:%8.2f Mops/s",
+            nthreads, ops * 1000 / tc, ops * 1000 / tl);
+
+        pthread_rwlock_destroy(&lock);
+        lmap_free(&lm);
+        cmap_free(&cm);
+    }
+}
+
+__attribute__((constructor))
+static void reg_bench_chmap(void) {
+
+    reg_add_test("chmap", bench_chmap);
+}
+
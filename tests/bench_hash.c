@@ -0,0 +1,104 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "cx_alloc.h"
+#include "registry.h"
+#include "logger.h"
+
+uint32_t cx_hmap_hash_fnv1a32(const void *buf, size_t len);
+uint64_t cx_hmap_hash_wy64(const void* buf, size_t len);
+uint64_t cx_hmap_hash_wy64_str(const char* str);
+uint64_t cx_hmap_hash_wy64_str_fast(const char* str);
+
+// Returns elapsed time in nanoseconds between two times
+static size_t elapsed_ns(const struct timespec* start, const struct timespec* stop) {
+    return (stop->tv_sec - start->tv_sec)*1000000000 + stop->tv_nsec - start->tv_nsec;
+}
+
+// Measures the average time to hash keys of the specified length
+static void bench_hash_len(const char* keys, size_t nkeys, size_t keylen) {
+
+    struct timespec start;
+    struct timespec stop;
+    const size_t stride = keylen + 1;
+    uint64_t sum = 0;
+
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &start);
+    for (size_t i = 0; i < nkeys; i++) {
+        sum += cx_hmap_hash_fnv1a32(keys + i*stride, keylen);
+    }
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &stop);
+    const size_t fnv = elapsed_ns(&start, &stop);
+
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &start);
+    for (size_t i = 0; i < nkeys; i++) {
+        sum += cx_hmap_hash_wy64(keys + i*stride, keylen);
+    }
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &stop);
+    const size_t wy = elapsed_ns(&start, &stop);
+
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &start);
+    for (size_t i = 0; i < nkeys; i++) {
+        sum += cx_hmap_hash_wy64_str(keys + i*stride);
+    }
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &stop);
+    const size_t wystr = elapsed_ns(&start, &stop);
+
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &start);
+    for (size_t i = 0; i < nkeys; i++) {
+        sum += cx_hmap_hash_wy64_str_fast(keys + i*stride);
+    }
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &stop);
+    const size_t wyfast = elapsed_ns(&start, &stop);
+
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &start);
+    for (size_t i = 0; i < nkeys; i++) {
+        const char* key = keys + i*stride;
+        sum += cx_hmap_hash_fnv1a32(key, strlen(key));
+    }
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &stop);
+    const size_t fnvstr = elapsed_ns(&start, &stop);
+
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &start);
+    for (size_t i = 0; i < nkeys; i++) {
+        const char* key = keys + i*stride;
+        sum += cx_hmap_hash_wy64(key, strlen(key));
+    }
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &stop);
+    const size_t wylen = elapsed_ns(&start, &stop);
+
+    LOGI("\tlen:%5zu fnv1a32:%8.2fns wy64:%7.2fns | fnv1a32+strlen:%8.2fns wy64+strlen:%7.2fns wy64_str:%7.2fns wy64_str_fast:%7.2fns (%lx)",
+        keylen, (double)fnv/nkeys, (double)wy/nkeys,
+        (double)fnvstr/nkeys, (double)wylen/nkeys, (double)wystr/nkeys, (double)wyfast/nkeys, sum & 0xF);
+}
+
+void bench_hash(void) {
+
+    const size_t lens[] = {4, 8, 16, 32, 40, 64, 100, 256, 1024, 4096};
+    const size_t total = 4 * 1024 * 1024;
+    LOGI("%s: average time per key", __func__);
+    for (size_t l = 0; l < sizeof(lens)/sizeof(lens[0]); l++) {
+        // Builds nul terminated keys with random non zero characters
+        const size_t keylen = lens[l];
+        const size_t nkeys = total / (keylen + 1);
+        char* keys = malloc(nkeys * (keylen + 1));
+        srand(1);
+        for (size_t i = 0; i < nkeys; i++) {
+            char* key = keys + i*(keylen + 1);
+            for (size_t j = 0; j < keylen; j++) {
+                key[j] = 'a' + rand() % 26;
+            }
+            key[keylen] = 0;
+        }
+        bench_hash_len(keys, nkeys, keylen);
+        free(keys);
+    }
+}
+
+__attribute__((constructor))
+static void reg_bench_hash(void) {
+
+    reg_add_test("hash", bench_hash);
+}
+
@@ -1,4 +1,7 @@
 #include "cx_alloc.h"
+#include "registry.h"
+#include "cx_tpool.h"
+#include "bench_hmap.h"
 
 #define cx_hmap_name hmap1
 #define cx_hmap_key  uint64_t
@@ -18,7 +21,69 @@
 #define cx_hmap_implement
 #include "cx_hmap2.h"
 
+#define cx_hmap_name hmap3
+#define cx_hmap_key  uint64_t
+#define cx_hmap_val  uint64_t
+#define cx_hmap_instance_allocator
+#define cx_hmap_static
+#define cx_hmap_stats
+#define cx_hmap_implement
+#include "cx_hmap3.h"
+
+#define cx_hmap_name hmap2rh
+#define cx_hmap_key  uint64_t
+#define cx_hmap_val  uint64_t
+#define cx_hmap_instance_allocator
+#define cx_hmap_robin_hood
+#define cx_hmap_static
+#define cx_hmap_stats
+#define cx_hmap_implement
+#include "cx_hmap2.h"
+
 // Auxiliary macros
+#define cx_phmap_name phmap
+#define cx_phmap_key  uint64_t
+#define cx_phmap_val  uint64_t
+#define cx_phmap_instance_allocator
+#define cx_phmap_static
+#define cx_phmap_implement
+#include "cx_phmap.h"
+
+// Hash set and the equivalent map with minimal value used for deduplication
+#define cx_hset_name hset
+#define cx_hset_key  uint64_t
+#define cx_hset_instance_allocator
+#define cx_hset_static
+#define cx_hset_implement
+#include "cx_hset.h"
+
+#define cx_hmap_name hmap2dd
+#define cx_hmap_key  uint64_t
+#define cx_hmap_val  uint8_t
+#define cx_hmap_instance_allocator
+#define cx_hmap_static
+#define cx_hmap_implement
+#include "cx_hmap2.h"
+
+// Aggregation value with 200 bytes
+typedef struct agg { uint64_t count; double sum; double min; double max; uint8_t hist[168]; } agg;
+
+#define cx_hmap_name hmap2agg
+#define cx_hmap_key  uint64_t
+#define cx_hmap_val  agg
+#define cx_hmap_instance_allocator
+#define cx_hmap_static
+#define cx_hmap_implement
+#include "cx_hmap2.h"
+
+#define cx_hmap_name hmap3agg
+#define cx_hmap_key  uint64_t
+#define cx_hmap_val  agg
+#define cx_hmap_instance_allocator
+#define cx_hmap_static
+#define cx_hmap_implement
+#include "cx_hmap3.h"
+
 #define concat1_(a,b) a ## b
 #define concat2_(a,b) concat1_(a,b)
 
@@ -26,6 +91,7 @@
 #define HMAP hmap1
 #define HMAP_(name) concat2_(HMAP,name)
 #define BENCH_(name) concat2_(bench_,name)
+#define BENCH_BATCH_(name) concat2_(bench_batch_,name)
 #define ARR arr1
 #define ARR_(name) concat2_(ARR,name)
 #include "bench_hmap_inc.c"
@@ -38,6 +104,332 @@
 #define ARR arr2
 #define ARR_(name) concat2_(ARR,name)
 #include "bench_hmap_inc.c"
+#undef ARR
+#undef ARR_
+
+// Define bench_hmap3
+#undef HMAP
+#define HMAP hmap3
+#define ARR arr3
+#define ARR_(name) concat2_(ARR,name)
+#include "bench_hmap_inc.c"
+
+// Deletes and inserts random keys keeping the number of entries constant
+// and measures the time of lookups of missing keys after the churn.
+#define BENCH_CHURN_(MAP)\
+static void bench_churn_##MAP(const CxAllocator* alloc, size_t elcount, size_t rounds) {\
+    MAP m = MAP##_init(alloc, 0);\
+    uint64_t* keys = malloc(elcount * sizeof(*keys));\
+    srand(1);\
+    for (size_t i = 0; i < elcount; i++) {\
+        keys[i] = ((uint64_t)rand() << 32) | rand();\
+        MAP##_set(&m, keys[i], i);\
+    }\
+    struct timespec start;\
+    struct timespec stop;\
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &start);\
+    for (size_t r = 0; r < rounds * elcount; r++) {\
+        const size_t i = rand() % elcount;\
+        MAP##_del(&m, keys[i]);\
+        keys[i] = ((uint64_t)rand() << 32) | rand();\
+        MAP##_set(&m, keys[i], i);\
+    }\
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &stop);\
+    const size_t churn = (stop.tv_sec - start.tv_sec)*1000000000 + stop.tv_nsec - start.tv_nsec;\
+    size_t found = 0;\
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &start);\
+    for (size_t i = 0; i < elcount; i++) {\
+        found += MAP##_get(&m, ((uint64_t)rand() << 32) | rand()) != NULL;\
+    }\
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &stop);\
+    const size_t miss = (stop.tv_sec - start.tv_sec)*1000000000 + stop.tv_nsec - start.tv_nsec;\
+    MAP##_stats st = MAP##_get_stats(&m);\
+    LOGI("%s: elcount:%zu del+set:%.2fns miss:%.2fns nbuckets:%zu deleted:%zu max_probe:%zu avg_probe:%.2f (%zu)",\
+        __func__, elcount, (double)churn/(rounds * elcount), (double)miss/elcount,\
+        st.nbuckets, st.deleted, st.max_probe, st.avg_probe, found);\
+    free(keys);\
+    MAP##_free(&m);\
+}
+BENCH_CHURN_(hmap2)
+BENCH_CHURN_(hmap2rh)
+
+// Aggregates random samples into map entries with large values using
+// get and set of a default value on a miss and using emplace.
+#define BENCH_AGG_(MAP)\
+static void bench_agg_##MAP(const CxAllocator* alloc, size_t nkeys, size_t nsamples) {\
+    MAP m1 = MAP##_init(alloc, 0);\
+    MAP m2 = MAP##_init(alloc, 0);\
+    struct timespec start;\
+    struct timespec stop;\
+    srand(1);\
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &start);\
+    for (size_t i = 0; i < nsamples; i++) {\
+        const uint64_t k = rand() % nkeys;\
+        agg* v = MAP##_get(&m1, k);\
+        if (v == NULL) {\
+            MAP##_set(&m1, k, (agg){0});\
+            v = MAP##_get(&m1, k);\
+        }\
+        v->count++;\
+        v->sum += i;\
+        v->hist[i % sizeof(v->hist)]++;\
+    }\
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &stop);\
+    const size_t getset = (stop.tv_sec - start.tv_sec)*1000000000 + stop.tv_nsec - start.tv_nsec;\
+    srand(1);\
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &start);\
+    for (size_t i = 0; i < nsamples; i++) {\
+        const uint64_t k = rand() % nkeys;\
+        agg* v = MAP##_emplace(&m2, &k, NULL);\
+        v->count++;\
+        v->sum += i;\
+        v->hist[i % sizeof(v->hist)]++;\
+    }\
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &stop);\
+    const size_t emplace = (stop.tv_sec - start.tv_sec)*1000000000 + stop.tv_nsec - start.tv_nsec;\
+    CHK(MAP##_count(&m1) == MAP##_count(&m2));\
+    LOGI("%s: nkeys:%zu nsamples:%zu get+set:%.2fns emplace:%.2fns",\
+        __func__, nkeys, nsamples, (double)getset/nsamples, (double)emplace/nsamples);\
+    MAP##_free(&m1);\
+    MAP##_free(&m2);\
+}
+BENCH_AGG_(hmap2agg)
+BENCH_AGG_(hmap3agg)
+
+// Lookups of static key set with the perfect hash map and hmap2
+static void bench_phmap(const CxAllocator* alloc, size_t elcount, size_t lookups) {
+
+    hmap2 m1 = hmap2_init(alloc, 0);
+    phmap m2 = phmap_init(alloc);
+    uint64_t* keys = malloc(elcount * sizeof(*keys));
+    srand(1);
+    for (size_t i = 0; i < elcount; i++) {
+        keys[i] = ((uint64_t)rand() << 32) | rand();
+        hmap2_set(&m1, keys[i], i);
+    }
+    hmap2_iter iter = {0};
+    hmap2_entry* e;
+    while ((e = hmap2_next(&m1, &iter)) != NULL) {
+        phmap_add(&m2, e->key, e->val);
+    }
+    struct timespec start;
+    struct timespec stop;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &start);
+    CHK(phmap_build(&m2));
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &stop);
+    const size_t build = (stop.tv_sec - start.tv_sec)*1000000000 + stop.tv_nsec - start.tv_nsec;
+
+    size_t sum1 = 0;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &start);
+    for (size_t i = 0; i < lookups; i++) {
+        sum1 += *hmap2_get(&m1, keys[i % elcount]);
+    }
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &stop);
+    const size_t get1 = (stop.tv_sec - start.tv_sec)*1000000000 + stop.tv_nsec - start.tv_nsec;
+    size_t sum2 = 0;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &start);
+    for (size_t i = 0; i < lookups; i++) {
+        sum2 += *phmap_get(&m2, keys[i % elcount]);
+    }
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &stop);
+    const size_t get2 = (stop.tv_sec - start.tv_sec)*1000000000 + stop.tv_nsec - start.tv_nsec;
+    CHK(sum1 == sum2);
+    LOGI("%s: elcount:%zu build:%.2fms hmap2 get:%.2fns (%zu bytes) phmap get:%.2fns (%zu bytes)",
+        __func__, elcount, (double)build/1000000, (double)get1/lookups, (double)get2/lookups,
+        m1.nbuckets_ * (sizeof(hmap2_entry) + 1), m2.count_ * sizeof(phmap_entry) + m2.nbuckets_ * sizeof(*m2.disps_));
+    free(keys);
+    hmap2_free(&m1);
+    phmap_free(&m2);
+}
+
+// Deduplicates random event ids, many of them repeated, with hmap2, hset and hset batches
+static void bench_dedup(const CxAllocator* alloc, size_t nids, size_t nevents) {
+
+    uint64_t* events = malloc(nevents * sizeof(*events));
+    srand(1);
+    for (size_t i = 0; i < nevents; i++) {
+        events[i] = (((uint64_t)rand() << 32) | rand()) % nids;
+    }
+    struct timespec start;
+    struct timespec stop;
+
+    hmap2dd m = hmap2dd_init(alloc, 0);
+    size_t uniq1 = 0;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &start);
+    for (size_t i = 0; i < nevents; i++) {
+        if (hmap2dd_get(&m, events[i]) == NULL) {
+            hmap2dd_set(&m, events[i], 1);
+            uniq1++;
+        }
+    }
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &stop);
+    const size_t time1 = (stop.tv_sec - start.tv_sec)*1000000000 + stop.tv_nsec - start.tv_nsec;
+
+    hset s2 = hset_init(alloc, 0);
+    size_t uniq2 = 0;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &start);
+    for (size_t i = 0; i < nevents; i++) {
+        uniq2 += hset_add(&s2, events[i]);
+    }
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &stop);
+    const size_t time2 = (stop.tv_sec - start.tv_sec)*1000000000 + stop.tv_nsec - start.tv_nsec;
+
+    hset s3 = hset_init(alloc, 0);
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &start);
+    const size_t uniq3 = hset_add_batch(&s3, events, nevents, NULL);
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &stop);
+    const size_t time3 = (stop.tv_sec - start.tv_sec)*1000000000 + stop.tv_nsec - start.tv_nsec;
+
+    // Membership tests of the same events in the filled set
+    size_t found1 = 0;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &start);
+    for (size_t i = 0; i < nevents; i++) {
+        found1 += hset_contains(&s2, events[i] + nids / 2);
+    }
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &stop);
+    const size_t time4 = (stop.tv_sec - start.tv_sec)*1000000000 + stop.tv_nsec - start.tv_nsec;
+    for (size_t i = 0; i < nevents; i++) {
+        events[i] += nids / 2;
+    }
+    bool* found = malloc(nevents * sizeof(*found));
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &start);
+    const size_t found2 = hset_contains_batch(&s2, events, nevents, found);
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &stop);
+    const size_t time5 = (stop.tv_sec - start.tv_sec)*1000000000 + stop.tv_nsec - start.tv_nsec;
+
+    CHK(uniq1 == uniq2 && uniq2 == uniq3 && found1 == found2);
+    LOGI("%s: nids:%zu uniq:%zu hmap2:%.2fns (%zu bytes) hset:%.2fns (%zu bytes) hset batch:%.2fns contains:%.2fns batch:%.2fns",
+        __func__, nids, uniq1, (double)time1/nevents, m.nbuckets_ * (sizeof(hmap2dd_entry) + 1),
+        (double)time2/nevents, s2.nbuckets_ * (sizeof(hset_entry) + 1), (double)time3/nevents,
+        (double)time4/nevents, (double)time5/nevents);
+    free(found);
+    free(events);
+    hmap2dd_free(&m);
+    hset_free(&s2);
+    hset_free(&s3);
+}
+
+// Scans a map sparsely filled after deletes, with a single iterator and with
+// split ranges iterated by threads of a pool.
+typedef struct scan_range { hmap2* m; hmap2_iter iter; uint64_t sum; } scan_range;
+static void scan_worker(void* arg) {
+
+    scan_range* r = arg;
+    hmap2_entry* e;
+    while ((e = hmap2_next(r->m, &r->iter)) != NULL) {
+        r->sum += e->val;
+    }
+}
+
+static void bench_scan(const CxAllocator* alloc, size_t elcount, size_t nthreads) {
+
+    hmap2 m = hmap2_init(alloc, 0);
+    for (size_t i = 0; i < elcount; i++) {
+        hmap2_set(&m, i, i);
+    }
+    for (size_t i = 0; i < elcount; i++) {
+        if (i % 4) {
+            hmap2_del(&m, i);
+        }
+    }
+    struct timespec start;
+    struct timespec stop;
+    scan_range r1 = {.m = &m};
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    scan_worker(&r1);
+    clock_gettime(CLOCK_MONOTONIC, &stop);
+    const size_t time1 = (stop.tv_sec - start.tv_sec)*1000000000 + stop.tv_nsec - start.tv_nsec;
+
+    scan_range ranges[64] = {0};
+    hmap2_iter iters[64];
+    CxThreadPool* tp = cx_tpool_new(alloc, nthreads, 64);
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    const size_t n = hmap2_iter_split(&m, nthreads, iters);
+    for (size_t i = 0; i < n; i++) {
+        ranges[i] = (scan_range){.m = &m, .iter = iters[i]};
+        CHK(cx_tpool_run(tp, scan_worker, &ranges[i]) == 0);
+    }
+    cx_tpool_del(tp);
+    clock_gettime(CLOCK_MONOTONIC, &stop);
+    const size_t time2 = (stop.tv_sec - start.tv_sec)*1000000000 + stop.tv_nsec - start.tv_nsec;
+    uint64_t sum2 = 0;
+    for (size_t i = 0; i < n; i++) {
+        sum2 += ranges[i].sum;
+    }
+    CHK(r1.sum == sum2);
+    LOGI("%s: nbuckets:%zu count:%zu scan:%.2fms split scan (%zu threads):%.2fms",
+        __func__, m.nbuckets_, hmap2_count(&m), (double)time1/1000000, n, (double)time2/1000000);
+    hmap2_free(&m);
+}
+
+// Expires half of the entries collecting the keys and deleting each one,
+// and with a single retain sweep.
+static bool retain_odd(hmap2_entry* e, void* ctx) {
+
+    return e->val % 2;
+}
+
+static void bench_retain(const CxAllocator* alloc, size_t elcount) {
+
+    hmap2 m1 = hmap2_init(alloc, 0);
+    hmap2 m2 = hmap2_init(alloc, 0);
+    srand(1);
+    for (size_t i = 0; i < elcount; i++) {
+        const uint64_t k = ((uint64_t)rand() << 32) | rand();
+        hmap2_set(&m1, k, i);
+        hmap2_set(&m2, k, i);
+    }
+    struct timespec start;
+    struct timespec stop;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &start);
+    uint64_t* keys = malloc(elcount * sizeof(*keys));
+    size_t nkeys = 0;
+    hmap2_iter iter = {0};
+    hmap2_entry* e;
+    while ((e = hmap2_next(&m1, &iter)) != NULL) {
+        if (e->val % 2 == 0) {
+            keys[nkeys++] = e->key;
+        }
+    }
+    for (size_t i = 0; i < nkeys; i++) {
+        hmap2_del(&m1, keys[i]);
+    }
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &stop);
+    const size_t time1 = (stop.tv_sec - start.tv_sec)*1000000000 + stop.tv_nsec - start.tv_nsec;
+
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &start);
+    hmap2_retain(&m2, retain_odd, NULL);
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &stop);
+    const size_t time2 = (stop.tv_sec - start.tv_sec)*1000000000 + stop.tv_nsec - start.tv_nsec;
+
+    const size_t nbuckets = m2.nbuckets_;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &start);
+    hmap2_shrink_to_fit(&m2);
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &stop);
+    const size_t time3 = (stop.tv_sec - start.tv_sec)*1000000000 + stop.tv_nsec - start.tv_nsec;
+    CHK(hmap2_count(&m1) == hmap2_count(&m2));
+
+    // Lookups of missing keys after the expiration
+    size_t found = 0;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &start);
+    for (size_t i = 0; i < elcount; i++) {
+        found += hmap2_get(&m1, ((uint64_t)rand() << 32) | rand()) != NULL;
+    }
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &stop);
+    const size_t miss1 = (stop.tv_sec - start.tv_sec)*1000000000 + stop.tv_nsec - start.tv_nsec;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &start);
+    for (size_t i = 0; i < elcount; i++) {
+        found += hmap2_get(&m2, ((uint64_t)rand() << 32) | rand()) != NULL;
+    }
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &stop);
+    const size_t miss2 = (stop.tv_sec - start.tv_sec)*1000000000 + stop.tv_nsec - start.tv_nsec;
+    LOGI("%s: elcount:%zu next+del:%.2fms (deleted:%zu miss:%.2fns) retain:%.2fms shrink:%.2fms (miss:%.2fns) nbuckets:%zu->%zu (%zu)",
+        __func__, elcount, (double)time1/1000000, m1.deleted_, (double)miss1/elcount, (double)time2/1000000,
+        (double)time3/1000000, (double)miss2/elcount, nbuckets, m2.nbuckets_, found);
+    free(keys);
+    hmap2_free(&m1);
+    hmap2_free(&m2);
+}
 
 void bench_hmap() {
 
@@ -45,5 +437,42 @@ void bench_hmap() {
     const size_t lookups = elcount;
     bench_hmap1(cx_def_allocator(), elcount, lookups);
     bench_hmap2(cx_def_allocator(), elcount, lookups);
+    bench_hmap3(cx_def_allocator(), elcount, lookups);
+
+    // Batch lookups with map larger than the cache
+    const size_t batch_elcount = 1000000;
+    const size_t batch_lookups = 1000000;
+    bench_batch_hmap1(cx_def_allocator(), batch_elcount, batch_lookups, 256);
+    bench_batch_hmap2(cx_def_allocator(), batch_elcount, batch_lookups, 256);
+    bench_batch_hmap3(cx_def_allocator(), batch_elcount, batch_lookups, 256);
+    bench_batch_hmap3(cx_def_allocator(), batch_elcount, batch_lookups, 4096);
+
+    // Delete heavy workload
+    bench_churn_hmap2(cx_def_allocator(), 100000, 10);
+    bench_churn_hmap2rh(cx_def_allocator(), 100000, 10);
+
+    // Static key sets
+    bench_phmap(cx_def_allocator(), 1000, 10000000);
+    bench_phmap(cx_def_allocator(), 1000000, 10000000);
+
+    // Aggregation with large values and many new keys
+    bench_agg_hmap2agg(cx_def_allocator(), 1000000, 2000000);
+    bench_agg_hmap3agg(cx_def_allocator(), 1000000, 2000000);
+
+    // Deduplication of event ids
+    bench_dedup(cx_def_allocator(), 10000, 20000);
+    bench_dedup(cx_def_allocator(), 2000000, 4000000);
+
+    // Full map scans
+    bench_scan(cx_def_allocator(), 4000000, 4);
+
+    // Expiration of entries
+    bench_retain(cx_def_allocator(), 1000000);
+}
+
+__attribute__((constructor))
+static void reg_bench_hmap(void) {
+
+    reg_add_test("hmap", bench_hmap);
 }
 
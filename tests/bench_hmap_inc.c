@@ -84,3 +84,57 @@ void BENCH_(HMAP)(const CxAllocator* alloc, size_t elcount, size_t lookups) {
     HMAP_(_free)(&m);
 }
 
+// Compares the time to resolve 'lookups' keys using scalar gets
+// and batch gets with the specified batch size.
+void BENCH_BATCH_(HMAP)(const CxAllocator* alloc, size_t elcount, size_t lookups, size_t batch) {
+
+    LOGI("%s: elcount:%zu lookups:%zu batch:%zu", __func__, elcount, lookups, batch);
+    // Fill map with 'elcount' random entries
+    HMAP m = HMAP_(_init)(alloc, 0);
+    srand(1);
+    for (size_t i = 0; i < elcount; i++) {
+        const uint64_t key = ((uint64_t)rand() << 31) | rand();
+        HMAP_(_set)(&m, key, key * 2);
+    }
+
+    // Random keys to lookup with approximately half found
+    uint64_t* keys = malloc(lookups * sizeof(*keys));
+    uint64_t** vals = malloc(lookups * sizeof(*vals));
+    srand(1);
+    for (size_t i = 0; i < lookups; i++) {
+        const uint64_t key = ((uint64_t)rand() << 31) | rand();
+        keys[i] = i % 2 ? key : key + 1;
+    }
+
+    struct timespec start;
+    struct timespec stop;
+    // Scalar lookups
+    size_t s_found = 0;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &start);
+    for (size_t i = 0; i < lookups; i++) {
+        uint64_t* val = HMAP_(_get)(&m, keys[i]);
+        if (val) {
+            s_found++;
+        }
+    }
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &stop);
+    const size_t s_elapsed = (stop.tv_sec - start.tv_sec)*1000000000 + stop.tv_nsec-start.tv_nsec;
+
+    // Batch lookups
+    size_t b_found = 0;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &start);
+    for (size_t i = 0; i < lookups; i += batch) {
+        const size_t n = lookups - i < batch ? lookups - i : batch;
+        b_found += HMAP_(_get_batch)(&m, keys + i, n, vals + i);
+    }
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &stop);
+    const size_t b_elapsed = (stop.tv_sec - start.tv_sec)*1000000000 + stop.tv_nsec-start.tv_nsec;
+    CHK(s_found == b_found);
+
+    LOGI("\tscalar:%6.2fns/key batch:%6.2fns/key found:%zu",
+        (double)s_elapsed/lookups, (double)b_elapsed/lookups, b_found);
+    free(keys);
+    free(vals);
+    HMAP_(_free)(&m);
+}
+
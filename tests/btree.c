@@ -0,0 +1,289 @@
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "cx_alloc.h"
+#include "logger.h"
+#include "registry.h"
+
+// Tree uint64 -> uint64 with instance allocator
+#define cx_btree_name btii
+#define cx_btree_key  uint64_t
+#define cx_btree_val  uint64_t
+#define cx_btree_instance_allocator
+#define cx_btree_static
+#define cx_btree_implement
+#include "cx_btree.h"
+
+// Tree with small nodes, which has more levels and splits and merges more often
+#define cx_btree_name btsm
+#define cx_btree_key  int32_t
+#define cx_btree_val  int32_t
+#define cx_btree_node_size 48
+#define cx_btree_static
+#define cx_btree_implement
+#include "cx_btree.h"
+
+// Tree of allocated strings
+#define cx_btree_name btcc
+#define cx_btree_key  char*
+#define cx_btree_val  char*
+#define cx_btree_cmp_key(pk1,pk2,s) strcmp(*(pk1),*(pk2))
+#define cx_btree_free_key(pk)       free(*pk)
+#define cx_btree_free_val(pv)       free(*pv)
+#define cx_btree_node_size 128
+#define cx_btree_static
+#define cx_btree_implement
+#include "cx_btree.h"
+
+// Checks the structure of the subtree and returns its number of entries.
+// All leaves must be at the same level, the keys sorted and each separator key
+// equal to the first key of the subtree at its right.
+#define CHECK_NODE_(BT)\
+static size_t check_node_##BT(const BT* t, void* node, size_t height, BT##_leaf_** leaf) {\
+    if (height == 0) {\
+        BT##_leaf_* l = node;\
+        CXCHK(l->count_ > 0 && l->count_ <= sizeof(l->entries_)/sizeof(l->entries_[0]));\
+        CXCHK(*leaf == NULL || (*leaf)->next_ == l);\
+        for (size_t i = 1; i < l->count_; i++) {\
+            CXCHK(l->entries_[i-1].key < l->entries_[i].key);\
+        }\
+        *leaf = l;\
+        return l->count_;\
+    }\
+    BT##_inner_* n = node;\
+    CXCHK(n->count_ > 0 && n->count_ <= sizeof(n->keys_)/sizeof(n->keys_[0]));\
+    CXCHK(node == t->root_ || n->count_ >= sizeof(n->keys_)/sizeof(n->keys_[0])/2);\
+    size_t count = 0;\
+    for (size_t i = 0; i <= n->count_; i++) {\
+        if (i > 0) {\
+            void* c = n->children_[i];\
+            for (size_t h = height - 1; h > 0; h--) {\
+                c = ((BT##_inner_*)c)->children_[0];\
+            }\
+            CXCHK(n->keys_[i-1] == ((BT##_leaf_*)c)->entries_[0].key);\
+        }\
+        count += check_node_##BT(t, n->children_[i], height - 1, leaf);\
+    }\
+    return count;\
+}\
+static void check_##BT(const BT* t) {\
+    BT##_leaf_* leaf = NULL;\
+    const size_t count = t->root_ ? check_node_##BT(t, t->root_, t->height_, &leaf) : 0;\
+    CXCHK(count == t->count_);\
+    CXCHK(leaf == NULL || leaf->next_ == NULL);\
+}
+CHECK_NODE_(btii)
+CHECK_NODE_(btsm)
+
+static void test_btii(size_t size, const CxAllocator* alloc) {
+
+    LOGI("%s: size=%lu alloc=%p", __func__, size, alloc);
+    btii t = btii_init(alloc);
+    CXCHK(btii_get(&t, 1) == NULL);
+    CXCHK(!btii_del(&t, 1));
+    btii_iter iter = {0};
+    CXCHK(btii_next(&t, &iter) == NULL);
+    iter = btii_lower_bound(&t, 0);
+    CXCHK(btii_next(&t, &iter) == NULL);
+
+    // Inserts keys in pseudo random order
+    const uint64_t step = 7919;
+    for (size_t i = 0; i < size; i++) {
+        const uint64_t k = ((i * step) % size) * 10;
+        btii_set(&t, k, k + 1);
+    }
+    check_btii(&t);
+    CXCHK(btii_count(&t) == size);
+    for (size_t i = 0; i < size; i++) {
+        uint64_t* v = btii_get(&t, i * 10);
+        CXCHK(v && *v == i * 10 + 1);
+        CXCHK(btii_get(&t, i * 10 + 5) == NULL);
+    }
+    // Updates values
+    for (size_t i = 0; i < size; i++) {
+        btii_set(&t, i * 10, i);
+    }
+    CXCHK(btii_count(&t) == size);
+
+    // Iterates in key order
+    iter = (btii_iter){0};
+    btii_entry* e;
+    size_t count = 0;
+    while ((e = btii_next(&t, &iter)) != NULL) {
+        CXCHK(e->key == count * 10 && e->val == count);
+        count++;
+    }
+    CXCHK(count == size);
+    CXCHK(btii_next(&t, &iter) == NULL);
+
+    // Range scans
+    for (size_t i = 0; i < size; i += 1 + size / 100) {
+        iter = btii_lower_bound(&t, i * 10);
+        e = btii_next(&t, &iter);
+        CXCHK(e && e->key == i * 10);
+        iter = btii_lower_bound(&t, i * 10 + 1);
+        e = btii_next(&t, &iter);
+        CXCHK(i + 1 == size ? e == NULL : e->key == (i + 1) * 10);
+        iter = btii_upper_bound(&t, i * 10);
+        e = btii_next(&t, &iter);
+        CXCHK(i + 1 == size ? e == NULL : e->key == (i + 1) * 10);
+        // Counts the keys in [i*10, i*10 + 100)
+        iter = btii_lower_bound(&t, i * 10);
+        count = 0;
+        while ((e = btii_next(&t, &iter)) != NULL && e->key < i * 10 + 100) {
+            count++;
+        }
+        CXCHK(count == (size - i < 10 ? size - i : 10));
+    }
+
+    // Deletes keys in pseudo random order, checking the tree periodically
+    for (size_t i = 0; i < size; i++) {
+        const uint64_t k = ((i * step) % size) * 10;
+        if (k % 20 == 0) {
+            CXCHK(btii_del(&t, k));
+            CXCHK(!btii_del(&t, k));
+        }
+        if (i % 1000 == 0) {
+            check_btii(&t);
+        }
+    }
+    check_btii(&t);
+    CXCHK(btii_count(&t) == size / 2);
+    for (size_t i = 0; i < size; i++) {
+        CXCHK((btii_get(&t, i * 10) != NULL) == (i % 2 != 0));
+    }
+    for (size_t i = 1; i < size; i += 2) {
+        CXCHK(btii_del(&t, i * 10));
+    }
+    CXCHK(btii_count(&t) == 0 && t.root_ == NULL);
+    btii_set(&t, 1, 1);
+    CXCHK(*btii_get(&t, 1) == 1);
+    btii_free(&t);
+}
+
+static void test_btsm(size_t size) {
+
+    LOGI("%s: size=%lu", __func__, size);
+    btsm t = btsm_init();
+
+    // Appending keys in order fills the leaves
+    for (size_t i = 0; i < size; i++) {
+        btsm_set(&t, i, i);
+    }
+    check_btsm(&t);
+    // Deletes from the front and back and inserts in reverse order
+    for (size_t i = 0; i < size / 4; i++) {
+        CXCHK(btsm_del(&t, i));
+        CXCHK(btsm_del(&t, size - 1 - i));
+        check_btsm(&t);
+    }
+    for (size_t i = size / 4; i > 0; i--) {
+        btsm_set(&t, i - 1, i - 1);
+        btsm_set(&t, size - i, size - i);
+        check_btsm(&t);
+    }
+    CXCHK(btsm_count(&t) == size);
+
+    // Bulk load
+    int32_t* keys = malloc(size * sizeof(*keys));
+    for (size_t i = 0; i < size; i++) {
+        keys[i] = i * 2;
+    }
+    CXCHK(!btsm_load_sorted(&t, keys, keys, size));
+    btsm_clear(&t);
+    CXCHK(btsm_load_sorted(&t, keys, keys, 0));
+    CXCHK(btsm_count(&t) == 0);
+    if (size > 1) {
+        keys[1] = keys[0];
+        CXCHK(!btsm_load_sorted(&t, keys, keys, size));
+        keys[1] = 2;
+    }
+    for (size_t n = 1; n <= size; n = n * 3 + 1) {
+        btsm_clear(&t);
+        CXCHK(btsm_load_sorted(&t, keys, keys, n));
+        check_btsm(&t);
+        CXCHK(btsm_count(&t) == n);
+        for (size_t i = 0; i < n; i++) {
+            CXCHK(*btsm_get(&t, i * 2) == (int32_t)i * 2);
+        }
+        // Tree loaded is updated normally
+        for (size_t i = 0; i < n; i++) {
+            btsm_set(&t, i * 2 + 1, 0);
+        }
+        check_btsm(&t);
+        for (size_t i = 0; i < 2 * n; i += 3) {
+            CXCHK(btsm_del(&t, i));
+        }
+        check_btsm(&t);
+    }
+    free(keys);
+    btsm_free(&t);
+}
+
+static char* newstr(size_t val) {
+
+    char buf[32];
+    snprintf(buf, sizeof(buf), "k%06zu", val);
+    return strdup(buf);
+}
+
+static void test_btcc(size_t size) {
+
+    LOGI("%s: size=%lu", __func__, size);
+    btcc t = btcc_init();
+    for (size_t i = 0; i < size; i++) {
+        btcc_set(&t, newstr((i * 7919) % size), newstr(i));
+    }
+    // Replacing the value frees the new key and the old value
+    for (size_t i = 0; i < size; i += 2) {
+        btcc_set(&t, newstr(i), newstr(i));
+    }
+    CXCHK(btcc_count(&t) == size);
+    char key[32];
+    for (size_t i = 0; i < size; i += 2) {
+        snprintf(key, sizeof(key), "k%06zu", i);
+        char** v = btcc_get(&t, key);
+        CXCHK(v && strcmp(*v, key) == 0);
+    }
+    // Deletes the first keys of the leaves and subtrees, which are also separator keys,
+    // and checks that the remaining keys are reachable.
+    for (size_t i = 0; i < size; i += 3) {
+        snprintf(key, sizeof(key), "k%06zu", i);
+        CXCHK(btcc_del(&t, key));
+    }
+    for (size_t i = 0; i < size; i++) {
+        snprintf(key, sizeof(key), "k%06zu", i);
+        CXCHK((btcc_get(&t, key) != NULL) == (i % 3 != 0));
+    }
+    snprintf(key, sizeof(key), "k%06zu", size / 2);
+    btcc_iter iter = btcc_lower_bound(&t, key);
+    btcc_entry* e;
+    char* prev = NULL;
+    size_t count = 0;
+    while ((e = btcc_next(&t, &iter)) != NULL) {
+        CXCHK(prev == NULL || strcmp(prev, e->key) < 0);
+        prev = e->key;
+        count++;
+    }
+    CXCHK(count > 0 && count < btcc_count(&t));
+    btcc_free(&t);
+}
+
+void test_btree(void) {
+
+    test_btii(0, NULL);
+    test_btii(1, NULL);
+    test_btii(100, cx_def_allocator());
+    test_btii(50000, NULL);
+    test_btsm(1);
+    test_btsm(2000);
+    test_btcc(5000);
+}
+
+__attribute__((constructor))
+static void reg_btree(void) {
+
+    reg_add_test("btree", test_btree);
+}
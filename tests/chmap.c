@@ -0,0 +1,111 @@
+#include <stdlib.h>
+#include <stdint.h>
+#include <pthread.h>
+
+#include "logger.h"
+#include "util.h"
+#include "registry.h"
+
+#define cx_chmap_name cmapii
+#define cx_chmap_key  uint64_t
+#define cx_chmap_val  uint64_t
+#define cx_chmap_instance_allocator
+#define cx_chmap_static
+#define cx_chmap_implement
+#include "cx_chmap.h"
+
+typedef struct Test {
+    cmapii* m;
+    size_t  start;
+    size_t  count;
+    size_t  counters;
+} Test;
+
+// Increments counter value
+static void incr(uint64_t* val, bool found, void* ctx) {
+
+    (*val)++;
+}
+
+// Inserts, checks and deletes a disjoint range of keys
+// and increments shared counters.
+static void* worker(void* arg) {
+
+    Test* t = arg;
+    for (size_t i = t->start; i < t->start + t->count; i++) {
+        cmapii_set(t->m, i, i * 2);
+        cmapii_update(t->m, i % t->counters, incr, NULL);
+    }
+    for (size_t i = t->start; i < t->start + t->count; i++) {
+        uint64_t v;
+        CHK(cmapii_get_copy(t->m, i, &v));
+        CHK(v == i * 2);
+    }
+    for (size_t i = t->start; i < t->start + t->count; i += 2) {
+        CHK(cmapii_del(t->m, i));
+    }
+    return NULL;
+}
+
+void test_chmap(void) {
+
+    const size_t nthreads = 8;
+    const size_t count = 10000;
+    const size_t counters = 100;
+    LOGI("chmap %zuT", nthreads);
+
+    cmapii m = cmapii_init(NULL, 0);
+
+    // Single thread
+    {
+        uint64_t v;
+        cmapii_set(&m, 1, 10);
+        CHK(cmapii_get_copy(&m, 1, &v) && v == 10);
+        CHK(!cmapii_get_copy(&m, 2, &v));
+        CHK(cmapii_update(&m, 1, incr, NULL));
+        CHK(!cmapii_update(&m, 2, incr, NULL));
+        CHK(cmapii_get_copy(&m, 1, &v) && v == 11);
+        CHK(cmapii_get_copy(&m, 2, &v) && v == 1);
+        CHK(cmapii_count(&m) == 2);
+        CHK(cmapii_del(&m, 1));
+        CHK(!cmapii_del(&m, 1));
+        cmapii_clear(&m);
+        CHK(cmapii_count(&m) == 0);
+    }
+
+    // Threads with disjoint ranges of keys above the counter keys
+    Test tests[nthreads];
+    pthread_t ids[nthreads];
+    for (size_t i = 0; i < nthreads; i++) {
+        tests[i] = (Test){.m = &m, .start = counters + i * count, .count = count, .counters = counters};
+        CHK(pthread_create(&ids[i], NULL, worker, &tests[i]) == 0);
+    }
+    for (size_t i = 0; i < nthreads; i++) {
+        CHK(pthread_join(ids[i], NULL) == 0);
+    }
+
+    // Checks remaining keys
+    CHK(cmapii_count(&m) == counters + nthreads * count / 2);
+    for (size_t i = counters; i < counters + nthreads * count; i++) {
+        uint64_t v;
+        const bool found = cmapii_get_copy(&m, i, &v);
+        CHK(found == (i % 2 != 0));
+        CHK(!found || v == i * 2);
+    }
+    // Checks counters
+    uint64_t total = 0;
+    for (size_t i = 0; i < counters; i++) {
+        uint64_t v;
+        CHK(cmapii_get_copy(&m, i, &v));
+        total += v;
+    }
+    CHK(total == nthreads * count);
+    cmapii_free(&m);
+}
+
+__attribute__((constructor))
+static void reg_chmap(void) {
+
+    reg_add_test("chmap", test_chmap);
+}
+
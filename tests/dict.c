@@ -0,0 +1,259 @@
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "cx_alloc.h"
+#include "logger.h"
+#include "registry.h"
+
+// Dictionary int -> int
+#define cx_dict_name dictii
+#define cx_dict_key  int
+#define cx_dict_val  int
+#define cx_dict_instance_allocator
+#define cx_dict_static
+#define cx_dict_implement
+#include "cx_dict.h"
+
+// Compares C string with key view (ptr,len) not necessarily NUL terminated
+static int cmp_strn(const char* s, const char* key, size_t len) {
+
+    return strncmp(s, key, len) != 0 || s[len] != 0;
+}
+
+// Dictionary of allocated strings
+uint64_t cx_hmap_hash_wy64(const void* buf, size_t len);
+uint64_t cx_hmap_hash_wy64_str(const char* str);
+#define cx_dict_name dictcc
+#define cx_dict_key  char*
+#define cx_dict_val  char*
+#define cx_dict_cmp_key(pk1,pk2,s)  strcmp(*(char**)(pk1),*(char**)(pk2))
+#define cx_dict_hash_key(pk,s)      cx_hmap_hash_wy64_str(*(char**)(pk))
+#define cx_dict_cmp_keyn(pk,key,len) cmp_strn(*(char**)(pk),key,len)
+#define cx_dict_free_key(pk)        free(*pk)
+#define cx_dict_free_val(pv)        free(*pv)
+#define cx_dict_cache_hash
+#define cx_dict_static
+#define cx_dict_implement
+#include "cx_dict.h"
+
+static char* newstr(size_t val) {
+
+    char buf[32];
+    snprintf(buf, sizeof(buf), "%zu", val);
+    return strdup(buf);
+}
+
+static void test_dictii(size_t size, const CxAllocator* alloc) {
+
+    LOGI("%s: size=%lu alloc=%p", __func__, size, alloc);
+    dictii d = dictii_init(alloc);
+    CXCHK(dictii_get(&d, 0) == NULL);
+    CXCHK(!dictii_del(&d, 0));
+
+    // Inserts keys in reverse order
+    for (size_t i = 0; i < size; i++) {
+        dictii_set(&d, size - 1 - i, i);
+    }
+    CXCHK(dictii_count(&d) == size);
+    for (size_t i = 0; i < size; i++) {
+        int* v = dictii_get(&d, size - 1 - i);
+        CXCHK(v && *v == i);
+        dictii_entry* e = dictii_at(&d, i);
+        CXCHK(e->key == size - 1 - i && e->val == i);
+    }
+    CXCHK(dictii_at(&d, size) == NULL);
+
+    // Updates keep the insertion order
+    for (size_t i = 0; i < size; i++) {
+        dictii_set(&d, i, i * 2);
+    }
+    CXCHK(dictii_count(&d) == size);
+    for (size_t i = 0; i < size; i++) {
+        CXCHK(dictii_at(&d, i)->key == size - 1 - i);
+        CXCHK(*dictii_get(&d, i) == i * 2);
+    }
+
+    // Deletes even keys keeping the order of the others
+    for (size_t i = 0; i < size; i += 2) {
+        CXCHK(dictii_del(&d, i));
+    }
+    CXCHK(dictii_count(&d) == size / 2);
+    int prev = size;
+    for (size_t i = 0; i < dictii_count(&d); i++) {
+        dictii_entry* e = dictii_at(&d, i);
+        CXCHK(e->key % 2 == 1 && e->key < prev);
+        prev = e->key;
+    }
+    for (size_t i = 0; i < size; i++) {
+        int* v = dictii_get(&d, i);
+        CXCHK(i % 2 == 0 ? v == NULL : *v == i * 2);
+    }
+
+    // Deletes while iterating and inserts new keys after the iteration
+    dictii_iter iter = {0};
+    dictii_entry* e;
+    size_t n = 0;
+    while ((e = dictii_next(&d, &iter)) != NULL) {
+        if (n++ % 3 == 0) {
+            CXCHK(dictii_del(&d, e->key));
+        }
+    }
+    CXCHK(n == size / 2);
+    const size_t count = dictii_count(&d);
+    CXCHK(count == size / 2 - (size / 2 + 2) / 3);
+    for (size_t i = 0; i < size; i++) {
+        dictii_set(&d, size + i, i);
+    }
+    CXCHK(dictii_count(&d) == count + size);
+    for (size_t i = 0; i < size; i++) {
+        e = dictii_at(&d, count + i);
+        CXCHK(e->key == size + i && e->val == i);
+    }
+
+    // Deletes all the keys one by one
+    for (size_t i = 0; i < 2 * size; i++) {
+        dictii_del(&d, i);
+    }
+    CXCHK(dictii_count(&d) == 0);
+    CXCHK(dictii_at(&d, 0) == NULL);
+    iter = (dictii_iter){0};
+    CXCHK(dictii_next(&d, &iter) == NULL);
+    dictii_set(&d, 1, 2);
+    CXCHK(dictii_at(&d, 0)->key == 1);
+
+    dictii_clear(&d);
+    CXCHK(dictii_count(&d) == 0);
+    CXCHK(dictii_get(&d, 1) == NULL);
+    dictii_set(&d, 1, 1);
+    CXCHK(*dictii_get(&d, 1) == 1);
+    dictii_free(&d);
+}
+
+static void test_dictcc(size_t size) {
+
+    LOGI("%s: size=%lu", __func__, size);
+    dictcc d = dictcc_init();
+    for (size_t i = 0; i < size; i++) {
+        dictcc_set(&d, newstr(i), newstr(i * 2));
+    }
+    for (size_t i = 0; i < size; i++) {
+        dictcc_set(&d, newstr(i), newstr(i * 3));
+    }
+    CXCHK(dictcc_count(&d) == size);
+    char key[32];
+    for (size_t i = 0; i < size; i++) {
+        snprintf(key, sizeof(key), "%zu", i);
+        char** v = dictcc_get(&d, key);
+        CXCHK(v && strtoul(*v, NULL, 10) == i * 3);
+        // Order of entry after the previous deletions
+        CXCHK(strcmp(dictcc_at(&d, i - (i + 2) / 3)->key, key) == 0);
+        if (i % 3 == 0) {
+            CXCHK(dictcc_del(&d, key));
+        }
+    }
+    CXCHK(dictcc_count(&d) == size - (size + 2) / 3);
+
+    // Lookups and deletions using key views of a larger buffer
+    for (size_t i = 0; i < size; i++) {
+        const size_t len = snprintf(key, sizeof(key), "%zu", i);
+        strcpy(key + len, "999");
+        const uint64_t hash = cx_hmap_hash_wy64(key, len);
+        char** v = dictcc_getn(&d, key, len, hash);
+        if (i % 3 == 0) {
+            CXCHK(v == NULL && !dictcc_deln(&d, key, len, hash));
+        }
+        else {
+            CXCHK(v && strtoul(*v, NULL, 10) == i * 3);
+            CXCHK(dictcc_deln(&d, key, len, hash));
+        }
+    }
+    CXCHK(dictcc_count(&d) == 0);
+
+    // Inserts using key views copying the key only for new entries
+    for (size_t i = 0; i < 2 * size; i++) {
+        const size_t len = snprintf(key, sizeof(key), "%zu", i % size);
+        strcpy(key + len, "999");
+        bool inserted;
+        dictcc_entry* e = dictcc_emplacen(&d, key, len, cx_hmap_hash_wy64(key, len), &inserted);
+        CXCHK(inserted == (i < size));
+        if (inserted) {
+            CXCHK(e->key == NULL && e->val == NULL);
+            e->key = strndup(key, len);
+        } else {
+            free(e->val);
+        }
+        e->val = newstr(i);
+    }
+    CXCHK(dictcc_count(&d) == size);
+    for (size_t i = 0; i < size; i++) {
+        snprintf(key, sizeof(key), "%zu", i);
+        dictcc_entry* e = dictcc_at(&d, i);
+        CXCHK(strcmp(e->key, key) == 0 && strtoul(e->val, NULL, 10) == size + i);
+        CXCHK(dictcc_get(&d, key) == &e->val);
+    }
+    dictcc_free(&d);
+}
+
+// Random sets and deletes of keys in a small range checking the
+// order of the entries against an array with the keys in insertion order
+static void test_dict_random(size_t nkeys, size_t nops) {
+
+    LOGI("%s: nkeys=%lu nops=%lu", __func__, nkeys, nops);
+    dictii d = dictii_init(NULL);
+    int keys[nkeys];
+    size_t count = 0;
+    srand(1);
+    for (size_t op = 0; op < nops; op++) {
+        const int key = rand() % nkeys;
+        size_t pos = 0;
+        while (pos < count && keys[pos] != key) {
+            pos++;
+        }
+        if (rand() % 2) {
+            dictii_set(&d, key, key * 2);
+            if (pos == count) {
+                keys[count++] = key;
+            }
+        } else {
+            CXCHK(dictii_del(&d, key) == (pos < count));
+            if (pos < count) {
+                memmove(keys + pos, keys + pos + 1, (count - pos - 1) * sizeof(keys[0]));
+                count--;
+            }
+        }
+        CXCHK(dictii_count(&d) == count);
+        // Checks the order using the iterator and sometimes by the entry order
+        if (op % 16 == 0) {
+            for (size_t i = 0; i < count; i++) {
+                CXCHK(dictii_at(&d, i)->key == keys[i]);
+            }
+        } else {
+            dictii_iter iter = {0};
+            for (size_t i = 0; i < count; i++) {
+                dictii_entry* e = dictii_next(&d, &iter);
+                CXCHK(e->key == keys[i] && e->val == keys[i] * 2);
+            }
+            CXCHK(dictii_next(&d, &iter) == NULL);
+        }
+    }
+    dictii_free(&d);
+}
+
+void test_dict(void) {
+
+    test_dictii(5, NULL);
+    test_dictii(1000, NULL);
+    test_dictcc(5);
+    test_dictcc(1000);
+    test_dict_random(6, 1000);
+    test_dict_random(200, 20000);
+}
+
+__attribute__((constructor))
+static void reg_dict(void) {
+
+    reg_add_test("dict", test_dict);
+}
+
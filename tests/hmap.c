@@ -2,9 +2,19 @@
 #include <stdlib.h>
 #include <stddef.h>
 #include <stdio.h>
+#include <unistd.h>
+#include <signal.h>
+#include <sys/wait.h>
 
 #include "logger.h"
 #include "registry.h"
+#include "cx_tpool.h"
+
+// Compares C string with key view (ptr,len) not necessarily NUL terminated
+static int cmp_strn(const char* s, const char* key, size_t len) {
+
+    return strncmp(s, key, len) != 0 || s[len] != 0;
+}
 
 // Map int -> int
 #define cx_hmap_name                mapii
@@ -109,6 +119,34 @@ void test_hmapii(size_t size, size_t nbuckets, const CxAllocator* alloc) {
         }
     }
 
+    // Batch get compared with get, including keys not found
+    {
+        const size_t nkeys = size + 100;
+        int* keys = malloc(nkeys * sizeof(*keys));
+        int* vals = malloc(nkeys * sizeof(*vals));
+        int** pvals = malloc(nkeys * sizeof(*pvals));
+        size_t found = 0;
+        for (size_t i = 0; i < nkeys; i++) {
+            keys[i] = nkeys - i - 1;
+            vals[i] = keys[i] * 5;
+            found += mapii_get(&m, keys[i]) != NULL;
+        }
+        CXCHK(mapii_get_batch(&m, keys, nkeys, pvals) == found);
+        for (size_t i = 0; i < nkeys; i++) {
+            CXCHK(pvals[i] == mapii_get(&m, keys[i]));
+        }
+        // Batch set
+        mapii_set_batch(&m, keys, vals, nkeys);
+        CXCHK(mapii_count(&m) == nkeys);
+        CXCHK(mapii_get_batch(&m, keys, nkeys, pvals) == nkeys);
+        for (size_t i = 0; i < nkeys; i++) {
+            CXCHK(*pvals[i] == keys[i] * 5);
+        }
+        free(keys);
+        free(vals);
+        free(pvals);
+    }
+
     mapii_clear(&m);
     CXCHK(mapii_count(&m) == 0);
     mapii_free(&m);
@@ -291,8 +329,10 @@ void test_hmapss(size_t size, size_t nbuckets, const CxAllocator* alloc) {
 #define cx_hmap_val                 char*
 #define cx_hmap_cmp_key(pk1,pk2)    strcmp(*pk1,*pk2)
 #define cx_hmap_hash_key(pk)        cx_hmap_hash_fnv1a32(*pk, strlen(*pk))
+#define cx_hmap_cmp_keyn(pk,key,len) cmp_strn(*(char**)(pk),key,len)
 #define cx_hmap_free_key(pk)        free(*pk)
 #define cx_hmap_free_val(pk)        free(*pk)
+#define cx_hmap_cache_hash
 #define cx_hmap_instance_allocator
 #define cx_hmap_implement
 #define cx_hmap_stats
@@ -395,6 +435,26 @@ void test_hmapcc(size_t size, size_t nbuckets, const CxAllocator* alloc) {
         }
     }
 
+    // Lookups and deletions using key views of a larger buffer
+    for (size_t i = 0; i < size; i++) {
+        char buf[64];
+        const size_t len = snprintf(buf, sizeof(buf), "%zu", i);
+        strcpy(buf + len, "999");
+        const uint64_t hash = cx_hmap_hash_fnv1a32(buf, len);
+        char** val = mapcc_getn(&m, buf, len, hash);
+        if (i % 2) {
+            CXCHK(val == NULL && !mapcc_deln(&m, buf, len, hash));
+        }
+        else {
+            CXCHK(val && strcmp(*val, numstr(i*4))==0);
+            if (i % 4 == 0) {
+                CXCHK(mapcc_deln(&m, buf, len, hash));
+                CXCHK(mapcc_getn(&m, buf, len, hash) == NULL);
+            }
+        }
+    }
+    CXCHK(mapcc_count(&m) == (size + 1)/4);
+
     // Stats
     if (0) {
         mapcc_stats stats = mapcc_get_stats(&m);
@@ -406,11 +466,1004 @@ void test_hmapcc(size_t size, size_t nbuckets, const CxAllocator* alloc) {
     mapcc_free(&m);
 }
 
+// Map int -> int with incremental rehash
+#define cx_hmap_name                mapinc
+#define cx_hmap_key                 int
+#define cx_hmap_val                 int
+#define cx_hmap_incremental_rehash
+#define cx_hmap_rehash_step         1
+#define cx_hmap_static
+#define cx_hmap_instance_allocator
+#define cx_hmap_stats
+#define cx_hmap_implement
+#include "cx_hmap.h"
+
+// Test map int -> int with incremental rehash
+void test_hmapinc(size_t size, size_t nbuckets, const CxAllocator* alloc) {
+
+    LOGI("%s: size=%lu nbuckets=%lu alloc=%p", __func__, size, nbuckets, alloc);
+    mapinc m = mapinc_init(alloc, nbuckets);
+
+    // Fill map checking all keys while buckets are being migrated
+    size_t migrations = 0;
+    for (size_t i = 0; i < size; i++) {
+        mapinc_set(&m, i, i*2);
+        if (m.old_buckets_ != NULL) {
+            migrations++;
+        }
+        if (i % 64 == 0) {
+            for (size_t j = 0; j <= i; j++) {
+                int* val = mapinc_get(&m, j);
+                CXCHK(val && *val == j*2);
+            }
+            CXCHK(mapinc_get(&m, i+1) == NULL);
+        }
+    }
+    CXCHK(migrations > 0);
+    CXCHK(mapinc_count(&m) == size);
+
+    // Iterates while there could be pending migration
+    mapinc_iter iter = {0};
+    size_t counter = 0;
+    mapinc_entry* e;
+    while ((e = mapinc_next(&m, &iter)) != NULL) {
+        CXCHK(e->val == e->key * 2);
+        counter++;
+    }
+    CXCHK(counter == size);
+    mapinc_stats stats = mapinc_get_stats(&m);
+    mapinc_stats stats2;
+    CXCHK(stats.count == size);
+    CXCHK(stats.slabs > 0 && stats.slab_nodes == stats.links + stats.free_nodes + stats.unused_nodes);
+
+    // Delete even keys
+    for (size_t i = 0; i < size; i++) {
+        if (i % 2 == 0) {
+            CXCHK(mapinc_del(&m, i));
+        }
+    }
+    CXCHK(mapinc_count(&m) == size/2);
+    // Chain nodes of deleted entries are in the free list
+    stats2 = mapinc_get_stats(&m);
+    CXCHK(stats2.free_nodes > 0 && stats2.slab_nodes == stats2.links + stats2.free_nodes + stats2.unused_nodes);
+    for (size_t i = 0; i < size; i++) {
+        int* val = mapinc_get(&m, i);
+        if (i % 2 == 0) {
+            CXCHK(val == NULL);
+        } else {
+            CXCHK(val && *val == i*2);
+        }
+    }
+
+    // Overwrites all keys
+    for (size_t i = 0; i < size; i++) {
+        mapinc_set(&m, i, i*3);
+    }
+    CXCHK(mapinc_count(&m) == size);
+    for (size_t i = 0; i < size; i++) {
+        int* val = mapinc_get(&m, i);
+        CXCHK(val && *val == i*3);
+    }
+    // Chain nodes of deleted entries are reused
+    stats2 = mapinc_get_stats(&m);
+    CXCHK(stats2.slabs == stats.slabs);
+
+    // Clear returns all chain nodes to the free list
+    mapinc_clear(&m);
+    CXCHK(mapinc_count(&m) == 0);
+    stats2 = mapinc_get_stats(&m);
+    CXCHK(stats2.slabs == stats.slabs);
+    CXCHK(stats2.links == 0 && stats2.free_nodes + stats2.unused_nodes == stats2.slab_nodes);
+    mapinc_free(&m);
+}
+
+// Map type of allocated C string key -> allocated C string using linear probing
+#define cx_hmap_name                map2cc
+#define cx_hmap_key                 char*
+#define cx_hmap_val                 char*
+#define cx_hmap_cmp_key(pk1,pk2,s)  strcmp(*(char**)(pk1),*(char**)(pk2))
+#define cx_hmap_hash_key(pk,s)      cx_hmap_hash_fnv1a32(*(char**)(pk), strlen(*(char**)(pk)))
+#define cx_hmap_cmp_keyn(pk,key,len) cmp_strn(*(char**)(pk),key,len)
+#define cx_hmap_free_key(pk)        free(*pk)
+#define cx_hmap_free_val(pk)        free(*pk)
+#define cx_hmap_cache_hash
+#define cx_hmap_instance_allocator
+#define cx_hmap_static
+#define cx_hmap_implement
+#include "cx_hmap2.h"
+
+void test_hmap2cc(size_t size, size_t nbuckets, const CxAllocator* alloc) {
+
+    LOGI("%s: size=%lu nbuckets=%lu alloc=%p", __func__, size, nbuckets, alloc);
+    map2cc m = map2cc_init(alloc, nbuckets);
+
+    // Fill map
+    for (size_t  i = 0; i < size; i++) {
+        map2cc_set(&m, newstr(i, NULL), newstr(i*2, NULL));
+    }
+    for (size_t  i = 0; i < size; i++) {
+        char** val = map2cc_get(&m, numstr(i));
+        CXCHK(val && strcmp(*val, numstr(i*2))==0);
+    }
+    CXCHK(map2cc_count(&m) == size);
+
+    // Checks the stored hashes
+    map2cc_iter iter = {0};
+    map2cc_entry* e;
+    while ((e = map2cc_next(&m, &iter)) != NULL) {
+        CXCHK(e->hash_ == cx_hmap_hash_fnv1a32(e->key, strlen(e->key)));
+    }
+
+    // Overwrites all keys with value = key * 3
+    for (size_t i = 0; i < size; i++) {
+        map2cc_set(&m, newstr(i, NULL), newstr(i*3, NULL));
+    }
+    CXCHK(map2cc_count(&m) == size);
+
+    // Delete odd keys
+    for (size_t i = 0; i < size; i++) {
+        if (i % 2) {
+            CXCHK(map2cc_del(&m, numstr(i)));
+        }
+    }
+    CXCHK(map2cc_count(&m) == size - size/2);
+    for (size_t  i = 0; i < size; i++) {
+        char** val = map2cc_get(&m, numstr(i));
+        if (i % 2) {
+            CXCHK(val == NULL);
+        }
+        else {
+            CXCHK(val && strcmp(*val, numstr(i*3))==0);
+        }
+    }
+
+    // Lookups and deletions using key views of a larger buffer
+    for (size_t i = 0; i < size; i++) {
+        char buf[64];
+        const size_t len = snprintf(buf, sizeof(buf), "%zu", i);
+        strcpy(buf + len, "999");
+        const uint64_t hash = cx_hmap_hash_fnv1a32(buf, len);
+        char** val = map2cc_getn(&m, buf, len, hash);
+        if (i % 2) {
+            CXCHK(val == NULL && !map2cc_deln(&m, buf, len, hash));
+        }
+        else {
+            CXCHK(val && strcmp(*val, numstr(i*3))==0);
+            if (i % 4 == 0) {
+                CXCHK(map2cc_deln(&m, buf, len, hash));
+                CXCHK(map2cc_getn(&m, buf, len, hash) == NULL);
+            }
+        }
+    }
+    CXCHK(map2cc_count(&m) == (size + 1)/4);
+    map2cc_free(&m);
+}
+
+// Maps using the default key comparison and hash functions for different key sizes
+#define cx_hmap_name                map2u16
+#define cx_hmap_key                 uint16_t
+#define cx_hmap_val                 size_t
+#define cx_hmap_static
+#define cx_hmap_implement
+#include "cx_hmap2.h"
+
+#define cx_hmap_name                map2u64
+#define cx_hmap_key                 uint64_t
+#define cx_hmap_val                 size_t
+#define cx_hmap_static
+#define cx_hmap_implement
+#include "cx_hmap2.h"
+
+typedef struct key3 { uint8_t b[3]; } key3;
+#define cx_hmap_name                map2k3
+#define cx_hmap_key                 key3
+#define cx_hmap_val                 size_t
+#define cx_hmap_static
+#define cx_hmap_implement
+#include "cx_hmap2.h"
+
+// Map with all keys colliding in the same initial bucket
+#define cx_hmap_name                map2col
+#define cx_hmap_key                 uint64_t
+#define cx_hmap_val                 size_t
+#define cx_hmap_hash_key(pk,s)      (0)
+#define cx_hmap_static
+#define cx_hmap_implement
+#include "cx_hmap2.h"
+
+void test_hmap2keys(size_t size) {
+
+    LOGI("%s: size=%lu", __func__, size);
+    map2u16 m16 = map2u16_init(0);
+    map2u64 m64 = map2u64_init(0);
+    map2k3 mk3 = map2k3_init(0);
+    for (size_t i = 0; i < size; i++) {
+        map2u16_set(&m16, i, i);
+        map2u64_set(&m64, i << 32 | i, i);
+        map2k3_set(&mk3, (key3){{i, i >> 8, i >> 16}}, i);
+    }
+    CXCHK(map2u16_count(&m16) == size);
+    CXCHK(map2u64_count(&m64) == size);
+    CXCHK(map2k3_count(&mk3) == size);
+    for (size_t i = 0; i < size; i++) {
+        if (i % 2) {
+            CXCHK(map2u16_del(&m16, i));
+            CXCHK(map2u64_del(&m64, i << 32 | i));
+            CXCHK(map2k3_del(&mk3, (key3){{i, i >> 8, i >> 16}}));
+        }
+    }
+    for (size_t i = 0; i < size; i++) {
+        size_t* v16 = map2u16_get(&m16, i);
+        size_t* v64 = map2u64_get(&m64, i << 32 | i);
+        size_t* vk3 = map2k3_get(&mk3, (key3){{i, i >> 8, i >> 16}});
+        if (i % 2) {
+            CXCHK(v16 == NULL && v64 == NULL && vk3 == NULL);
+        } else {
+            CXCHK(v16 && *v16 == i && v64 && *v64 == i && vk3 && *vk3 == i);
+        }
+    }
+    CXCHK(map2u64_get(&m64, 1) == NULL);
+
+    // Batch get and set
+    uint64_t keys[100];
+    size_t vals[100];
+    size_t* pvals[100];
+    for (size_t i = 0; i < 100; i++) {
+        keys[i] = i << 32 | i;
+        vals[i] = i * 3;
+    }
+    CXCHK(map2u64_get_batch(&m64, keys, 100, pvals) == 50);
+    for (size_t i = 0; i < 100; i++) {
+        CXCHK(i % 2 ? pvals[i] == NULL : *pvals[i] == i);
+    }
+    map2u64_set_batch(&m64, keys, vals, 100);
+    CXCHK(map2u64_get_batch(&m64, keys, 100, pvals) == 100);
+    for (size_t i = 0; i < 100; i++) {
+        CXCHK(*pvals[i] == i * 3);
+    }
+    map2u16_free(&m16);
+    map2u64_free(&m64);
+    map2k3_free(&mk3);
+
+    // Setting a key after deleting the previous key of its probe sequence
+    // must find the key instead of reusing the deleted bucket.
+    map2col mc = map2col_init(0);
+    map2col_set(&mc, 1, 1);
+    map2col_set(&mc, 2, 2);
+    CXCHK(map2col_del(&mc, 1));
+    map2col_set(&mc, 2, 3);
+    bool inserted;
+    uint64_t k = 2;
+    map2col_emplace(&mc, &k, &inserted);
+    CXCHK(!inserted && map2col_count(&mc) == 1 && *map2col_get(&mc, 2) == 3);
+    CXCHK(map2col_del(&mc, 2) && map2col_get(&mc, 2) == NULL);
+    map2col_set(&mc, 3, 3);
+    CXCHK(map2col_count(&mc) == 1 && *map2col_get(&mc, 3) == 3);
+    map2col_free(&mc);
+}
+
+// Map using Robin Hood insertion
+#define cx_hmap_name                map2rh
+#define cx_hmap_key                 uint64_t
+#define cx_hmap_val                 size_t
+#define cx_hmap_robin_hood
+#define cx_hmap_freeze
+#define cx_hmap_static
+#define cx_hmap_stats
+#define cx_hmap_implement
+#include "cx_hmap2.h"
+
+// Map of strings using Robin Hood insertion
+#define cx_hmap_name                map2rhcc
+#define cx_hmap_key                 char*
+#define cx_hmap_val                 char*
+#define cx_hmap_cmp_key(pk1,pk2,s)  strcmp(*(char**)(pk1),*(char**)(pk2))
+#define cx_hmap_hash_key(pk,s)      cx_hmap_hash_wy64_str(*(char**)(pk))
+#define cx_hmap_free_key(pk)        free(*pk)
+#define cx_hmap_free_val(pk)        free(*pk)
+#define cx_hmap_cache_hash
+#define cx_hmap_robin_hood
+#define cx_hmap_static
+#define cx_hmap_implement
+#include "cx_hmap2.h"
+
+void test_hmap2rh(size_t size) {
+
+    LOGI("%s: size=%lu", __func__, size);
+    map2rh m = map2rh_init(0);
+    for (size_t i = 0; i < size; i++) {
+        map2rh_set(&m, i, i);
+    }
+    CXCHK(map2rh_count(&m) == size);
+    const size_t nbuckets = map2rh_get_stats(&m).nbuckets;
+
+    // Deletes and inserts keys keeping the number of entries
+    for (size_t round = 1; round <= 10; round++) {
+        for (size_t i = 0; i < size; i++) {
+            if (i % 3 == round % 3) {
+                CXCHK(map2rh_del(&m, (round - 1) * size + i));
+                map2rh_set(&m, round * size + i, i);
+            }
+        }
+        for (size_t i = 0; i < size; i++) {
+            const uint64_t key = (i % 3 == round % 3 ? round : round - 1) * size + i;
+            size_t* v = map2rh_get(&m, key);
+            CXCHK(v && *v == i);
+            CXCHK(map2rh_get(&m, key + size * 100) == NULL);
+        }
+        // Next round deletes the keys not updated in this round
+        for (size_t i = 0; i < size; i++) {
+            if (i % 3 != round % 3) {
+                size_t* v = map2rh_get(&m, (round - 1) * size + i);
+                CXCHK(v);
+                CXCHK(map2rh_del(&m, (round - 1) * size + i));
+                map2rh_set(&m, round * size + i, i);
+            }
+        }
+    }
+    CXCHK(map2rh_count(&m) == size);
+
+    // No deleted buckets and no resize with constant number of entries
+    map2rh_stats st = map2rh_get_stats(&m);
+    CXCHK(st.deleted == 0);
+    CXCHK(st.count == size);
+    CXCHK(st.nbuckets == nbuckets);
+    CXCHK(st.max_probe < 64);
+    map2rh_iter iter = {0};
+    size_t count = 0;
+    map2rh_entry* e;
+    while ((e = map2rh_next(&m, &iter)) != NULL) {
+        CXCHK(e->key == 10 * size + e->val);
+        count++;
+    }
+    CXCHK(count == size);
+    map2rh_free(&m);
+
+    // Strings with stored hash
+    map2rhcc mcc = map2rhcc_init(0);
+    for (size_t i = 0; i < size; i++) {
+        map2rhcc_set(&mcc, newstr(i, NULL), newstr(i*2, NULL));
+    }
+    for (size_t i = 0; i < size; i++) {
+        map2rhcc_set(&mcc, newstr(i, NULL), newstr(i*3, NULL));
+    }
+    for (size_t i = 0; i < size; i += 2) {
+        CXCHK(map2rhcc_del(&mcc, numstr(i)));
+    }
+    CXCHK(map2rhcc_count(&mcc) == size / 2);
+    for (size_t i = 0; i < size; i++) {
+        char** val = map2rhcc_get(&mcc, numstr(i));
+        CXCHK(i % 2 == 0 ? val == NULL : strcmp(*val, numstr(i*3)) == 0);
+    }
+    map2rhcc_free(&mcc);
+}
+
+// Map using Robin Hood insertion with a constant hash
+#define cx_hmap_name                map2rhc
+#define cx_hmap_key                 uint64_t
+#define cx_hmap_val                 size_t
+#define cx_hmap_hash_key(pk,s)      ((void)(pk), 1)
+#define cx_hmap_robin_hood
+#define cx_hmap_static
+#define cx_hmap_stats
+#define cx_hmap_implement
+#include "cx_hmap2.h"
+
+// Inserts keys which have all the same hash
+void test_hmap2rh_collisions(void) {
+
+    LOGI("%s:", __func__);
+    // Probe distances up to the maximum fit without growing the map
+    const size_t size = 200;
+    map2rhc m = map2rhc_init(0);
+    for (size_t i = 0; i < size; i++) {
+        map2rhc_set(&m, i, i);
+    }
+    CXCHK(map2rhc_count(&m) == size);
+    for (size_t i = 0; i < size; i++) {
+        size_t* v = map2rhc_get(&m, i);
+        CXCHK(v && *v == i);
+    }
+    map2rhc_stats st = map2rhc_get_stats(&m);
+    CXCHK(st.max_probe == size - 1);
+    CXCHK(st.nbuckets <= 512);
+    map2rhc_free(&m);
+
+    // Longer probe distances abort after a single resize instead of growing the map without bound
+    const pid_t pid = fork();
+    CXCHK(pid >= 0);
+    if (pid == 0) {
+        fclose(stderr);
+        map2rhc m = map2rhc_init(0);
+        for (size_t i = 0; i < 300; i++) {
+            map2rhc_set(&m, i, i);
+        }
+        _exit(0);
+    }
+    int status;
+    CXCHK(waitpid(pid, &status, 0) == pid);
+    CXCHK(WIFSIGNALED(status) && WTERMSIG(status) == SIGABRT);
+}
+
+// Map int -> int using group probing
+#define cx_hmap_name                map3ii
+#define cx_hmap_key                 int
+#define cx_hmap_val                 int
+#define cx_hmap_static
+#define cx_hmap_instance_allocator
+#define cx_hmap_stats
+#define cx_hmap_implement
+#include "cx_hmap3.h"
+
+// Test map3 int -> int
+void test_hmap3ii(size_t size, size_t nbuckets, const CxAllocator* alloc) {
+
+    LOGI("%s: size=%lu nbuckets=%lu alloc=%p", __func__, size, nbuckets, alloc);
+    // Initializes map and sets entries
+    map3ii m = map3ii_init(alloc, nbuckets);
+    // Tests clearing empty map
+    map3ii_clear(&m);
+    CXCHK(map3ii_count(&m) == 0);
+    CXCHK(map3ii_get(&m, 0) == NULL);
+    CXCHK(map3ii_del(&m, 0) == false);
+
+    // Fill map
+    for (size_t  i = 0; i < size; i++) {
+        map3ii_set(&m, i, i*2);
+    }
+    // Checks entries directly
+    for (size_t  i = 0; i < size; i++) {
+        int* val = map3ii_get(&m, i);
+        CXCHK(val && *val == i * 2);
+    }
+    CXCHK(map3ii_get(&m, size) == NULL);
+    CXCHK(map3ii_count(&m) == size);
+
+    // Checks entries using iterator
+    map3ii_iter iter1 = {};
+    size_t counter = 0;
+    while (true) {
+        map3ii_entry* e = map3ii_next(&m, &iter1);
+        if (e == NULL) {
+            break;
+        }
+        CXCHK(e->val == e->key * 2);
+        counter++;
+    }
+    CXCHK(counter == map3ii_count(&m));
+
+    // Delete even keys
+    for (size_t i = 0; i < size; i++) {
+        if (i % 2 == 0) {
+            CXCHK(map3ii_del(&m, i));
+        }
+    }
+    CXCHK(map3ii_count(&m) == size/2);
+    // Checks entries
+    for (size_t  i = 0; i < size; i++) {
+        int* val = map3ii_get(&m, i);
+        if (i % 2 == 0) {
+            CXCHK(val == NULL);
+        }
+        else {
+            CXCHK(val && *val == i * 2);
+        }
+    }
+
+    // Churn: deletes and inserts keys to reuse deleted buckets
+    for (size_t c = 0; c < 4; c++) {
+        for (size_t i = 0; i < size; i++) {
+            map3ii_set(&m, size + c*size + i, i);
+        }
+        for (size_t i = 0; i < size; i++) {
+            CXCHK(map3ii_del(&m, size + c*size + i));
+        }
+    }
+    CXCHK(map3ii_count(&m) == size/2);
+
+    // Overwrites all keys with value = key * 4
+    for (size_t i = 0; i < size; i++) {
+        map3ii_set(&m, i, i * 4);
+    }
+    for (size_t  i = 0; i < size; i++) {
+        int* val = map3ii_get(&m, i);
+        CXCHK(val && *val == i * 4);
+    }
+    CXCHK(map3ii_count(&m) == size);
+
+    // Batch get compared with get, including keys not found
+    {
+        const size_t nkeys = size + 100;
+        int* keys = malloc(nkeys * sizeof(*keys));
+        int* vals = malloc(nkeys * sizeof(*vals));
+        int** pvals = malloc(nkeys * sizeof(*pvals));
+        size_t found = 0;
+        for (size_t i = 0; i < nkeys; i++) {
+            keys[i] = nkeys - i - 1;
+            vals[i] = keys[i] * 5;
+            found += map3ii_get(&m, keys[i]) != NULL;
+        }
+        CXCHK(map3ii_get_batch(&m, keys, nkeys, pvals) == found);
+        for (size_t i = 0; i < nkeys; i++) {
+            CXCHK(pvals[i] == map3ii_get(&m, keys[i]));
+        }
+        // Batch set
+        map3ii_set_batch(&m, keys, vals, nkeys);
+        CXCHK(map3ii_count(&m) == nkeys);
+        CXCHK(map3ii_get_batch(&m, keys, nkeys, pvals) == nkeys);
+        for (size_t i = 0; i < nkeys; i++) {
+            CXCHK(*pvals[i] == keys[i] * 5);
+        }
+        free(keys);
+        free(vals);
+        free(pvals);
+    }
+
+    // Stats
+    map3ii_stats stats = map3ii_get_stats(&m);
+    CXCHK(stats.count == size + 100);
+    if (0) {
+        map3ii_print_stats(&stats);
+    }
+
+    map3ii_clear(&m);
+    CXCHK(map3ii_count(&m) == 0);
+    CXCHK(map3ii_get(&m, 1) == NULL);
+    map3ii_free(&m);
+}
+
+// Map type of allocated C string key -> allocated C string using group probing
+#define cx_hmap_name                map3cc
+#define cx_hmap_key                 char*
+#define cx_hmap_val                 char*
+#define cx_hmap_cmp_key(pk1,pk2,s)  strcmp(*(char**)(pk1),*(char**)(pk2))
+#define cx_hmap_hash_key(pk,s)      cx_hmap_hash_fnv1a32(*(char**)(pk), strlen(*(char**)(pk)))
+#define cx_hmap_cmp_keyn(pk,key,len) cmp_strn(*(char**)(pk),key,len)
+#define cx_hmap_free_key(pk)        free(*pk)
+#define cx_hmap_free_val(pk)        free(*pk)
+#define cx_hmap_instance_allocator
+#define cx_hmap_static
+#define cx_hmap_implement
+#include "cx_hmap3.h"
+
+void test_hmap3cc(size_t size, size_t nbuckets, const CxAllocator* alloc) {
+
+    LOGI("%s: size=%lu nbuckets=%lu alloc=%p", __func__, size, nbuckets, alloc);
+    map3cc m = map3cc_init(alloc, nbuckets);
+
+    // Fill map
+    for (size_t  i = 0; i < size; i++) {
+        map3cc_set(&m, newstr(i, NULL), newstr(i*2, NULL));
+    }
+    for (size_t  i = 0; i < size; i++) {
+        char** val = map3cc_get(&m, numstr(i));
+        CXCHK(val && strcmp(*val, numstr(i*2))==0);
+    }
+    CXCHK(map3cc_count(&m) == size);
+
+    // Overwrites all keys with value = key * 3
+    for (size_t i = 0; i < size; i++) {
+        map3cc_set(&m, newstr(i, NULL), newstr(i*3, NULL));
+    }
+    CXCHK(map3cc_count(&m) == size);
+
+    // Delete odd keys
+    for (size_t i = 0; i < size; i++) {
+        if (i % 2) {
+            CXCHK(map3cc_del(&m, numstr(i)));
+        }
+    }
+    CXCHK(map3cc_count(&m) == size - size/2);
+    for (size_t  i = 0; i < size; i++) {
+        char** val = map3cc_get(&m, numstr(i));
+        if (i % 2) {
+            CXCHK(val == NULL);
+        }
+        else {
+            CXCHK(val && strcmp(*val, numstr(i*3))==0);
+        }
+    }
+
+    // Lookups and deletions using key views of a larger buffer
+    for (size_t i = 0; i < size; i++) {
+        char buf[64];
+        const size_t len = snprintf(buf, sizeof(buf), "%zu", i);
+        strcpy(buf + len, "999");
+        const uint64_t hash = cx_hmap_hash_fnv1a32(buf, len);
+        char** val = map3cc_getn(&m, buf, len, hash);
+        if (i % 2) {
+            CXCHK(val == NULL && !map3cc_deln(&m, buf, len, hash));
+        }
+        else {
+            CXCHK(val && strcmp(*val, numstr(i*3))==0);
+            if (i % 4 == 0) {
+                CXCHK(map3cc_deln(&m, buf, len, hash));
+                CXCHK(map3cc_getn(&m, buf, len, hash) == NULL);
+            }
+        }
+    }
+    CXCHK(map3cc_count(&m) == (size + 1)/4);
+    map3cc_free(&m);
+}
+
+// Map with plain data key and value which can be saved and mapped from a file
+typedef struct point3 { double x; double y; double z; } point3;
+#define cx_hmap_name                map2fz
+#define cx_hmap_key                 uint64_t
+#define cx_hmap_val                 point3
+#define cx_hmap_cache_hash
+#define cx_hmap_instance_allocator
+#define cx_hmap_freeze
+#define cx_hmap_static
+#define cx_hmap_implement
+#include "cx_hmap2.h"
+
+// Saves map to a temporary file and opens it mapped in memory
+#define TEST_FREEZE_(MAP)\
+static void test_freeze_##MAP(MAP* m, MAP* fm) {\
+    char path[] = "/tmp/cx_hmap_freeze_XXXXXX";\
+    const int fd = mkstemp(path);\
+    CXCHK(fd >= 0);\
+    FILE* f = fdopen(fd, "w");\
+    CxWriter out = cx_writer_file(f);\
+    CXERR_CHK(MAP##_freeze(m, &out));\
+    fclose(f);\
+    CXERR_CHK(MAP##_mapped_open(path, fm));\
+    unlink(path);\
+    CXCHK(MAP##_count(fm) == MAP##_count(m));\
+}
+TEST_FREEZE_(map2fz)
+TEST_FREEZE_(map2rh)
+
+void test_hmap2_freeze(size_t size) {
+
+    LOGI("%s: size=%zu", __func__, size);
+    map2fz m = map2fz_init(NULL, 0);
+    for (size_t i = 0; i < size; i++) {
+        map2fz_set(&m, i * 7, (point3){i, i * 2, i * 3});
+    }
+    // Leaves deleted buckets
+    for (size_t i = 0; i < size; i += 3) {
+        CXCHK(map2fz_del(&m, i * 7));
+    }
+    map2fz fm;
+    test_freeze_map2fz(&m, &fm);
+    map2fz_free(&m);
+    for (size_t i = 0; i < size; i++) {
+        const point3* p = map2fz_get(&fm, i * 7);
+        if (i % 3 == 0) {
+            CXCHK(p == NULL);
+        } else {
+            CXCHK(p && p->x == i && p->y == i * 2 && p->z == i * 3);
+        }
+        CXCHK(map2fz_get(&fm, i * 7 + 1) == NULL);
+    }
+    map2fz_iter iter = {0};
+    size_t count = 0;
+    while (map2fz_next(&fm, &iter) != NULL) {
+        count++;
+    }
+    CXCHK(count == map2fz_count(&fm));
+    map2fz_mapped_close(&fm);
+
+    // Robin Hood map without stored hashes
+    map2rh m2 = map2rh_init(0);
+    for (size_t i = 0; i < size; i++) {
+        map2rh_set(&m2, i, i * 2);
+    }
+    map2rh fm2;
+    test_freeze_map2rh(&m2, &fm2);
+    map2rh_free(&m2);
+    for (size_t i = 0; i < size; i++) {
+        size_t* v = map2rh_get(&fm2, i);
+        CXCHK(v && *v == i * 2);
+        CXCHK(map2rh_get(&fm2, i + size) == NULL);
+    }
+    map2rh_mapped_close(&fm2);
+
+    // Opening file with a different map type fails
+    map2fz m3 = map2fz_init(NULL, 0);
+    map2fz_set(&m3, 1, (point3){0});
+    char path[] = "/tmp/cx_hmap_freeze_XXXXXX";
+    FILE* f = fdopen(mkstemp(path), "w");
+    CxWriter out = cx_writer_file(f);
+    CXERR_CHK(map2fz_freeze(&m3, &out));
+    fclose(f);
+    CxError err = map2rh_mapped_open(path, &fm2);
+    CXCHK(err.msg != NULL);
+    CXCHK(map2rh_mapped_open("/tmp/cx_hmap_freeze_none", &fm2).msg != NULL);
+    unlink(path);
+    map2fz_free(&m3);
+}
+
+// Checks emplace, set_ptr and upsert for maps with integer keys and values
+#define TEST_EMPLACE_(MAP, INIT)\
+static void incr_##MAP(typeof(((MAP##_entry*)0)->val)* v, bool found, void* ctx) {\
+    (*v)++;\
+    *(size_t*)ctx += found;\
+}\
+static void test_emplace_##MAP(size_t size) {\
+    LOGI("%s: size=%zu", __func__, size);\
+    MAP m = INIT;\
+    for (size_t i = 0; i < size; i++) {\
+        bool inserted;\
+        typeof(((MAP##_entry*)0)->key) k = i;\
+        typeof(((MAP##_entry*)0)->val)* v = MAP##_emplace(&m, &k, &inserted);\
+        CXCHK(inserted && *v == 0);\
+        *v = i;\
+        v = MAP##_emplace(&m, &k, &inserted);\
+        CXCHK(!inserted && *v == (typeof(*v))i);\
+    }\
+    CXCHK(MAP##_count(&m) == size);\
+    for (size_t i = 0; i < size; i++) {\
+        typeof(((MAP##_entry*)0)->key) k = i;\
+        typeof(((MAP##_entry*)0)->val) v = i * 2;\
+        MAP##_set_ptr(&m, &k, &v);\
+    }\
+    CXCHK(MAP##_count(&m) == size);\
+    size_t found = 0;\
+    for (size_t i = 0; i < 2 * size; i++) {\
+        CXCHK(MAP##_upsert(&m, i, incr_##MAP, &found) == (i < size));\
+    }\
+    CXCHK(found == size && MAP##_count(&m) == 2 * size);\
+    for (size_t i = 0; i < 2 * size; i++) {\
+        typeof(((MAP##_entry*)0)->val)* v = MAP##_get(&m, i);\
+        CXCHK(v && *v == (typeof(*v))(i < size ? i * 2 + 1 : 1));\
+    }\
+    MAP##_free(&m);\
+}
+TEST_EMPLACE_(mapii, mapii_init(NULL, 0))
+TEST_EMPLACE_(mapinc, mapinc_init(NULL, 0))
+TEST_EMPLACE_(map2rh, map2rh_init(0))
+TEST_EMPLACE_(map3ii, map3ii_init(NULL, 0))
+
+// Checks range iterators, splitting the map and iterating the ranges in parallel
+#define TEST_RANGE_(MAP, INIT)\
+typedef struct range_##MAP { const MAP* m; MAP##_iter iter; size_t count; size_t sum; } range_##MAP;\
+static void range_worker_##MAP(void* arg) {\
+    range_##MAP* r = arg;\
+    MAP##_entry* e;\
+    while ((e = MAP##_next((MAP*)r->m, &r->iter)) != NULL) {\
+        r->count++;\
+        r->sum += e->key;\
+    }\
+}\
+static void test_range_##MAP(size_t size) {\
+    LOGI("%s: size=%zu", __func__, size);\
+    MAP m = INIT;\
+    MAP##_iter iters[64];\
+    CXCHK(MAP##_iter_split(&m, 4, iters) == 0);\
+    size_t sum = 0;\
+    for (size_t i = 0; i < 2 * size; i++) {\
+        MAP##_set(&m, i, i);\
+    }\
+    for (size_t i = 1; i < 2 * size; i += 2) {\
+        MAP##_del(&m, i);\
+    }\
+    for (size_t i = 0; i < 2 * size; i += 2) {\
+        sum += i;\
+    }\
+    /* Consecutive ranges of arbitrary sizes */\
+    size_t count = 0;\
+    size_t rsum = 0;\
+    for (size_t b = 0; b < m.nbuckets_; b += 13) {\
+        MAP##_iter iter = MAP##_iter_range(&m, b, b + 13);\
+        MAP##_entry* e;\
+        while ((e = MAP##_next(&m, &iter)) != NULL) {\
+            count++;\
+            rsum += e->key;\
+        }\
+    }\
+    CXCHK(count == size && rsum == sum);\
+    MAP##_iter empty = MAP##_iter_range(&m, 10, 10);\
+    CXCHK(MAP##_next(&m, &empty) == NULL);\
+    /* Splits and iterates each range by a thread */\
+    const size_t splits[] = {1, 3, 7, 64};\
+    for (size_t s = 0; s < sizeof(splits)/sizeof(splits[0]); s++) {\
+        const size_t n = MAP##_iter_split(&m, splits[s], iters);\
+        CXCHK(n > 0 && n <= splits[s]);\
+        range_##MAP ranges[64] = {0};\
+        CxThreadPool* tp = cx_tpool_new(NULL, 4, n);\
+        for (size_t i = 0; i < n; i++) {\
+            ranges[i] = (range_##MAP){.m = &m, .iter = iters[i]};\
+            CXCHK(cx_tpool_run(tp, range_worker_##MAP, &ranges[i]) == 0);\
+        }\
+        cx_tpool_del(tp);\
+        count = 0;\
+        rsum = 0;\
+        for (size_t i = 0; i < n; i++) {\
+            count += ranges[i].count;\
+            rsum += ranges[i].sum;\
+        }\
+        CXCHK(count == size && rsum == sum);\
+    }\
+    MAP##_free(&m);\
+}
+TEST_RANGE_(map2u64, map2u64_init(0))
+TEST_RANGE_(map2rh, map2rh_init(0))
+TEST_RANGE_(map3ii, map3ii_init(NULL, 0))
+
+// Checks retain and shrink to fit for maps with integer keys and values
+#define TEST_RETAIN_(MAP, INIT)\
+static bool keep_##MAP(MAP##_entry* e, void* ctx) {\
+    (*(size_t*)ctx)++;\
+    e->val++;\
+    return e->key % 3 != 0;\
+}\
+static bool drop_##MAP(MAP##_entry* e, void* ctx) {\
+    return false;\
+}\
+static void test_retain_##MAP(size_t size) {\
+    LOGI("%s: size=%zu", __func__, size);\
+    MAP m = INIT;\
+    size_t calls = 0;\
+    MAP##_retain(&m, keep_##MAP, &calls);\
+    MAP##_shrink_to_fit(&m);\
+    CXCHK(calls == 0 && MAP##_count(&m) == 0);\
+    for (size_t i = 0; i < 4 * size; i++) {\
+        MAP##_set(&m, i, i);\
+    }\
+    /* Deletes the upper keys leaving deleted buckets */\
+    for (size_t i = size; i < 4 * size; i++) {\
+        MAP##_del(&m, i);\
+    }\
+    MAP##_retain(&m, keep_##MAP, &calls);\
+    CXCHK(calls == size);\
+    size_t count = 0;\
+    for (size_t i = 0; i < 4 * size; i++) {\
+        typeof(((MAP##_entry*)0)->val)* v = MAP##_get(&m, i);\
+        const bool kept = i < size && i % 3 != 0;\
+        CXCHK((v != NULL) == kept);\
+        CXCHK(!kept || *v == (typeof(*v))(i + 1));\
+        count += kept;\
+    }\
+    CXCHK(MAP##_count(&m) == count);\
+    const size_t nbuckets = m.nbuckets_;\
+    MAP##_shrink_to_fit(&m);\
+    CXCHK(m.nbuckets_ <= nbuckets && m.deleted_ == 0 && MAP##_count(&m) == count);\
+    CXCHK(MAP##_count(&m) + 1 < m.nbuckets_ * 0.9);\
+    for (size_t i = 0; i < size; i++) {\
+        typeof(((MAP##_entry*)0)->val)* v = MAP##_get(&m, i);\
+        CXCHK((v != NULL) == (i % 3 != 0));\
+    }\
+    /* Inserts again after shrinking */\
+    for (size_t i = 0; i < size; i++) {\
+        MAP##_set(&m, i, i);\
+    }\
+    CXCHK(MAP##_count(&m) == size);\
+    MAP##_retain(&m, drop_##MAP, NULL);\
+    CXCHK(MAP##_count(&m) == 0 && MAP##_get(&m, 1) == NULL);\
+    MAP##_shrink_to_fit(&m);\
+    MAP##_set(&m, 1, 1);\
+    CXCHK(MAP##_count(&m) == 1 && *MAP##_get(&m, 1) == 1);\
+    MAP##_free(&m);\
+}
+TEST_RETAIN_(map2u64, map2u64_init(0))
+TEST_RETAIN_(map2col, map2col_init(0))
+TEST_RETAIN_(map2rh, map2rh_init(0))
+TEST_RETAIN_(map3ii, map3ii_init(NULL, 0))
+
+// Retains string entries, checking that the removed keys and values are freed
+static bool keep_odd_map2cc(map2cc_entry* e, void* ctx) {
+
+    return atoi(e->key) % 2 != 0;
+}
+
+static void test_retain_map2cc(size_t size) {
+
+    LOGI("%s: size=%zu", __func__, size);
+    map2cc m = map2cc_init(NULL, 0);
+    char buf[32];
+    for (size_t i = 0; i < size; i++) {
+        snprintf(buf, sizeof(buf), "%zu", i);
+        map2cc_set(&m, strdup(buf), strdup(buf));
+    }
+    map2cc_retain(&m, keep_odd_map2cc, NULL);
+    map2cc_shrink_to_fit(&m);
+    CXCHK(map2cc_count(&m) == size / 2);
+    for (size_t i = 0; i < size; i++) {
+        snprintf(buf, sizeof(buf), "%zu", i);
+        char** v = map2cc_get(&m, buf);
+        CXCHK((v != NULL) == (i % 2 != 0));
+        CXCHK(v == NULL || strcmp(*v, buf) == 0);
+    }
+    map2cc_free(&m);
+}
+
+// Checks emplace and upsert ownership of the keys for map of allocated strings
+static void incr_str(char** v, bool found, void* ctx) {
+
+    char* old = found ? *v : NULL;
+    *v = newstr(found ? atoi(old) + 1 : 0, NULL);
+    free(old);
+    (void)ctx;
+}
+
+static void test_emplace_map2cc(size_t size) {
+
+    LOGI("%s: size=%zu", __func__, size);
+    map2cc m = map2cc_init(NULL, 0);
+    for (size_t i = 0; i < size; i++) {
+        // The key is owned by the map only if inserted
+        bool inserted;
+        char* key = newstr(i, NULL);
+        char** v = map2cc_emplace(&m, &key, &inserted);
+        CXCHK(inserted && *v == NULL);
+        *v = newstr(i, NULL);
+        v = map2cc_emplace(&m, (char*[]){numstr(i)}, &inserted);
+        CXCHK(!inserted && strcmp(*v, numstr(i)) == 0);
+        // The key is moved to the map and freed if found
+        map2cc_upsert(&m, newstr(i, NULL), incr_str, NULL);
+        map2cc_upsert(&m, newstr(i + size, NULL), incr_str, NULL);
+    }
+    CXCHK(map2cc_count(&m) == 2 * size);
+    for (size_t i = 0; i < size; i++) {
+        char** v = map2cc_get(&m, numstr(i));
+        CXCHK(v && atoi(*v) == (int)i + 1);
+    }
+    map2cc_free(&m);
+}
+
+// Checks that the string hash is the same as the buffer hash
+// for all lengths and alignments of the string.
+uint64_t cx_hmap_hash_wy64(const void* buf, size_t len);
+uint64_t cx_hmap_hash_wy64_str(const char* str);
+uint64_t cx_hmap_hash_wy64_str_fast(const char* str);
+void test_hmap_hash(void) {
+
+    LOGI("%s:", __func__);
+    const size_t maxlen = 4096;
+    char* buf = malloc(maxlen + 32);
+    srand(1);
+    for (size_t i = 0; i < maxlen + 32; i++) {
+        buf[i] = 1 + rand() % 255;
+    }
+    for (size_t off = 0; off < 16; off++) {
+        for (size_t len = 0; len < maxlen; len = len < 300 ? len + 1 : len * 2) {
+            char* str = buf + off;
+            const char saved = str[len];
+            str[len] = 0;
+            const uint64_t h = cx_hmap_hash_wy64(str, len);
+            CXCHK(h == cx_hmap_hash_wy64_str(str));
+            CXCHK(h == cx_hmap_hash_wy64_str_fast(str));
+            CXCHK(len == 0 || h != cx_hmap_hash_wy64(str, len - 1));
+            str[len] = saved;
+        }
+    }
+    free(buf);
+}
+
 void test_hmap(void) {
 
+    test_hmap_hash();
     test_hmapii(1000, 0, NULL);
     test_hmapss(1000, 0, NULL);
     test_hmapcc(1000, 0, NULL);
+    test_hmapinc(5000, 0, NULL);
+    test_hmap2cc(1000, 0, NULL);
+    test_hmap2keys(5000);
+    test_hmap2rh(5000);
+    test_hmap2rh_collisions();
+    test_hmap3ii(1000, 0, NULL);
+    test_hmap3ii(5000, 100, NULL);
+    test_hmap3cc(1000, 0, NULL);
+    test_emplace_mapii(1000);
+    test_emplace_mapinc(1000);
+    test_emplace_map2rh(1000);
+    test_emplace_map3ii(1000);
+    test_emplace_map2cc(1000);
+    test_hmap2_freeze(5000);
+    test_range_map2u64(1);
+    test_range_map2u64(5000);
+    test_range_map2rh(5000);
+    test_range_map3ii(5);
+    test_range_map3ii(5000);
+    test_retain_map2u64(1);
+    test_retain_map2u64(5000);
+    test_retain_map2col(200);
+    test_retain_map2rh(5000);
+    test_retain_map3ii(5000);
+    test_retain_map2cc(1000);
 }
 
 __attribute__((constructor))
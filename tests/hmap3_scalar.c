@@ -0,0 +1,109 @@
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "cx_alloc.h"
+#include "logger.h"
+#include "registry.h"
+
+// Map int -> int using group probing with the portable scalar group matching.
+// The group matching functions are defined once per translation unit,
+// so this map must be the only one including cx_hmap3.h in this file.
+#define cx_hmap_name                map3sii
+#define cx_hmap_key                 int
+#define cx_hmap_val                 int
+#define cx_hmap_no_simd
+#define cx_hmap_static
+#define cx_hmap_instance_allocator
+#define cx_hmap_implement
+#include "cx_hmap3.h"
+
+// Checks the scalar group matching functions with all types of control bytes
+static void test_hmap3_scalar_match(void) {
+
+    int8_t group[CX_HMAP3_GROUP_SIZE];
+    uint32_t full = 0;
+    uint32_t empty = 0;
+    uint32_t deleted = 0;
+    for (int i = 0; i < CX_HMAP3_GROUP_SIZE; i++) {
+        switch (i % 3) {
+            case 0: group[i] = i; full |= 1u << i; break;
+            case 1: group[i] = CX_HMAP3_EMPTY; empty |= 1u << i; break;
+            case 2: group[i] = CX_HMAP3_DELETED; deleted |= 1u << i; break;
+        }
+    }
+    CXCHK(cx_hmap3_match_empty_(group) == empty);
+    CXCHK(cx_hmap3_match_free_(group) == (empty | deleted));
+    CXCHK(cx_hmap3_match_free_(group) == (~full & 0xFFFF));
+    CXCHK(cx_hmap3_match_(group, CX_HMAP3_DELETED) == deleted);
+    CXCHK(cx_hmap3_match_(group, 3) == 1u << 3);
+    CXCHK(cx_hmap3_match_(group, 1) == 0);
+    CXCHK(cx_hmap3_first_(empty) == 1);
+}
+
+static void test_hmap3_scalar_map(size_t size, size_t nbuckets) {
+
+    LOGI("%s: size=%lu nbuckets=%lu", __func__, size, nbuckets);
+    map3sii m = map3sii_init(NULL, nbuckets);
+    CXCHK(map3sii_get(&m, 0) == NULL);
+    CXCHK(map3sii_del(&m, 0) == false);
+
+    for (size_t i = 0; i < size; i++) {
+        map3sii_set(&m, i, i * 2);
+    }
+    CXCHK(map3sii_count(&m) == size);
+    for (size_t i = 0; i < size; i++) {
+        int* val = map3sii_get(&m, i);
+        CXCHK(val && *val == i * 2);
+    }
+    CXCHK(map3sii_get(&m, size) == NULL);
+
+    // Deletes even keys
+    for (size_t i = 0; i < size; i += 2) {
+        CXCHK(map3sii_del(&m, i));
+    }
+    CXCHK(map3sii_count(&m) == size / 2);
+    for (size_t i = 0; i < size; i++) {
+        int* val = map3sii_get(&m, i);
+        CXCHK(i % 2 == 0 ? val == NULL : (val && *val == i * 2));
+    }
+
+    // Churn: deletes and inserts keys to reuse deleted buckets
+    for (size_t c = 0; c < 4; c++) {
+        for (size_t i = 0; i < size; i++) {
+            map3sii_set(&m, size + c*size + i, i);
+        }
+        for (size_t i = 0; i < size; i++) {
+            CXCHK(map3sii_del(&m, size + c*size + i));
+        }
+    }
+    CXCHK(map3sii_count(&m) == size / 2);
+
+    // Iterates over the odd keys
+    map3sii_iter iter = {0};
+    map3sii_entry* e;
+    size_t count = 0;
+    while ((e = map3sii_next(&m, &iter)) != NULL) {
+        CXCHK(e->key % 2 == 1 && e->val == e->key * 2);
+        count++;
+    }
+    CXCHK(count == size / 2);
+
+    map3sii_clear(&m);
+    CXCHK(map3sii_count(&m) == 0);
+    CXCHK(map3sii_get(&m, 1) == NULL);
+    map3sii_free(&m);
+}
+
+void test_hmap3_scalar(void) {
+
+    test_hmap3_scalar_match();
+    test_hmap3_scalar_map(1000, 0);
+    test_hmap3_scalar_map(5000, 100);
+}
+
+__attribute__((constructor))
+static void reg_hmap3_scalar(void) {
+
+    reg_add_test("hmap3_scalar", test_hmap3_scalar);
+}
@@ -0,0 +1,258 @@
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "cx_alloc.h"
+#include "logger.h"
+#include "registry.h"
+
+// Set of uint64 keys with instance allocator
+#define cx_hset_name hseti
+#define cx_hset_key  uint64_t
+#define cx_hset_instance_allocator
+#define cx_hset_static
+#define cx_hset_implement
+#include "cx_hset.h"
+
+// Set of allocated strings with cached hashes
+uint64_t cx_hmap_hash_wy64_str(const char* str);
+#define cx_hset_name hsetc
+#define cx_hset_key  char*
+#define cx_hset_cmp_key(pk1,pk2,s)  strcmp(*(char**)(pk1),*(char**)(pk2))
+#define cx_hset_hash_key(pk,s)      cx_hmap_hash_wy64_str(*(char**)(pk))
+#define cx_hset_free_key(pk)        free(*pk)
+#define cx_hset_cache_hash
+#define cx_hset_static
+#define cx_hset_implement
+#include "cx_hset.h"
+
+// Set of structs using default memcmp/hash with single bucket hash for collisions
+typedef struct point { int32_t x; int32_t y; int32_t z; } point;
+#define cx_hset_name hsetp
+#define cx_hset_key  point
+#define cx_hset_hash_key(pk,s)  ((size_t)(((point*)(pk))->x % 4))
+#define cx_hset_def_nbuckets    2
+#define cx_hset_static
+#define cx_hset_implement
+#include "cx_hset.h"
+
+static char* newstr(size_t val) {
+
+    char buf[32];
+    snprintf(buf, sizeof(buf), "k%zu", val);
+    return strdup(buf);
+}
+
+static void test_hseti(size_t size, const CxAllocator* alloc) {
+
+    LOGI("%s: size=%lu alloc=%p", __func__, size, alloc);
+    hseti s = hseti_init(alloc, 0);
+    CXCHK(!hseti_contains(&s, 1));
+    CXCHK(!hseti_del(&s, 1));
+    hseti_iter iter = {0};
+    CXCHK(hseti_next(&s, &iter) == NULL);
+
+    for (size_t i = 0; i < size; i++) {
+        CXCHK(hseti_add(&s, i));
+        CXCHK(!hseti_add(&s, i));
+    }
+    CXCHK(hseti_count(&s) == size);
+    for (size_t i = 0; i < size; i++) {
+        CXCHK(hseti_contains(&s, i));
+        CXCHK(!hseti_contains(&s, i + size));
+    }
+
+    // Iterates over all keys
+    size_t count = 0;
+    uint64_t sum = 0;
+    uint64_t* k;
+    while ((k = hseti_next(&s, &iter)) != NULL) {
+        count++;
+        sum += *k;
+    }
+    CXCHK(count == size);
+    CXCHK(sum == (size * (size - 1)) / 2 || size == 0);
+
+    // Deletes odd keys and checks that the even keys are still reachable
+    for (size_t i = 1; i < size; i += 2) {
+        CXCHK(hseti_del(&s, i));
+        CXCHK(!hseti_del(&s, i));
+    }
+    CXCHK(hseti_count(&s) == size / 2 + size % 2);
+    for (size_t i = 0; i < size; i++) {
+        CXCHK(hseti_contains(&s, i) == (i % 2 == 0));
+    }
+
+    // Batch membership test
+    uint64_t* keys = malloc(2 * size * sizeof(*keys) + 1);
+    bool* found = malloc(2 * size * sizeof(*found) + 1);
+    for (size_t i = 0; i < 2 * size; i++) {
+        keys[i] = i;
+    }
+    CXCHK(hseti_contains_batch(&s, keys, 2 * size, found) == hseti_count(&s));
+    for (size_t i = 0; i < 2 * size; i++) {
+        CXCHK(found[i] == (i < size && i % 2 == 0));
+    }
+
+    // Batch insert
+    const size_t missing = 2 * size - hseti_count(&s);
+    CXCHK(hseti_add_batch(&s, keys, 2 * size, found) == missing);
+    for (size_t i = 0; i < 2 * size; i++) {
+        CXCHK(found[i] == !(i < size && i % 2 == 0));
+        CXCHK(hseti_contains(&s, i));
+    }
+    CXCHK(hseti_count(&s) == 2 * size);
+    CXCHK(hseti_add_batch(&s, keys, 2 * size, NULL) == 0);
+    free(keys);
+    free(found);
+
+    hseti_clear(&s);
+    CXCHK(hseti_count(&s) == 0);
+    CXCHK(!hseti_contains(&s, 0));
+    CXCHK(hseti_add(&s, 0));
+    hseti_free(&s);
+}
+
+static void test_hseti_ops(size_t size) {
+
+    LOGI("%s: size=%lu", __func__, size);
+    hseti s1 = hseti_init(NULL, 0);
+    hseti s2 = hseti_init(NULL, 0);
+    hseti s3 = hseti_init(NULL, 0);
+    hseti empty = hseti_init(NULL, 0);
+    for (size_t i = 0; i < size; i++) {
+        hseti_add(&s1, i);
+        hseti_add(&s2, i * 2);
+        hseti_add(&s3, i);
+    }
+
+    // s3 = s1 | s2
+    hseti_union(&s3, &s2);
+    CXCHK(hseti_count(&s3) == size + size / 2);
+    for (size_t i = 0; i < 2 * size; i++) {
+        CXCHK(hseti_contains(&s3, i) == (i < size || i % 2 == 0));
+    }
+
+    // s3 = s3 - s1
+    hseti_difference(&s3, &s1);
+    CXCHK(hseti_count(&s3) == size / 2);
+    for (size_t i = 0; i < 2 * size; i++) {
+        CXCHK(hseti_contains(&s3, i) == (i >= size && i % 2 == 0));
+    }
+
+    // s1 = s1 & s2
+    hseti_intersect(&s1, &s2);
+    CXCHK(hseti_count(&s1) == size / 2 + size % 2);
+    for (size_t i = 0; i < 2 * size; i++) {
+        CXCHK(hseti_contains(&s1, i) == (i < size && i % 2 == 0));
+    }
+
+    // Operations with empty set
+    hseti_difference(&s1, &empty);
+    CXCHK(hseti_count(&s1) == size / 2 + size % 2);
+    hseti_union(&empty, &s1);
+    CXCHK(hseti_count(&empty) == hseti_count(&s1));
+    hseti_clear(&empty);
+    hseti_intersect(&s1, &empty);
+    CXCHK(hseti_count(&s1) == 0);
+
+    // Union with itself and with an equal set when the next insert would resize
+    hseti full1 = hseti_init(NULL, 16);
+    hseti full2 = hseti_init(NULL, 16);
+    size_t n = 0;
+    while (n + 1 <= 16 * 0.8) {
+        hseti_add(&full1, n);
+        hseti_add(&full2, n);
+        n++;
+    }
+    hseti_union(&full1, &full1);
+    hseti_union(&full1, &full2);
+    CXCHK(hseti_count(&full1) == n && full1.nbuckets_ == 16);
+    for (size_t i = 0; i < n; i++) {
+        CXCHK(hseti_contains(&full1, i));
+    }
+    hseti_add(&full1, n);
+    CXCHK(hseti_count(&full1) == n + 1 && full1.nbuckets_ == 32);
+    hseti_free(&full1);
+    hseti_free(&full2);
+
+    hseti_free(&s1);
+    hseti_free(&s2);
+    hseti_free(&s3);
+    hseti_free(&empty);
+}
+
+static void test_hsetc(size_t size) {
+
+    LOGI("%s: size=%lu", __func__, size);
+    hsetc s = hsetc_init(0);
+    hsetc other = hsetc_init(0);
+    for (size_t i = 0; i < size; i++) {
+        CXCHK(hsetc_add(&s, newstr(i)));
+        char* dup = newstr(i);
+        CXCHK(!hsetc_add(&s, dup));
+        free(dup);
+        if (i % 3 == 0) {
+            hsetc_add(&other, newstr(i));
+        }
+    }
+    CXCHK(hsetc_count(&s) == size);
+    char key[32];
+    for (size_t i = 0; i < size; i++) {
+        snprintf(key, sizeof(key), "k%zu", i);
+        CXCHK(hsetc_contains(&s, key));
+        snprintf(key, sizeof(key), "x%zu", i);
+        CXCHK(!hsetc_contains(&s, key));
+    }
+    for (size_t i = 0; i < size; i += 2) {
+        snprintf(key, sizeof(key), "k%zu", i);
+        CXCHK(hsetc_del(&s, key));
+    }
+    // Removes the keys multiple of 3, freeing them
+    hsetc_difference(&s, &other);
+    for (size_t i = 0; i < size; i++) {
+        snprintf(key, sizeof(key), "k%zu", i);
+        CXCHK(hsetc_contains(&s, key) == (i % 2 != 0 && i % 3 != 0));
+    }
+    hsetc_free(&s);
+    hsetc_free(&other);
+}
+
+static void test_hsetp(size_t size) {
+
+    LOGI("%s: size=%lu", __func__, size);
+    hsetp s = hsetp_init(0);
+    for (size_t i = 0; i < size; i++) {
+        CXCHK(hsetp_add(&s, (point){i, i+1, i+2}));
+    }
+    // Deletes keys in the middle of the colliding probe sequences
+    for (size_t i = 0; i < size; i += 3) {
+        CXCHK(hsetp_del(&s, (point){i, i+1, i+2}));
+    }
+    for (size_t i = 0; i < size; i++) {
+        CXCHK(hsetp_contains(&s, (point){i, i+1, i+2}) == (i % 3 != 0));
+        CXCHK(!hsetp_contains(&s, (point){i, i, i}));
+    }
+    hsetp_free(&s);
+}
+
+void test_hset(void) {
+
+    test_hseti(0, NULL);
+    test_hseti(1, NULL);
+    test_hseti(100, cx_def_allocator());
+    test_hseti(100000, NULL);
+    test_hseti_ops(0);
+    test_hseti_ops(1);
+    test_hseti_ops(1001);
+    test_hsetc(1);
+    test_hsetc(5000);
+    test_hsetp(1000);
+}
+
+__attribute__((constructor))
+static void reg_hset(void) {
+
+    reg_add_test("hset", test_hset);
+}
@@ -0,0 +1,147 @@
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "cx_alloc.h"
+#include "logger.h"
+#include "registry.h"
+
+// Perfect hash map uint64 -> uint64 which can be saved to file
+#define cx_phmap_name phmapii
+#define cx_phmap_key  uint64_t
+#define cx_phmap_val  uint64_t
+#define cx_phmap_instance_allocator
+#define cx_phmap_freeze
+#define cx_phmap_static
+#define cx_phmap_implement
+#include "cx_phmap.h"
+
+// Perfect hash map of allocated strings
+uint64_t cx_hmap_hash_wy64_str(const char* str);
+#define cx_phmap_name phmapcc
+#define cx_phmap_key  char*
+#define cx_phmap_val  char*
+#define cx_phmap_cmp_key(pk1,pk2,s)  strcmp(*(char**)(pk1),*(char**)(pk2))
+#define cx_phmap_hash_key(pk,s)      cx_hmap_hash_wy64_str(*(char**)(pk))
+#define cx_phmap_free_key(pk)        free(*pk)
+#define cx_phmap_free_val(pv)        free(*pv)
+#define cx_phmap_lambda              6
+#define cx_phmap_static
+#define cx_phmap_implement
+#include "cx_phmap.h"
+
+// Hashmap used as the source of the entries
+#define cx_hmap_name hmapii
+#define cx_hmap_key  uint64_t
+#define cx_hmap_val  uint64_t
+#define cx_hmap_static
+#define cx_hmap_implement
+#include "cx_hmap2.h"
+
+static char* newstr(size_t val) {
+
+    char buf[32];
+    snprintf(buf, sizeof(buf), "k%zu", val);
+    return strdup(buf);
+}
+
+static void test_phmapii(size_t size, const CxAllocator* alloc) {
+
+    LOGI("%s: size=%lu alloc=%p", __func__, size, alloc);
+
+    // Builds from the entries of a hashmap
+    hmapii src = hmapii_init(0);
+    for (size_t i = 0; i < size; i++) {
+        hmapii_set(&src, i * 0x100000001ull, i * 3);
+    }
+    phmapii m = phmapii_init(alloc);
+    hmapii_iter iter = {0};
+    hmapii_entry* e;
+    while ((e = hmapii_next(&src, &iter)) != NULL) {
+        phmapii_add(&m, e->key, e->val);
+    }
+    hmapii_free(&src);
+    CXCHK(phmapii_build(&m));
+    CXCHK(phmapii_count(&m) == size);
+    for (size_t i = 0; i < size; i++) {
+        uint64_t* v = phmapii_get(&m, i * 0x100000001ull);
+        CXCHK(v && *v == i * 3);
+        CXCHK(phmapii_get(&m, i * 0x100000001ull + 1) == NULL);
+    }
+    // All positions are used
+    for (size_t i = 0; i < size; i++) {
+        phmapii_entry* pe = phmapii_at(&m, i);
+        CXCHK(pe && *phmapii_get(&m, pe->key) == pe->val);
+    }
+    CXCHK(phmapii_at(&m, size) == NULL);
+
+    // Saves to file and opens it mapped in memory
+    char path[] = "/tmp/cx_phmap_XXXXXX";
+    FILE* f = fdopen(mkstemp(path), "w");
+    CXCHK(f);
+    CxWriter out = cx_writer_file(f);
+    CXERR_CHK(phmapii_freeze(&m, &out));
+    fclose(f);
+    phmapii fm;
+    CXERR_CHK(phmapii_mapped_open(path, &fm));
+    unlink(path);
+    CXCHK(phmapii_count(&fm) == size);
+    for (size_t i = 0; i < size; i++) {
+        uint64_t* v = phmapii_get(&fm, i * 0x100000001ull);
+        CXCHK(v && *v == i * 3);
+        CXCHK(phmapii_get(&fm, i * 0x100000001ull + 1) == NULL);
+    }
+    phmapii_mapped_close(&fm);
+
+    // Adding entries requires a new build
+    phmapii_add(&m, 1, 1);
+    CXCHK(phmapii_get(&m, 0) == NULL);
+    CXCHK(phmapii_build(&m));
+    CXCHK(*phmapii_get(&m, 1) == 1);
+
+    // Duplicated keys
+    phmapii_add(&m, 1, 2);
+    CXCHK(!phmapii_build(&m));
+    CXCHK(phmapii_get(&m, 1) == NULL);
+    phmapii_free(&m);
+}
+
+static void test_phmapcc(size_t size) {
+
+    LOGI("%s: size=%lu", __func__, size);
+    phmapcc m = phmapcc_init();
+    CXCHK(phmapcc_build(&m));
+    CXCHK(phmapcc_get(&m, "k0") == NULL);
+    for (size_t i = 0; i < size; i++) {
+        phmapcc_add(&m, newstr(i), newstr(i * 2));
+    }
+    CXCHK(phmapcc_build(&m));
+    char key[32];
+    for (size_t i = 0; i < size; i++) {
+        snprintf(key, sizeof(key), "k%zu", i);
+        char** v = phmapcc_get(&m, key);
+        CXCHK(v && atoi(*v + 1) == (int)i * 2);
+        snprintf(key, sizeof(key), "x%zu", i);
+        CXCHK(phmapcc_get(&m, key) == NULL);
+    }
+    phmapcc_free(&m);
+}
+
+void test_phmap(void) {
+
+    test_phmapii(0, NULL);
+    test_phmapii(1, NULL);
+    test_phmapii(7, NULL);
+    test_phmapii(10000, NULL);
+    test_phmapii(10000, cx_def_allocator());
+    test_phmapcc(1);
+    test_phmapcc(3000);
+}
+
+__attribute__((constructor))
+static void reg_phmap(void) {
+
+    reg_add_test("phmap", test_phmap);
+}
@@ -0,0 +1,177 @@
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+#include <stdatomic.h>
+
+#include "logger.h"
+#include "util.h"
+#include "registry.h"
+
+#define cx_rmap_name rmapii
+#define cx_rmap_key  uint64_t
+#define cx_rmap_val  uint64_t
+#define cx_rmap_instance_allocator
+#define cx_rmap_static
+#define cx_rmap_implement
+#include "cx_rmap.h"
+
+uint64_t cx_hmap_hash_wy64_str(const char* str);
+
+// Map with allocated string keys and values
+#define cx_rmap_name rmapss
+#define cx_rmap_key  char*
+#define cx_rmap_val  char*
+#define cx_rmap_cmp_key(pk1,pk2,s) strcmp(*(char**)pk1,*(char**)pk2)
+#define cx_rmap_hash_key(pk,s) cx_hmap_hash_wy64_str(*(char**)pk)
+#define cx_rmap_free_key(pk) free(*(char**)pk)
+#define cx_rmap_free_val(pv) free(*(char**)pv)
+#define cx_rmap_static
+#define cx_rmap_implement
+#include "cx_rmap.h"
+
+typedef struct Test {
+    rmapii*     m;
+    size_t      nkeys;
+    atomic_bool stop;
+    size_t      reads;
+} Test;
+
+// Reads keys until stopped checking that values are consistent with their keys
+static void* reader(void* arg) {
+
+    Test* t = arg;
+    rmapii_reader* r = rmapii_reader_add(t->m);
+    CHK(r != NULL);
+    uint64_t key = 0;
+    while (!atomic_load(&t->stop)) {
+        rmapii_read_begin(r);
+        for (size_t i = 0; i < 100; i++) {
+            uint64_t const* v = rmapii_get(r, key);
+            CHK(v == NULL || *v % t->nkeys == key);
+            key = (key + 1) % t->nkeys;
+        }
+        rmapii_read_end(r);
+        // Count can be read outside of a read section while the writer replaces versions
+        CHK(rmapii_count(t->m) <= t->nkeys);
+        t->reads++;
+    }
+    rmapii_reader_del(r);
+    return NULL;
+}
+
+void test_rmap(void) {
+
+    // Single thread
+    {
+        LOGI("rmap 1T");
+        rmapii m = rmapii_init(NULL, 0);
+        rmapii_reader* r = rmapii_reader_add(&m);
+        const size_t size = 2000;
+        for (size_t i = 0; i < size; i++) {
+            rmapii_set(&m, i, i * 2);
+        }
+        CHK(rmapii_count(&m) == size);
+        for (size_t i = 0; i < size; i++) {
+            uint64_t v;
+            CHK(rmapii_get_copy(r, i, &v) && v == i * 2);
+        }
+        // Deletes odd keys in one version
+        uint64_t keys[size / 2];
+        for (size_t i = 0; i < size / 2; i++) {
+            keys[i] = i * 2 + 1;
+        }
+        CHK(rmapii_del_batch(&m, keys, size / 2) == size / 2);
+        CHK(rmapii_del_batch(&m, keys, size / 2) == 0);
+        CHK(rmapii_count(&m) == size / 2);
+        rmapii_read_begin(r);
+        for (size_t i = 0; i < size; i++) {
+            uint64_t const* v = rmapii_get(r, i);
+            CHK((v != NULL) == (i % 2 == 0));
+            CHK(v == NULL || *v == i * 2);
+        }
+        rmapii_read_end(r);
+        // Updates deleted keys in one version
+        uint64_t vals[size / 2];
+        for (size_t i = 0; i < size / 2; i++) {
+            vals[i] = keys[i] * 3;
+        }
+        rmapii_set_batch(&m, keys, vals, size / 2);
+        CHK(rmapii_count(&m) == size);
+        for (size_t i = 0; i < size; i++) {
+            uint64_t v;
+            CHK(rmapii_get_copy(r, i, &v) && v == (i % 2 ? i * 3 : i * 2));
+        }
+        CHK(rmapii_del(&m, 0));
+        CHK(!rmapii_del(&m, 0));
+        rmapii_clear(&m);
+        CHK(rmapii_count(&m) == 0);
+        CHK(rmapii_reclaim(&m) == 0);
+        rmapii_reader_del(r);
+        rmapii_free(&m);
+    }
+
+    // Version used by a reader is not reclaimed
+    {
+        LOGI("rmap reclaim");
+        rmapss m = rmapss_init(0);
+        rmapss_reader* r = rmapss_reader_add(&m);
+        char key[32];
+        for (size_t i = 0; i < 100; i++) {
+            snprintf(key, sizeof(key), "k%zu", i);
+            rmapss_set(&m, strdup(key), strdup(key));
+        }
+        CHK(rmapss_reclaim(&m) == 0);
+        rmapss_read_begin(r);
+        char* const* v = rmapss_get(r, "k10");
+        CHK(v && strcmp(*v, "k10") == 0);
+        // Replaces value and deletes key read by the reader
+        rmapss_set(&m, strdup("k10"), strdup("new"));
+        char* k10 = "k10";
+        CHK(rmapss_del(&m, k10));
+        CHK(rmapss_reclaim(&m) == 2);
+        CHK(strcmp(*v, "k10") == 0);
+        rmapss_read_end(r);
+        CHK(rmapss_reclaim(&m) == 0);
+        CHK(rmapss_count(&m) == 99);
+        rmapss_reader_del(r);
+        rmapss_free(&m);
+    }
+
+    // Concurrent readers and writer
+    {
+        const size_t nthreads = 4;
+        const size_t nkeys = 1000;
+        LOGI("rmap %zu readers", nthreads);
+        rmapii m = rmapii_init(NULL, 0);
+        Test tests[nthreads];
+        pthread_t ids[nthreads];
+        for (size_t i = 0; i < nthreads; i++) {
+            tests[i] = (Test){.m = &m, .nkeys = nkeys};
+            CHK(pthread_create(&ids[i], NULL, reader, &tests[i]) == 0);
+        }
+        for (size_t v = 0; v < 10; v++) {
+            for (size_t i = 0; i < nkeys; i++) {
+                rmapii_set(&m, i, v * nkeys + i);
+            }
+            for (size_t i = v % 2; i < nkeys; i += 2) {
+                CHK(rmapii_del(&m, i));
+            }
+        }
+        for (size_t i = 0; i < nthreads; i++) {
+            atomic_store(&tests[i].stop, true);
+            CHK(pthread_join(ids[i], NULL) == 0);
+        }
+        CHK(rmapii_reclaim(&m) == 0);
+        CHK(rmapii_count(&m) == nkeys / 2);
+        rmapii_free(&m);
+    }
+}
+
+__attribute__((constructor))
+static void reg_rmap(void) {
+
+    reg_add_test("rmap", test_rmap);
+}
+
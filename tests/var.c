@@ -136,6 +136,12 @@ static void test_var1(const CxAllocator* alloc) {
         CHK(cx_var_get_map_int(map_el, "kint", &vint) && vint == 20);
         CHK(cx_var_get_map_float(map_el, "kfloat", &vfloat) && vfloat == -0.2);
         CHK(cx_var_get_map_str(map_el, "kstr", &vstr) && strcmp(vstr, "second") == 0);
+        // Lookup and set using key views
+        CHK(cx_var_get_map_valn(map_el, "kintXYZ", 4) == cx_var_get_map_val(map_el, "kint"));
+        CHK(cx_var_get_map_valn(map_el, "kin", 3) == NULL);
+        CHKN(cx_var_set_map_valn(map_el, "knewXYZ", 4, cx_var_set_int(cx_var_new(alloc), 7)));
+        CHK(cx_var_get_map_len(map_el, &len) && len == 6);
+        CHK(cx_var_get_map_int(map_el, "knew", &vint) && vint == 7);
 
         CHK(cx_var_get_arr_buf(arr, 8, &vbuf, &len) && len == 3 && memcmp(vbuf, (uint8_t[]){0,1,2}, 3) == 0);
 